@@ -208,7 +208,7 @@ private:
 		bool r = false;
 		_u32 n = 0;
 
-		while(p_opt_array[n].opt_name) {
+		while(p_opt_array && p_opt_array[n].opt_name) {
 			if(p_opt_array[n].opt_value) {
 				if(mpi_str->str_cmp(val, p_opt_array[n].opt_value) == 0) {
 					r = true;
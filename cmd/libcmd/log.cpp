@@ -0,0 +1,211 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "iCmd.h"
+#include "iLog.h"
+#include "iRepository.h"
+
+// actions
+#define ACT_SINK	"sink"
+#define ACT_CLOSE	"close"
+#define ACT_MODE	"mode"
+#define ACT_STAT	"stat"
+#define ACT_DECODE	"decode"
+
+// mode arguments
+#define MODE_SYNC	"sync"
+#define MODE_ASYNC	"async"
+#define MODE_DROP	"drop"
+
+typedef struct {
+	_cstr_t	a_name;
+	_cmd_handler_t	*a_handler;
+}_cmd_action_t;
+
+class cCmdLog;
+
+static void fout(iIO *pi_io, _cstr_t fmt, ...) {
+	if(pi_io) {
+		va_list va;
+		_char_t lb[2048]="";
+		_u32 sz=0;
+
+		va_start(va, fmt);
+		sz = vsnprintf(lb, sizeof(lb), fmt, va);
+		if(sz >= sizeof(lb))
+			sz = sizeof(lb) - 1;
+		pi_io->write(lb, sz);
+		va_end(va);
+	}
+}
+
+static iLog *get_log(void) {
+	return (iLog *)_gpi_repo_->object_by_iname(I_LOG, RF_ORIGINAL);
+}
+
+static void cmd_log_sink(iCmd *pi_cmd, iCmdHost *pi_cmd_host,
+			iIO *pi_io, _cmd_opt_t *p_opt,
+			_u32 argc, _cstr_t argv[]) {
+	_cstr_t path = pi_cmd_host->argument(argc, argv, p_opt, 2);
+	_cstr_t seg_size = pi_cmd_host->argument(argc, argv, p_opt, 3);
+	_cstr_t rotate = pi_cmd_host->argument(argc, argv, p_opt, 4);
+	iLog *pi_log = NULL;
+
+	if(path) {
+		if((pi_log = get_log())) {
+			if(!pi_log->sink(path, (seg_size) ? atoi(seg_size) : LOG_SEGMENT_SIZE,
+					(rotate) ? atoi(rotate) : 0))
+				fout(pi_io, "Failed to open log file '%s'\n", path);
+			_gpi_repo_->object_release(pi_log);
+		}
+	} else
+		fout(pi_io, "log " ACT_SINK " <path> [segment size] [rotate time (sec.)]\n");
+}
+
+static void cmd_log_close(iCmd *pi_cmd, iCmdHost *pi_cmd_host,
+			iIO *pi_io, _cmd_opt_t *p_opt,
+			_u32 argc, _cstr_t argv[]) {
+	iLog *pi_log = get_log();
+
+	if(pi_log) {
+		pi_log->sink(NULL);
+		_gpi_repo_->object_release(pi_log);
+	}
+}
+
+static void cmd_log_mode(iCmd *pi_cmd, iCmdHost *pi_cmd_host,
+			iIO *pi_io, _cmd_opt_t *p_opt,
+			_u32 argc, _cstr_t argv[]) {
+	_cstr_t mode = pi_cmd_host->argument(argc, argv, p_opt, 2);
+	_cstr_t overflow = pi_cmd_host->argument(argc, argv, p_opt, 3);
+	iLog *pi_log = NULL;
+
+	if(mode && (strcmp(mode, MODE_SYNC) == 0 || strcmp(mode, MODE_ASYNC) == 0)) {
+		if((pi_log = get_log())) {
+			pi_log->mode((strcmp(mode, MODE_ASYNC) == 0) ? LOG_ASYNC : LOG_SYNC,
+					(overflow && strcmp(overflow, MODE_DROP) == 0) ? LOG_DROP : LOG_BLOCK);
+			_gpi_repo_->object_release(pi_log);
+		}
+	} else
+		fout(pi_io, "log " ACT_MODE " <" MODE_SYNC "|" MODE_ASYNC " [" MODE_DROP "]>\n");
+}
+
+static void cmd_log_stat(iCmd *pi_cmd, iCmdHost *pi_cmd_host,
+			iIO *pi_io, _cmd_opt_t *p_opt,
+			_u32 argc, _cstr_t argv[]) {
+	iLog *pi_log = get_log();
+
+	if(pi_log) {
+		_log_stat_t s;
+
+		pi_log->stat(&s);
+		fout(pi_io, "mode: %s%s\nmessages: %llu\ndropped: %llu\nflushed: %llu\nbatches: %llu\nbinary: %llu\n",
+				(s.mode == LOG_ASYNC) ? MODE_ASYNC : MODE_SYNC,
+				(s.mode == LOG_ASYNC && s.overflow == LOG_DROP) ? " (" MODE_DROP ")" : "",
+				(unsigned long long)s.messages, (unsigned long long)s.dropped,
+				(unsigned long long)s.flushed, (unsigned long long)s.batches,
+				(unsigned long long)s.binary);
+		_gpi_repo_->object_release(pi_log);
+	}
+}
+
+static void cmd_log_decode(iCmd *pi_cmd, iCmdHost *pi_cmd_host,
+			iIO *pi_io, _cmd_opt_t *p_opt,
+			_u32 argc, _cstr_t argv[]) {
+	_cstr_t arg = 0;
+	_u32 i = 2;
+	iLog *pi_log = get_log();
+
+	if(pi_log) {
+		while((arg = pi_cmd_host->argument(argc, argv, p_opt, i))) {
+			if(!pi_log->decode(arg, [](_u8 lmt, _u64 time, _cstr_t msg, void *udata) {
+				_cstr_t slmt[] = {"   ", "[I]", "[W]", "[E]"};
+				time_t t = time / 1000000000;
+				struct tm tm;
+				_char_t ts[32]="";
+
+				localtime_r(&t, &tm);
+				strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tm);
+				fout((iIO *)udata, "%s.%06u %s %s\n", ts, (_u32)(time % 1000000000 / 1000),
+						(lmt <= LMT_ERROR) ? slmt[lmt] : "[?]", msg);
+			}, pi_io))
+				fout(pi_io, "Failed to decode '%s'\n", arg);
+			i++;
+		}
+
+		_gpi_repo_->object_release(pi_log);
+	}
+}
+
+static _cmd_action_t _g_cmd_log_actions_[]={
+	{ ACT_SINK,		cmd_log_sink },
+	{ ACT_CLOSE,		cmd_log_close },
+	{ ACT_MODE,		cmd_log_mode },
+	{ ACT_STAT,		cmd_log_stat },
+	{ ACT_DECODE,		cmd_log_decode },
+	{ 0,			0 }
+};
+
+static void cmd_log_handler(iCmd *pi_cmd, iCmdHost *pi_cmd_host,
+			iIO *pi_io, _cmd_opt_t *p_opt,
+			_u32 argc, _cstr_t argv[]) {
+	_cstr_t arg = pi_cmd_host->argument(argc, argv, p_opt, 1);
+
+	if(arg) {
+		_u32 n = 0;
+
+		while(_g_cmd_log_actions_[n].a_name) {
+			if(strcmp(arg, _g_cmd_log_actions_[n].a_name) == 0) {
+				_g_cmd_log_actions_[n].a_handler(pi_cmd, pi_cmd_host,
+								pi_io, p_opt,
+								argc, argv);
+				break;
+			}
+			n++;
+		}
+
+		if(_g_cmd_log_actions_[n].a_name == 0)
+			fout(pi_io, "Unknown action '%s'\n", arg);
+	}
+}
+
+static _cmd_t _g_cmd_log_[]={
+	{ "log",	0, cmd_log_handler,
+		"Log management",
+		"Manage the log by following actions:\n"
+		ACT_SINK "\t\t:Write messages to binary file <path> [segment size] [rotate time (sec.)]\n"
+		ACT_CLOSE "\t\t:Close the binary file\n"
+		ACT_MODE "\t\t:Set mode (" MODE_SYNC ", " MODE_ASYNC " [" MODE_DROP "])\n"
+		ACT_STAT "\t\t:Print statistics\n"
+		ACT_DECODE "\t\t:Print content of binary file segments\n",
+		"log <action> [arguments]"
+	},
+	{ 0,	0,	0,	0,	0,	0 }
+};
+
+class cCmdLog: public iCmd {
+public:
+	BASE(cCmdLog, "cCmdLog", RF_ORIGINAL, 1,0,0);
+
+	bool object_ctl(_u32 cmd, void *arg, ...) {
+		bool r = false;
+
+		switch(cmd) {
+			case OCTL_INIT:
+				r = true;
+				break;
+			case OCTL_UNINIT:
+				r = true;
+				break;
+		}
+
+		return r;
+	}
+
+	_cmd_t *get_info(void) {
+		return _g_cmd_log_;
+	}
+};
+
+static cCmdLog _g_cmd_log_object_;
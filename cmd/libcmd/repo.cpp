@@ -1,6 +1,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <dlfcn.h>
+#include <unistd.h>
 #include "iCmd.h"
 #include "iRepository.h"
 
@@ -13,6 +14,13 @@
 #define ACT_LIST	"list"
 #define ACT_LOAD	"load"
 #define ACT_UNLOAD	"unload"
+#define ACT_TRACE	"trace"
+
+// trace arguments
+#define TRACE_ON	"on"
+#define TRACE_OFF	"off"
+#define TRACE_CLEAR	"clear"
+#define TRACE_SAVE	"save"
 
 typedef struct {
 	_cstr_t	a_name;
@@ -122,10 +130,83 @@ static void cmd_ext_unload(iCmd *pi_cmd, iCmdHost *pi_cmd_host,
 	}
 }
 
+// write trace events in Chrome trace format (chrome://tracing, Perfetto)
+static void trace_save(iIO *pi_io, FILE *f) {
+	typedef struct {
+		iIO	*pi_io;
+		FILE	*f;
+		_u32	count;
+	}_enum_t;
+
+	_enum_t e = {pi_io, f, 0};
+	_cstr_t hdr = "{\"traceEvents\":[\n";
+
+	if(f)
+		fputs(hdr, f);
+	else
+		fout(pi_io, "%s", hdr);
+
+	_gpi_repo_->trace_enum([](_trace_event_t *p_event, void *udata) {
+		_enum_t *pe = (_enum_t *)udata;
+		_char_t lb[512]="";
+
+		snprintf(lb, sizeof(lb), "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+				"\"ts\":%llu,\"dur\":%u,\"pid\":%d,\"tid\":%u,\"args\":{\"count\":%u}}\n",
+				(pe->count) ? "," : "",
+				p_event->name, p_event->cat,
+				(unsigned long long)p_event->ts, p_event->dur,
+				getpid(), p_event->tid, p_event->count);
+
+		if(pe->f)
+			fputs(lb, pe->f);
+		else
+			fout(pe->pi_io, "%s", lb);
+
+		pe->count++;
+	}, &e);
+
+	if(f)
+		fputs("]}\n", f);
+	else
+		fout(pi_io, "]}\n");
+}
+
+static void cmd_repo_trace(iCmd *pi_cmd, iCmdHost *pi_cmd_host,
+			iIO *pi_io, _cmd_opt_t *p_opt,
+			_u32 argc, _cstr_t argv[]) {
+	_cstr_t arg = pi_cmd_host->argument(argc, argv, p_opt, 2);
+
+	if(arg) {
+		if(strcmp(arg, TRACE_ON) == 0)
+			_gpi_repo_->trace_enable(true);
+		else if(strcmp(arg, TRACE_OFF) == 0)
+			_gpi_repo_->trace_enable(false);
+		else if(strcmp(arg, TRACE_CLEAR) == 0)
+			_gpi_repo_->trace_clear();
+		else if(strcmp(arg, TRACE_SAVE) == 0) {
+			_cstr_t fname = pi_cmd_host->argument(argc, argv, p_opt, 3);
+
+			if(fname) {
+				FILE *f = fopen(fname, "w");
+
+				if(f) {
+					trace_save(pi_io, f);
+					fclose(f);
+				} else
+					fout(pi_io, "Failed to open '%s'\n", fname);
+			} else
+				trace_save(pi_io, NULL);
+		} else
+			fout(pi_io, "Unknown trace argument '%s'\n", arg);
+	} else
+		fout(pi_io, "repo trace <" TRACE_ON "|" TRACE_OFF "|" TRACE_CLEAR "|" TRACE_SAVE " [file]>\n");
+}
+
 static _cmd_action_t _g_cmd_repo_actions_[]={
 	{ ACT_LIST,		cmd_repo_list },
 	{ ACT_LOAD,		cmd_ext_load },
 	{ ACT_UNLOAD,		cmd_ext_unload },
+	{ ACT_TRACE,		cmd_repo_trace },
 	{ 0,			0 }
 };
 
@@ -170,7 +251,8 @@ static _cmd_t _g_cmd_repo_[]={
 		"Manage reposiotory by following actions:\n"
 		ACT_LIST "\t\t:Print available objects\n"
 		ACT_LOAD "\t\t:Load extension\n"
-		ACT_UNLOAD "\t\t:Unload extension\n",
+		ACT_UNLOAD "\t\t:Unload extension\n"
+		ACT_TRACE "\t\t:Initialization trace (on, off, clear, save [file] in Chrome JSON format)\n",
 		"repo [options] <action>"
 	},
 	{ 0,	0,	0,	0,	0,	0 }
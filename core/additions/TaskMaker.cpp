@@ -5,10 +5,14 @@
 #include "iRepository.h"
 #include "iTaskMaker.h"
 #include "iMemory.h"
+#include "futex.h"
 
 #define TS_RUNNING	(1<<0)
 #define TS_IDLE		(1<<1)
 #define TS_STOPPED	(1<<2)
+#define TS_PENDING	(1<<3) // assigned, but not started yet
+
+#define TM_MAX_POOLS	16
 
 typedef struct {
 	iBase 		*pi_base;
@@ -25,6 +29,8 @@ typedef void *_thread_t(void *);
 class cTaskMaker: public iTaskMaker {
 private:
 	iPool	*mpi_pool;
+	iThreadPool	*mpi_tpool[TM_MAX_POOLS]; // shared thread pools
+	_futex_mutex_t	m_tpool_lock;
 
 	friend void *starter(_task_t *task);
 
@@ -62,14 +68,27 @@ private:
 	HTASK start_task(_task_t *task) {
 		HTASK r = 0;
 
+		task->state = TS_RUNNING | TS_PENDING;
 		if(pthread_create(&task->thread, 0, (_thread_t *)starter, task) == ERR_NONE) {
 			r = task;
 			usleep(1);
-		}
+		} else
+			task->state = 0;
 
 		return r;
 	}
 
+	// pass the job to idle thread
+	HTASK assign_task(_task_t *task) {
+		_u8 s;
+
+		do {
+			s = task->state;
+		} while(!__sync_bool_compare_and_swap(&task->state, s, (s & ~TS_IDLE) | TS_PENDING));
+
+		return task;
+	}
+
 	bool wait_for_idle(_task_t *task, _u32 timeout) {
 		bool r = false;
 		_u32 n = timeout;
@@ -88,7 +107,10 @@ private:
 	bool stop_task(_task_t *task) {
 		bool r = false;
 
-		if(!(task->state & TS_IDLE) && (task->state & TS_RUNNING)) {
+		if(__sync_fetch_and_and(&task->state, ~TS_PENDING) & TS_PENDING)
+			// cancelled before start, the thread only releases it
+			r = wait_for_idle(task, 0);
+		else if(!(task->state & TS_IDLE) && (task->state & TS_RUNNING)) {
 			if(task->pi_base) {
 				if((r = task->pi_base->object_ctl(OCTL_STOP, 0)))
 					r = wait_for_idle(task, 100);
@@ -131,7 +153,7 @@ private:
 					break;
 				case POOL_OP_DELETE:
 					p_tmaker->stop_task(p_task);
-					p_task->state &= ~TS_RUNNING;
+					__sync_fetch_and_and(&p_task->state, ~TS_RUNNING);
 					while(!(p_task->state & TS_STOPPED))
 						usleep(10000);
 					break;
@@ -148,11 +170,20 @@ public:
 		switch(cmd) {
 			case OCTL_INIT: {
 				iRepository *pi_repo = (iRepository*)arg;
+				memset(mpi_tpool, 0, sizeof(mpi_tpool));
+				futex_mutex_init(&m_tpool_lock);
 				if((mpi_pool = (iPool*)pi_repo->object_by_iname(I_POOL, RF_CLONE)))
 					r = init_pool();
 			} break;
 			case OCTL_UNINIT: {
 				iRepository *pi_repo = (iRepository*)arg;
+				for(_u32 i = 0; i < TM_MAX_POOLS; i++) {
+					if(mpi_tpool[i]) {
+						mpi_tpool[i]->uninit();
+						pi_repo->object_release(mpi_tpool[i]);
+						mpi_tpool[i] = NULL;
+					}
+				}
 				pi_repo->object_release(mpi_pool);
 				r = true;
 			} break;
@@ -173,7 +204,7 @@ public:
 				if(!(p_task->state & TS_RUNNING))
 					r = start_task(p_task);
 				else
-					r = p_task;
+					r = assign_task(p_task);
 			}
 		}
 
@@ -195,7 +226,7 @@ public:
 			if(!(p_task->state & TS_RUNNING))
 				r = start_task(p_task);
 			else
-				r = p_task;
+				r = assign_task(p_task);
 		}
 
 		return r;
@@ -256,6 +287,38 @@ public:
 
 		return r;
 	}
+
+	iThreadPool *pool(_cstr_t name, _u32 threads=0, _u64 cpu_mask=0) {
+		iThreadPool *r = NULL;
+		_s32 slot = -1;
+
+		futex_mutex_lock(&m_tpool_lock);
+
+		for(_u32 i = 0; i < TM_MAX_POOLS; i++) {
+			if(mpi_tpool[i]) {
+				if(strcmp(mpi_tpool[i]->name(), name) == 0) {
+					r = mpi_tpool[i];
+					break;
+				}
+			} else if(slot < 0)
+				slot = i;
+		}
+
+		if(!r && slot >= 0) {
+			if((r = (iThreadPool *)_gpi_repo_->object_by_iname(I_THREAD_POOL, RF_CLONE))) {
+				if(r->init(name, threads, cpu_mask))
+					mpi_tpool[slot] = r;
+				else {
+					_gpi_repo_->object_release(r);
+					r = NULL;
+				}
+			}
+		}
+
+		futex_mutex_unlock(&m_tpool_lock);
+
+		return r;
+	}
 };
 
 static cTaskMaker _g_task_maker_;
@@ -263,24 +326,22 @@ static cTaskMaker _g_task_maker_;
 static void *starter(_task_t *task) {
 	void *r = 0;
 
-	task->state = TS_RUNNING;
-
 	while(task->state & TS_RUNNING) {
-		if(task->pi_base) {
-			_object_info_t oi;
-
-			task->pi_base->object_info(&oi);
-			task->state &= ~TS_IDLE;
-			_g_task_maker_.set_name(task, oi.cname);
-			task->pi_base->object_ctl(OCTL_START, task->arg);
-		} else if(task->proc) {
-			_g_task_maker_.set_name(task, task->name);
-			task->state &= ~TS_IDLE;
-			r = task->proc(TM_SIG_START, task->arg);
+		if(__sync_fetch_and_and(&task->state, ~TS_PENDING) & TS_PENDING) {
+			if(task->pi_base) {
+				_object_info_t oi;
+
+				task->pi_base->object_info(&oi);
+				_g_task_maker_.set_name(task, oi.cname);
+				task->pi_base->object_ctl(OCTL_START, task->arg);
+			} else if(task->proc) {
+				_g_task_maker_.set_name(task, task->name);
+				r = task->proc(TM_SIG_START, task->arg);
+			}
 		}
 
 		if(!(task->state & TS_IDLE)) {
-			task->state |= TS_IDLE;
+			__sync_fetch_and_or(&task->state, TS_IDLE);
 			task->pi_base = NULL;
 			task->proc = NULL;
 			_g_task_maker_.set_name(task, "idle");
@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <atomic>
+#include "iRepository.h"
+#include "iTaskMaker.h"
+#include "iMemory.h"
+#include "futex.h"
+
+#define TP_MAX_THREADS	256
+
+// job state
+#define JOB_DONE	(1<<0)
+#define JOB_DETACHED	(1<<1)
+#define JOB_WAITING	(1<<2)
+
+typedef struct job _job_t;
+struct job {
+	_job_proc_t	*proc;
+	void		*arg;
+	void		*result;
+	_job_t		*next;
+	_u64		cpu_ns;
+	std::atomic<_u32> state; // futex word for waiters
+	_u8		prio;
+};
+
+class cThreadPool;
+
+typedef struct { // worker thread and its queue
+	_futex_mutex_t	lock;
+	_job_t		*head[JOB_PRIO_COUNT];
+	_job_t		*tail[JOB_PRIO_COUNT];
+	std::atomic<_u32> count;
+	pthread_t	thread;
+	cThreadPool	*p_pool;
+	_u32		index;
+	_u8		pad[64];
+}_worker_t;
+
+static thread_local _worker_t *_g_tp_worker_ = NULL;
+
+static _u64 thread_cpu_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (_u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+class cThreadPool: public iThreadPool {
+private:
+	_char_t		m_name[16];
+	iPool		*mpi_jobs;
+	_worker_t	*mp_workers;
+	_u32		m_threads;
+	std::atomic<bool> m_running;
+	std::atomic<_u32> m_next; // round robin for external submit
+	_futex_wq_t	m_wq; // idle workers
+	std::atomic<_u64> m_done;
+	std::atomic<_u64> m_steals;
+	std::atomic<_u64> m_cpu;
+
+	void push(_worker_t *pw, _job_t *p_job) {
+		futex_mutex_lock(&pw->lock);
+		p_job->next = NULL;
+		if(pw->tail[p_job->prio])
+			pw->tail[p_job->prio]->next = p_job;
+		else
+			pw->head[p_job->prio] = p_job;
+		pw->tail[p_job->prio] = p_job;
+		pw->count++;
+		futex_mutex_unlock(&pw->lock);
+	}
+
+	// highest priority first
+	_job_t *pop(_worker_t *pw) {
+		_job_t *r = NULL;
+
+		if(pw->count.load(std::memory_order_relaxed)) {
+			futex_mutex_lock(&pw->lock);
+			for(_u32 i = 0; i < JOB_PRIO_COUNT; i++) {
+				if((r = pw->head[i])) {
+					if(!(pw->head[i] = r->next))
+						pw->tail[i] = NULL;
+					pw->count--;
+					break;
+				}
+			}
+			futex_mutex_unlock(&pw->lock);
+		}
+
+		return r;
+	}
+
+	_job_t *get_job(_worker_t *pw) {
+		_job_t *r = pop(pw);
+
+		// steal
+		for(_u32 i = 1; !r && i < m_threads; i++) {
+			if((r = pop(&mp_workers[(pw->index + i) % m_threads])))
+				m_steals.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		return r;
+	}
+
+	void free_job(_job_t *p_job) {
+		mpi_jobs->free(p_job);
+	}
+
+	void run(_job_t *p_job) {
+		_u64 cpu = thread_cpu_ns();
+		_u32 state = 0;
+
+		p_job->result = p_job->proc(p_job->arg);
+		p_job->cpu_ns = thread_cpu_ns() - cpu;
+		m_cpu.fetch_add(p_job->cpu_ns, std::memory_order_relaxed);
+		m_done.fetch_add(1, std::memory_order_relaxed);
+
+		state = p_job->state.fetch_or(JOB_DONE);
+		if(state & JOB_DETACHED)
+			free_job(p_job);
+		else if(state & JOB_WAITING)
+			// memory of pool records stays mapped, even if waiter has released it
+			futex_wake(&p_job->state, INT_MAX);
+	}
+
+	static void *worker(void *arg) {
+		_worker_t *pw = (_worker_t *)arg;
+		cThreadPool *p_pool = pw->p_pool;
+		_char_t name[16]="";
+
+		_g_tp_worker_ = pw;
+		snprintf(name, sizeof(name), "%.10s/%u", p_pool->m_name, pw->index);
+		pthread_setname_np(pthread_self(), name);
+
+		while(p_pool->m_running.load(std::memory_order_relaxed)) {
+			_job_t *p_job = NULL;
+
+			futex_wq_wait(&p_pool->m_wq, 0, [&]()->bool {
+				return ((p_job = p_pool->get_job(pw)) || !p_pool->m_running.load());
+			});
+
+			if(p_job)
+				p_pool->run(p_job);
+		}
+
+		return NULL;
+	}
+
+	void set_affinity(pthread_t thread, _u64 cpu_mask) {
+		cpu_set_t cpus;
+
+		CPU_ZERO(&cpus);
+		for(_u32 i = 0; i < 64; i++) {
+			if(cpu_mask & (1ULL << i))
+				CPU_SET(i, &cpus);
+		}
+
+		pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+	}
+
+public:
+	BASE(cThreadPool, "cThreadPool", RF_CLONE, 1,0,0);
+
+	bool object_ctl(_u32 cmd, void *arg, ...) {
+		bool r = false;
+
+		switch(cmd) {
+			case OCTL_INIT:
+				memset(m_name, 0, sizeof(m_name));
+				mpi_jobs = NULL;
+				mp_workers = NULL;
+				m_threads = 0;
+				m_running = false;
+				r = true;
+				break;
+			case OCTL_UNINIT:
+				uninit();
+				r = true;
+				break;
+		}
+
+		return r;
+	}
+
+	bool init(_cstr_t name, _u32 threads=0, _u64 cpu_mask=0) {
+		bool r = false;
+
+		if(!mp_workers) {
+			if(!threads)
+				threads = sysconf(_SC_NPROCESSORS_ONLN);
+			if(threads > TP_MAX_THREADS)
+				threads = TP_MAX_THREADS;
+
+			strncpy(m_name, (name) ? name : "pool", sizeof(m_name) - 1);
+			m_next = 0;
+			m_done = m_steals = m_cpu = 0;
+			futex_wq_init(&m_wq);
+
+			if((mpi_jobs = (iPool *)_gpi_repo_->object_by_iname(I_POOL, RF_CLONE))) {
+				if(mpi_jobs->init(sizeof(_job_t), NULL, NULL, NULL, POOL_SHARDED) &&
+						(mp_workers = (_worker_t *)calloc(threads, sizeof(_worker_t)))) {
+					m_running = true;
+
+					for(m_threads = 0; m_threads < threads; m_threads++) {
+						_worker_t *pw = &mp_workers[m_threads];
+
+						futex_mutex_init(&pw->lock);
+						pw->p_pool = this;
+						pw->index = m_threads;
+					}
+
+					for(_u32 i = 0; i < m_threads; i++) {
+						_worker_t *pw = &mp_workers[i];
+
+						if(pthread_create(&pw->thread, NULL, worker, pw) == 0) {
+							if(cpu_mask)
+								set_affinity(pw->thread, cpu_mask);
+						} else {
+							m_threads = i;
+							break;
+						}
+					}
+
+					r = (m_threads > 0);
+				}
+			}
+
+			if(!r)
+				uninit();
+		}
+
+		return r;
+	}
+
+	void uninit(void) {
+		if(mp_workers) {
+			m_running = false;
+			futex_wq_notify(&m_wq, INT_MAX);
+
+			for(_u32 i = 0; i < m_threads; i++)
+				pthread_join(mp_workers[i].thread, NULL);
+
+			// complete the rest (somebody can wait for it)
+			for(_u32 i = 0; i < m_threads; i++) {
+				_job_t *p_job = NULL;
+
+				while((p_job = pop(&mp_workers[i])))
+					run(p_job);
+			}
+
+			::free(mp_workers);
+			mp_workers = NULL;
+			m_threads = 0;
+		}
+
+		if(mpi_jobs) {
+			_gpi_repo_->object_release(mpi_jobs);
+			mpi_jobs = NULL;
+		}
+	}
+
+	HJOB submit(_job_proc_t *proc, void *arg, _u8 prio=JOB_PRIO_NORMAL) {
+		HJOB r = NULL;
+		_job_t *p_job = NULL;
+
+		if(m_running.load(std::memory_order_relaxed) && (p_job = (_job_t *)mpi_jobs->alloc())) {
+			_worker_t *pw = _g_tp_worker_;
+
+			p_job->proc = proc;
+			p_job->arg = arg;
+			p_job->result = NULL;
+			p_job->cpu_ns = 0;
+			p_job->state = 0;
+			p_job->prio = (prio < JOB_PRIO_COUNT) ? prio : JOB_PRIO_LOW;
+
+			if(!pw || pw->p_pool != this)
+				// external thread
+				pw = &mp_workers[m_next.fetch_add(1, std::memory_order_relaxed) % m_threads];
+
+			push(pw, p_job);
+			futex_wq_notify(&m_wq, 1);
+			r = p_job;
+		}
+
+		return r;
+	}
+
+	bool wait(HJOB h, void **pp_result=0, _u32 timeout=0) {
+		bool r = false;
+		_job_t *p_job = (_job_t *)h;
+
+		if(p_job) {
+			_u64 deadline = (timeout) ? futex_now_ms() + timeout : 0;
+			_u32 state = p_job->state.load(std::memory_order_acquire);
+
+			while(!(state & JOB_DONE)) {
+				struct timespec ts, *p_ts = NULL;
+
+				if(deadline) {
+					_u64 now = futex_now_ms();
+
+					if(now >= deadline)
+						break;
+					ts.tv_sec = (deadline - now) / 1000;
+					ts.tv_nsec = ((deadline - now) % 1000) * 1000000;
+					p_ts = &ts;
+				}
+
+				if(_g_tp_worker_ && _g_tp_worker_->p_pool == this) {
+					// waiting in worker thread: run other jobs meanwhile,
+					// otherwise nested jobs can block all workers
+					_job_t *p_next = get_job(_g_tp_worker_);
+
+					if(p_next) {
+						run(p_next);
+						state = p_job->state.load(std::memory_order_acquire);
+						continue;
+					}
+
+					// nothing to run, check again soon
+					if(!p_ts || p_ts->tv_sec || p_ts->tv_nsec > 1000000) {
+						ts.tv_sec = 0;
+						ts.tv_nsec = 1000000;
+						p_ts = &ts;
+					}
+				}
+
+				state = p_job->state.fetch_or(JOB_WAITING) | JOB_WAITING;
+				if(!(state & JOB_DONE)) {
+					futex_wait(&p_job->state, state, p_ts);
+					state = p_job->state.load(std::memory_order_acquire);
+				}
+			}
+
+			if(state & JOB_DONE) {
+				if(pp_result)
+					*pp_result = p_job->result;
+				free_job(p_job);
+				r = true;
+			}
+		}
+
+		return r;
+	}
+
+	bool done(HJOB h) {
+		return (h && (((_job_t *)h)->state.load(std::memory_order_acquire) & JOB_DONE));
+	}
+
+	_u64 cpu_time(HJOB h) {
+		return (done(h)) ? ((_job_t *)h)->cpu_ns : 0;
+	}
+
+	void release(HJOB h) {
+		_job_t *p_job = (_job_t *)h;
+
+		if(p_job) {
+			if(p_job->state.fetch_or(JOB_DETACHED) & JOB_DONE)
+				free_job(p_job);
+		}
+	}
+
+	_cstr_t name(void) {
+		return m_name;
+	}
+
+	void stat(_tpool_stat_t *p_stat) {
+		p_stat->threads = m_threads;
+		p_stat->pending = 0;
+		for(_u32 i = 0; i < m_threads; i++)
+			p_stat->pending += mp_workers[i].count.load(std::memory_order_relaxed);
+		p_stat->done = m_done.load(std::memory_order_relaxed);
+		p_stat->steals = m_steals.load(std::memory_order_relaxed);
+		p_stat->cpu_time = m_cpu.load(std::memory_order_relaxed);
+	}
+};
+
+static cThreadPool _g_thread_pool_;
@@ -1,37 +1,179 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
 #include "iRepository.h"
 #include "iMemory.h"
 #include "iLog.h"
 #include "iSync.h"
 #include "iArgs.h"
+#include "futex.h"
+#include "log_file.h"
 
 #define MAX_MSG_BUFFER		1024
 #define DEFAULT_RB_CAPACITY 	16384
+#define MIN_MQ_CAPACITY		(MAX_MSG_BUFFER * 4)
+#define FLUSH_INTERVAL		100 // ms.
+
+#define LMT_BINARY		0x80 // message with deferred formatting
 
 class cLog: public iLog {
 private:
-	iRingBuffer *mpi_rb;
+	iRingBuffer *mpi_rb; // history
+	iRingBuffer *mpi_mq; // pending messages
 	iLlist *mpi_lstr;
+	std::atomic<bool> m_draining;
+	// asynchronous mode
+	std::atomic<_u8> m_mode;
+	std::atomic<_u8> m_overflow;
+	std::atomic<bool> m_running;
+	std::thread m_flusher;
+	_futex_wq_t m_wq; // flusher waits here
+	_futex_wq_t m_pwq; // writers wait here for free space (LOG_BLOCK) and flush
+	// statistics
+	std::atomic<_u64> m_messages;
+	std::atomic<_u64> m_dropped;
+	std::atomic<_u64> m_flushed;
+	std::atomic<_u64> m_batches;
+	std::atomic<_u64> m_binary;
+	// file sink (written by the consumer under lock)
+	_log_file_t m_file;
+
+	void dispatch(_str_t msg, HMUTEX hm) {
+		_u32 sz = 0;
+		_log_listener_t **plstr = (_log_listener_t**)mpi_lstr->first(&sz, hm);
 
-	void sync(void) {
-		_str_t msg = 0;
+		if(plstr) {
+			do {
+				_log_listener_t *f = *plstr;
+				f(msg[0], msg+1);
+			}while((plstr = (_log_listener_t**)mpi_lstr->next(&sz, hm)));
+		}
+	}
 
-		if(mpi_rb && mpi_lstr && mpi_lstr->cnt()) {
-			_u16 sz = 0;
+	// Writers only commit messages to the lock free queue. The thread which
+	// wins 'm_draining' moves them to history and listeners on behalf of all.
+	void drain(HMUTEX hm=0) {
+		while(mpi_mq && !m_draining.exchange(true)) {
+			_str_t msg = 0;
+			_u32 sz = 0;
+			HMUTEX h = lock(hm);
 
-			while((msg = (_str_t)mpi_rb->pull(&sz))) {
-				HMUTEX hm = mpi_lstr->lock();
-				_u32 sz = 0;
-				_log_listener_t **plstr = (_log_listener_t**)mpi_lstr->first(&sz, hm);
-				if(plstr) {
-					do {
-						_log_listener_t *f = *plstr;
-						f(msg[0], msg+1);
-					}while((plstr = (_log_listener_t**)mpi_lstr->next(&sz, hm)));
+			_u64 n = 0;
+			bool file = lf_is_open(&m_file);
+
+			while((msg = (_str_t)mpi_mq->read(&sz))) {
+				if(msg[0] & LMT_BINARY) {
+					// [lmt][time][format pointer][arguments]
+					_char_t txt[MAX_MSG_BUFFER];
+					_u32 hdr = 1 + sizeof(_u64) + sizeof(_cstr_t);
+					_u64 time = 0;
+					_cstr_t fmt = NULL;
+
+					memcpy(&time, msg + 1, sizeof(time));
+					memcpy(&fmt, msg + 1 + sizeof(time), sizeof(fmt));
+					txt[0] = msg[0] & ~LMT_BINARY;
+					if(file)
+						lf_binary(&m_file, txt[0], time, fmt, (_u8 *)msg + hdr, sz - hdr);
+					sz = log_format(txt + 1, sizeof(txt) - 1, fmt, (_u8 *)msg + hdr, sz - hdr) + 2;
+					mpi_rb->push(txt, sz);
+					dispatch(txt, h);
+				} else {
+					// [lmt][time][text] --> [lmt][text]
+					_u64 time = 0;
+					_str_t txt = msg + sizeof(time);
+
+					memcpy(&time, msg + 1, sizeof(time));
+					txt[0] = msg[0];
+					if(file)
+						lf_text(&m_file, txt[0], time, txt + 1, strlen(txt + 1));
+					mpi_rb->push(txt, sz - sizeof(time));
+					dispatch(txt, h);
 				}
-				mpi_lstr->unlock(hm);
+				mpi_mq->release();
+				n++;
 			}
+
+			if(file)
+				// rotation by time and the next segment
+				lf_tick(&m_file);
+
+			unlock(h);
+
+			if(n) {
+				m_flushed.fetch_add(n, std::memory_order_relaxed);
+				m_batches.fetch_add(1, std::memory_order_relaxed);
+			}
+			m_draining.store(false);
+			futex_wq_notify(&m_pwq, INT_MAX);
+			// message committed after last read and before the store above
+			if(!mpi_mq->pending())
+				break;
+		}
+	}
+
+	void post(_str_t msg, _u32 sz) {
+		void *p = 0;
+		bool async = (m_mode.load(std::memory_order_relaxed) == LOG_ASYNC);
+
+		if(sz > MAX_MSG_BUFFER)
+			// truncated by snprintf
+			sz = MAX_MSG_BUFFER;
+
+		while(!(p = mpi_mq->reserve(sz))) {
+			// full
+			if(async) {
+				if(m_overflow.load(std::memory_order_relaxed) == LOG_DROP) {
+					m_dropped.fetch_add(1, std::memory_order_relaxed);
+					break;
+				}
+				futex_wq_notify(&m_wq, 1);
+				// sleep until the flusher releases space (timeout for mode change)
+				if(futex_wq_wait(&m_pwq, FLUSH_INTERVAL, [&]()->bool {
+						return ((p = mpi_mq->reserve(sz)) != NULL);
+					}))
+					break;
+				async = (m_mode.load(std::memory_order_relaxed) == LOG_ASYNC);
+			} else {
+				drain();
+				std::this_thread::yield();
+			}
+		}
+
+		if(p) {
+			memcpy(p, msg, sz);
+			mpi_mq->commit(p);
+			m_messages.fetch_add(1, std::memory_order_relaxed);
+
+			if(async)
+				futex_wq_notify(&m_wq, 1);
+			else
+				drain();
+		}
+	}
+
+	void flusher(void) {
+		while(m_running.load()) {
+			futex_wq_wait(&m_wq, FLUSH_INTERVAL, [&]()->bool {
+				return (mpi_mq->pending() || !m_running.load());
+			});
+			drain();
+		}
+	}
+
+	void start_flusher(void) {
+		if(!m_running.exchange(true))
+			m_flusher = std::thread([this]() {
+				pthread_setname_np(pthread_self(), "log-flusher");
+				flusher();
+			});
+	}
+
+	void stop_flusher(void) {
+		if(m_running.exchange(false)) {
+			futex_wq_notify(&m_wq, 1);
+			m_flusher.join();
 		}
 	}
 
@@ -59,6 +201,7 @@ private:
 			pi_repo->object_release(pi_args);
 		}
 		mpi_rb->init(lbc);
+		mpi_mq->init_mpsc((lbc > MIN_MQ_CAPACITY) ? lbc : MIN_MQ_CAPACITY);
 	}
 
 public:
@@ -69,13 +212,22 @@ public:
 
 		switch(cmd) {
 			case OCTL_INIT: {
-				mpi_rb = 0;
+				mpi_rb = mpi_mq = 0;
 				mpi_lstr = 0;
+				m_draining = false;
+				m_mode = LOG_SYNC;
+				m_overflow = LOG_BLOCK;
+				m_running = false;
+				futex_wq_init(&m_wq);
+				futex_wq_init(&m_pwq);
+				m_messages = m_dropped = m_flushed = m_batches = m_binary = 0;
+				memset(&m_file, 0, sizeof(m_file));
 				iRepository *pi_repo = (iRepository*)arg;
 				mpi_rb = (iRingBuffer*)pi_repo->object_by_iname(I_RING_BUFFER, RF_CLONE);
+				mpi_mq = (iRingBuffer*)pi_repo->object_by_iname(I_RING_BUFFER, RF_CLONE);
 				mpi_lstr = (iLlist*)pi_repo->object_by_iname(I_LLIST, RF_CLONE);
-				if(mpi_rb && mpi_lstr) {
-					mpi_lstr->init(LL_VECTOR, 1);
+				if(mpi_rb && mpi_mq && mpi_lstr) {
+					mpi_lstr->init(LL_VECTOR|LL_SLAB, 1);
 					init_rb(pi_repo);
 					r = true;
 				}
@@ -83,8 +235,15 @@ public:
 			}
 			case OCTL_UNINIT: {
 				iRepository *pi_repo = (iRepository*)arg;
+				stop_flusher();
+				drain();
+				lf_close(&m_file);
+				pi_repo->object_release(mpi_mq);
 				pi_repo->object_release(mpi_rb);
 				pi_repo->object_release(mpi_lstr);
+				// later writes are ignored
+				mpi_mq = mpi_rb = 0;
+				mpi_lstr = 0;
 				r = true;
 				break;
 			}
@@ -106,67 +265,165 @@ public:
 	}
 
 	void add_listener(_log_listener_t *lstr) {
-		HMUTEX hm = lock();
-		bool add = true;
-		_u32 sz;
+		if(mpi_lstr) {
+			HMUTEX hm = lock();
+			bool add = true;
+			_u32 sz;
+
+			_log_listener_t **plstr = (_log_listener_t **)mpi_lstr->first(&sz, hm);
+			if(plstr) {
+				do {
+					if(*plstr == lstr) {
+						add = false;
+						break;
+					}
+				}while((plstr = (_log_listener_t **)mpi_lstr->next(&sz, hm)));
+			}
 
-		_log_listener_t **plstr = (_log_listener_t **)mpi_lstr->first(&sz, hm);
-		if(plstr) {
-			do {
-				if(*plstr == lstr) {
-					add = false;
-					break;
-				}
-			}while((plstr = (_log_listener_t **)mpi_lstr->next(&sz, hm)));
-		}
+			if(add) {
+				// pending messages goes to existing listeners first
+				drain(hm);
+				mpi_lstr->add(&lstr, sizeof(lstr), hm);
+				sync(lstr);
+			}
 
-		if(add) {
-			mpi_lstr->add(&lstr, sizeof(lstr), hm);
-			sync(lstr);
+			unlock(hm);
 		}
-
-		unlock(hm);
 	}
 
 	void remove_listener(_log_listener_t *lstr) {
-		_u32 sz;
-		HMUTEX hm = lock();
-		_log_listener_t **plstr = (_log_listener_t **)mpi_lstr->first(&sz, hm);
-
-		if(plstr) {
-			do {
-				if(lstr == *plstr) {
-					mpi_lstr->del(hm);
-					break;
-				}
-			} while((plstr = (_log_listener_t **)mpi_lstr->next(&sz, hm)));
+		if(mpi_lstr) {
+			_u32 sz;
+			HMUTEX hm = lock();
+			_log_listener_t **plstr = (_log_listener_t **)mpi_lstr->first(&sz, hm);
+
+			if(plstr) {
+				do {
+					if(lstr == *plstr) {
+						mpi_lstr->del(hm);
+						break;
+					}
+				} while((plstr = (_log_listener_t **)mpi_lstr->next(&sz, hm)));
+			}
+			unlock(hm);
 		}
-		unlock(hm);
 	}
 
 	void write(_u8 lmt, _cstr_t msg) {
-		if(mpi_rb) {
+		if(mpi_mq) {
 			_s8 _msg[MAX_MSG_BUFFER];
+			_u32 hdr = 1 + sizeof(_u64);
+			_u64 time = lf_time();
 
-			_u32 sz = snprintf(_msg+1, sizeof(_msg)-1, "%s", msg);
+			_u32 sz = snprintf(_msg+hdr, sizeof(_msg)-hdr, "%s", msg);
 			_msg[0] = lmt;
-			mpi_rb->push(_msg, sz+2);
-			sync();
+			memcpy(_msg + 1, &time, sizeof(time));
+			post(_msg, sz+hdr+1);
 		}
 	}
 
 	void fwrite(_u8 lmt, _cstr_t fmt, ...) {
-		if(mpi_rb) {
+		if(mpi_mq) {
 			_s8 _msg[MAX_MSG_BUFFER];
+			_u32 hdr = 1 + sizeof(_u64);
+			_u64 time = lf_time();
 			va_list args;
 
 			va_start(args, fmt);
-			_u32 sz = vsnprintf(_msg+1, sizeof(_msg)-1, fmt, args);
+			_u32 sz = vsnprintf(_msg+hdr, sizeof(_msg)-hdr, fmt, args);
 			_msg[0] = lmt;
-			mpi_rb->push(_msg, sz+2);
+			memcpy(_msg + 1, &time, sizeof(time));
 			va_end(args);
-			sync();
+			post(_msg, sz+hdr+1);
+		}
+	}
+
+	bool mode(_u8 mode, _u8 overflow=LOG_BLOCK) {
+		bool r = false;
+
+		if(mpi_mq && (mode == LOG_SYNC || mode == LOG_ASYNC)) {
+			m_overflow = overflow;
+			if(mode == LOG_ASYNC) {
+				m_mode = mode;
+				start_flusher();
+			} else {
+				stop_flusher();
+				m_mode = mode;
+				// messages posted after the last flush
+				drain();
+			}
+			r = true;
+		}
+
+		return r;
+	}
+
+	void flush(void) {
+		if(mpi_mq) {
+			if(m_mode.load() == LOG_ASYNC) {
+				while(mpi_mq->pending() || m_draining.load()) {
+					futex_wq_notify(&m_wq, 1);
+					futex_wq_wait(&m_pwq, FLUSH_INTERVAL, [&]()->bool {
+						return (!mpi_mq->pending() && !m_draining.load());
+					});
+				}
+			} else
+				drain();
+		}
+	}
+
+	void stat(_log_stat_t *p_stat) {
+		p_stat->mode = m_mode.load(std::memory_order_relaxed);
+		p_stat->overflow = m_overflow.load(std::memory_order_relaxed);
+		p_stat->messages = m_messages.load(std::memory_order_relaxed);
+		p_stat->dropped = m_dropped.load(std::memory_order_relaxed);
+		p_stat->flushed = m_flushed.load(std::memory_order_relaxed);
+		p_stat->batches = m_batches.load(std::memory_order_relaxed);
+		p_stat->binary = m_binary.load(std::memory_order_relaxed);
+	}
+
+	void bwrite(_u8 lmt, _cstr_t fmt, _log_args_t *args) {
+		if(mpi_mq && fmt) {
+			_s8 _msg[MAX_MSG_BUFFER];
+			_u32 sz_args = (args) ? args->size : 0;
+			_u32 hdr = 1 + sizeof(_u64) + sizeof(fmt);
+			_u64 time = lf_time();
+
+			if(sz_args > sizeof(_msg) - hdr)
+				sz_args = sizeof(_msg) - hdr;
+
+			_msg[0] = lmt | LMT_BINARY;
+			memcpy(_msg + 1, &time, sizeof(time));
+			memcpy(_msg + 1 + sizeof(time), &fmt, sizeof(fmt));
+			if(sz_args)
+				memcpy(_msg + hdr, args->data, sz_args);
+			m_binary.fetch_add(1, std::memory_order_relaxed);
+			post(_msg, hdr + sz_args);
+		}
+	}
+
+	bool sink(_cstr_t path, _u32 segment_size=LOG_SEGMENT_SIZE, _u32 rotate_time=0) {
+		bool r = false;
+
+		if(mpi_mq) {
+			HMUTEX hm = lock();
+
+			// pending messages belongs to the current file
+			drain(hm);
+			lf_close(&m_file);
+			if(path) {
+				if(!(r = lf_open(&m_file, path, segment_size, rotate_time)))
+					lf_close(&m_file);
+			} else
+				r = true;
+			unlock(hm);
 		}
+
+		return r;
+	}
+
+	bool decode(_cstr_t fname, _log_record_t *pcb, void *udata=NULL) {
+		return lf_decode(fname, pcb, udata);
 	}
 
 	_str_t first(HMUTEX hm) {
@@ -176,6 +433,7 @@ public:
 		if(mpi_rb) {
 			HMUTEX h = lock(hm);
 
+			drain(h);
 			mpi_rb->reset_pull();
 			if((r = (_str_t)mpi_rb->pull(&sz)))
 				r++;
@@ -0,0 +1,544 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include "futex.h"
+#include "log_file.h"
+
+#define LF_MAX_RECORD		0xffff
+#define LF_MAX_TEXT		(LF_MAX_RECORD - sizeof(_lf_record_t))
+#define LF_FMT_LIMIT		(LF_MAX_FMT * 3 / 4) // fill limit of format dictionary
+#define LF_NEXT_NAME		".next"
+
+// state of next segment
+#define LF_NEXT_NONE		0
+#define LF_NEXT_REQUEST		1 // prepared by helper
+#define LF_NEXT_READY		2 // done (p_map is NULL on error)
+
+struct lf_helper {
+	std::thread		thread;
+	std::atomic<_u8>	state;
+	std::atomic<bool>	running;
+	_futex_wq_t		wq;
+};
+
+static bool arg_valid(_u8 *arg, _u32 sz) {
+	bool r = false;
+
+	if(sz >= 3) {
+		if(arg[0] == LOG_ARG_STR) {
+			_u16 len = 0;
+
+			memcpy(&len, arg + 1, sizeof(len));
+			r = ((_u32)len + 3 <= sz && len < LOG_MAX_ARGS_SIZE);
+		} else
+			r = (sz >= sizeof(_u64) + 1 && (arg[0] == LOG_ARG_INT || arg[0] == LOG_ARG_UINT ||
+					arg[0] == LOG_ARG_DOUBLE || arg[0] == LOG_ARG_PTR));
+	}
+
+	return r;
+}
+
+_u32 log_format(_str_t out, _u32 sz_out, _cstr_t fmt, _u8 *args, _u32 sz_args) {
+	_u32 r = 0;
+	_u32 ia = 0;
+
+	while(*fmt && r < sz_out - 1) {
+		_char_t spec[32];
+		_char_t conv = 0;
+		_u32 ns = 0;
+		_s32 n = 0;
+
+		if(*fmt != '%') {
+			out[r++] = *fmt++;
+			continue;
+		}
+		if(fmt[1] == '%') {
+			out[r++] = '%';
+			fmt += 2;
+			continue;
+		}
+
+		spec[ns++] = *fmt++;
+		while(*fmt && strchr("-+ #0123456789.", *fmt) && ns < sizeof(spec) - 4)
+			spec[ns++] = *fmt++;
+		// length modifier is given by argument type
+		while(*fmt && strchr("hlLqjzt", *fmt))
+			fmt++;
+		if(!(conv = *fmt))
+			break;
+		fmt++;
+
+		if(!arg_valid(args + ia, sz_args - ia))
+			// missing (or corrupted) argument
+			continue;
+
+		switch(args[ia]) {
+			case LOG_ARG_INT:
+			case LOG_ARG_UINT:
+			case LOG_ARG_PTR: {
+				_u64 v = 0;
+
+				memcpy(&v, args + ia + 1, sizeof(v));
+				ia += sizeof(v) + 1;
+				if(conv == 'c') {
+					spec[ns++] = 'c';
+					spec[ns] = 0;
+					n = snprintf(out + r, sz_out - r, spec, (int)v);
+				} else if(conv == 'p') {
+					spec[ns++] = 'p';
+					spec[ns] = 0;
+					n = snprintf(out + r, sz_out - r, spec, (void *)v);
+				} else {
+					if(!strchr("dioxXu", conv))
+						conv = (args[ia - sizeof(v) - 1] == LOG_ARG_INT) ? 'd' : 'u';
+					spec[ns++] = 'l';
+					spec[ns++] = 'l';
+					spec[ns++] = conv;
+					spec[ns] = 0;
+					n = snprintf(out + r, sz_out - r, spec, (long long)v);
+				}
+			} break;
+			case LOG_ARG_DOUBLE: {
+				double v = 0;
+
+				memcpy(&v, args + ia + 1, sizeof(v));
+				ia += sizeof(v) + 1;
+				spec[ns++] = (strchr("fFeEgGaA", conv)) ? conv : 'g';
+				spec[ns] = 0;
+				n = snprintf(out + r, sz_out - r, spec, v);
+			} break;
+			case LOG_ARG_STR: {
+				_char_t str[LOG_MAX_ARGS_SIZE];
+				_u16 len = 0;
+
+				memcpy(&len, args + ia + 1, sizeof(len));
+				memcpy(str, args + ia + 3, len);
+				str[len] = 0;
+				ia += len + 3;
+				spec[ns++] = 's';
+				spec[ns] = 0;
+				n = snprintf(out + r, sz_out - r, spec, str);
+			} break;
+		}
+
+		if(n > 0)
+			r += ((_u32)n < sz_out - r) ? n : sz_out - r - 1;
+	}
+
+	out[r] = 0;
+	return r;
+}
+
+_u64 lf_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (_u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void seg_reset(_lf_segment_t *ps) {
+	ps->fd = -1;
+	ps->p_map = NULL;
+	ps->name[0] = 0;
+}
+
+// preallocated and mapped segment with temporary name
+static bool seg_create(_log_file_t *plf, _lf_segment_t *ps) {
+	bool r = false;
+
+	snprintf(ps->name, sizeof(ps->name), "%s" LF_NEXT_NAME, plf->path);
+	if((ps->fd = open(ps->name, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0644)) != -1) {
+		if(posix_fallocate(ps->fd, 0, plf->seg_size) == 0) {
+			void *p = mmap(NULL, plf->seg_size, PROT_READ|PROT_WRITE,
+					MAP_SHARED|MAP_POPULATE, ps->fd, 0);
+
+			if(p != MAP_FAILED) {
+				ps->p_map = (_u8 *)p;
+				r = true;
+			}
+		}
+
+		if(!r) {
+			close(ps->fd);
+			unlink(ps->name);
+		}
+	}
+
+	if(!r)
+		seg_reset(ps);
+
+	return r;
+}
+
+// fallocate and MAP_POPULATE of the next segment runs out of the consumer
+static void helper_start(_log_file_t *plf) {
+	_lf_helper_t *ph = new _lf_helper_t;
+
+	ph->state = LF_NEXT_NONE;
+	ph->running = true;
+	futex_wq_init(&ph->wq);
+	plf->p_helper = ph;
+	ph->thread = std::thread([plf, ph]() {
+		pthread_setname_np(pthread_self(), "log-segment");
+		while(ph->running.load()) {
+			futex_wq_wait(&ph->wq, 0, [&]()->bool {
+				return (ph->state.load() == LF_NEXT_REQUEST || !ph->running.load());
+			});
+
+			if(ph->running.load() && ph->state.load() == LF_NEXT_REQUEST) {
+				seg_create(plf, &plf->next);
+				ph->state.store(LF_NEXT_READY);
+				futex_wq_notify(&ph->wq, INT_MAX);
+			}
+		}
+	});
+}
+
+static void helper_stop(_log_file_t *plf) {
+	_lf_helper_t *ph = plf->p_helper;
+
+	if(ph) {
+		ph->running = false;
+		futex_wq_notify(&ph->wq, INT_MAX);
+		ph->thread.join();
+		delete ph;
+		plf->p_helper = NULL;
+	}
+}
+
+// ask helper for the next segment
+static void next_request(_log_file_t *plf) {
+	_lf_helper_t *ph = plf->p_helper;
+
+	if(ph && ph->state.load(std::memory_order_relaxed) == LF_NEXT_NONE) {
+		ph->state.store(LF_NEXT_REQUEST);
+		futex_wq_notify(&ph->wq, INT_MAX);
+	}
+}
+
+// take the prepared segment, false if there is none
+static bool next_take(_log_file_t *plf) {
+	bool r = false;
+	_lf_helper_t *ph = plf->p_helper;
+
+	if(ph) {
+		// in progress, it's faster to wait for it
+		futex_wq_wait(&ph->wq, 0, [&]()->bool {
+			return (ph->state.load() != LF_NEXT_REQUEST);
+		});
+
+		if(ph->state.load() == LF_NEXT_READY) {
+			r = (plf->next.p_map != NULL);
+			ph->state.store(LF_NEXT_NONE);
+		}
+	}
+
+	return r;
+}
+
+// give the segment its final name 'path.YYYYmmdd-HHMMSS.N'
+static bool seg_publish(_log_file_t *plf, _lf_segment_t *ps, _u64 time) {
+	bool r = false;
+	time_t t = time / 1000000000;
+	struct tm tm;
+	_char_t ts[16]="";
+	_char_t name[sizeof(ps->name)]="";
+
+	localtime_r(&t, &tm);
+	strftime(ts, sizeof(ts), "%Y%m%d-%H%M%S", &tm);
+
+	for(_u32 n = 0; n < 1000; n++) {
+		snprintf(name, sizeof(name), "%s.%s.%u", plf->path, ts, n);
+		if(link(ps->name, name) == 0) {
+			unlink(ps->name);
+			strcpy(ps->name, name);
+			r = true;
+			break;
+		} else if(errno != EEXIST)
+			break;
+	}
+
+	return r;
+}
+
+static void seg_close(_log_file_t *plf, _lf_segment_t *ps, _u32 size, bool remove) {
+	if(ps->p_map) {
+		munmap(ps->p_map, plf->seg_size);
+		if(remove)
+			unlink(ps->name);
+		else
+			// cut the preallocated rest
+			ftruncate(ps->fd, size);
+		close(ps->fd);
+	}
+
+	seg_reset(ps);
+}
+
+static bool lf_switch(_log_file_t *plf, _u64 time) {
+	bool r = false;
+
+	if(plf->cur.p_map)
+		seg_close(plf, &plf->cur, plf->offset, false);
+
+	if(next_take(plf)) {
+		plf->cur = plf->next;
+		seg_reset(&plf->next);
+	} else
+		seg_create(plf, &plf->cur);
+
+	if(plf->cur.p_map) {
+		_lf_header_t *p_hdr = (_lf_header_t *)plf->cur.p_map;
+
+		p_hdr->magic = LF_MAGIC;
+		p_hdr->version = LF_VERSION;
+		p_hdr->hdr_size = sizeof(_lf_header_t);
+		p_hdr->size = plf->seg_size;
+		p_hdr->seq = plf->seq++;
+		p_hdr->time = time;
+
+		if(seg_publish(plf, &plf->cur, time)) {
+			plf->offset = sizeof(_lf_header_t);
+			plf->time = time;
+			// every segment has own dictionary
+			memset(plf->fmt, 0, sizeof(plf->fmt));
+			plf->nfmt = 0;
+			r = true;
+		} else
+			seg_close(plf, &plf->cur, 0, true);
+	}
+
+	return r;
+}
+
+bool lf_open(_log_file_t *plf, _cstr_t path, _u32 seg_size, _u32 rotate_time) {
+	bool r = false;
+	_u32 page = sysconf(_SC_PAGESIZE);
+
+	memset(plf, 0, sizeof(_log_file_t));
+	seg_reset(&plf->cur);
+	seg_reset(&plf->next);
+
+	if(path && strlen(path) < sizeof(plf->path)) {
+		if(seg_size < LF_MIN_SEGMENT)
+			seg_size = LF_MIN_SEGMENT;
+		plf->seg_size = (seg_size + page - 1) / page * page;
+		plf->rotate_time = rotate_time;
+		strcpy(plf->path, path);
+		if((r = lf_switch(plf, lf_time())))
+			helper_start(plf);
+	}
+
+	return r;
+}
+
+void lf_close(_log_file_t *plf) {
+	helper_stop(plf);
+	// empty segment is removed
+	seg_close(plf, &plf->cur, plf->offset, (plf->offset <= sizeof(_lf_header_t)));
+	// prepared, but not used
+	seg_close(plf, &plf->next, 0, true);
+	plf->path[0] = 0;
+}
+
+bool lf_is_open(_log_file_t *plf) {
+	return (plf->cur.p_map != NULL);
+}
+
+// make room for 'size' bytes, switch to next segment if needed
+static bool lf_reserve(_log_file_t *plf, _u32 size, _u64 time) {
+	if(plf->cur.p_map && plf->offset + size > plf->seg_size)
+		lf_switch(plf, time);
+
+	return (plf->cur.p_map && plf->offset + size <= plf->seg_size);
+}
+
+static void lf_put(_log_file_t *plf, _u8 type, _u8 lmt, _u64 time, _u16 id,
+			const void *data, _u32 sz_data) {
+	_lf_record_t rec;
+	_u8 *p = plf->cur.p_map + plf->offset;
+	_u32 sz_hdr = sizeof(rec);
+
+	rec.size = sizeof(rec) + sz_data;
+	rec.type = type;
+	rec.lmt = lmt;
+	rec.time = time;
+
+	if(type != LF_REC_TEXT) {
+		memcpy(p + sz_hdr, &id, sizeof(id));
+		sz_hdr += sizeof(id);
+		rec.size += sizeof(id);
+	}
+
+	memcpy(p + sz_hdr, data, sz_data);
+	// header at last, size 0 stops the decoder
+	memcpy(p, &rec, sizeof(rec));
+	plf->offset += rec.size;
+
+	if(plf->offset >= plf->seg_size / 4 * 3)
+		next_request(plf);
+}
+
+bool lf_text(_log_file_t *plf, _u8 lmt, _u64 time, _cstr_t msg, _u32 len) {
+	bool r = false;
+
+	if(len > LF_MAX_TEXT)
+		len = LF_MAX_TEXT;
+
+	if((r = lf_reserve(plf, sizeof(_lf_record_t) + len, time)))
+		lf_put(plf, LF_REC_TEXT, lmt, time, 0, msg, len);
+
+	return r;
+}
+
+// slot of format pointer in dictionary, or empty slot
+static _u32 fmt_slot(_log_file_t *plf, _cstr_t fmt) {
+	_u32 r = (_u32)(((_u64)fmt * 0x9e3779b97f4a7c15ULL) >> 32) % LF_MAX_FMT;
+
+	while(plf->fmt[r] && plf->fmt[r] != fmt)
+		r = (r + 1) % LF_MAX_FMT;
+
+	return r;
+}
+
+bool lf_binary(_log_file_t *plf, _u8 lmt, _u64 time, _cstr_t fmt, _u8 *args, _u32 sz_args) {
+	bool r = false;
+
+	if(plf->cur.p_map) {
+		_u32 len_fmt = strlen(fmt) + 1;
+		_u32 rec_bin = sizeof(_lf_record_t) + sizeof(_u16) + sz_args;
+		_u32 rec_fmt = sizeof(_lf_record_t) + sizeof(_u16) + len_fmt;
+		_u32 slot = fmt_slot(plf, fmt);
+		_u32 need = rec_bin + ((plf->fmt[slot]) ? 0 : rec_fmt);
+
+		if(sz_args <= LOG_MAX_ARGS_SIZE && rec_fmt <= LF_MAX_RECORD &&
+				rec_fmt + rec_bin <= plf->seg_size - sizeof(_lf_header_t)) {
+			if(plf->offset + need > plf->seg_size) {
+				// format and arguments must be in the same segment
+				if(lf_switch(plf, time))
+					slot = fmt_slot(plf, fmt);
+			}
+
+			if(plf->cur.p_map && (plf->fmt[slot] || plf->nfmt < LF_FMT_LIMIT)) {
+				if(!plf->fmt[slot]) {
+					plf->fmt[slot] = fmt;
+					plf->fmt_id[slot] = plf->nfmt++;
+					lf_put(plf, LF_REC_FMT, lmt, time, plf->fmt_id[slot], fmt, len_fmt);
+				}
+
+				lf_put(plf, LF_REC_BINARY, lmt, time, plf->fmt_id[slot], args, sz_args);
+				r = true;
+			}
+		}
+
+		if(!r && plf->cur.p_map) {
+			// dictionary is full (or too long format)
+			_char_t txt[LOG_MAX_ARGS_SIZE * 2];
+			_u32 len = log_format(txt, sizeof(txt), fmt, args, sz_args);
+
+			r = lf_text(plf, lmt, time, txt, len);
+		}
+	}
+
+	return r;
+}
+
+void lf_tick(_log_file_t *plf) {
+	if(plf->cur.p_map) {
+		_u64 now = lf_time();
+		_u64 rotate = (_u64)plf->rotate_time * 1000000000;
+
+		if(rotate && plf->offset > sizeof(_lf_header_t) && now - plf->time >= rotate)
+			lf_switch(plf, now);
+
+		// prepare the next segment before it's needed (by size in lf_put)
+		if(plf->cur.p_map && rotate && now - plf->time >= rotate / 4 * 3)
+			next_request(plf);
+	} else if(plf->path[0])
+		// the last switch has failed
+		lf_switch(plf, lf_time());
+}
+
+bool lf_decode(_cstr_t fname, _log_record_t *pcb, void *udata) {
+	bool r = false;
+	_s32 fd = open(fname, O_RDONLY|O_CLOEXEC);
+
+	if(fd != -1) {
+		struct stat st;
+		_str_t buffer = NULL;
+
+		if(fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(_lf_header_t) &&
+				(buffer = (_str_t)malloc(LF_MAX_RECORD + 1))) {
+			_u64 size = st.st_size;
+			void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+			if(p != MAP_FAILED) {
+				_u8 *p_map = (_u8 *)p;
+				_lf_header_t *p_hdr = (_lf_header_t *)p_map;
+
+				if(p_hdr->magic == LF_MAGIC && p_hdr->version == LF_VERSION) {
+					_cstr_t fmt[LF_MAX_FMT];
+					_u64 offset = p_hdr->hdr_size;
+
+					memset(fmt, 0, sizeof(fmt));
+					while(offset + sizeof(_lf_record_t) <= size) {
+						_lf_record_t rec;
+						_u8 *data = p_map + offset + sizeof(rec);
+						_u32 sz_data = 0;
+						_u16 id = 0;
+
+						memcpy(&rec, p_map + offset, sizeof(rec));
+						if(rec.size < sizeof(rec) || offset + rec.size > size)
+							// end of segment
+							break;
+
+						sz_data = rec.size - sizeof(rec);
+						if(rec.type != LF_REC_TEXT && sz_data >= sizeof(id)) {
+							memcpy(&id, data, sizeof(id));
+							data += sizeof(id);
+							sz_data -= sizeof(id);
+						}
+
+						switch(rec.type) {
+							case LF_REC_TEXT:
+								memcpy(buffer, data, sz_data);
+								buffer[sz_data] = 0;
+								pcb(rec.lmt, rec.time, buffer, udata);
+								break;
+							case LF_REC_FMT:
+								if(id < LF_MAX_FMT && sz_data && data[sz_data - 1] == 0)
+									fmt[id] = (_cstr_t)data;
+								break;
+							case LF_REC_BINARY:
+								if(id < LF_MAX_FMT && fmt[id]) {
+									log_format(buffer, LF_MAX_RECORD + 1, fmt[id], data, sz_data);
+									pcb(rec.lmt, rec.time, buffer, udata);
+								}
+								break;
+						}
+
+						offset += rec.size;
+					}
+
+					r = true;
+				}
+
+				munmap(p, size);
+			}
+		}
+
+		if(buffer)
+			free(buffer);
+		close(fd);
+	}
+
+	return r;
+}
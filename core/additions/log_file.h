@@ -0,0 +1,79 @@
+/* binary log file (rotating memory mapped segments) */
+
+#ifndef __LOG_FILE_H__
+#define __LOG_FILE_H__
+
+#include "dtype.h"
+#include "iLog.h"
+
+#define LF_MAGIC		0x474f4c50 /* 'PLOG' */
+#define LF_VERSION		1
+#define LF_MIN_SEGMENT		(64 * 1024)
+#define LF_MAX_PATH		256
+#define LF_MAX_FMT		1024 /* formats in segment dictionary */
+
+/* record types */
+#define LF_REC_TEXT		1 /* [text] */
+#define LF_REC_FMT		2 /* [u16 id][format string with terminator] */
+#define LF_REC_BINARY		3 /* [u16 id][arguments] */
+
+typedef struct {
+	_u32	magic;
+	_u16	version;
+	_u16	hdr_size;
+	_u32	size; /* segment size */
+	_u32	seq; /* segment number */
+	_u64	time; /* creation time (ns) */
+	_u8	_pad[8];
+}_lf_header_t;
+
+/* record size 0 means end of segment */
+typedef struct __attribute__((packed)) {
+	_u16	size; /* record size with header */
+	_u8	type;
+	_u8	lmt;
+	_u64	time; /* realtime in nanoseconds */
+}_lf_record_t;
+
+typedef struct {
+	_s32	fd;
+	_u8	*p_map;
+	_char_t	name[LF_MAX_PATH + 32];
+}_lf_segment_t;
+
+/* thread which prepares the next segment */
+typedef struct lf_helper _lf_helper_t;
+
+typedef struct {
+	_char_t		path[LF_MAX_PATH];
+	_u32		seg_size;
+	_u32		rotate_time; /* seconds */
+	_u32		seq;
+	_u32		offset; /* in current segment */
+	_u64		time; /* start of current segment (ns) */
+	_lf_segment_t	cur;
+	_lf_segment_t	next; /* prepared in advance (owned by helper until ready) */
+	_lf_helper_t	*p_helper;
+	/* format dictionary of current segment (format pointer -> id) */
+	_cstr_t		fmt[LF_MAX_FMT];
+	_u16		fmt_id[LF_MAX_FMT];
+	_u16		nfmt;
+}_log_file_t;
+
+/* format binary message arguments (see _log_args_t) */
+_u32 log_format(_str_t out, _u32 sz_out, _cstr_t fmt, _u8 *args, _u32 sz_args);
+
+/* realtime in nanoseconds */
+_u64 lf_time(void);
+/* path is prefix of segment files: 'path.YYYYmmdd-HHMMSS.N' */
+bool lf_open(_log_file_t *plf, _cstr_t path, _u32 seg_size, _u32 rotate_time);
+void lf_close(_log_file_t *plf);
+bool lf_is_open(_log_file_t *plf);
+bool lf_text(_log_file_t *plf, _u8 lmt, _u64 time, _cstr_t msg, _u32 len);
+bool lf_binary(_log_file_t *plf, _u8 lmt, _u64 time, _cstr_t fmt, _u8 *args, _u32 sz_args);
+/* rotation by time and preparation of next segment */
+void lf_tick(_log_file_t *plf);
+/* read segment file */
+bool lf_decode(_cstr_t fname, _log_record_t *pcb, void *udata);
+
+#endif
@@ -164,7 +164,7 @@ _s32 _nfind_string(_str_t text, _u32 text_sz, _cstr_t sub_str) {
 	_u32 l = (_u32)_str_len(sub_str);
 	if(l <= text_sz) {
 		_u32 i = 0;
-		while(i < (text_sz - l)) {
+		while(i <= (text_sz - l)) {
 			if(_mem_cmp((text + i), (void *)sub_str, l) == 0) {
 				r = i;
 				break;
@@ -0,0 +1,318 @@
+#ifndef __FUTEX_H__
+#define __FUTEX_H__
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
+#include <atomic>
+#include "dtype.h"
+
+// Wait queue for lock free structures: waiters register themselves and
+// sleep on the sequence word, so notify makes a syscall only when needed.
+typedef struct {
+	std::atomic<_u32> seq; // futex word
+	std::atomic<_u32> waiters;
+}_futex_wq_t;
+
+static inline void futex_wait(std::atomic<_u32> *p_word, _u32 val, struct timespec *p_timeout) {
+	syscall(SYS_futex, (_u32 *)p_word, FUTEX_WAIT_PRIVATE, val, p_timeout, NULL, 0);
+}
+
+static inline void futex_wake(std::atomic<_u32> *p_word, _u32 n) {
+	syscall(SYS_futex, (_u32 *)p_word, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+static inline _u64 futex_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (_u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline _u64 futex_now_ms(void) {
+	return futex_now_ns() / 1000000;
+}
+
+// ID of current thread (never 0)
+static inline _u64 futex_tid(void) {
+	static thread_local _u64 tid = (_u64)syscall(SYS_gettid);
+
+	return tid;
+}
+
+static inline void futex_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+// spinning makes sense only when lock owner can run in parallel
+static inline bool futex_smp(void) {
+	static bool smp = (sysconf(_SC_NPROCESSORS_ONLN) > 1);
+
+	return smp;
+}
+
+static inline void futex_wq_init(_futex_wq_t *pwq) {
+	pwq->seq = 0;
+	pwq->waiters = 0;
+}
+
+// wake up to 'n' waiters (after the state change was published)
+static inline void futex_wq_notify(_futex_wq_t *pwq, _u32 n) {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if(pwq->waiters.load(std::memory_order_relaxed)) {
+		pwq->seq.fetch_add(1);
+		futex_wake(&pwq->seq, n);
+	}
+}
+
+// wait until 'try_op' succeeds (timeout in milliseconds, zero means infinite)
+template<typename _op_t>
+bool futex_wq_wait(_futex_wq_t *pwq, _u32 timeout, _op_t try_op) {
+	bool r = false;
+	_u64 deadline = (timeout) ? futex_now_ms() + timeout : 0;
+
+	while(!(r = try_op())) {
+		struct timespec ts, *p_ts = NULL;
+		_u32 seq = 0;
+
+		if(deadline) {
+			_u64 now = futex_now_ms();
+
+			if(now >= deadline)
+				break;
+			ts.tv_sec = (deadline - now) / 1000;
+			ts.tv_nsec = ((deadline - now) % 1000) * 1000000;
+			p_ts = &ts;
+		}
+
+		pwq->waiters.fetch_add(1);
+		seq = pwq->seq.load();
+		// check again after registration
+		if((r = try_op())) {
+			pwq->waiters.fetch_sub(1);
+			break;
+		}
+		futex_wait(&pwq->seq, seq, p_ts);
+		pwq->waiters.fetch_sub(1);
+	}
+
+	return r;
+}
+
+// Statistics of lock contention
+typedef struct {
+	std::atomic<_u64> contended; // acquisitions by slow path
+	std::atomic<_u64> spins; // spin iterations
+	std::atomic<_u64> wait_ns; // time in futex wait
+}_futex_stat_t;
+
+#define FUTEX_SPIN_MIN	16
+#define FUTEX_SPIN_MAX	512
+
+// Spin with limit adapted by the spins needed in previous acquisitions
+// (like glibc adaptive mutex), returns true when 'try_op' succeeds.
+template<typename _op_t>
+bool futex_spin(std::atomic<_u32> *p_spin, _futex_stat_t *p_stat, _op_t try_op) {
+	bool r = false;
+	_u32 n = 0;
+
+	if(futex_smp()) {
+		_u32 spin = p_spin->load(std::memory_order_relaxed);
+		_u32 limit = spin * 2 + FUTEX_SPIN_MIN;
+
+		if(limit > FUTEX_SPIN_MAX)
+			limit = FUTEX_SPIN_MAX;
+
+		for(; n < limit; n++) {
+			futex_cpu_relax();
+			if((r = try_op()))
+				break;
+		}
+
+		p_spin->store(spin + ((_s32)n - (_s32)spin) / 8, std::memory_order_relaxed);
+		p_stat->spins.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	return r;
+}
+
+// Adaptive mutex (non recursive). The futex word is 0 when free, 1 when
+// locked and 2 when locked with (possible) sleeping waiters.
+typedef struct {
+	std::atomic<_u32> state;
+	std::atomic<_u32> spin; // adaptive spin limit
+	_futex_stat_t	stat;
+}_futex_mutex_t;
+
+static inline void futex_mutex_init(_futex_mutex_t *pm) {
+	pm->state = 0;
+	pm->spin = 0;
+	pm->stat.contended = pm->stat.spins = pm->stat.wait_ns = 0;
+}
+
+static inline bool futex_mutex_try_lock(_futex_mutex_t *pm) {
+	_u32 c = 0;
+
+	return pm->state.compare_exchange_strong(c, 1, std::memory_order_acquire,
+						std::memory_order_relaxed);
+}
+
+static inline void futex_mutex_lock(_futex_mutex_t *pm) {
+	if(!futex_mutex_try_lock(pm)) {
+		pm->stat.contended.fetch_add(1, std::memory_order_relaxed);
+
+		if(!futex_spin(&pm->spin, &pm->stat, [&]()->bool {
+					return (pm->state.load(std::memory_order_relaxed) == 0 &&
+						futex_mutex_try_lock(pm));
+				})) {
+			_u64 t = futex_now_ns();
+
+			while(pm->state.exchange(2, std::memory_order_acquire) != 0)
+				futex_wait(&pm->state, 2, NULL);
+
+			pm->stat.wait_ns.fetch_add(futex_now_ns() - t, std::memory_order_relaxed);
+		}
+	}
+}
+
+static inline void futex_mutex_unlock(_futex_mutex_t *pm) {
+	if(pm->state.fetch_sub(1, std::memory_order_release) != 1) {
+		// waiters
+		pm->state.store(0, std::memory_order_release);
+		futex_wake(&pm->state, 1);
+	}
+}
+
+// Reader/writer lock with writer preference. The futex word keeps number
+// of readers, writer bit and 'writer is waiting' bit (blocks new readers).
+#define FUTEX_RW_WRITER		(1U << 31)
+#define FUTEX_RW_WWAIT		(1U << 30)
+#define FUTEX_RW_READERS	(FUTEX_RW_WWAIT - 1)
+
+typedef struct {
+	std::atomic<_u32> state;
+	std::atomic<_u32> waiters;
+	std::atomic<_u32> spin; // adaptive spin limit
+	std::atomic<_u32> max_readers;
+	_futex_stat_t	stat;
+}_futex_rwlock_t;
+
+static inline void futex_rw_init(_futex_rwlock_t *prw) {
+	prw->state = 0;
+	prw->waiters = 0;
+	prw->spin = 0;
+	prw->max_readers = 0;
+	prw->stat.contended = prw->stat.spins = prw->stat.wait_ns = 0;
+}
+
+static inline bool futex_rw_try_rlock(_futex_rwlock_t *prw) {
+	bool r = false;
+	_u32 s = prw->state.load(std::memory_order_relaxed);
+
+	while(!(s & (FUTEX_RW_WRITER | FUTEX_RW_WWAIT))) {
+		if(prw->state.compare_exchange_weak(s, s + 1, std::memory_order_acquire,
+							std::memory_order_relaxed)) {
+			_u32 max = prw->max_readers.load(std::memory_order_relaxed);
+
+			while(s + 1 > max && !prw->max_readers.compare_exchange_weak(max, s + 1,
+							std::memory_order_relaxed));
+			r = true;
+			break;
+		}
+	}
+
+	return r;
+}
+
+static inline bool futex_rw_try_wlock(_futex_rwlock_t *prw) {
+	bool r = false;
+	_u32 s = prw->state.load(std::memory_order_relaxed);
+
+	// take it over a waiting writer bit (waiting writers will set it again)
+	while(!(s & ~FUTEX_RW_WWAIT)) {
+		if((r = prw->state.compare_exchange_weak(s, FUTEX_RW_WRITER, std::memory_order_acquire,
+							std::memory_order_relaxed)))
+			break;
+	}
+
+	return r;
+}
+
+static inline void futex_rw_rlock(_futex_rwlock_t *prw) {
+	if(!futex_rw_try_rlock(prw)) {
+		prw->stat.contended.fetch_add(1, std::memory_order_relaxed);
+
+		if(!futex_spin(&prw->spin, &prw->stat, [&]()->bool {
+					return futex_rw_try_rlock(prw);
+				})) {
+			_u64 t = futex_now_ns();
+
+			for(;;) {
+				_u32 s = 0;
+
+				prw->waiters.fetch_add(1);
+				s = prw->state.load();
+				if(futex_rw_try_rlock(prw)) {
+					prw->waiters.fetch_sub(1);
+					break;
+				}
+				if(s & (FUTEX_RW_WRITER | FUTEX_RW_WWAIT))
+					futex_wait(&prw->state, s, NULL);
+				prw->waiters.fetch_sub(1);
+			}
+
+			prw->stat.wait_ns.fetch_add(futex_now_ns() - t, std::memory_order_relaxed);
+		}
+	}
+}
+
+static inline void futex_rw_wlock(_futex_rwlock_t *prw) {
+	if(!futex_rw_try_wlock(prw)) {
+		prw->stat.contended.fetch_add(1, std::memory_order_relaxed);
+
+		if(!futex_spin(&prw->spin, &prw->stat, [&]()->bool {
+					return futex_rw_try_wlock(prw);
+				})) {
+			_u64 t = futex_now_ns();
+
+			for(;;) {
+				_u32 s = 0;
+
+				prw->waiters.fetch_add(1);
+				// stop new readers
+				s = prw->state.fetch_or(FUTEX_RW_WWAIT) | FUTEX_RW_WWAIT;
+				if(futex_rw_try_wlock(prw)) {
+					prw->waiters.fetch_sub(1);
+					break;
+				}
+				if(s & ~FUTEX_RW_WWAIT)
+					futex_wait(&prw->state, s, NULL);
+				prw->waiters.fetch_sub(1);
+			}
+
+			prw->stat.wait_ns.fetch_add(futex_now_ns() - t, std::memory_order_relaxed);
+		}
+	}
+}
+
+static inline void futex_rw_runlock(_futex_rwlock_t *prw) {
+	_u32 s = prw->state.fetch_sub(1) - 1;
+
+	if(!(s & FUTEX_RW_READERS) && prw->waiters.load())
+		futex_wake(&prw->state, INT_MAX);
+}
+
+static inline void futex_rw_wunlock(_futex_rwlock_t *prw) {
+	prw->state.fetch_and(~FUTEX_RW_WRITER);
+	if(prw->waiters.load())
+		futex_wake(&prw->state, INT_MAX);
+}
+
+#endif
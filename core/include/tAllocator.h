@@ -1,6 +1,8 @@
 #ifndef __TALLOCATOR_H__
 #define __TALLOCATOR_H__
 
+#include <cstddef>
+#include <typeinfo>
 #include "iMemory.h"
 #include "iRepository.h"
 
@@ -1,6 +1,8 @@
 #ifndef __I_LOG_H__
 #define __I_LOG_H__
 
+#include <string.h>
+#include <type_traits>
 #include "iBase.h"
 #include "iSync.h"
 
@@ -15,6 +17,88 @@
 
 typedef void _log_listener_t(_u8 lmt, _cstr_t msg);
 
+/* log mode */
+#define LOG_SYNC	0 // listeners are called by writers
+#define LOG_ASYNC	1 // listeners are called by background thread in batches
+
+/* overflow policy of asynchronous mode */
+#define LOG_BLOCK	0 // writer waits for free space
+#define LOG_DROP	1 // message is dropped (and counted)
+
+/* binary file sink */
+#define LOG_SEGMENT_SIZE	(16 * 1024 * 1024)
+
+typedef void _log_record_t(_u8 lmt, _u64 time, _cstr_t msg, void *udata);
+
+typedef struct {
+	_u8	mode;
+	_u8	overflow;
+	_u64	messages; // posted messages
+	_u64	dropped;
+	_u64	flushed; // messages delivered to listeners
+	_u64	batches; // deliveries to listeners
+	_u64	binary; // messages with deferred formatting
+}_log_stat_t;
+
+/* arguments of binary messages (formatted by the consumer) */
+#define LOG_MAX_ARGS_SIZE	512
+
+#define LOG_ARG_INT	'i'
+#define LOG_ARG_UINT	'u'
+#define LOG_ARG_DOUBLE	'd'
+#define LOG_ARG_PTR	'p'
+#define LOG_ARG_STR	's'
+
+typedef struct {
+	_u8	data[LOG_MAX_ARGS_SIZE];
+	_u32	size;
+
+	void put(_u8 type, const void *value, _u32 sz) {
+		if(size + sz + 1 <= sizeof(data)) {
+			data[size] = type;
+			memcpy(data + size + 1, value, sz);
+			size += sz + 1;
+		} else
+			size = sizeof(data); // no more arguments
+	}
+
+	void put_str(_cstr_t str) {
+		_u32 len = (str) ? strlen(str) : 0;
+
+		if(len > sizeof(data) - 3)
+			len = sizeof(data) - 3;
+
+		if(size + len + 3 <= sizeof(data)) {
+			_u16 _len = len;
+
+			data[size] = LOG_ARG_STR;
+			memcpy(data + size + 1, &_len, sizeof(_len));
+			memcpy(data + size + 3, str, len);
+			size += len + 3;
+		} else
+			size = sizeof(data);
+	}
+
+	template<typename _t>
+	void arg(_t v) {
+		if constexpr (std::is_floating_point<_t>::value) {
+			double d = v;
+			put(LOG_ARG_DOUBLE, &d, sizeof(d));
+		} else if constexpr (std::is_same<_t, _cstr_t>::value || std::is_same<_t, _str_t>::value)
+			put_str(v);
+		else if constexpr (std::is_pointer<_t>::value) {
+			_u64 p = (_u64)v;
+			put(LOG_ARG_PTR, &p, sizeof(p));
+		} else if constexpr (std::is_signed<_t>::value) {
+			_s64 i = v;
+			put(LOG_ARG_INT, &i, sizeof(i));
+		} else {
+			_u64 u = (_u64)v;
+			put(LOG_ARG_UINT, &u, sizeof(u));
+		}
+	}
+}_log_args_t;
+
 class iLog: public iBase {
 public:
 	INTERFACE(iLog, I_LOG);
@@ -26,6 +110,29 @@ public:
 	virtual _str_t next(HMUTEX=0)=0;
 	virtual HMUTEX lock(HMUTEX=0)=0;
 	virtual void unlock(HMUTEX)=0;
+	// switch between synchronous and asynchronous mode (LOG_SYNC/LOG_ASYNC)
+	virtual bool mode(_u8 mode, _u8 overflow=LOG_BLOCK)=0;
+	// wait until posted messages are delivered
+	virtual void flush(void)=0;
+	virtual void stat(_log_stat_t *)=0;
+	// message with deferred formatting ('fmt' must be static string)
+	virtual void bwrite(_u8 lmt, _cstr_t fmt, _log_args_t *args)=0;
+	// write messages to memory mapped segments 'path.YYYYmmdd-HHMMSS.N', rotated
+	// by size and time (seconds, 0 for size only), NULL path closes the file
+	virtual bool sink(_cstr_t path, _u32 segment_size=LOG_SEGMENT_SIZE, _u32 rotate_time=0)=0;
+	// read segment file, 'time' of records is realtime in nanoseconds
+	virtual bool decode(_cstr_t fname, _log_record_t *pcb, void *udata=NULL)=0;
+
+	// binary fast path of fwrite: arguments are copied, formatting
+	// is made by consumer (conversions without '*' only)
+	template<typename... _args_t>
+	void bfwrite(_u8 lmt, _cstr_t fmt, _args_t... args) {
+		_log_args_t la;
+
+		la.size = 0;
+		(la.arg(args), ...);
+		bwrite(lmt, fmt, &la);
+	}
 };
 
 #endif
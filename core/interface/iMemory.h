@@ -8,14 +8,24 @@
 #define I_LLIST		"iLlist"
 #define I_RING_BUFFER 	"iRingBuffer"
 #define I_MAP		"iMap"
+#define I_CONCURRENT_MAP "iConcurrentMap"
 #define I_BUFFER_MAP	"iBufferMap"
 #define I_POOL		"iPool"
+#define I_QUEUE		"iQueue"
+
+// iMap implementations (I_MAP returns the default one)
+#define CLASS_NAME_FAST_MAP	"cFastMap" // open addressing, non cryptographic hash
 
 typedef struct {
 	_u32 robj; // number of reserved objects
 	_u32 aobj; // number of active objects
 	_u32 dpgs; // number of data pages
 	_u32 mpgs; // number of meta pages
+	_u32 cobj; // number of objects in thread caches
+	_u32 cthreads; // number of threads with cache
+	_u64 chits; // allocations served by thread caches
+	_u64 crefill; // thread cache refills (batches)
+	_u64 cflush; // thread cache flushes (batches)
 }_heap_status_t;
 
 class iHeap:public iBase {
@@ -35,6 +45,17 @@ public:
 	virtual void push(void *msg, _u16 sz)=0;
 	virtual void *pull(_u16 *psz)=0;
 	virtual void reset_pull(void)=0;
+	// lock free mode (multiple producers, single consumer)
+	virtual bool init_mpsc(_u32 capacity)=0;
+	// reserve space for message (NULL if full), write in place and commit
+	virtual void *reserve(_u32 sz)=0;
+	virtual void commit(void *msg)=0;
+	// consumer side: oldest committed message, must be released after use
+	virtual void *read(_u32 *psz)=0;
+	// wait for message (timeout in milliseconds, zero means infinite)
+	virtual void *read_wait(_u32 *psz, _u32 timeout=0)=0;
+	virtual void release(void)=0;
+	virtual bool pending(void)=0;
 };
 
 typedef void*	_map_enum_t;
@@ -78,11 +99,75 @@ public:
 	virtual void status(_map_status_t *)=0;
 };
 
+typedef struct {
+	const void	*key;
+	_u32		sz_key;
+	void		*data; // pointer to record data (NULL if not found)
+	_u32		sz_data;
+}_cmap_key_t;
+
+// Sharded hash table for read mostly data. Writers are serialized per shard
+// and readers do not lock. Pointers to record data are valid until read_unlock
+// (or until record is removed/replaced, when called out of read section).
+class iConcurrentMap: public iBase {
+public:
+	INTERFACE(iConcurrentMap, I_CONCURRENT_MAP);
+	// shards is rounded to power of 2 (zero means default)
+	virtual bool init(_u32 capacity, _u32 shards=0, iHeap *pi_heap=0)=0;
+	// add new record (returns false if already exists)
+	virtual bool add(const void *key, _u32 sz_key, const void *data, _u32 sz_data)=0;
+	// add or replace record
+	virtual bool set(const void *key, _u32 sz_key, const void *data, _u32 sz_data)=0;
+	virtual void del(const void *key, _u32 sz_key)=0;
+	virtual _u32 cnt(void)=0;
+	// copy record data (sz_data: in - buffer size, out - data size)
+	virtual bool copy(const void *key, _u32 sz_key, void *buffer, _u32 *sz_data)=0;
+	// read section (can be nested)
+	virtual void read_lock(void)=0;
+	virtual void read_unlock(void)=0;
+	virtual void *get(const void *key, _u32 sz_key, _u32 *sz_data)=0;
+	// lookup for array of keys, returns number of found records
+	virtual _u32 get_batch(_cmap_key_t *p_keys, _u32 count)=0;
+	virtual void clr(void)=0;
+	// callback can't modify the map (ENUM_ERASE can be returned)
+	virtual void enumerate(_s32 (*)(void *, _u32, void *), void *)=0;
+	virtual void status(_map_status_t *)=0;
+};
+
 #define POOL_OP_NEW	1
 #define POOL_OP_BUSY	2
 #define POOL_OP_FREE	3
 #define POOL_OP_DELETE	4
 
+// pool flags
+#define POOL_SHARDED	1 // per thread free lists and lock free depot
+
+// queue modes
+#define Q_MPMC	0 // multiple producers, multiple consumers
+#define Q_SPSC	1 // single producer, single consumer
+
+// Bounded queue of fixed size items (lock free, except the waiting)
+class iQueue: public iBase {
+public:
+	INTERFACE(iQueue, I_QUEUE);
+	// capacity is rounded up to power of 2
+	virtual bool init(_u32 capacity, _u32 item_size, _u8 mode=Q_MPMC, iHeap *pi_heap=0)=0;
+	virtual void destroy(void)=0;
+	// returns false if queue is full
+	virtual bool push(const void *item)=0;
+	// returns false if queue is empty
+	virtual bool pop(void *item)=0;
+	// returns number of pushed/popped items
+	virtual _u32 push_batch(const void *items, _u32 count)=0;
+	virtual _u32 pop_batch(void *items, _u32 count)=0;
+	// wait for free space/item (timeout in milliseconds, zero means infinite)
+	virtual bool push_wait(const void *item, _u32 timeout=0)=0;
+	virtual bool pop_wait(void *item, _u32 timeout=0)=0;
+	// number of items (approximate)
+	virtual _u32 size(void)=0;
+	virtual _u32 capacity(void)=0;
+};
+
 typedef _s32 _pool_enum_t(void *data, _u32 size, void *udata);
 
 class iPool: public iBase {
@@ -91,7 +176,8 @@ public:
 	virtual bool init(_u32 data_size,
 			void (*cb)(_u8, void *, void *)=0,
 			void *udata=NULL,
-			iHeap *p=0)=0;
+			iHeap *p=0,
+			_u32 flags=0)=0;
 	virtual void *alloc(void)=0;
 	virtual void free(void *)=0;
 	virtual bool verify(void *)=0; // returns true if record is in BUSY state
@@ -106,6 +192,9 @@ public:
 
 #define LL_VECTOR	1
 #define LL_RING		2
+// storage flags (combined with mode)
+#define LL_SLAB		0x10 // records from per list slabs (16 bytes aligned data)
+#define LL_INDEX	0x20 // index array for O(1) get(index)
 
 class iLlist:public iBase {
 public:
@@ -176,6 +265,10 @@ public:
 
 #define MAX_UDATA64_INDEX	3
 
+// buffer map flags
+#define BMAP_SLAB	1 // page aligned buffers in pre-faulted slabs, lock free free list
+#define BMAP_ZERO	2 // (with BMAP_SLAB) buffers are zeroed by map before BIO_INIT
+
 typedef void*	HBUFFER;
 typedef _u32 _buffer_io_t(_u8 op, void *buffer, _u32 size, void *udata);
 
@@ -190,7 +283,7 @@ typedef struct {
 class iBufferMap: public iBase {
 public:
 	INTERFACE(iBufferMap, I_BUFFER_MAP);
-	virtual void init(_u32 buffer_size, _buffer_io_t *pcb_bio, iHeap *pi_heap=0)=0;
+	virtual void init(_u32 buffer_size, _buffer_io_t *pcb_bio, iHeap *pi_heap=0, _u32 flags=0)=0;
 	virtual void uninit(void)=0;
 	virtual HBUFFER alloc(void *udata=0)=0;
 	virtual void free(HBUFFER)=0;
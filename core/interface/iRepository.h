@@ -59,6 +59,40 @@ typedef _base_entry_t* HOBJECT;
  * @param[in] udata - Pointer to user data.  */
 typedef void _cb_enum_ext_t(_cstr_t file, _cstr_t alias, _base_entry_t *p_bentry, _u32 count, _u32 limit, void *udata);
 
+// extension_load_list flags
+#define EXT_PARALLEL	(1<<0) /*!< Initialize independent components in parallel */
+
+/**
+ * Extension load request (see extension_load_list). */
+typedef struct {
+	_cstr_t	file; //!< Extension file name
+	_cstr_t	alias; //!< Alias name (can be null)
+	_err_t	err; //!< [out] Result of loading
+	_u32	load_time; //!< [out] Time (in microseconds) for loading of shared object
+}_ext_load_t;
+
+/**
+ * @brief Prototype of initialization report callback.
+ * @param[in] alias - Extension alias name.
+ * @param[in] cname - Class name of component.
+ * @param[in] init_time - Initialization time in microseconds.
+ * @param[in] state - Component state after initialization (ST_INITIALIZED ...).
+ * @param[in] udata - User defined data.  */
+typedef void _cb_init_report_t(_cstr_t alias, _cstr_t cname, _u32 init_time, _cstat_t state, void *udata);
+
+/**
+ * Trace event (see trace_enable).  */
+typedef struct {
+	_char_t	name[48]; //!< Class name or extension alias
+	_cstr_t	cat; //!< Category ("init", "link", "scan", "pending", "dlopen")
+	_u64	ts; //!< Start time in microseconds
+	_u32	dur; //!< Duration in microseconds
+	_u32	tid; //!< Thread ID
+	_u32	count; //!< Number of iterations (pending list)
+}_trace_event_t;
+
+typedef void _cb_trace_t(_trace_event_t *p_event, void *udata);
+
 /**
  * Interface of a 'repository' component.
  *
@@ -161,6 +195,23 @@ public:
  * @return ERR_NONE for sucess, otherwise, ERR_MISSING for missing file or
  * ERR_DUPLICATED for already loaded extension or ERR_LOADEXT for other mistakes. */
 	virtual _err_t extension_load(_cstr_t file, _cstr_t alias=0)=0;
+/**
+ * Load list of extensions.
+ *
+ * All extensions are loaded before initialization of their components.
+ * Components are initialized in order of dependencies (by link maps), and with
+ * EXT_PARALLEL, components without dependencies between them are initialized
+ * in parallel. Components requesting another components in OCTL_INIT outside
+ * of link map should not be loaded with EXT_PARALLEL.
+ *
+ * @param[in,out] p_list - Array of _ext_load_t structures.
+ * @param[in] count - Number of elements in array.
+ * @param[in] flags - EXT_PARALLEL or 0.
+ * @param[in] pcb - Optional callback for initialization time of every component.
+ * @param[in] udata - User data that will be passed to callback.
+ * @return ERR_NONE when all extensions are loaded, otherwise error of the first failed one. */
+	virtual _err_t extension_load_list(_ext_load_t *p_list, _u32 count, _u32 flags=0,
+					_cb_init_report_t *pcb=0, void *udata=0)=0;
 /**
  * Unload extension
  *
@@ -174,6 +225,20 @@ public:
  * void _cb_enum_ext_t(_cstr_t file, _cstr_t alias, _base_entry_t *p_bentry, _u32 count, _u32 limit, void *udata)
  * @param[in] udata - User data that will be passed to callback. */
 	virtual void extension_enum(_cb_enum_ext_t *pcb, void *udata)=0;
+/**
+ * Enable/disable tracing of initialization (also enabled by PULSE_TRACE environment variable).
+ *
+ * @param[in] enable - true for enable. */
+	virtual void trace_enable(bool enable)=0;
+/**
+ * Enumeration of recorded trace events.
+ *
+ * @param[in] pcb - Pointer to enumeration callback.
+ * @param[in] udata - User data that will be passed to callback. */
+	virtual void trace_enum(_cb_trace_t *pcb, void *udata)=0;
+/**
+ * Remove all recorded trace events. */
+	virtual void trace_clear(void)=0;
 	virtual void destroy(void)=0;
 };
 
@@ -5,24 +5,57 @@
 
 #define I_MUTEX	"iMutex"
 #define I_EVENT	"iEvent"
+#define I_RW_LOCK	"iRWLock"
 
 typedef _u64	HMUTEX;
 typedef _u64 	_evt_t;
 
+// lock statistics
+typedef struct {
+	_u64	locks; // exclusive acquisitions
+	_u64	contended; // acquisitions which had to spin or sleep
+	_u64	spins; // spin iterations
+	_u64	wait_time; // time in sleep (nanoseconds)
+	_u64	owner; // thread ID of exclusive owner (0 when free)
+	_u32	readers; // current readers (iRWLock)
+	_u32	max_readers; // max. simultaneous readers (iRWLock)
+}_lock_stat_t;
+
 class iMutex: public iBase {
 public:
 	INTERFACE(iMutex, I_MUTEX);
 	virtual HMUTEX try_lock(HMUTEX=0)=0;
 	virtual HMUTEX lock(HMUTEX=0)=0;
 	virtual void unlock(HMUTEX)=0;
+	// zero statistics for implementations without them
+	virtual void stat(_lock_stat_t *p_stat) {
+		*p_stat = _lock_stat_t();
+	}
+};
+
+// Reader/writer lock. The exclusive part is recursive by handle (as iMutex),
+// the shared part is not recursive (it blocks when writer is waiting).
+class iRWLock: public iMutex {
+public:
+	INTERFACE(iRWLock, I_RW_LOCK);
+	virtual bool try_rlock(void)=0;
+	virtual void rlock(void)=0;
+	virtual void runlock(void)=0;
 };
 
 class iEvent: public iBase {
 public:
 	INTERFACE(iEvent, I_EVENT);
-	virtual _evt_t wait(_evt_t mask, _u32 sleep=0)=0;
+	// wait for any bit of mask (timeout in milliseconds, 0 means infinite),
+	// returns (and clears) signaled bits, or 0 for timeout
+	virtual _evt_t wait(_evt_t mask, _u32 timeout=0)=0;
+	// returns and clears signaled bits of mask (without clearing when mask is 0)
 	virtual _evt_t check(_evt_t mask)=0;
 	virtual void set(_evt_t mask)=0;
+	// wait for any of events (with separate mask for every event),
+	// returns index of signaled event and its bits in 'p_evt', or -1 for timeout
+	virtual _s32 wait_any(iEvent *events[], _evt_t masks[], _u32 count,
+				_evt_t *p_evt, _u32 timeout=0)=0;
 };
 #endif
 
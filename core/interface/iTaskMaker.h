@@ -4,12 +4,52 @@
 #include "iBase.h"
 
 #define I_TASK_MAKER	"iTaskMaker"
+#define I_THREAD_POOL	"iThreadPool"
 
 #define TM_SIG_START	1
 #define TM_SIG_STOP	2
 
 typedef void*	HTASK;
+typedef void*	HJOB;
 typedef void *_task_proc_t(_u8 sig, void *);
+typedef void *_job_proc_t(void *);
+
+// job priority
+#define JOB_PRIO_HIGH	0
+#define JOB_PRIO_NORMAL	1
+#define JOB_PRIO_LOW	2
+#define JOB_PRIO_COUNT	3
+
+typedef struct {
+	_u32	threads;
+	_u32	pending; // jobs in queues
+	_u64	done; // completed jobs
+	_u64	steals; // jobs taken from queue of another worker
+	_u64	cpu_time; // CPU time of all completed jobs (nanoseconds)
+}_tpool_stat_t;
+
+// Thread pool with work stealing. Jobs submitted from worker thread go
+// to its own queue, idle workers steal from the others.
+class iThreadPool: public iBase {
+public:
+	INTERFACE(iThreadPool, I_THREAD_POOL);
+	// threads=0 for number of CPUs, cpu_mask=0 for no affinity
+	virtual bool init(_cstr_t name, _u32 threads=0, _u64 cpu_mask=0)=0;
+	virtual void uninit(void)=0;
+	// returns handle of job (future), that must be passed to wait or release
+	virtual HJOB submit(_job_proc_t *proc, void *arg, _u8 prio=JOB_PRIO_NORMAL)=0;
+	// wait for job (timeout in milliseconds, 0 means infinite) and release it,
+	// returns false for timeout (the job is still valid). Called from a worker,
+	// it runs queued jobs while waiting.
+	virtual bool wait(HJOB, void **pp_result=0, _u32 timeout=0)=0;
+	virtual bool done(HJOB)=0;
+	// CPU time of completed job in nanoseconds
+	virtual _u64 cpu_time(HJOB)=0;
+	// forget the job (released after completion)
+	virtual void release(HJOB)=0;
+	virtual _cstr_t name(void)=0;
+	virtual void stat(_tpool_stat_t *)=0;
+};
 
 class iTaskMaker: public iBase {
 public:
@@ -23,6 +63,8 @@ public:
 	virtual _err_t detach(HTASK)=0;
 	virtual _err_t set_name(HTASK, _cstr_t name)=0;
 	virtual _err_t get_name(HTASK, _str_t name, _u32 len)=0;
+	// shared thread pool by name (created by the first call)
+	virtual iThreadPool *pool(_cstr_t name, _u32 threads=0, _u64 cpu_mask=0)=0;
 };
 
 #endif
@@ -1,6 +1,12 @@
 // buffer map
+#include <string.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
 #include "iMemory.h"
 #include "iRepository.h"
+#include "obj_cache.h"
+#include "page_arena.h"
 
 #define BFREE	0
 #define BBUSY	1
@@ -13,12 +19,46 @@ typedef struct __attribute__((packed)) {
 	_u64	udata64[MAX_UDATA64_INDEX];
 } _buffer_t;
 
+// slab mode
+#define BMAP_PAGE	ARENA_PAGE_SIZE
+#define BMAP_SLAB_MAX	16 // max. buffers per slab
+
+typedef struct { // buffer descriptor in slab mode
+	_buffer_t	b;
+	_u8		clean; // buffer memory is zero
+	_oc_link_t	link; // in free list
+}_sbuffer_t;
+
+#define SBUFFER(pb)	((_sbuffer_t *)((_u8 *)(pb) - offsetof(_sbuffer_t, b)))
+#define SBUFFER_LINK(pl) ((_sbuffer_t *)((_u8 *)(pl) - offsetof(_sbuffer_t, link)))
+
+typedef struct bmap_slab _bmap_slab_t;
+struct bmap_slab {
+	_bmap_slab_t	*next;
+	_u8		*base; // page aligned buffers
+	_u32		pages; // number of pages for buffers
+	_u32		count; // number of buffers
+	// descriptors follows
+};
+
+#define SLAB_BUFFER(ps, i) ((_sbuffer_t *)((ps) + 1) + (i))
+
 class cBufferMap: public iBufferMap {
 private:
 	iLlist	*mpi_list;
 	iHeap	*mpi_heap;
 	volatile _u32	m_bsize;
 	volatile _buffer_io_t *m_pcb_bio; // I/O callback
+	_u32	m_flags;
+	// slab mode
+	_u32	m_stride; // page aligned buffer size
+	_u32	m_slab_buffers; // buffers per slab
+	obj_cache	m_cache; // free buffers
+	std::mutex	m_slab_mutex; // protects slab list
+	_bmap_slab_t	*mp_slabs;
+	std::atomic<_u32> m_total;
+	std::atomic<_u32> m_busy;
+	std::atomic<_u32> m_dirty;
 
 	void uninit_llist(_u8 col, HMUTEX hlock) {
 		if(mpi_list) {
@@ -39,6 +79,159 @@ private:
 		}
 	}
 
+	// slab mode
+
+	// new slab, returns the first buffer (others goes to free list)
+	_sbuffer_t *grow(void) {
+		_sbuffer_t *r = NULL;
+		_u32 pages = (m_stride / BMAP_PAGE) * m_slab_buffers;
+		_u32 sz_slab = sizeof(_bmap_slab_t) + m_slab_buffers * sizeof(_sbuffer_t);
+		_bmap_slab_t *ps = NULL;
+
+		m_slab_mutex.lock();
+
+		if((ps = (_bmap_slab_t *)mpi_heap->alloc(sz_slab))) {
+			if((ps->base = (_u8 *)arena_page_alloc(pages))) {
+				_oc_link_t *free_list[BMAP_SLAB_MAX];
+
+				// pre-fault (arena pages may be reused, so it's zeroing too)
+				memset(ps->base, 0, pages * BMAP_PAGE);
+				ps->pages = pages;
+				ps->count = m_slab_buffers;
+
+				for(_u32 i = 0; i < ps->count; i++) {
+					_sbuffer_t *psb = SLAB_BUFFER(ps, i);
+
+					memset(&psb->b, 0, sizeof(_buffer_t));
+					psb->b.state = BFREE;
+					psb->b.ptr = ps->base + i * m_stride;
+					psb->clean = 1;
+					psb->link.next = NULL;
+					free_list[i] = &psb->link;
+				}
+
+				if(ps->count > 1)
+					m_cache.put_depot(free_list + 1, ps->count - 1);
+				r = SLAB_BUFFER(ps, 0);
+				ps->next = mp_slabs;
+				mp_slabs = ps;
+				m_total += ps->count;
+			} else
+				mpi_heap->free(ps, sz_slab);
+		}
+
+		m_slab_mutex.unlock();
+
+		return r;
+	}
+
+	void uninit_slabs(void) {
+		m_slab_mutex.lock();
+
+		while(mp_slabs) {
+			_bmap_slab_t *ps = mp_slabs;
+
+			mp_slabs = ps->next;
+			for(_u32 i = 0; i < ps->count; i++) {
+				if(m_pcb_bio)
+					m_pcb_bio(BIO_UNINIT, SLAB_BUFFER(ps, i)->b.ptr, m_bsize, SLAB_BUFFER(ps, i)->b.udata);
+			}
+			arena_page_free(ps->base, ps->pages);
+			mpi_heap->free(ps, sizeof(_bmap_slab_t) + ps->count * sizeof(_sbuffer_t));
+		}
+
+		m_cache.reset();
+		m_total = m_busy = m_dirty = 0;
+
+		m_slab_mutex.unlock();
+	}
+
+	HBUFFER alloc_slab(void *udata) {
+		HBUFFER r = 0;
+		_oc_link_t *pl = m_cache.get();
+		_sbuffer_t *psb = (pl) ? SBUFFER_LINK(pl) : grow();
+
+		if(psb) {
+			psb->b.udata = udata;
+			if((m_flags & BMAP_ZERO) && !psb->clean)
+				memset(psb->b.ptr, 0, m_bsize);
+			psb->clean = 0;
+			__atomic_store_n(&psb->b.state, BBUSY, __ATOMIC_RELEASE);
+			m_busy++;
+			if(m_pcb_bio)
+				m_pcb_bio(BIO_INIT, psb->b.ptr, m_bsize, psb->b.udata);
+			r = &psb->b;
+		}
+
+		return r;
+	}
+
+	void free_slab(_buffer_t *b) {
+		_u8 state = __atomic_load_n(&b->state, __ATOMIC_ACQUIRE);
+
+		if(state != BFREE) {
+			if(m_pcb_bio) {
+				if(state == BDIRTY)
+					m_pcb_bio(BIO_WRITE, b->ptr, m_bsize, b->udata);
+				m_pcb_bio(BIO_UNINIT, b->ptr, m_bsize, b->udata);
+			}
+
+			// state can be changed by flush/reset meanwhile
+			while(!__atomic_compare_exchange_n(&b->state, &state, BFREE, 0,
+							__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+			if(state != BFREE) {
+				if(state == BDIRTY)
+					m_dirty--;
+				else
+					m_busy--;
+				m_cache.put(&SBUFFER(b)->link);
+			}
+		}
+	}
+
+	// move buffer between BBUSY and BDIRTY
+	void set_state_slab(_buffer_t *b, _u8 from, _u8 to) {
+		if(__atomic_compare_exchange_n(&b->state, &from, to, 0,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			if(to == BDIRTY) {
+				m_busy--;
+				m_dirty++;
+			} else {
+				m_dirty--;
+				m_busy++;
+			}
+		}
+	}
+
+	// reset/flush in slab mode (op is BIO_READ or BIO_WRITE)
+	void sync_slab(_u8 op, _buffer_t *b) {
+		if(b) {
+			_u8 state = __atomic_load_n(&b->state, __ATOMIC_ACQUIRE);
+
+			if(state != BFREE && m_pcb_bio)
+				m_pcb_bio(op, b->ptr, m_bsize, b->udata);
+			if(state == BDIRTY)
+				set_state_slab(b, BDIRTY, BBUSY);
+		} else {
+			m_slab_mutex.lock();
+
+			for(_bmap_slab_t *ps = mp_slabs; ps; ps = ps->next) {
+				for(_u32 i = 0; i < ps->count; i++) {
+					_buffer_t *pb = &SLAB_BUFFER(ps, i)->b;
+
+					if(__atomic_load_n(&pb->state, __ATOMIC_ACQUIRE) == BDIRTY) {
+						if(m_pcb_bio)
+							m_pcb_bio(op, pb->ptr, m_bsize, pb->udata);
+						set_state_slab(pb, BDIRTY, BBUSY);
+					}
+				}
+			}
+
+			m_slab_mutex.unlock();
+		}
+	}
+
 public:
 	BASE(cBufferMap, "cBufferMap", RF_CLONE, 1,0,0);
 
@@ -51,13 +244,19 @@ public:
 				m_pcb_bio = 0;
 				mpi_heap = 0;
 				mpi_list = 0;
+				m_flags = 0;
+				mp_slabs = NULL;
+				m_total = m_busy = m_dirty = 0;
+				m_cache.init();
 				r = true;
 			} break;
 			case OCTL_UNINIT: {
 				iRepository *pi_repo = (iRepository *)arg;
 
 				uninit();
-				pi_repo->object_release(mpi_list);
+				m_cache.destroy();
+				if(mpi_list)
+					pi_repo->object_release(mpi_list);
 				pi_repo->object_release(mpi_heap);
 				mpi_list = 0;
 				r = true;
@@ -67,13 +266,20 @@ public:
 		return r;
 	}
 
-	void init(_u32 buffer_size, _buffer_io_t *pcb_bio, iHeap *pi_heap=0) {
+	void init(_u32 buffer_size, _buffer_io_t *pcb_bio, iHeap *pi_heap=0, _u32 flags=0) {
 		if(!m_bsize) {
 			if(!(mpi_heap = pi_heap))
 				mpi_heap = dynamic_cast<iHeap *>(_gpi_repo_->object_by_iname(I_HEAP, RF_ORIGINAL));
 
-			if((mpi_list = dynamic_cast<iLlist *>(_gpi_repo_->object_by_iname(I_LLIST, RF_CLONE))))
-				mpi_list->init(LL_VECTOR, 3, mpi_heap);
+			if((m_flags = flags) & BMAP_SLAB) {
+				m_stride = (buffer_size + BMAP_PAGE - 1) & ~(BMAP_PAGE - 1);
+				m_slab_buffers = (ARENA_MAX_RUN * BMAP_PAGE) / m_stride;
+				if(m_slab_buffers > BMAP_SLAB_MAX)
+					m_slab_buffers = BMAP_SLAB_MAX;
+				if(!m_slab_buffers)
+					m_slab_buffers = 1;
+			} else if(!mpi_list && (mpi_list = dynamic_cast<iLlist *>(_gpi_repo_->object_by_iname(I_LLIST, RF_CLONE))))
+				mpi_list->init(LL_VECTOR|LL_SLAB, 3, mpi_heap);
 
 			m_bsize = buffer_size;
 			m_pcb_bio = pcb_bio;
@@ -81,7 +287,11 @@ public:
 	}
 
 	void uninit(void) {
-		if(m_bsize) {
+		if(m_bsize && (m_flags & BMAP_SLAB)) {
+			uninit_slabs();
+			m_bsize = 0;
+			m_pcb_bio = 0;
+		} else if(m_bsize) {
 			HMUTEX hm = mpi_list->lock();
 
 			uninit_llist(BFREE, hm);
@@ -97,6 +307,18 @@ public:
 
 	HBUFFER alloc(void *udata=0) {
 		HBUFFER r = 0;
+
+		if(m_flags & BMAP_SLAB) {
+			if(m_bsize)
+				r = alloc_slab(udata);
+		} else
+			r = alloc_list(udata);
+
+		return r;
+	}
+
+	HBUFFER alloc_list(void *udata) {
+		HBUFFER r = 0;
 		HMUTEX hm = mpi_list->lock();
 
 		if(m_bsize) {
@@ -139,7 +361,10 @@ public:
 	void free(HBUFFER hb) {
 		_buffer_t *b = (_buffer_t *)hb;
 
-		if(b && mpi_list) {
+		if(b && (m_flags & BMAP_SLAB)) {
+			if(m_bsize)
+				free_slab(b);
+		} else if(b && mpi_list) {
 			HMUTEX hm = mpi_list->lock();
 
 			if(m_bsize) {
@@ -170,7 +395,9 @@ public:
 	void dirty(HBUFFER hb) {
 		_buffer_t *b = (_buffer_t *)hb;
 
-		if(b && mpi_list) {
+		if(b && (m_flags & BMAP_SLAB))
+			set_state_slab(b, BBUSY, BDIRTY);
+		else if(b && mpi_list) {
 			HMUTEX hm = mpi_list->lock();
 
 			if(m_bsize) {
@@ -221,7 +448,14 @@ public:
 	}
 
 	void reset(HBUFFER hb=0) {
-		_buffer_t *b = (_buffer_t *)hb;
+		if(m_flags & BMAP_SLAB) {
+			if(m_bsize)
+				sync_slab(BIO_READ, (_buffer_t *)hb);
+		} else
+			reset_list((_buffer_t *)hb);
+	}
+
+	void reset_list(_buffer_t *b) {
 		HMUTEX hm = mpi_list->lock();
 
 		if(m_bsize) {
@@ -259,7 +493,14 @@ public:
 	}
 
 	void flush(HBUFFER hb=0) {
-		_buffer_t *b = (_buffer_t *)hb;
+		if(m_flags & BMAP_SLAB) {
+			if(m_bsize)
+				sync_slab(BIO_WRITE, (_buffer_t *)hb);
+		} else
+			flush_list((_buffer_t *)hb);
+	}
+
+	void flush_list(_buffer_t *b) {
 		HMUTEX hm = mpi_list->lock();
 
 		if(m_bsize) {
@@ -297,6 +538,17 @@ public:
 	}
 
 	void status(_bmap_status_t *p_st) {
+		if(m_flags & BMAP_SLAB) {
+			p_st->b_size = size();
+			p_st->b_all = m_total;
+			p_st->b_busy = m_busy;
+			p_st->b_dirty = m_dirty;
+			p_st->b_free = p_st->b_all - p_st->b_busy - p_st->b_dirty;
+		} else
+			status_list(p_st);
+	}
+
+	void status_list(_bmap_status_t *p_st) {
 		HMUTEX hm = mpi_list->lock();
 
 		p_st->b_size = size();
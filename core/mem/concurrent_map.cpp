@@ -0,0 +1,686 @@
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include "iRepository.h"
+#include "iMemory.h"
+#include "oa_alg.h"
+
+#define CM_DEFAULT_SHARDS	16
+#define CM_MAX_SHARDS		256
+#define CM_MIN_CAPACITY		8 // per shard
+#define CM_MAX_READERS		1024 // threads with reader slot
+#define CM_RECLAIM		64 // retired blocks per shard before reclaim
+#define CM_BATCH		16 // keys hashed ahead by get_batch
+#define CM_CACHE_LINE		64
+
+typedef struct cm_retired _cm_retired_t;
+typedef struct cm_node _cm_node_t;
+typedef struct cm_table _cm_table_t;
+
+struct cm_retired { // header of nodes and tables
+	_cm_retired_t	*next;
+	_u64		epoch; // global epoch at retire time
+	_u32		size;
+};
+
+struct cm_node {
+	_cm_retired_t			ret;
+	std::atomic<_cm_node_t *>	next;
+	_u64				hash;
+	_u32				sz_key;
+	_u32				sz_data; // without terminating zero
+	// data, terminating zero and key follows
+};
+
+struct cm_table {
+	_cm_retired_t	ret;
+	_u32		capacity; // power of 2
+	// buckets follows
+};
+
+#define CM_DATA(pn)	((_u8 *)((pn) + 1))
+#define CM_KEY(pn)	(CM_DATA(pn) + (pn)->sz_data + 1)
+#define CM_BUCKETS(pt)	((std::atomic<_cm_node_t *> *)((pt) + 1))
+
+struct alignas(CM_CACHE_LINE) cm_shard {
+	std::mutex			mutex; // writers
+	std::atomic<_u32>		seq; // odd while rehash
+	std::atomic<_cm_table_t *>	table;
+	std::atomic<_u32>		records;
+	_cm_retired_t			*p_retired;
+	_u32				retired;
+};
+
+typedef struct cm_shard _cm_shard_t;
+
+// Epoch based reclamation (common for all instances).
+// Pinned reader publishes the global epoch in it's slot, and blocks
+// retired at this epoch or later can't be released until reader leaves.
+static std::atomic<_u64> _g_cm_epoch_(1);
+static std::atomic<_u64> _g_cm_reader_[CM_MAX_READERS]; // zero for idle slot
+static std::atomic<bool> _g_cm_slot_busy_[CM_MAX_READERS];
+static std::atomic<_u32> _g_cm_slots_(0); // max. used slot + 1
+static std::atomic<_u32> _g_cm_overflow_(0); // pinned readers without slot
+
+struct cm_tls {
+	_s32	slot;
+	_u32	nest;
+
+	cm_tls() {
+		slot = -1;
+		nest = 0;
+	}
+
+	~cm_tls() {
+		if(slot >= 0) {
+			_g_cm_reader_[slot].store(0);
+			_g_cm_slot_busy_[slot].store(false);
+		}
+	}
+};
+
+static thread_local cm_tls _g_cm_tls_;
+
+static void cm_claim_slot(cm_tls *p_tls) {
+	for(_u32 i = 0; i < CM_MAX_READERS; i++) {
+		bool busy = false;
+
+		if(_g_cm_slot_busy_[i].compare_exchange_strong(busy, true)) {
+			_u32 n = _g_cm_slots_.load();
+
+			while(n < i + 1 && !_g_cm_slots_.compare_exchange_weak(n, i + 1));
+			p_tls->slot = i;
+			break;
+		}
+	}
+}
+
+static void cm_pin(void) {
+	cm_tls *p_tls = &_g_cm_tls_;
+
+	if(!p_tls->nest++) {
+		if(p_tls->slot < 0)
+			cm_claim_slot(p_tls);
+
+		if(p_tls->slot >= 0) {
+			_u64 e;
+
+			// epoch may move between load and store
+			do {
+				e = _g_cm_epoch_.load();
+				_g_cm_reader_[p_tls->slot].store(e);
+			} while(_g_cm_epoch_.load() != e);
+		} else
+			_g_cm_overflow_++;
+	}
+}
+
+static void cm_unpin(void) {
+	cm_tls *p_tls = &_g_cm_tls_;
+
+	if(p_tls->nest && !--p_tls->nest) {
+		if(p_tls->slot >= 0)
+			_g_cm_reader_[p_tls->slot].store(0);
+		else
+			_g_cm_overflow_--;
+	}
+}
+
+// returns the oldest epoch that may be in use
+static _u64 cm_safe_epoch(void) {
+	_u64 r = _g_cm_epoch_.fetch_add(1) + 1;
+
+	if(_g_cm_overflow_.load())
+		// can't track readers without slot
+		r = 0;
+	else {
+		_u32 n = _g_cm_slots_.load();
+
+		for(_u32 i = 0; i < n; i++) {
+			_u64 e = _g_cm_reader_[i].load();
+
+			if(e && e < r)
+				r = e;
+		}
+	}
+
+	return r;
+}
+
+class cConcurrentMap: public iConcurrentMap {
+private:
+	iHeap *mpi_heap;
+	_cm_shard_t *mp_shard;
+	void *mp_shard_mem;
+	_u32 m_shards;
+	_u64 m_seed;
+	bool m_is_init, m_my_heap;
+
+	_cm_shard_t *shard(_u64 hash) {
+		return &mp_shard[(hash >> 48) & (m_shards - 1)];
+	}
+
+	_cm_table_t *alloc_table(_u32 capacity) {
+		_u32 size = sizeof(_cm_table_t) + capacity * sizeof(std::atomic<_cm_node_t *>);
+		_cm_table_t *r = (_cm_table_t *)mpi_heap->alloc(size);
+
+		if(r) {
+			memset(r, 0, size);
+			r->ret.size = size;
+			r->capacity = capacity;
+		}
+
+		return r;
+	}
+
+	_cm_node_t *alloc_node(_u64 hash, const void *key, _u32 sz_key, const void *data, _u32 sz_data) {
+		_u32 size = sizeof(_cm_node_t) + sz_data + 1 + sz_key;
+		_cm_node_t *r = (_cm_node_t *)mpi_heap->alloc(size);
+
+		if(r) {
+			r->ret.next = NULL;
+			r->ret.epoch = 0;
+			r->ret.size = size;
+			r->hash = hash;
+			r->sz_key = sz_key;
+			r->sz_data = sz_data;
+			r->next.store(NULL, std::memory_order_relaxed);
+			if(data)
+				memcpy(CM_DATA(r), data, sz_data);
+			else
+				memset(CM_DATA(r), 0, sz_data);
+			CM_DATA(r)[sz_data] = 0;
+			memcpy(CM_KEY(r), key, sz_key);
+		}
+
+		return r;
+	}
+
+	// release block after all current readers (shard must be locked)
+	void retire(_cm_shard_t *p_shard, _cm_retired_t *p_block) {
+		// unlink must be visible before the epoch is taken
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		p_block->epoch = _g_cm_epoch_.load();
+		p_block->next = p_shard->p_retired;
+		p_shard->p_retired = p_block;
+
+		if(++p_shard->retired >= CM_RECLAIM)
+			reclaim(p_shard);
+	}
+
+	void reclaim(_cm_shard_t *p_shard) {
+		_u64 safe = cm_safe_epoch();
+		_cm_retired_t **pp = &p_shard->p_retired;
+
+		while(*pp) {
+			_cm_retired_t *p = *pp;
+
+			if(p->epoch < safe) {
+				*pp = p->next;
+				mpi_heap->free(p, p->size);
+				p_shard->retired--;
+			} else
+				pp = &p->next;
+		}
+	}
+
+	static bool match(_cm_node_t *p_node, _u64 hash, const void *key, _u32 sz_key) {
+		return (p_node->hash == hash && p_node->sz_key == sz_key &&
+				memcmp(CM_KEY(p_node), key, sz_key) == 0);
+	}
+
+	// lock free lookup (caller must be pinned)
+	_cm_node_t *find(_u64 hash, const void *key, _u32 sz_key) {
+		_cm_node_t *r = NULL;
+		_cm_shard_t *p_shard = shard(hash);
+		_u32 seq;
+
+		do {
+			if((seq = p_shard->seq.load(std::memory_order_acquire)) & 1) {
+				// rehash in progress, wait for writer
+				p_shard->mutex.lock();
+				r = find_locked(p_shard, hash, key, sz_key, NULL);
+				p_shard->mutex.unlock();
+				break;
+			}
+
+			_cm_table_t *p_table = p_shard->table.load(std::memory_order_acquire);
+			_cm_node_t *p_node = CM_BUCKETS(p_table)[hash & (p_table->capacity - 1)].load(std::memory_order_acquire);
+
+			r = NULL;
+			while(p_node) {
+				if(match(p_node, hash, key, sz_key)) {
+					r = p_node;
+					break;
+				}
+				p_node = p_node->next.load(std::memory_order_acquire);
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			// nodes may be moved to other chain by rehash
+		} while(p_shard->seq.load(std::memory_order_relaxed) != seq);
+
+		return r;
+	}
+
+	// returns node and pointer to the link (shard must be locked)
+	_cm_node_t *find_locked(_cm_shard_t *p_shard, _u64 hash, const void *key, _u32 sz_key,
+				std::atomic<_cm_node_t *> **ppp_link) {
+		_cm_node_t *r = NULL;
+		_cm_table_t *p_table = p_shard->table.load(std::memory_order_relaxed);
+		std::atomic<_cm_node_t *> *p_link = &CM_BUCKETS(p_table)[hash & (p_table->capacity - 1)];
+		_cm_node_t *p_node = NULL;
+
+		while((p_node = p_link->load(std::memory_order_relaxed))) {
+			if(match(p_node, hash, key, sz_key)) {
+				r = p_node;
+				break;
+			}
+			p_link = &p_node->next;
+		}
+
+		if(ppp_link)
+			*ppp_link = p_link;
+
+		return r;
+	}
+
+	// double the table of shard (shard must be locked)
+	void rehash(_cm_shard_t *p_shard) {
+		_cm_table_t *p_old = p_shard->table.load(std::memory_order_relaxed);
+		_cm_table_t *p_new = alloc_table(p_old->capacity * 2);
+
+		if(p_new) {
+			std::atomic<_cm_node_t *> *p_ob = CM_BUCKETS(p_old);
+			std::atomic<_cm_node_t *> *p_nb = CM_BUCKETS(p_new);
+
+			p_shard->seq.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			// relink nodes (readers of old table retry by seq)
+			for(_u32 i = 0; i < p_old->capacity; i++) {
+				_cm_node_t *p_node = p_ob[i].load(std::memory_order_relaxed);
+
+				while(p_node) {
+					_cm_node_t *p_next = p_node->next.load(std::memory_order_relaxed);
+					_u32 idx = p_node->hash & (p_new->capacity - 1);
+
+					p_node->next.store(p_nb[idx].load(std::memory_order_relaxed), std::memory_order_release);
+					p_nb[idx].store(p_node, std::memory_order_relaxed);
+					p_node = p_next;
+				}
+			}
+
+			p_shard->table.store(p_new, std::memory_order_release);
+			p_shard->seq.fetch_add(1, std::memory_order_release);
+			retire(p_shard, &p_old->ret);
+		}
+	}
+
+	bool insert(const void *key, _u32 sz_key, const void *data, _u32 sz_data, bool replace) {
+		bool r = false;
+		_u64 hash = oa_hash(key, sz_key, m_seed);
+		_cm_shard_t *p_shard = shard(hash);
+		std::atomic<_cm_node_t *> *p_link = NULL;
+
+		p_shard->mutex.lock();
+
+		_cm_node_t *p_old = find_locked(p_shard, hash, key, sz_key, &p_link);
+
+		if(!p_old || replace) {
+			_cm_node_t *p_node = alloc_node(hash, key, sz_key, data, sz_data);
+
+			if(p_node) {
+				if(p_old) {
+					// replace in place of old node
+					p_node->next.store(p_old->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+					p_link->store(p_node, std::memory_order_release);
+					retire(p_shard, &p_old->ret);
+				} else {
+					_cm_table_t *p_table = p_shard->table.load(std::memory_order_relaxed);
+					std::atomic<_cm_node_t *> *p_head = &CM_BUCKETS(p_table)[hash & (p_table->capacity - 1)];
+
+					p_node->next.store(p_head->load(std::memory_order_relaxed), std::memory_order_relaxed);
+					p_head->store(p_node, std::memory_order_release);
+
+					if(p_shard->records.fetch_add(1, std::memory_order_relaxed) + 1 > p_table->capacity)
+						rehash(p_shard);
+				}
+
+				r = true;
+			}
+		}
+
+		p_shard->mutex.unlock();
+
+		return r;
+	}
+
+	// release everything (no readers)
+	void destroy_shard(_cm_shard_t *p_shard) {
+		_cm_table_t *p_table = p_shard->table.load();
+
+		if(p_table) {
+			std::atomic<_cm_node_t *> *p_bucket = CM_BUCKETS(p_table);
+
+			for(_u32 i = 0; i < p_table->capacity; i++) {
+				_cm_node_t *p_node = p_bucket[i].load();
+
+				while(p_node) {
+					_cm_node_t *p_next = p_node->next.load();
+
+					mpi_heap->free(p_node, p_node->ret.size);
+					p_node = p_next;
+				}
+			}
+
+			mpi_heap->free(p_table, p_table->ret.size);
+		}
+
+		while(p_shard->p_retired) {
+			_cm_retired_t *p = p_shard->p_retired;
+
+			p_shard->p_retired = p->next;
+			mpi_heap->free(p, p->size);
+		}
+
+		p_shard->~cm_shard();
+	}
+
+public:
+	BASE(cConcurrentMap, "cConcurrentMap", RF_CLONE, 1,0,0);
+
+	bool object_ctl(_u32 cmd, void *arg, ...) {
+		bool r = false;
+
+		switch(cmd) {
+			case OCTL_INIT:
+				m_is_init = m_my_heap = false;
+				mpi_heap = 0;
+				mp_shard = 0;
+				mp_shard_mem = 0;
+				m_shards = 0;
+				r = true;
+				break;
+			case OCTL_UNINIT: {
+				iRepository *pi_repo = (iRepository *)arg;
+
+				uninit();
+				if(m_my_heap)
+					pi_repo->object_release(mpi_heap);
+				r = true;
+			} break;
+		}
+
+		return r;
+	}
+
+	bool init(_u32 capacity, _u32 shards=0, iHeap *pi_heap=0) {
+		bool r = false;
+		_u32 shard_capacity = CM_MIN_CAPACITY;
+
+		if(!(mpi_heap = pi_heap)) {
+			if((mpi_heap = (iHeap *)_gpi_repo_->object_by_iname(I_HEAP, RF_ORIGINAL)))
+				m_my_heap = true;
+		}
+
+		if(!shards)
+			shards = CM_DEFAULT_SHARDS;
+		if(shards > CM_MAX_SHARDS)
+			shards = CM_MAX_SHARDS;
+		for(m_shards = 1; m_shards < shards; m_shards <<= 1);
+		while(shard_capacity * m_shards < capacity)
+			shard_capacity <<= 1;
+
+		// per instance seed (hash flooding)
+		m_seed = (_u64)this ^ ((_u64)time(NULL) << 32);
+
+		if(mpi_heap && (mp_shard_mem = mpi_heap->alloc((m_shards + 1) * sizeof(_cm_shard_t)))) {
+			// cache line aligned shards
+			mp_shard = (_cm_shard_t *)(((_ulong)mp_shard_mem + CM_CACHE_LINE - 1) & ~((_ulong)CM_CACHE_LINE - 1));
+			r = true;
+
+			for(_u32 i = 0; i < m_shards; i++) {
+				_cm_shard_t *p_shard = new (&mp_shard[i]) _cm_shard_t();
+
+				p_shard->seq = 0;
+				p_shard->records = 0;
+				p_shard->p_retired = NULL;
+				p_shard->retired = 0;
+				p_shard->table = alloc_table(shard_capacity);
+				if(!p_shard->table.load())
+					r = false;
+			}
+
+			if(r)
+				m_is_init = true;
+			else
+				uninit();
+		}
+
+		return r;
+	}
+
+	void uninit(void) {
+		if(mp_shard) {
+			for(_u32 i = 0; i < m_shards; i++)
+				destroy_shard(&mp_shard[i]);
+			mpi_heap->free(mp_shard_mem, (m_shards + 1) * sizeof(_cm_shard_t));
+			mp_shard = 0;
+			mp_shard_mem = 0;
+		}
+		m_is_init = false;
+	}
+
+	bool add(const void *key, _u32 sz_key, const void *data, _u32 sz_data) {
+		assert(m_is_init);
+		return insert(key, sz_key, data, sz_data, false);
+	}
+
+	bool set(const void *key, _u32 sz_key, const void *data, _u32 sz_data) {
+		assert(m_is_init);
+		return insert(key, sz_key, data, sz_data, true);
+	}
+
+	void del(const void *key, _u32 sz_key) {
+		assert(m_is_init);
+		_u64 hash = oa_hash(key, sz_key, m_seed);
+		_cm_shard_t *p_shard = shard(hash);
+		std::atomic<_cm_node_t *> *p_link = NULL;
+
+		p_shard->mutex.lock();
+
+		_cm_node_t *p_node = find_locked(p_shard, hash, key, sz_key, &p_link);
+
+		if(p_node) {
+			p_link->store(p_node->next.load(std::memory_order_relaxed), std::memory_order_release);
+			p_shard->records.fetch_sub(1, std::memory_order_relaxed);
+			retire(p_shard, &p_node->ret);
+		}
+
+		p_shard->mutex.unlock();
+	}
+
+	_u32 cnt(void) {
+		_u32 r = 0;
+
+		for(_u32 i = 0; i < m_shards; i++)
+			r += mp_shard[i].records.load(std::memory_order_relaxed);
+
+		return r;
+	}
+
+	bool copy(const void *key, _u32 sz_key, void *buffer, _u32 *sz_data) {
+		bool r = false;
+		assert(m_is_init);
+
+		cm_pin();
+
+		_cm_node_t *p_node = find(oa_hash(key, sz_key, m_seed), key, sz_key);
+
+		if(p_node) {
+			memcpy(buffer, CM_DATA(p_node), (*sz_data < p_node->sz_data) ? *sz_data : p_node->sz_data);
+			*sz_data = p_node->sz_data;
+			r = true;
+		}
+
+		cm_unpin();
+
+		return r;
+	}
+
+	void read_lock(void) {
+		cm_pin();
+	}
+
+	void read_unlock(void) {
+		cm_unpin();
+	}
+
+	void *get(const void *key, _u32 sz_key, _u32 *sz_data) {
+		void *r = NULL;
+		assert(m_is_init);
+
+		cm_pin();
+
+		_cm_node_t *p_node = find(oa_hash(key, sz_key, m_seed), key, sz_key);
+
+		if(p_node) {
+			r = CM_DATA(p_node);
+			if(sz_data)
+				*sz_data = p_node->sz_data;
+		}
+
+		cm_unpin();
+
+		return r;
+	}
+
+	_u32 get_batch(_cmap_key_t *p_keys, _u32 count) {
+		_u32 r = 0;
+		_u64 hash[CM_BATCH];
+		assert(m_is_init);
+
+		cm_pin();
+
+		for(_u32 i = 0; i < count; i += CM_BATCH) {
+			_u32 n = (count - i < CM_BATCH) ? count - i : CM_BATCH;
+
+			// hash keys and prefetch buckets first
+			for(_u32 j = 0; j < n; j++) {
+				_cm_table_t *p_table;
+
+				hash[j] = oa_hash(p_keys[i + j].key, p_keys[i + j].sz_key, m_seed);
+				p_table = shard(hash[j])->table.load(std::memory_order_relaxed);
+				__builtin_prefetch(&CM_BUCKETS(p_table)[hash[j] & (p_table->capacity - 1)]);
+			}
+
+			for(_u32 j = 0; j < n; j++) {
+				_cmap_key_t *pk = &p_keys[i + j];
+				_cm_node_t *p_node = find(hash[j], pk->key, pk->sz_key);
+
+				pk->data = NULL;
+				pk->sz_data = 0;
+				if(p_node) {
+					pk->data = CM_DATA(p_node);
+					pk->sz_data = p_node->sz_data;
+					r++;
+				}
+			}
+		}
+
+		cm_unpin();
+
+		return r;
+	}
+
+	void clr(void) {
+		assert(m_is_init);
+
+		for(_u32 i = 0; i < m_shards; i++) {
+			_cm_shard_t *p_shard = &mp_shard[i];
+
+			p_shard->mutex.lock();
+
+			_cm_table_t *p_table = p_shard->table.load(std::memory_order_relaxed);
+			std::atomic<_cm_node_t *> *p_bucket = CM_BUCKETS(p_table);
+
+			for(_u32 j = 0; j < p_table->capacity; j++) {
+				_cm_node_t *p_node = p_bucket[j].exchange(NULL, std::memory_order_acq_rel);
+
+				while(p_node) {
+					_cm_node_t *p_next = p_node->next.load(std::memory_order_relaxed);
+
+					retire(p_shard, &p_node->ret);
+					p_node = p_next;
+				}
+			}
+
+			p_shard->records.store(0, std::memory_order_relaxed);
+			p_shard->mutex.unlock();
+		}
+	}
+
+	void enumerate(_s32 (*pcb)(void *, _u32, void *), void *udata) {
+		bool cancel = false;
+		assert(m_is_init);
+
+		for(_u32 i = 0; i < m_shards && !cancel; i++) {
+			_cm_shard_t *p_shard = &mp_shard[i];
+
+			p_shard->mutex.lock();
+
+			_cm_table_t *p_table = p_shard->table.load(std::memory_order_relaxed);
+			std::atomic<_cm_node_t *> *p_bucket = CM_BUCKETS(p_table);
+
+			for(_u32 j = 0; j < p_table->capacity && !cancel; j++) {
+				std::atomic<_cm_node_t *> *p_link = &p_bucket[j];
+				_cm_node_t *p_node = NULL;
+
+				while(!cancel && (p_node = p_link->load(std::memory_order_relaxed))) {
+					switch(pcb(CM_DATA(p_node), p_node->sz_data, udata)) {
+						case ENUM_CANCEL:
+							cancel = true;
+							break;
+						case ENUM_ERASE:
+							p_link->store(p_node->next.load(std::memory_order_relaxed), std::memory_order_release);
+							p_shard->records.fetch_sub(1, std::memory_order_relaxed);
+							retire(p_shard, &p_node->ret);
+							break;
+						default:
+							p_link = &p_node->next;
+					}
+				}
+			}
+
+			p_shard->mutex.unlock();
+		}
+	}
+
+	void status(_map_status_t *p_st) {
+		memset(p_st, 0, sizeof(_map_status_t));
+		cm_pin();
+
+		for(_u32 i = 0; i < m_shards; i++) {
+			_cm_table_t *p_table = mp_shard[i].table.load(std::memory_order_acquire);
+			std::atomic<_cm_node_t *> *p_bucket = CM_BUCKETS(p_table);
+
+			p_st->capacity += p_table->capacity;
+			p_st->count += mp_shard[i].records.load(std::memory_order_relaxed);
+			// nodes out of bucket head (may be inaccurate while writing)
+			for(_u32 j = 0; j < p_table->capacity; j++) {
+				_cm_node_t *p_node = p_bucket[j].load(std::memory_order_acquire);
+
+				while(p_node && (p_node = p_node->next.load(std::memory_order_acquire)))
+					p_st->collisions++;
+			}
+		}
+
+		cm_unpin();
+	}
+};
+
+static cConcurrentMap _g_concurrent_map_;
@@ -0,0 +1,203 @@
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include "iRepository.h"
+#include "iMemory.h"
+#include "oa_alg.h"
+
+class cFastMap: public iMap {
+private:
+	iHeap *mpi_heap;
+	iMutex *mpi_mutex;
+	_oa_context_t oa_cxt;
+	bool m_is_init, m_my_heap;
+
+	static void *_alloc(_u32 size, void *udata) {
+		void *r = 0;
+		cFastMap *pobj = (cFastMap *)udata;
+		if(pobj)
+			r = pobj->mpi_heap->alloc(size);
+		return r;
+	}
+
+	static void _free(void *ptr, _u32 size, void *udata) {
+		cFastMap *pobj = (cFastMap *)udata;
+		if(pobj)
+			pobj->mpi_heap->free(ptr, size);
+	}
+
+public:
+	BASE(cFastMap, CLASS_NAME_FAST_MAP, RF_CLONE, 1,0,0);
+
+	bool object_ctl(_u32 cmd, void *arg, ...) {
+		bool r = false;
+
+		switch(cmd) {
+			case OCTL_INIT: {
+				iRepository *pi_repo = (iRepository *)arg;
+
+				m_is_init = m_my_heap = false;
+				mpi_heap = 0;
+				mpi_mutex = (iMutex *)pi_repo->object_by_iname(I_MUTEX, RF_CLONE);
+
+				if(mpi_mutex)
+					r = true;
+			} break;
+			case OCTL_UNINIT: {
+				iRepository *pi_repo = (iRepository *)arg;
+
+				uninit();
+				if(m_my_heap)
+					pi_repo->object_release(mpi_heap);
+				pi_repo->object_release(mpi_mutex);
+				r = true;
+			} break;
+		}
+
+		return r;
+	}
+
+	bool init(_u32 capacity, iHeap *pi_heap=0) {
+		bool r = false;
+
+		if(!(mpi_heap = pi_heap)) {
+			if((mpi_heap = (iHeap *)_gpi_repo_->object_by_iname(I_HEAP, RF_ORIGINAL)))
+				m_my_heap = true;
+		}
+
+		memset(&oa_cxt, 0, sizeof(_oa_context_t));
+		oa_cxt.pf_mem_alloc = _alloc;
+		oa_cxt.pf_mem_free = _free;
+		oa_cxt.udata = this;
+		// per instance seed (hash flooding)
+		oa_cxt.seed = (_u64)this ^ ((_u64)time(NULL) << 32);
+
+		if(oa_init(&oa_cxt, capacity) == _true)
+			m_is_init = r = true;
+
+		return r;
+	}
+
+	void uninit(void) {
+		oa_destroy(&oa_cxt);
+	}
+
+	HMUTEX lock(HMUTEX hlock=0) {
+		HMUTEX r = 0;
+
+		if(mpi_mutex)
+			r = mpi_mutex->lock(hlock);
+
+		return r;
+	}
+
+	void unlock(HMUTEX hlock) {
+		if(mpi_mutex)
+			mpi_mutex->unlock(hlock);
+	}
+
+	void *add(const void *key, _u32 sz_key, const void *data, _u32 sz_data, HMUTEX hlock=0) {
+		void *r = 0;
+		assert(m_is_init);
+		HMUTEX hm = lock(hlock);
+
+		r = oa_add(&oa_cxt, key, sz_key, data, sz_data);
+		unlock(hm);
+
+		return r;
+	}
+
+	void *set(const void *key, _u32 sz_key, const void *data, _u32 sz_data, HMUTEX hlock=0) {
+		void *r = 0;
+		assert(m_is_init);
+		HMUTEX hm = lock(hlock);
+
+		r = oa_set(&oa_cxt, key, sz_key, data, sz_data);
+		unlock(hm);
+
+		return r;
+	}
+
+	void del(const void *key, _u32 sz_key, HMUTEX hlock=0) {
+		assert(m_is_init);
+		HMUTEX hm = lock(hlock);
+
+		oa_del(&oa_cxt, key, sz_key);
+		unlock(hm);
+	}
+
+	_u32 cnt(void) {
+		return oa_cxt.records;
+	}
+
+	void *get(const void *key, _u32 sz_key, _u32 *sz_data, HMUTEX hlock=0) {
+		void *r = 0;
+		assert(m_is_init);
+		HMUTEX hm = lock(hlock);
+
+		r = oa_get(&oa_cxt, key, sz_key, sz_data);
+		unlock(hm);
+
+		return r;
+	}
+
+	void clr(HMUTEX hlock=0) {
+		assert(m_is_init);
+		HMUTEX hm = lock(hlock);
+
+		oa_clr(&oa_cxt);
+		unlock(hm);
+	}
+
+	_map_enum_t enum_open(void) {
+		assert(m_is_init);
+		return oa_enum_open(&oa_cxt);
+	}
+
+	void enum_close(_map_enum_t en) {
+		oa_enum_close(en);
+	}
+
+	void *enum_first(_map_enum_t en, _u32 *sz_data, HMUTEX hlock=0) {
+		void *r = 0;
+		HMUTEX hm = lock(hlock);
+
+		r = oa_enum_first(en, sz_data);
+		unlock(hm);
+
+		return r;
+	}
+
+	void *enum_next(_map_enum_t en, _u32 *sz_data, HMUTEX hlock=0) {
+		void *r = 0;
+		HMUTEX hm = lock(hlock);
+
+		r = oa_enum_next(en, sz_data);
+		unlock(hm);
+
+		return r;
+	}
+
+	void enum_del(_map_enum_t en, HMUTEX hlock=0) {
+		HMUTEX hm = lock(hlock);
+
+		oa_enum_del(en);
+		unlock(hm);
+	}
+
+	void enumerate(_s32 (*pcb)(void *, _u32, void *), void *udata, HMUTEX hlock=0) {
+		HMUTEX hm = lock(hlock);
+
+		oa_enum(&oa_cxt, pcb, udata);
+		unlock(hm);
+	}
+
+	void status(_map_status_t *p_st) {
+		p_st->capacity = oa_cxt.table.capacity;
+		p_st->count = oa_cxt.records;
+		p_st->collisions = oa_cxt.collisions;
+	}
+};
+
+static cFastMap _g_fast_map_;
+
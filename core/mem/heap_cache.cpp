@@ -0,0 +1,209 @@
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+#include "heap_cache.h"
+
+struct hc_thread { // magazines of one thread for one heap
+	heap_cache	*p_owner; // NULL when heap is gone
+	_hc_thread_t	*next; // next in owner's list
+	_u32		count[HC_CLASSES];
+	void		*mag[HC_CLASSES][HC_MAG_SIZE];
+	_hc_status_t	stat; // updated by owner thread only
+};
+
+// protects owner lists and owner pointers
+// (used by thread registration, thread exit and heap destroy only)
+static std::mutex _g_hc_mutex_;
+static std::atomic<_u64> _g_hc_id_(0);
+
+static void hc_flush(_hc_thread_t *pt) {
+	heap_cache *p_owner = pt->p_owner;
+
+	for(_u32 c = 0; c < HC_CLASSES; c++) {
+		if(pt->count[c]) {
+			p_owner->pf_free(HC_MIN_SIZE << c, pt->mag[c], pt->count[c], p_owner->udata);
+			pt->count[c] = 0;
+			pt->stat.flush++;
+		}
+	}
+}
+
+static void hc_detach(_hc_thread_t *pt) {
+	heap_cache *p_owner = pt->p_owner;
+
+	if(p_owner) {
+		_hc_thread_t **pp = &p_owner->p_threads;
+
+		while(*pp && *pp != pt)
+			pp = &(*pp)->next;
+		if(*pp)
+			*pp = pt->next;
+		pt->p_owner = NULL;
+	}
+}
+
+struct hc_tls { // thread slots
+	_u64		id[HC_MAX_HEAPS];
+	_hc_thread_t	*p_rec[HC_MAX_HEAPS];
+
+	~hc_tls() {
+		// thread exit
+		for(_u32 i = 0; i < HC_MAX_HEAPS; i++) {
+			_hc_thread_t *pt = p_rec[i];
+
+			if(pt) {
+				_g_hc_mutex_.lock();
+				if(pt->p_owner) {
+					hc_flush(pt);
+					hc_detach(pt);
+				}
+				_g_hc_mutex_.unlock();
+				::free(pt);
+				p_rec[i] = NULL;
+				id[i] = 0;
+			}
+		}
+	}
+};
+
+static thread_local hc_tls _g_hc_tls_;
+
+static _u32 hc_class(_u32 size) {
+	_u32 r = HC_CLASSES;
+
+	if(size && size <= HC_MAX_SIZE)
+		r = (size <= HC_MIN_SIZE) ? 0 : (32 - __builtin_clz(size - 1)) - 4;
+
+	return r;
+}
+
+void heap_cache::init(_hc_batch_alloc_t *_pf_alloc, _hc_batch_free_t *_pf_free, void *_udata) {
+	pf_alloc = _pf_alloc;
+	pf_free = _pf_free;
+	udata = _udata;
+	p_threads = NULL;
+	id = ++_g_hc_id_;
+}
+
+void heap_cache::destroy(void) {
+	_g_hc_mutex_.lock();
+
+	while(p_threads)
+		// thread releases the record at exit
+		hc_detach(p_threads);
+
+	_g_hc_mutex_.unlock();
+}
+
+_hc_thread_t *heap_cache::thread(void) {
+	_hc_thread_t *r = NULL;
+	hc_tls *p_tls = &_g_hc_tls_;
+	_u32 i = 0;
+
+	for(; i < HC_MAX_HEAPS; i++) {
+		if(p_tls->id[i] == id) {
+			r = p_tls->p_rec[i];
+			break;
+		}
+	}
+
+	if(!r) {
+		// first access to this heap from current thread
+		_g_hc_mutex_.lock();
+
+		for(i = 0; i < HC_MAX_HEAPS; i++) {
+			if(!p_tls->p_rec[i])
+				break;
+			if(!p_tls->p_rec[i]->p_owner) {
+				// reuse slot of destroyed heap
+				::free(p_tls->p_rec[i]);
+				p_tls->p_rec[i] = NULL;
+				break;
+			}
+		}
+
+		if(i < HC_MAX_HEAPS && (r = (_hc_thread_t *)::calloc(1, sizeof(_hc_thread_t)))) {
+			r->p_owner = this;
+			r->next = p_threads;
+			p_threads = r;
+			p_tls->p_rec[i] = r;
+			p_tls->id[i] = id;
+		}
+
+		_g_hc_mutex_.unlock();
+	}
+
+	return r;
+}
+
+void *heap_cache::alloc(_u32 size) {
+	void *r = NULL;
+	_u32 c = hc_class(size);
+	_hc_thread_t *pt = NULL;
+
+	if(c < HC_CLASSES && (pt = thread())) {
+		if(!pt->count[c]) {
+			pt->count[c] = pf_alloc(HC_MIN_SIZE << c, pt->mag[c], HC_BATCH, udata);
+			pt->stat.refill++;
+		}
+
+		if(pt->count[c]) {
+			r = pt->mag[c][--pt->count[c]];
+			pt->stat.alloc++;
+		}
+	}
+
+	return r;
+}
+
+bool heap_cache::free(void *ptr, _u32 size) {
+	bool r = false;
+	_u32 c = hc_class(size);
+	_hc_thread_t *pt = NULL;
+
+	if(c < HC_CLASSES && (pt = thread())) {
+		if(pt->count[c] == HC_MAG_SIZE) {
+			// return the oldest half (keep the hot objects)
+			pf_free(HC_MIN_SIZE << c, pt->mag[c], HC_BATCH, udata);
+			memmove(pt->mag[c], pt->mag[c] + HC_BATCH, (HC_MAG_SIZE - HC_BATCH) * sizeof(void *));
+			pt->count[c] -= HC_BATCH;
+			pt->stat.flush++;
+		}
+
+		pt->mag[c][pt->count[c]++] = ptr;
+		pt->stat.free++;
+		r = true;
+	}
+
+	return r;
+}
+
+void heap_cache::flush(void) {
+	hc_tls *p_tls = &_g_hc_tls_;
+
+	for(_u32 i = 0; i < HC_MAX_HEAPS; i++) {
+		if(p_tls->id[i] == id) {
+			hc_flush(p_tls->p_rec[i]);
+			break;
+		}
+	}
+}
+
+void heap_cache::status(_hc_status_t *p_hs) {
+	memset(p_hs, 0, sizeof(_hc_status_t));
+	_g_hc_mutex_.lock();
+
+	for(_hc_thread_t *pt = p_threads; pt; pt = pt->next) {
+		// counters of other threads may be a bit behind
+		p_hs->alloc += pt->stat.alloc;
+		p_hs->free += pt->stat.free;
+		p_hs->refill += pt->stat.refill;
+		p_hs->flush += pt->stat.flush;
+		for(_u32 c = 0; c < HC_CLASSES; c++)
+			p_hs->objects += pt->count[c];
+		p_hs->threads++;
+	}
+
+	_g_hc_mutex_.unlock();
+}
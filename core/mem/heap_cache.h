@@ -0,0 +1,52 @@
+#ifndef __HEAP_CACHE_H__
+#define __HEAP_CACHE_H__
+
+#include "dtype.h"
+
+// Per thread magazines (size classes 16 ... 2048 bytes) in front of heap
+
+#define HC_MIN_SIZE	16
+#define HC_CLASSES	8
+#define HC_MAX_SIZE	(HC_MIN_SIZE << (HC_CLASSES - 1))
+#define HC_MAG_SIZE	32 // objects per magazine
+#define HC_BATCH	(HC_MAG_SIZE / 2) // objects per refill/flush
+#define HC_MAX_HEAPS	8 // cached heaps per thread
+
+// take up to 'n' objects from heap and return number of objects
+typedef _u32 _hc_batch_alloc_t(_u32 size, void **ptrs, _u32 n, void *udata);
+// return 'n' objects to heap
+typedef void _hc_batch_free_t(_u32 size, void **ptrs, _u32 n, void *udata);
+
+typedef struct {
+	_u64	alloc; // allocations from magazine
+	_u64	free; // deallocations to magazine
+	_u64	refill; // batches taken from heap
+	_u64	flush; // batches returned to heap
+	_u32	objects; // objects in magazines
+	_u32	threads; // number of threads with magazines
+}_hc_status_t;
+
+typedef struct hc_thread _hc_thread_t;
+
+struct heap_cache {
+	_hc_batch_alloc_t	*pf_alloc;
+	_hc_batch_free_t	*pf_free;
+	void			*udata;
+	_u64			id; // unique (never reused) cache ID
+	_hc_thread_t		*p_threads; // magazines of all threads
+
+	void init(_hc_batch_alloc_t *, _hc_batch_free_t *, void *udata);
+	// detach threads (objects in magazines stays with heap memory)
+	void destroy(void);
+	// return NULL when size is not cached
+	void *alloc(_u32 size);
+	// return false when object is not cached (caller should free it)
+	bool free(void *ptr, _u32 size);
+	void status(_hc_status_t *);
+	// return magazines of current thread to heap
+	void flush(void);
+private:
+	_hc_thread_t *thread(void);
+};
+
+#endif
@@ -17,6 +17,272 @@ static void _set(_u8 *ptr, _u8 x, _u32 sz) {
 		*(ptr + i) = x;
 }
 
+static void _cpy(_u8 *dst,_u8 *src,_u32 sz) {
+	_u32 _sz = sz;
+	_u32 i = 0;
+
+	while(_sz) {
+		*(dst + i) = *(src + i);
+		i++;
+		_sz--;
+	}
+}
+
+static _ll_slab_class_t *_slab_class(_ll_context_t *p_cxt, _u32 item_size, _u8 create) {
+	_ll_slab_class_t *r = 0;
+	_u32 i = 0;
+
+	/* classes are never released before the list is empty */
+	for(; i < LL_SLAB_CLASSES; i++) {
+		if(p_cxt->slab[i].item_size == item_size) {
+			r = &p_cxt->slab[i];
+			break;
+		}
+		if(!p_cxt->slab[i].item_size) {
+			if(create) {
+				r = &p_cxt->slab[i];
+				r->item_size = item_size;
+			}
+			break;
+		}
+	}
+
+	return r;
+}
+
+static _u32 _item_size(_u32 size) {
+	return (size + sizeof(_ll_item_hdr_t) + LL_ALIGN - 1) & ~(LL_ALIGN - 1);
+}
+
+/* first item of slab (slab pointer is stored before it) */
+static _u8 *_slab_items(_ll_slab_t *ps) {
+	return (_u8 *)(((_ulong)(ps + 1) + sizeof(_ll_slab_t *) + LL_ALIGN - 1) & ~((_ulong)LL_ALIGN - 1));
+}
+
+static void _slab_unlink(_ll_slab_class_t *pc, _ll_slab_t *ps) {
+	if(ps->prev)
+		ps->prev->next = ps->next;
+	else
+		pc->p_slab = ps->next;
+	if(ps->next)
+		ps->next->prev = ps->prev;
+	else
+		pc->p_last = ps->prev;
+	ps->prev = ps->next = 0;
+}
+
+static void _slab_link_first(_ll_slab_class_t *pc, _ll_slab_t *ps) {
+	ps->prev = 0;
+	ps->next = pc->p_slab;
+	if(pc->p_slab)
+		pc->p_slab->prev = ps;
+	else
+		pc->p_last = ps;
+	pc->p_slab = ps;
+}
+
+static void _slab_link_last(_ll_slab_class_t *pc, _ll_slab_t *ps) {
+	ps->next = 0;
+	ps->prev = pc->p_last;
+	if(pc->p_last)
+		pc->p_last->next = ps;
+	else
+		pc->p_slab = ps;
+	pc->p_last = ps;
+}
+
+/* take item from slab (list must be locked) */
+static _ll_item_hdr_t *_slab_alloc(_ll_context_t *p_cxt, _u32 item_size) {
+	_ll_item_hdr_t *r = 0;
+	_ll_slab_class_t *pc = _slab_class(p_cxt, item_size, 1);
+
+	if(pc) {
+		_ll_slab_t *ps = pc->p_slab;
+
+		if(!ps || !ps->p_free) {
+			/* all slabs are full */
+			_u32 sz = sizeof(_ll_slab_t) + sizeof(_ll_slab_t *) + LL_ALIGN + item_size * LL_SLAB_ITEMS;
+
+			if((ps = (_ll_slab_t *)p_cxt->p_alloc(sz, p_cxt->addr_limit, p_cxt->p_udata))) {
+				_u8 *p = _slab_items(ps);
+				_s32 i = LL_SLAB_ITEMS - 1;
+
+				*((_ll_slab_t **)p - 1) = ps;
+				ps->size = sz;
+				ps->used = 0;
+				ps->p_free = 0;
+				/* first item at head of free list */
+				for(; i >= 0; i--) {
+					_ll_item_hdr_t *pi = (_ll_item_hdr_t *)(p + i * item_size);
+
+					pi->slot = i;
+					pi->next = ps->p_free;
+					ps->p_free = pi;
+				}
+
+				_slab_link_first(pc, ps);
+			}
+		}
+
+		if(ps && (r = ps->p_free)) {
+			ps->p_free = r->next;
+			ps->used++;
+			if(!ps->p_free && ps->next) {
+				/* keep slabs with free items in front */
+				_slab_unlink(pc, ps);
+				_slab_link_last(pc, ps);
+			}
+		}
+	}
+
+	return r;
+}
+
+/* return item to its slab and release the slab when it's empty (list must be locked) */
+static void _slab_free(_ll_context_t *p_cxt, _ll_item_hdr_t *p) {
+	_u32 item_size = _item_size(p->size);
+	_ll_slab_class_t *pc = _slab_class(p_cxt, item_size, 0);
+
+	if(pc) {
+		_u8 *items = (_u8 *)p - p->slot * item_size;
+		_ll_slab_t *ps = *((_ll_slab_t **)items - 1);
+		_u8 full = (ps->p_free == 0);
+
+		p->next = ps->p_free;
+		ps->p_free = p;
+		ps->used--;
+
+		if(!ps->used && (ps->prev || ps->next)) {
+			/* keep the last slab of class for next allocation */
+			_slab_unlink(pc, ps);
+			p_cxt->p_free(ps, ps->size, p_cxt->p_udata);
+		} else if(full && ps->prev) {
+			_slab_unlink(pc, ps);
+			_slab_link_first(pc, ps);
+		}
+	}
+}
+
+static void _slab_release(_ll_context_t *p_cxt) {
+	_u32 i = 0;
+
+	for(; i < LL_SLAB_CLASSES; i++) {
+		_ll_slab_class_t *pc = &p_cxt->slab[i];
+
+		while(pc->p_slab) {
+			_ll_slab_t *ps = pc->p_slab;
+
+			pc->p_slab = ps->next;
+			p_cxt->p_free(ps, ps->size, p_cxt->p_udata);
+		}
+
+		pc->item_size = 0;
+		pc->p_last = 0;
+	}
+}
+
+/* allocate item and lock the list
+   (slab items are taken under the same lock, that links them) */
+static _ll_item_hdr_t *_alloc_item(_ll_context_t *p_cxt, _u32 size, _u64 hlock, _u64 *p_hm) {
+	_ll_item_hdr_t *r = 0;
+	_u32 sz = size + sizeof(_ll_item_hdr_t);
+	_u8 flags = 0;
+	_u8 slot = 0;
+
+	if((p_cxt->flags & LL_MODE_SLAB) && _item_size(size) <= LL_SLAB_MAX) {
+		*p_hm = ll_lock(p_cxt, hlock);
+		if((r = _slab_alloc(p_cxt, _item_size(size)))) {
+			flags = LL_ITEM_SLAB;
+			slot = r->slot;
+		} else if(p_cxt->p_alloc)
+			r = (_ll_item_hdr_t *)p_cxt->p_alloc(sz, p_cxt->addr_limit, p_cxt->p_udata);
+	} else {
+		if(p_cxt->p_alloc)
+			r = (_ll_item_hdr_t *)p_cxt->p_alloc(sz, p_cxt->addr_limit, p_cxt->p_udata);
+		*p_hm = ll_lock(p_cxt, hlock);
+	}
+
+	if(r) {
+		/* clear record */
+		_set((_u8 *)r, 0, sz);
+
+		r->cxt = p_cxt;
+		r->size = size;
+		r->col = p_cxt->ccol;
+		r->flags = flags;
+		r->slot = slot;
+	}
+
+	return r;
+}
+
+/* list must be locked */
+static void _free_item(_ll_context_t *p_cxt, _ll_item_hdr_t *p) {
+	p->cxt = 0; /* do not belong to this list any more */
+
+	if(p->flags & LL_ITEM_SLAB)
+		_slab_free(p_cxt, p);
+	else if(p_cxt->p_free)
+		p_cxt->p_free(p, p->size + sizeof(_ll_item_hdr_t), p_cxt->p_udata);
+}
+
+/* insert item in index array at 'pos' (before increasing the counter) */
+static void _idx_ins(_ll_context_t *p_cxt, _ll_state_t *p_st, _u32 pos, _ll_item_hdr_t *p) {
+	if((p_cxt->flags & LL_MODE_INDEX) && !p_st->index_off) {
+		_u32 i = p_st->count;
+
+		if(p_st->count >= p_st->index_capacity) {
+			_u32 capacity = (p_st->index_capacity) ? p_st->index_capacity * 2 : LL_INDEX_MIN;
+			_ll_item_hdr_t **pp = (_ll_item_hdr_t **)p_cxt->p_alloc(capacity * sizeof(_ll_item_hdr_t *),
+									p_cxt->addr_limit, p_cxt->p_udata);
+
+			if(pp && p_st->pp_index)
+				_cpy((_u8 *)pp, (_u8 *)p_st->pp_index, p_st->count * sizeof(_ll_item_hdr_t *));
+			if(p_st->pp_index)
+				p_cxt->p_free(p_st->pp_index, p_st->index_capacity * sizeof(_ll_item_hdr_t *), p_cxt->p_udata);
+
+			if((p_st->pp_index = pp))
+				p_st->index_capacity = capacity;
+			else {
+				/* walk the list until it's cleared */
+				p_st->index_capacity = 0;
+				p_st->index_off = 1;
+			}
+		}
+
+		if(p_st->pp_index) {
+			for(; i > pos; i--)
+				p_st->pp_index[i] = p_st->pp_index[i - 1];
+			p_st->pp_index[pos] = p;
+		}
+	}
+}
+
+/* remove item from index array (before decreasing the counter) */
+static void _idx_rem(_ll_state_t *p_st, _u32 hint, _ll_item_hdr_t *p) {
+	if(p_st->pp_index) {
+		_u32 i = hint;
+
+		if(i >= p_st->count || p_st->pp_index[i] != p) {
+			for(i = 0; i < p_st->count; i++) {
+				if(p_st->pp_index[i] == p)
+					break;
+			}
+		}
+
+		for(; i + 1 < p_st->count; i++)
+			p_st->pp_index[i] = p_st->pp_index[i + 1];
+	}
+}
+
+static void _idx_clr(_ll_context_t *p_cxt, _ll_state_t *p_st) {
+	if(p_st->pp_index)
+		p_cxt->p_free(p_st->pp_index, p_st->index_capacity * sizeof(_ll_item_hdr_t *), p_cxt->p_udata);
+	p_st->pp_index = 0;
+	p_st->index_capacity = 0;
+	p_st->index_off = 0;
+}
+
 _u8 ll_init(_ll_context_t *p_cxt, _u8 mode, _u8 ncol, _ulong addr_limit) {
 	_u8 r = 0;
 
@@ -24,7 +290,10 @@ _u8 ll_init(_ll_context_t *p_cxt, _u8 mode, _u8 ncol, _ulong addr_limit) {
 		_u64 lock = ll_lock(p_cxt, 0);
 		_u32 ssz = ncol * sizeof(_ll_state_t);
 
-		p_cxt->mode = mode;
+		p_cxt->mode = mode & LL_MODE_MASK;
+		p_cxt->flags = mode & ~LL_MODE_MASK;
+		p_cxt->items = 0;
+		_set((_u8 *)p_cxt->slab, 0, sizeof(p_cxt->slab));
 		p_cxt->ncol = ncol;
 		p_cxt->addr_limit = addr_limit;
 		p_cxt->ccol = 0;
@@ -48,6 +317,7 @@ void ll_uninit(_ll_context_t *p_cxt) {
 			ll_col(p_cxt, i, lock);
 			ll_clr(p_cxt, lock);
 		}
+		_slab_release(p_cxt);
 		p_cxt->p_free(p_cxt->state, p_cxt->ncol * sizeof(_ll_state_t), p_cxt->p_udata);
 		p_cxt->state = 0;
 		p_cxt->ncol = 0;
@@ -64,23 +334,16 @@ _u32 ll_cnt(_ll_context_t *p_cxt, _u64 hlock) {
 	return r;
 }
 
-static void _cpy(_u8 *dst,_u8 *src,_u32 sz) {
-	_u32 _sz = sz;
-	_u32 i = 0;
-
-	while(_sz) {
-		*(dst + i) = *(src + i);
-		i++;
-		_sz--;
-	}
-}
-
 _ll_item_hdr_t *_get(_ll_context_t *p_cxt, _u32 index) {
 	_u32 i = 0;
 	_ll_item_hdr_t *p = 0;
 
 	if(index < p_cxt->state[p_cxt->ccol].count) {
-		if((p = p_cxt->state[p_cxt->ccol].p_current)) {
+		if(p_cxt->state[p_cxt->ccol].pp_index) {
+			p = p_cxt->state[p_cxt->ccol].pp_index[index];
+			p_cxt->state[p_cxt->ccol].current = index;
+			p_cxt->state[p_cxt->ccol].p_current = p;
+		} else if((p = p_cxt->state[p_cxt->ccol].p_current)) {
 			i = p_cxt->state[p_cxt->ccol].current;
 
 			while(i != index && i < p_cxt->state[p_cxt->ccol].count) {
@@ -124,109 +387,68 @@ void *ll_get(_ll_context_t *p_cxt, _u32 index, _u32 *p_size, _u64 hlock) {
 	return r;
 }
 
-// alloc new empty record
-void *ll_new(_ll_context_t *p_cxt, _u32 size, _u64 hlock) {
-	void *r = 0;
-	_u32 sz = size + sizeof(_ll_item_hdr_t);
- 	_ll_item_hdr_t *p = 0; /* prev */
+/* link item at end of current column (list must be locked) */
+static void _append(_ll_context_t *p_cxt, _ll_item_hdr_t *p) {
+	_ll_state_t *p_st = &p_cxt->state[p_cxt->ccol];
 
-	if(p_cxt->p_alloc)
-		p = (_ll_item_hdr_t *)p_cxt->p_alloc(sz, p_cxt->addr_limit, p_cxt->p_udata);
+	if(p_st->p_last)
+		p_st->p_last->next = p;
 
-	if(p) {
-		/* clear record */
-		_set((_u8 *)p, 0, sz);
-
-		p->cxt = p_cxt;
-		p->size= size;
-		p->col = p_cxt->ccol;
-
-		_u64 hm = ll_lock(p_cxt, hlock);
-
-		if(p_cxt->state[p_cxt->ccol].p_last)
-			p_cxt->state[p_cxt->ccol].p_last->next = p;
+	p->prev = p_st->p_last;
+	if(p_cxt->mode == LL_MODE_RING)
+		p->next = p_st->p_first;
+	else
+		p->next = 0;
 
-		p->prev = p_cxt->state[p_cxt->ccol].p_last;
-		if(p_cxt->mode == LL_MODE_RING)
-			p->next = p_cxt->state[p_cxt->ccol].p_first;
-		else
-			p->next = 0;
+	p_st->p_last = p_st->p_current = p;
 
-		p_cxt->state[p_cxt->ccol].p_last = p_cxt->state[p_cxt->ccol].p_current = p;
+	if(!p_st->p_first)
+		p_st->p_first = p;
 
-		if(!p_cxt->state[p_cxt->ccol].p_first)
-			p_cxt->state[p_cxt->ccol].p_first = p;
+	_idx_ins(p_cxt, p_st, p_st->count, p);
+	/* make the new item as current */
+	p_st->current = p_st->count;
+	/* increase items counter */
+	p_st->count++;
+	p_cxt->items++;
+}
 
-		/* make the new item as current */
-		p_cxt->state[p_cxt->ccol].current = p_cxt->state[p_cxt->ccol].count;
-		/* increase items counter */
-		p_cxt->state[p_cxt->ccol].count++;
+// alloc new empty record
+void *ll_new(_ll_context_t *p_cxt, _u32 size, _u64 hlock) {
+	void *r = 0;
+	_u64 hm = 0;
+	_ll_item_hdr_t *p = _alloc_item(p_cxt, size, hlock, &hm);
 
-		ll_unlock(p_cxt, hm);
+	if(p) {
+		_append(p_cxt, p);
 
 		/* move the pointer to user data area
 			(skip the item header) */
 		r = (p + 1);
 	}
 
+	ll_unlock(p_cxt, hm);
+
 	return r;
 }
 
 void *ll_add(_ll_context_t *p_cxt, void *p_data, _u32 size, _u64 hlock) {
 	void *r = 0;
- 	_ll_item_hdr_t *_p = 0; /* prev */
-	_u32 sz = size + sizeof(_ll_item_hdr_t);
-
-
-	if(p_cxt->p_alloc)
-		_p = (_ll_item_hdr_t *)p_cxt->p_alloc(sz, p_cxt->addr_limit, p_cxt->p_udata);
+	_u64 hm = 0;
+	_ll_item_hdr_t *_p = _alloc_item(p_cxt, size, hlock, &hm);
 
 	if(_p) {
-		/* clear memory region */
-		_u8 *ptr = (_u8 *)_p;
-		_u32 i = 0;
-
-		for(; i < sz; i++)
-			*(ptr + i) = 0;
-
-		_p->cxt = p_cxt;
-		_p->size= size;
-		_p->col = p_cxt->ccol;
-
-		_u64 hm = ll_lock(p_cxt, hlock);
-
-		if(p_cxt->state[p_cxt->ccol].p_last)
-			p_cxt->state[p_cxt->ccol].p_last->next = _p;
-
-		_p->prev = p_cxt->state[p_cxt->ccol].p_last;
-		if(p_cxt->mode == LL_MODE_RING)
-			_p->next = p_cxt->state[p_cxt->ccol].p_first;
-		else
-			_p->next = 0;
-
 		/* copy user data to newly allocated memory */
-		_u8 *dst = (_u8 *)_p;
-		_u8 *src = (_u8 *)p_data;
-		_cpy(dst + sizeof(_ll_item_hdr_t), src, size);
-		/******************************************/
-
-		p_cxt->state[p_cxt->ccol].p_last = p_cxt->state[p_cxt->ccol].p_current = _p;
-
-		if(!p_cxt->state[p_cxt->ccol].p_first)
-			p_cxt->state[p_cxt->ccol].p_first = _p;
-
-		/* make the new item as current */
-		p_cxt->state[p_cxt->ccol].current = p_cxt->state[p_cxt->ccol].count;
-		/* increase items counter */
-		p_cxt->state[p_cxt->ccol].count++;
-
-		ll_unlock(p_cxt, hm);
+		_cpy((_u8 *)(_p + 1), (_u8 *)p_data, size);
+		_append(p_cxt, _p);
 
 		/* move the pointer to user data area
 			(skip the item header) */
 		r = (_p + 1);
 	}
 
+	ll_unlock(p_cxt, hm);
+
 	return r;
 }
 
@@ -235,26 +457,14 @@ void *ll_ins(_ll_context_t *p_cxt, _u32 index, void *p_data, _u32 size, _u64 hlo
 	_ll_item_hdr_t *p_prev = NULL; /* prev */
 	_ll_item_hdr_t *p_new = NULL; /* new */
 	_ll_item_hdr_t *p_cur = NULL; /* current */
-	_u32 sz = size + sizeof(_ll_item_hdr_t);
 
 	if(index < p_cxt->state[p_cxt->ccol].count) {
-		if(p_cxt->p_alloc)
-			p_new = (_ll_item_hdr_t *)p_cxt->p_alloc(sz, p_cxt->addr_limit, p_cxt->p_udata);
+		_u64 hm = 0;
 
+		p_new = _alloc_item(p_cxt, size, hlock, &hm);
 		if(p_new) {
-			/* clear memory region */
-			_u8 *ptr = (_u8 *)p_new;
-			_u32 i = 0;
-
-			for(; i < sz; i++)
-				*(ptr + i) = 0;
-
-			_u64 hm = ll_lock(p_cxt, hlock);
-
 			p_cur = _get(p_cxt, index);
 			if(p_cur) {
-				p_new->cxt = p_cxt;
-				p_new->size= size;
 				p_new->col = p_cxt->ccol;
 
 				/* initialize the new header */
@@ -278,19 +488,19 @@ void *ll_ins(_ll_context_t *p_cxt, _u32 index, void *p_data, _u32 size, _u64 hlo
 				p_new->next = p_cur;
 				p_cur->prev = p_new;
 
+				_idx_ins(p_cxt, &p_cxt->state[p_cxt->ccol], index, p_new);
 				p_cxt->state[p_cxt->ccol].p_current = p_new;
 				p_cxt->state[p_cxt->ccol].current = index;
 				p_cxt->state[p_cxt->ccol].count++;
+				p_cxt->items++;
 
 				/* skip header (return pointer to user data area) */
 				r = (p_new + 1);
-			} else {
-				if(p_cxt->p_free)
-					p_cxt->p_free(p_new, sz, p_cxt->p_udata);
-			}
-
-			ll_unlock(p_cxt, hm);
+			} else
+				_free_item(p_cxt, p_new);
 		}
+
+		ll_unlock(p_cxt, hm);
 	}
 
 	return r;
@@ -301,6 +511,8 @@ void  ll_rem(_ll_context_t *p_cxt, _u32 index, _u64 hlock) {
 
 	_ll_item_hdr_t *p_cur = _get(p_cxt, index);
 	if(p_cur && p_cxt->p_free) {
+		_idx_rem(&p_cxt->state[p_cxt->ccol], index, p_cur);
+
 		if(p_cur->prev)
 			/* releate prev to next */
 			p_cur->prev->next = p_cur->next;
@@ -330,10 +542,10 @@ void  ll_rem(_ll_context_t *p_cxt, _u32 index, _u64 hlock) {
 		}
 
 		p_cxt->state[p_cxt->ccol].count--;
+		p_cxt->items--;
 
 		/* release memory */
-		_u32 sz = p_cur->size + sizeof(_ll_item_hdr_t);
-		p_cxt->p_free(p_cur, sz, p_cxt->p_udata);
+		_free_item(p_cxt, p_cur);
 	}
 
 	ll_unlock(p_cxt, hm);
@@ -346,6 +558,8 @@ void  ll_del(_ll_context_t *p_cxt, _u64 hlock) {
 	if(p_cur && p_cxt->p_free) {
 		_ll_item_hdr_t *p_prev = p_cur->prev, *p_next = p_cur->next;
 
+		_idx_rem(&p_cxt->state[p_cxt->ccol], p_cxt->state[p_cxt->ccol].current, p_cur);
+
 		if(p_prev)
 			/* releate prev to next */
 			p_prev->next = p_cur->next;
@@ -372,12 +586,11 @@ void  ll_del(_ll_context_t *p_cxt, _u64 hlock) {
 			p_cxt->state[p_cxt->ccol].current--;
 		}
 
-		p_cur->cxt = 0; /* do not belong to this list any more */
 		p_cxt->state[p_cxt->ccol].count--;
+		p_cxt->items--;
 
 		/* release memory */
-		_u32 sz = p_cur->size + sizeof(_ll_item_hdr_t);
-		p_cxt->p_free(p_cur, sz, p_cxt->p_udata);
+		_free_item(p_cxt, p_cur);
 	}
 
 	ll_unlock(p_cxt, hm);
@@ -391,8 +604,8 @@ void  ll_clr(_ll_context_t *p_cxt, _u64 hlock) {
 	for(; i < p_cxt->state[p_cxt->ccol].count; i++) {
 		if(p) {
 			_ll_item_hdr_t *_p = p->next;
-			_u32 sz = p->size + sizeof(_ll_item_hdr_t);
-			p_cxt->p_free(p, sz, p_cxt->p_udata);
+			_free_item(p_cxt, p);
+			p_cxt->items--;
 			p = _p;
 			p_cxt->state[p_cxt->ccol].p_first = p;
 		} else
@@ -403,6 +616,11 @@ void  ll_clr(_ll_context_t *p_cxt, _u64 hlock) {
 			p_cxt->state[p_cxt->ccol].p_first =
 			p_cxt->state[p_cxt->ccol].p_last = 0;
 	p_cxt->state[p_cxt->ccol].count = p_cxt->state[p_cxt->ccol].current = 0;
+	_idx_clr(p_cxt, &p_cxt->state[p_cxt->ccol]);
+
+	if(!p_cxt->items)
+		/* return slabs to heap */
+		_slab_release(p_cxt);
 
 	ll_unlock(p_cxt, hm);
 }
@@ -440,6 +658,7 @@ _u8 ll_mov(_ll_context_t *p_cxt, void *p_data, _u8 col, _u64 hlock) {
 		/* unlink from source column */
 		_ll_item_hdr_t *p_src_prev = p_hdr->prev;
 		_ll_item_hdr_t *p_src_next = p_hdr->next;
+		_idx_rem(p_ss, p_ss->current, p_hdr);
 		if(p_src_prev)
 			p_src_prev->next = p_src_next;
 		if(p_src_next)
@@ -467,6 +686,7 @@ _u8 ll_mov(_ll_context_t *p_cxt, void *p_data, _u8 col, _u64 hlock) {
 				else
 					p_hdr->next = 0;
 				p_ds->p_last = p_hdr;
+				_idx_ins(p_cxt, p_ds, p_ds->count, p_hdr);
 			} else if(p_ds->p_first) {
 				p_ds->p_first->prev = p_hdr;
 				p_hdr->next = p_ds->p_first;
@@ -475,6 +695,7 @@ _u8 ll_mov(_ll_context_t *p_cxt, void *p_data, _u8 col, _u64 hlock) {
 				else
 					p_hdr->prev = 0;
 				p_ds->p_first = p_hdr;
+				_idx_ins(p_cxt, p_ds, 0, p_hdr);
 			} else /* !!! panic */
 				goto _mov_done_;
 		} else {
@@ -483,6 +704,7 @@ _u8 ll_mov(_ll_context_t *p_cxt, void *p_data, _u8 col, _u64 hlock) {
 				p_hdr->next = p_ds->p_first;
 			else
 				p_hdr->prev = p_hdr->next = 0;
+			_idx_ins(p_cxt, p_ds, 0, p_hdr);
 		}
 		p_hdr->col = col;
 		p_ds->count++;
@@ -507,6 +729,14 @@ void ll_roll(_ll_context_t *p_cxt, _u64 hlock) {
 			pf->next = pc;
 			pc->prev = pl;
 			p_cxt->state[p_cxt->ccol].p_last = pf;
+			if(p_cxt->state[p_cxt->ccol].pp_index) {
+				_ll_state_t *p_st = &p_cxt->state[p_cxt->ccol];
+				_u32 i = 0;
+
+				for(; i + 1 < p_st->count; i++)
+					p_st->pp_index[i] = p_st->pp_index[i + 1];
+				p_st->pp_index[p_st->count - 1] = pf;
+			}
 		}
 		ll_unlock(p_cxt, hm);
 	}
@@ -522,6 +752,9 @@ void *ll_next(_ll_context_t *p_cxt, _u32 *p_size, _u64 hlock) {
 		r = (p_cxt->state[ccol].p_current + 1);
 		*p_size = p_cxt->state[ccol].p_current->size;
 		p_cxt->state[ccol].current++;
+		/* header of the following item */
+		if(p->next->next)
+			__builtin_prefetch(p->next->next);
 	}
 	ll_unlock(p_cxt, hm);
 	return r;
@@ -549,6 +782,8 @@ void *ll_first(_ll_context_t *p_cxt, _u32 *p_size, _u64 hlock) {
 		r = p+1;
 		*p_size = p->size;
 		p_cxt->state[ccol].current = 0;
+		if(p->next)
+			__builtin_prefetch(p->next);
 	}
 
 	ll_unlock(p_cxt, hm);
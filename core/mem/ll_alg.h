@@ -5,6 +5,19 @@
 
 #define LL_MODE_VECTOR	1
 #define LL_MODE_RING	2
+#define LL_MODE_MASK	0x0f
+/* storage flags (combined with mode) */
+#define LL_MODE_SLAB	0x10 /* items from per list slabs */
+#define LL_MODE_INDEX	0x20 /* index array for O(1) access by index */
+
+#define LL_ALIGN	16 /* alignment of item data */
+#define LL_SLAB_ITEMS	32 /* items per slab */
+#define LL_SLAB_CLASSES	4 /* different item sizes per list */
+#define LL_SLAB_MAX	1024 /* max. item size (with header) in slab */
+#define LL_INDEX_MIN	16 /* initial capacity of index array */
+
+/* item flags */
+#define LL_ITEM_SLAB	(1<<0)
 
 typedef void *_ll_alloc_t(_u32 size, _ulong limit, void *p_udata);
 typedef void _ll_free_t(void *ptr, _u32 size, void *p_udata);
@@ -16,9 +29,26 @@ struct ll_item_hdr {
 	void		*cxt; /* pointer to _ll_context_t */
 	_u32		size; /* data size */
 	_u8		col;
+	_u8		flags;
+	_u8		slot; /* index in slab */
 	_ll_item_hdr_t *prev;	/* prev. item */
 	_ll_item_hdr_t *next;	/* next item */
-}__attribute__((packed));
+}__attribute__((aligned(LL_ALIGN)));
+
+typedef struct ll_slab _ll_slab_t;
+struct ll_slab {
+	_ll_slab_t	*prev;
+	_ll_slab_t	*next;
+	_u32		size; /* allocated size */
+	_u32		used; /* items in list */
+	_ll_item_hdr_t	*p_free; /* free items (linked by 'next') */
+};
+
+typedef struct {
+	_u32		item_size; /* header + data (zero for unused class) */
+	_ll_slab_t	*p_slab; /* slabs with free items first */
+	_ll_slab_t	*p_last;
+}_ll_slab_class_t;
 
 typedef struct {
 	_ll_item_hdr_t	*p_first;
@@ -26,6 +56,9 @@ typedef struct {
 	_ll_item_hdr_t	*p_current;
 	_u32		count;
 	_u32		current;
+	_ll_item_hdr_t	**pp_index; /* LL_MODE_INDEX */
+	_u32		index_capacity;
+	_u8		index_off; /* no memory for index */
 }_ll_state_t;
 
 typedef struct {
@@ -39,6 +72,9 @@ typedef struct {
 	_u8		ccol;
 	_u8 		ncol;
 	_ll_state_t	*state;
+	_u8		flags; /* storage flags */
+	_u32		items; /* in all columns */
+	_ll_slab_class_t slab[LL_SLAB_CLASSES];
 }_ll_context_t;
 
 #ifdef __cplusplus
@@ -23,6 +23,9 @@ _bool map_init(_map_context_t *p_mcxt) {
 		if((p_mcxt->pp_list = p_mcxt->pf_mem_alloc(p_mcxt->capacity * sizeof(_map_rec_hdr_t *), p_mcxt->udata))) {
 			memset(p_mcxt->pp_list, 0, p_mcxt->capacity * sizeof(_map_rec_hdr_t *));
 			p_mcxt->records = p_mcxt->collisions = 0;
+			p_mcxt->min_capacity = p_mcxt->capacity;
+			p_mcxt->old_capacity = p_mcxt->migrate = 0;
+			p_mcxt->pp_old = NULL;
 			r = _true;
 		}
 	}
@@ -57,37 +60,50 @@ static _bool add_record(_map_rec_hdr_t *p_rec, _map_rec_hdr_t **pp_map, _u32 cap
 	return r;
 }
 
-static _bool remap(_map_context_t *p_mcxt) {
+/* move next 'buckets' of old table into the current one */
+static void migrate(_map_context_t *p_mcxt, _u32 buckets) {
+	while(p_mcxt->pp_old && buckets) {
+		_map_rec_hdr_t *p_rec = p_mcxt->pp_old[p_mcxt->migrate];
+
+		while(p_rec) {
+			_map_rec_hdr_t *p_next = p_rec->next;
+
+			p_rec->next = NULL;
+			add_record(p_rec, p_mcxt->pp_list, p_mcxt->capacity, &p_mcxt->collisions);
+			p_rec = p_next;
+		}
+
+		p_mcxt->pp_old[p_mcxt->migrate] = NULL;
+		p_mcxt->migrate++;
+		buckets--;
+
+		if(p_mcxt->migrate == p_mcxt->old_capacity) {
+			/* migration done */
+			p_mcxt->pf_mem_free(p_mcxt->pp_old, p_mcxt->old_capacity * sizeof(_map_rec_hdr_t *), p_mcxt->udata);
+			p_mcxt->pp_old = NULL;
+			p_mcxt->old_capacity = p_mcxt->migrate = 0;
+		}
+	}
+}
+
+/* start migration to table with new capacity */
+static _bool resize(_map_context_t *p_mcxt, _u32 new_capacity) {
 	_bool r = _false;
 
 	if(p_mcxt->pf_mem_alloc && p_mcxt->pf_mem_free && p_mcxt->capacity) {
-		_u32 new_capacity = (p_mcxt->capacity * 2) + 1;
-		_map_rec_hdr_t **pp_new_map = p_mcxt->pf_mem_alloc(new_capacity * sizeof(_map_rec_hdr_t *), p_mcxt->udata);
-		_u32 collisions = 0;
+		_map_rec_hdr_t **pp_new_map = NULL;
 
-		if(pp_new_map) {
-			_u32 i = 0;
-			_map_rec_hdr_t *p_rec = NULL;
+		/* finish the previous one */
+		migrate(p_mcxt, p_mcxt->old_capacity);
 
+		if((pp_new_map = p_mcxt->pf_mem_alloc(new_capacity * sizeof(_map_rec_hdr_t *), p_mcxt->udata))) {
 			memset(pp_new_map, 0, new_capacity * sizeof(_map_rec_hdr_t *));
-			while(i < p_mcxt->capacity) {
-				if((p_rec = p_mcxt->pp_list[i])) {
-					_map_rec_hdr_t *p_next = NULL;
-
-					do {
-						p_next = p_rec->next;
-						p_rec->next = NULL;
-						add_record(p_rec, pp_new_map, new_capacity, &collisions);
-					} while((p_rec = p_next));
-				}
-
-				i++;
-			}
-
-			p_mcxt->pf_mem_free(p_mcxt->pp_list, p_mcxt->capacity * sizeof(_map_rec_hdr_t *), p_mcxt->udata);
+			p_mcxt->pp_old = p_mcxt->pp_list;
+			p_mcxt->old_capacity = p_mcxt->capacity;
+			p_mcxt->migrate = 0;
 			p_mcxt->pp_list = pp_new_map;
 			p_mcxt->capacity = new_capacity;
-			p_mcxt->collisions = collisions;
+			p_mcxt->collisions = 0;
 			r = _true;
 		}
 	}
@@ -95,27 +111,44 @@ static _bool remap(_map_context_t *p_mcxt) {
 	return r;
 }
 
+/* search in bucket (returns record and previous one) */
+static _map_rec_hdr_t *find_record(_map_rec_hdr_t *p_first, _u8 *hash_key, _map_rec_hdr_t **pp_prev) {
+	_map_rec_hdr_t *r = p_first;
+
+	*pp_prev = NULL;
+	while(r) {
+		if(memcmp(r->key, hash_key, HASH_SIZE) == 0)
+			break;
+		*pp_prev = r;
+		r = r->next;
+	}
+
+	return r;
+}
+
+/* returns record, previous record and bucket (of current or old table) */
 static _map_rec_hdr_t *get_record(_map_context_t *p_mcxt,
 				void *key,
 				_u32 sz_key,
 				_u8 *hash_key,
-				_u32 *idx,
+				_map_rec_hdr_t ***ppp_bucket,
 				_map_rec_hdr_t **pp_prev) {
 	_map_rec_hdr_t *r = NULL;
 
 	if(p_mcxt->pp_list) {
+		_ulong h;
+
 		if(p_mcxt->pf_hash)
 			p_mcxt->pf_hash((_u8 *)key, sz_key, hash_key, p_mcxt->udata);
 		else
 			memcpy(hash_key, key, (sz_key < HASH_SIZE) ? sz_key : HASH_SIZE);
 
-		*idx = hash(hash_key, HASH_SIZE) % p_mcxt->capacity;
-		if((r = p_mcxt->pp_list[*idx])) {
-			do {
-				if(memcmp(r->key, hash_key, HASH_SIZE) == 0)
-					break;
-				*pp_prev = r;
-			} while((r = r->next));
+		h = hash(hash_key, HASH_SIZE);
+		*ppp_bucket = &p_mcxt->pp_list[h % p_mcxt->capacity];
+		if(!(r = find_record(**ppp_bucket, hash_key, pp_prev)) && p_mcxt->pp_old) {
+			/* not migrated yet */
+			*ppp_bucket = &p_mcxt->pp_old[h % p_mcxt->old_capacity];
+			r = find_record(**ppp_bucket, hash_key, pp_prev);
 		}
 	}
 
@@ -126,8 +159,8 @@ void *map_get(_map_context_t *p_mcxt, void *key, _u32 sz_key, _u32 *sz_data) {
 	void *r = NULL;
 	_u8 hash_key[HASH_SIZE]="";
 	_map_rec_hdr_t *p_prev = NULL;
-	_u32 idx;
-	_map_rec_hdr_t *p_rec = get_record(p_mcxt, key, sz_key, hash_key, &idx, &p_prev);
+	_map_rec_hdr_t **pp_bucket = NULL;
+	_map_rec_hdr_t *p_rec = get_record(p_mcxt, key, sz_key, hash_key, &pp_bucket, &p_prev);
 
 	if(p_rec) {
 		*sz_data = p_rec->sz_rec -1;
@@ -158,27 +191,35 @@ static _map_rec_hdr_t *alloc_record(_map_context_t *p_mcxt, _u8 *hash_key, void
 	return p_rec;
 }
 
+/* add new record to current table (grow if needed) */
+static void *insert_record(_map_context_t *p_mcxt, _map_rec_hdr_t *p_rec) {
+	void *r = NULL;
+
+	if(add_record(p_rec, p_mcxt->pp_list, p_mcxt->capacity, &p_mcxt->collisions)) {
+		p_mcxt->records++;
+		if(p_mcxt->records >= p_mcxt->capacity)
+			resize(p_mcxt, (p_mcxt->capacity * 2) + 1);
+		r = (p_rec + 1);
+	} else
+		p_mcxt->pf_mem_free(p_rec, sizeof(_map_rec_hdr_t) + p_rec->sz_rec, p_mcxt->udata);
+
+	return r;
+}
+
 void *map_add(_map_context_t *p_mcxt, void *key, _u32 sz_key, void *data, _u32 sz_data) {
 	void *r = NULL;
 	_u8 hash_key[HASH_SIZE]="";
 	_map_rec_hdr_t *p_prev = NULL;
-	_u32 idx;
-	_map_rec_hdr_t *p_rec = get_record(p_mcxt, key, sz_key, hash_key, &idx, &p_prev);
+	_map_rec_hdr_t **pp_bucket = NULL;
+	_map_rec_hdr_t *p_rec = NULL;
 
-	if(p_rec)
+	migrate(p_mcxt, MAP_MIGRATE);
+
+	if((p_rec = get_record(p_mcxt, key, sz_key, hash_key, &pp_bucket, &p_prev)))
 		r = (p_rec + 1);
 	else {
-		if((p_rec = alloc_record(p_mcxt, hash_key, data, sz_data))) {
-			if(add_record(p_rec, p_mcxt->pp_list, p_mcxt->capacity, &p_mcxt->collisions)) {
-				p_mcxt->records++;
-				if(p_mcxt->records >= p_mcxt->capacity)
-					remap(p_mcxt);
-				r = (p_rec + 1);
-			} else {
-				p_mcxt->pf_mem_free(p_rec, sizeof(_map_rec_hdr_t) + sz_data, p_mcxt->udata);
-				r = NULL;
-			}
-		}
+		if((p_rec = alloc_record(p_mcxt, hash_key, data, sz_data)))
+			r = insert_record(p_mcxt, p_rec);
 	}
 
 	return r;
@@ -196,17 +237,8 @@ void *map_set(_map_context_t *p_mcxt, void *key, _u32 sz_key, void *data, _u32 s
 	else
 		memcpy(hash_key, key, (sz_key < HASH_SIZE) ? sz_key : HASH_SIZE);
 
-	if((p_rec = alloc_record(p_mcxt, hash_key, data, sz_data))) {
-		if(add_record(p_rec, p_mcxt->pp_list, p_mcxt->capacity, &p_mcxt->collisions)) {
-			p_mcxt->records++;
-			if(p_mcxt->records >= p_mcxt->capacity)
-				remap(p_mcxt);
-			r = (p_rec + 1);
-		} else {
-			p_mcxt->pf_mem_free(p_rec, sizeof(_map_rec_hdr_t) + sz_data, p_mcxt->udata);
-			r = NULL;
-		}
-	}
+	if((p_rec = alloc_record(p_mcxt, hash_key, data, sz_data)))
+		r = insert_record(p_mcxt, p_rec);
 
 	return r;
 }
@@ -214,40 +246,58 @@ void *map_set(_map_context_t *p_mcxt, void *key, _u32 sz_key, void *data, _u32 s
 void map_del(_map_context_t *p_mcxt, void *key, _u32 sz_key) {
 	_u8 hash_key[HASH_SIZE]="";
 	_map_rec_hdr_t *p_prev = NULL;
-	_u32 idx;
-	_map_rec_hdr_t *p_rec = get_record(p_mcxt, key, sz_key, hash_key, &idx, &p_prev);
+	_map_rec_hdr_t **pp_bucket = NULL;
+	_map_rec_hdr_t *p_rec = NULL;
 
-	if(p_rec) {
+	migrate(p_mcxt, MAP_MIGRATE);
+
+	if((p_rec = get_record(p_mcxt, key, sz_key, hash_key, &pp_bucket, &p_prev))) {
 		if(p_mcxt->pf_mem_free) {
 			if(p_prev)
 				p_prev->next = p_rec->next;
 			else
-				p_mcxt->pp_list[idx] = p_rec->next;
+				*pp_bucket = p_rec->next;
 			p_mcxt->pf_mem_free(p_rec, sizeof(_map_rec_hdr_t) + p_rec->sz_rec, p_mcxt->udata);
 			p_mcxt->records--;
+
+			if(!p_mcxt->pp_old && p_mcxt->records < p_mcxt->capacity / 8 &&
+					(p_mcxt->capacity - 1) / 2 >= p_mcxt->min_capacity)
+				/* shrink */
+				resize(p_mcxt, (p_mcxt->capacity - 1) / 2);
 		}
 	}
 }
 
-void map_clr(_map_context_t *p_mcxt) {
+static void clr_table(_map_context_t *p_mcxt, _map_rec_hdr_t **pp_list, _u32 capacity) {
 	_u32 i = 0;
 
-	if(p_mcxt->pf_mem_free && p_mcxt->pp_list) {
-		while(i < p_mcxt->capacity) {
-			_map_rec_hdr_t *p_rec = p_mcxt->pp_list[i];
+	while(i < capacity) {
+		_map_rec_hdr_t *p_rec = pp_list[i];
 
-			if(p_rec) {
-				_map_rec_hdr_t *p_next = NULL;
+		if(p_rec) {
+			_map_rec_hdr_t *p_next = NULL;
 
-				do {
-					p_next = p_rec->next;
-					p_mcxt->pf_mem_free(p_rec, sizeof(_map_rec_hdr_t) + p_rec->sz_rec, p_mcxt->udata);
-				} while((p_rec = p_next));
+			do {
+				p_next = p_rec->next;
+				p_mcxt->pf_mem_free(p_rec, sizeof(_map_rec_hdr_t) + p_rec->sz_rec, p_mcxt->udata);
+			} while((p_rec = p_next));
 
-				p_mcxt->pp_list[i] = NULL;
-			}
+			pp_list[i] = NULL;
+		}
 
-			i++;
+		i++;
+	}
+}
+
+void map_clr(_map_context_t *p_mcxt) {
+	if(p_mcxt->pf_mem_free && p_mcxt->pp_list) {
+		clr_table(p_mcxt, p_mcxt->pp_list, p_mcxt->capacity);
+
+		if(p_mcxt->pp_old) {
+			clr_table(p_mcxt, p_mcxt->pp_old, p_mcxt->old_capacity);
+			p_mcxt->pf_mem_free(p_mcxt->pp_old, p_mcxt->old_capacity * sizeof(_map_rec_hdr_t *), p_mcxt->udata);
+			p_mcxt->pp_old = NULL;
+			p_mcxt->old_capacity = p_mcxt->migrate = 0;
 		}
 
 		p_mcxt->records = p_mcxt->collisions = 0;
@@ -295,6 +345,9 @@ void *map_enum_first(MAPENUM h, _u32 *sz_data) {
 	_map_rec_hdr_t *p_rec = NULL;
 
 	if(pe && pe->p_mcxt) {
+		/* enumeration works on current table only */
+		migrate(pe->p_mcxt, pe->p_mcxt->old_capacity);
+
 		if(pe->p_mcxt->records && pe->p_mcxt->pp_list) {
 			pe->aidx = pe->uidx = 0;
 			while(pe->aidx < pe->p_mcxt->capacity) {
@@ -4,6 +4,7 @@
 #include "dtype.h"
 
 #define HASH_SIZE	20
+#define MAP_MIGRATE	16 /* buckets of old table migrated per update */
 
 typedef struct map_rec_hdr _map_rec_hdr_t;
 struct map_rec_hdr {
@@ -25,6 +26,11 @@ typedef struct {
 	_hash_t *pf_hash;
 	_map_rec_hdr_t **pp_list;
 	void *udata;
+	/* incremental resize (initialized by map_init) */
+	_u32 min_capacity; /* initial capacity (no shrink below) */
+	_u32 old_capacity;
+	_u32 migrate; /* next bucket of old table */
+	_map_rec_hdr_t **pp_old; /* table under migration */
 }_map_context_t;
 
 #define MAPENUM	void*
@@ -0,0 +1,516 @@
+#include <string.h>
+#include "oa_alg.h"
+
+/* wyhash constants */
+#define WY0	0xa0761d6478bd642fULL
+#define WY1	0xe7037ed1a0b428dbULL
+#define WY2	0x8ebc6af09c88c6e3ULL
+#define WY3	0x589965cc75374cc3ULL
+
+static _u64 _wymix(_u64 a, _u64 b) {
+	__uint128_t r = (__uint128_t)a * b;
+
+	return (_u64)r ^ (_u64)(r >> 64);
+}
+
+static _u64 _r8(const _u8 *p) {
+	_u64 v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static _u64 _r4(const _u8 *p) {
+	_u32 v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+_u64 oa_hash(const void *key, _u32 sz_key, _u64 seed) {
+	const _u8 *p = (const _u8 *)key;
+	_u64 a = 0, b = 0;
+	_u32 i = sz_key;
+
+	seed ^= _wymix(seed ^ WY0, WY1);
+
+	if(sz_key <= 16) {
+		if(sz_key >= 4) {
+			_u32 o = (sz_key >> 3) << 2;
+
+			a = (_r4(p) << 32) | _r4(p + o);
+			b = (_r4(p + sz_key - 4) << 32) | _r4(p + sz_key - 4 - o);
+		} else if(sz_key)
+			a = ((_u64)p[0] << 16) | ((_u64)p[sz_key >> 1] << 8) | p[sz_key - 1];
+	} else {
+		if(i > 48) {
+			_u64 s1 = seed, s2 = seed;
+
+			do {
+				seed = _wymix(_r8(p) ^ WY1, _r8(p + 8) ^ seed);
+				s1 = _wymix(_r8(p + 16) ^ WY2, _r8(p + 24) ^ s1);
+				s2 = _wymix(_r8(p + 32) ^ WY3, _r8(p + 40) ^ s2);
+				p += 48;
+				i -= 48;
+			} while(i > 48);
+
+			seed ^= s1 ^ s2;
+		}
+
+		while(i > 16) {
+			seed = _wymix(_r8(p) ^ WY1, _r8(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+
+		a = _r8(p + i - 16);
+		b = _r8(p + i - 8);
+	}
+
+	{
+		__uint128_t r = (__uint128_t)(a ^ WY1) * (b ^ seed);
+
+		a = (_u64)r;
+		b = (_u64)(r >> 64);
+	}
+
+	return _wymix(a ^ WY0 ^ sz_key, b ^ WY1);
+}
+
+#define H1(hash)	((hash) >> 7)
+#define H2(hash)	((_u8)((hash) & 0x7f))
+
+static _u8 *_rec_key(_oa_rec_t *p_rec) {
+	return (_u8 *)(p_rec + 1) + p_rec->sz_data + 1;
+}
+
+static _u32 _rec_size(_oa_rec_t *p_rec) {
+	return sizeof(_oa_rec_t) + p_rec->sz_data + 1 + p_rec->sz_key;
+}
+
+static _bool _table_alloc(_oa_context_t *p_ocxt, _oa_table_t *p_table, _u32 capacity) {
+	_bool r = _false;
+	_u8 *p = (_u8 *)p_ocxt->pf_mem_alloc(capacity + capacity * sizeof(_oa_rec_t *), p_ocxt->udata);
+
+	if(p) {
+		memset(p, OA_EMPTY, capacity);
+		p_table->ctrl = p;
+		p_table->slots = (_oa_rec_t **)(p + capacity);
+		p_table->capacity = capacity;
+		p_table->used = 0;
+		r = _true;
+	}
+
+	return r;
+}
+
+static void _table_free(_oa_context_t *p_ocxt, _oa_table_t *p_table) {
+	if(p_table->ctrl) {
+		p_ocxt->pf_mem_free(p_table->ctrl,
+			p_table->capacity + p_table->capacity * sizeof(_oa_rec_t *), p_ocxt->udata);
+		memset(p_table, 0, sizeof(_oa_table_t));
+	}
+}
+
+static _u32 _table_find(_oa_table_t *p_table, _u64 hash, const void *key, _u32 sz_key) {
+	_u32 r = OA_NONE;
+
+	if(p_table->capacity) {
+		_u32 mask = p_table->capacity - 1;
+		_u32 pos = (_u32)H1(hash) & mask & ~(OA_GROUP - 1);
+		_u32 stride = 0;
+		_u32 groups = p_table->capacity / OA_GROUP;
+
+		while(groups--) {
+			const _u8 *ctrl = p_table->ctrl + pos;
+			_u32 m = oa_group_match(ctrl, H2(hash));
+
+			while(m) {
+				_u32 idx = pos + __builtin_ctz(m);
+				_oa_rec_t *p_rec = p_table->slots[idx];
+
+				if(p_rec->hash == hash && p_rec->sz_key == sz_key &&
+						memcmp(_rec_key(p_rec), key, sz_key) == 0) {
+					r = idx;
+					goto _table_find_end_;
+				}
+
+				m &= m - 1;
+			}
+
+			if(oa_group_match(ctrl, OA_EMPTY))
+				break;
+
+			stride += OA_GROUP;
+			pos = (pos + stride) & mask;
+		}
+	}
+_table_find_end_:
+	return r;
+}
+
+static _u32 _table_insert(_oa_table_t *p_table, _oa_rec_t *p_rec, _u32 *collisions) {
+	_u32 r = OA_NONE;
+	_u32 mask = p_table->capacity - 1;
+	_u32 pos = (_u32)H1(p_rec->hash) & mask & ~(OA_GROUP - 1);
+	_u32 stride = 0;
+	_u32 groups = p_table->capacity / OA_GROUP;
+
+	while(groups--) {
+		_u32 m = oa_group_free(p_table->ctrl + pos);
+
+		if(m) {
+			r = pos + __builtin_ctz(m);
+			if(p_table->ctrl[r] == OA_EMPTY)
+				p_table->used++;
+			p_table->ctrl[r] = H2(p_rec->hash);
+			p_table->slots[r] = p_rec;
+			if(stride)
+				(*collisions)++;
+			break;
+		}
+
+		stride += OA_GROUP;
+		pos = (pos + stride) & mask;
+	}
+
+	return r;
+}
+
+/* move up to 'n' slots of old table */
+static void _migrate(_oa_context_t *p_ocxt, _u32 n) {
+	_oa_table_t *p_old = &p_ocxt->old;
+
+	while(n && p_old->capacity) {
+		if(p_ocxt->migrate < p_old->capacity) {
+			_u32 i = p_ocxt->migrate++;
+
+			if(!(p_old->ctrl[i] & 0x80)) {
+				_table_insert(&p_ocxt->table, p_old->slots[i], &p_ocxt->collisions);
+				/* keep probe chains of old table */
+				p_old->ctrl[i] = OA_DELETED;
+			}
+
+			n--;
+		} else
+			_table_free(p_ocxt, p_old);
+	}
+}
+
+static _bool _resize(_oa_context_t *p_ocxt, _u32 capacity) {
+	_bool r = _false;
+	_oa_table_t table;
+
+	_migrate(p_ocxt, OA_NONE);
+
+	if(_table_alloc(p_ocxt, &table, capacity)) {
+		p_ocxt->old = p_ocxt->table;
+		p_ocxt->table = table;
+		p_ocxt->migrate = 0;
+		p_ocxt->collisions = 0;
+		r = _true;
+	}
+
+	return r;
+}
+
+/* grow (or clean deleted slots) before insert */
+static void _reserve(_oa_context_t *p_ocxt) {
+	_oa_table_t *p_table = &p_ocxt->table;
+
+	if(p_table->used + 1 > p_table->capacity - p_table->capacity / 8) {
+		_u32 capacity = p_table->capacity;
+
+		if(p_ocxt->records >= capacity / 2)
+			capacity <<= 1;
+
+		_resize(p_ocxt, capacity);
+	}
+}
+
+/* shrink after delete */
+static void _release(_oa_context_t *p_ocxt) {
+	_oa_table_t *p_table = &p_ocxt->table;
+
+	if(!p_ocxt->old.capacity && p_table->capacity > p_ocxt->min_capacity &&
+			p_ocxt->records < p_table->capacity / 8)
+		_resize(p_ocxt, p_table->capacity / 2);
+}
+
+_bool oa_init(_oa_context_t *p_ocxt, _u32 capacity) {
+	_bool r = _false;
+	_u32 c = OA_MIN_CAPACITY;
+
+	/* capacity for given number of records */
+	while(c - c / 8 <= capacity && c < 0x80000000)
+		c <<= 1;
+
+	if(p_ocxt->pf_mem_alloc && p_ocxt->pf_mem_free && !p_ocxt->table.ctrl) {
+		memset(&p_ocxt->old, 0, sizeof(_oa_table_t));
+		p_ocxt->records = p_ocxt->collisions = p_ocxt->migrate = 0;
+		p_ocxt->min_capacity = c;
+		r = _table_alloc(p_ocxt, &p_ocxt->table, c);
+	}
+
+	return r;
+}
+
+_oa_rec_t *oa_find(_oa_context_t *p_ocxt, _u64 hash, const void *key, _u32 sz_key) {
+	_oa_rec_t *r = NULL;
+	_u32 idx = _table_find(&p_ocxt->table, hash, key, sz_key);
+
+	if(idx != OA_NONE)
+		r = p_ocxt->table.slots[idx];
+	else if(p_ocxt->old.capacity) {
+		if((idx = _table_find(&p_ocxt->old, hash, key, sz_key)) != OA_NONE)
+			r = p_ocxt->old.slots[idx];
+	}
+
+	return r;
+}
+
+void *oa_rec_data(_oa_rec_t *p_rec, _u32 *sz_data) {
+	*sz_data = p_rec->sz_data;
+	return p_rec + 1;
+}
+
+void *oa_get(_oa_context_t *p_ocxt, const void *key, _u32 sz_key, _u32 *sz_data) {
+	void *r = NULL;
+	_oa_rec_t *p_rec = oa_find(p_ocxt, oa_hash(key, sz_key, p_ocxt->seed), key, sz_key);
+
+	if(p_rec)
+		r = oa_rec_data(p_rec, sz_data);
+
+	return r;
+}
+
+static _oa_rec_t *_rec_alloc(_oa_context_t *p_ocxt, _u64 hash, const void *key, _u32 sz_key, const void *data, _u32 sz_data) {
+	_u32 size = sizeof(_oa_rec_t) + sz_data + 1 + sz_key;
+	_oa_rec_t *r = (_oa_rec_t *)p_ocxt->pf_mem_alloc(size, p_ocxt->udata);
+
+	if(r) {
+		_u8 *p = (_u8 *)(r + 1);
+
+		r->hash = hash;
+		r->sz_key = sz_key;
+		r->sz_data = sz_data;
+		if(data)
+			memcpy(p, data, sz_data);
+		else
+			memset(p, 0, sz_data);
+		p[sz_data] = 0; /* the last byte should be 0 always */
+		memcpy(p + sz_data + 1, key, sz_key);
+	}
+
+	return r;
+}
+
+static void *_insert(_oa_context_t *p_ocxt, _u64 hash, const void *key, _u32 sz_key, const void *data, _u32 sz_data) {
+	void *r = NULL;
+	_oa_rec_t *p_rec = NULL;
+
+	_reserve(p_ocxt);
+
+	if((p_rec = _rec_alloc(p_ocxt, hash, key, sz_key, data, sz_data))) {
+		if(_table_insert(&p_ocxt->table, p_rec, &p_ocxt->collisions) != OA_NONE) {
+			p_ocxt->records++;
+			r = p_rec + 1;
+		} else
+			p_ocxt->pf_mem_free(p_rec, _rec_size(p_rec), p_ocxt->udata);
+	}
+
+	_migrate(p_ocxt, OA_MIGRATE);
+
+	return r;
+}
+
+/* remove record by hash and key, returns _true if found */
+static _bool _remove(_oa_context_t *p_ocxt, _u64 hash, const void *key, _u32 sz_key) {
+	_bool r = _false;
+	_oa_table_t *p_table = &p_ocxt->table;
+	_u32 idx = _table_find(p_table, hash, key, sz_key);
+
+	if(idx == OA_NONE && p_ocxt->old.capacity) {
+		p_table = &p_ocxt->old;
+		idx = _table_find(p_table, hash, key, sz_key);
+	}
+
+	if(idx != OA_NONE) {
+		_oa_rec_t *p_rec = p_table->slots[idx];
+
+		p_table->ctrl[idx] = OA_DELETED;
+		p_table->slots[idx] = NULL;
+		p_ocxt->pf_mem_free(p_rec, _rec_size(p_rec), p_ocxt->udata);
+		p_ocxt->records--;
+		r = _true;
+	}
+
+	return r;
+}
+
+void *oa_add(_oa_context_t *p_ocxt, const void *key, _u32 sz_key, const void *data, _u32 sz_data) {
+	void *r = NULL;
+	_u64 hash = oa_hash(key, sz_key, p_ocxt->seed);
+	_oa_rec_t *p_rec = oa_find(p_ocxt, hash, key, sz_key);
+
+	if(p_rec)
+		r = p_rec + 1;
+	else
+		r = _insert(p_ocxt, hash, key, sz_key, data, sz_data);
+
+	return r;
+}
+
+void *oa_set(_oa_context_t *p_ocxt, const void *key, _u32 sz_key, const void *data, _u32 sz_data) {
+	_u64 hash = oa_hash(key, sz_key, p_ocxt->seed);
+
+	_remove(p_ocxt, hash, key, sz_key);
+
+	return _insert(p_ocxt, hash, key, sz_key, data, sz_data);
+}
+
+void oa_del(_oa_context_t *p_ocxt, const void *key, _u32 sz_key) {
+	if(_remove(p_ocxt, oa_hash(key, sz_key, p_ocxt->seed), key, sz_key)) {
+		_migrate(p_ocxt, OA_MIGRATE);
+		_release(p_ocxt);
+	}
+}
+
+static void _table_clr(_oa_context_t *p_ocxt, _oa_table_t *p_table) {
+	_u32 i = 0;
+
+	for(; i < p_table->capacity; i++) {
+		if(!(p_table->ctrl[i] & 0x80)) {
+			_oa_rec_t *p_rec = p_table->slots[i];
+
+			p_ocxt->pf_mem_free(p_rec, _rec_size(p_rec), p_ocxt->udata);
+		}
+	}
+
+	if(p_table->capacity)
+		memset(p_table->ctrl, OA_EMPTY, p_table->capacity);
+	p_table->used = 0;
+}
+
+void oa_clr(_oa_context_t *p_ocxt) {
+	if(p_ocxt->table.ctrl) {
+		_table_clr(p_ocxt, &p_ocxt->old);
+		_table_free(p_ocxt, &p_ocxt->old);
+		_table_clr(p_ocxt, &p_ocxt->table);
+		p_ocxt->records = p_ocxt->collisions = 0;
+	}
+}
+
+void oa_destroy(_oa_context_t *p_ocxt) {
+	oa_clr(p_ocxt);
+	_table_free(p_ocxt, &p_ocxt->table);
+}
+
+typedef struct {
+	_oa_context_t *p_ocxt;
+	_u32 idx; /* current slot */
+	_oa_rec_t *p_rec; /* current record */
+}_oa_enum_t;
+
+OAENUM oa_enum_open(_oa_context_t *p_ocxt) {
+	_oa_enum_t *r = (_oa_enum_t *)p_ocxt->pf_mem_alloc(sizeof(_oa_enum_t), p_ocxt->udata);
+
+	if(r) {
+		r->p_ocxt = p_ocxt;
+		r->idx = 0;
+		r->p_rec = NULL;
+	}
+
+	return r;
+}
+
+static void *_enum_scan(_oa_enum_t *pe, _u32 idx, _u32 *sz_data) {
+	void *r = NULL;
+	_oa_table_t *p_table = &pe->p_ocxt->table;
+
+	pe->p_rec = NULL;
+	for(; idx < p_table->capacity; idx++) {
+		if(!(p_table->ctrl[idx] & 0x80)) {
+			pe->p_rec = p_table->slots[idx];
+			r = oa_rec_data(pe->p_rec, sz_data);
+			break;
+		}
+	}
+
+	pe->idx = idx;
+
+	return r;
+}
+
+void *oa_enum_first(OAENUM h, _u32 *sz_data) {
+	void *r = NULL;
+	_oa_enum_t *pe = (_oa_enum_t *)h;
+
+	if(pe && pe->p_ocxt) {
+		/* enumerate single table */
+		_migrate(pe->p_ocxt, OA_NONE);
+		r = _enum_scan(pe, 0, sz_data);
+	}
+
+	return r;
+}
+
+void *oa_enum_next(OAENUM h, _u32 *sz_data) {
+	void *r = NULL;
+	_oa_enum_t *pe = (_oa_enum_t *)h;
+
+	if(pe && pe->p_ocxt && pe->idx < pe->p_ocxt->table.capacity)
+		r = _enum_scan(pe, pe->idx + 1, sz_data);
+
+	return r;
+}
+
+void oa_enum_del(OAENUM h) {
+	_oa_enum_t *pe = (_oa_enum_t *)h;
+
+	if(pe && pe->p_ocxt && pe->p_rec) {
+		_oa_context_t *p_ocxt = pe->p_ocxt;
+		_oa_table_t *p_table = &p_ocxt->table;
+
+		if(pe->idx < p_table->capacity && p_table->slots[pe->idx] == pe->p_rec &&
+				!(p_table->ctrl[pe->idx] & 0x80)) {
+			/* don't resize while enumerating */
+			p_table->ctrl[pe->idx] = OA_DELETED;
+			p_table->slots[pe->idx] = NULL;
+			p_ocxt->pf_mem_free(pe->p_rec, _rec_size(pe->p_rec), p_ocxt->udata);
+			p_ocxt->records--;
+			pe->p_rec = NULL;
+		}
+	}
+}
+
+void oa_enum_close(OAENUM h) {
+	_oa_enum_t *pe = (_oa_enum_t *)h;
+
+	if(pe && pe->p_ocxt)
+		pe->p_ocxt->pf_mem_free(pe, sizeof(_oa_enum_t), pe->p_ocxt->udata);
+}
+
+void oa_enum(_oa_context_t *p_ocxt, _s32 (*pcb)(void *, _u32, void *), void *udata) {
+	_oa_enum_t me;
+	void *data = NULL;
+	_u32 size = 0;
+	_s32 op = 0;
+
+	me.p_ocxt = p_ocxt;
+	me.idx = 0;
+	me.p_rec = NULL;
+
+	data = oa_enum_first(&me, &size);
+
+	while(data) {
+		op = pcb(data, size, udata);
+
+		if(op == OA_ENUM_BREAK)
+			break;
+		else if(op == OA_ENUM_DELETE)
+			oa_enum_del(&me);
+
+		data = oa_enum_next(&me, &size);
+	}
+}
@@ -0,0 +1,90 @@
+#ifndef __OA_ALG_H__
+#define __OA_ALG_H__
+
+#include "dtype.h"
+#include "oa_group.h"
+
+/* Open addressing hash table (groups of 16 control bytes, probed with SSE2)
+   Records are allocated separately, so pointers to record data stays valid
+   until record is removed. Resizing is incremental (both tables are
+   consulted while records migrates to the new one). */
+
+#define OA_MIGRATE	64 /* slots of old table migrated per update */
+#define OA_MIN_CAPACITY	16
+
+#define OA_EMPTY	0x80
+#define OA_DELETED	0xfe
+#define OA_NONE		0xffffffff
+
+typedef struct oa_rec _oa_rec_t;
+struct oa_rec {
+	_u64 hash;
+	_u32 sz_key;
+	_u32 sz_data; /* without terminating zero */
+	/* data, terminating zero and key follows */
+};
+
+typedef void *_oa_mem_alloc_t(_u32 size, void *udata);
+typedef void _oa_mem_free_t(void *ptr, _u32 size, void *udata);
+
+typedef struct {
+	_u32 capacity; /* number of slots (power of 2) */
+	_u32 used; /* full and deleted slots */
+	_u8 *ctrl; /* control bytes (EMPTY, DELETED or 7 bits of hash) */
+	_oa_rec_t **slots;
+}_oa_table_t;
+
+typedef struct {
+	_u32 records;
+	_u32 collisions; /* records out of home group */
+	_u32 min_capacity;
+	_u64 seed;
+	_oa_mem_alloc_t *pf_mem_alloc;
+	_oa_mem_free_t *pf_mem_free;
+	void *udata;
+	_oa_table_t table; /* current table */
+	_oa_table_t old; /* table under migration */
+	_u32 migrate; /* next slot of old table */
+}_oa_context_t;
+
+#define OAENUM	void*
+
+/* Advanced enumeration */
+#define OA_ENUM_CONTINUE	0
+#define OA_ENUM_BREAK		1
+#define OA_ENUM_DELETE		2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* 64 bit hash (wyhash) */
+_u64 oa_hash(const void *key, _u32 sz_key, _u64 seed);
+/* Initialize context (pf_mem_alloc, pf_mem_free, udata, seed must be set) */
+_bool oa_init(_oa_context_t *p_ocxt, _u32 capacity);
+/* Add record and returns pointer to data (or to data of existing record) */
+void *oa_add(_oa_context_t *p_ocxt, const void *key, _u32 sz_key, const void *data, _u32 sz_data);
+/* Same as oa_add, but replace existing record */
+void *oa_set(_oa_context_t *p_ocxt, const void *key, _u32 sz_key, const void *data, _u32 sz_data);
+/* Get record data by key */
+void *oa_get(_oa_context_t *p_ocxt, const void *key, _u32 sz_key, _u32 *sz_data);
+/* Get record by precomputed hash (does not modify context) */
+_oa_rec_t *oa_find(_oa_context_t *p_ocxt, _u64 hash, const void *key, _u32 sz_key);
+/* Delete record by key */
+void oa_del(_oa_context_t *p_ocxt, const void *key, _u32 sz_key);
+/* Remove all records */
+void oa_clr(_oa_context_t *p_ocxt);
+/* Remove all records and release tables */
+void oa_destroy(_oa_context_t *p_ocxt);
+/* Record data and size */
+void *oa_rec_data(_oa_rec_t *p_rec, _u32 *sz_data);
+OAENUM oa_enum_open(_oa_context_t *p_ocxt);
+void *oa_enum_first(OAENUM h, _u32 *sz_data);
+void *oa_enum_next(OAENUM h, _u32 *sz_data);
+void oa_enum_del(OAENUM h);
+void oa_enum_close(OAENUM h);
+
+void oa_enum(_oa_context_t *p_ocxt, _s32 (*)(void *, _u32, void *), void *);
+#ifdef __cplusplus
+}
+#endif
+#endif
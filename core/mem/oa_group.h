@@ -0,0 +1,53 @@
+#ifndef __OA_GROUP_H__
+#define __OA_GROUP_H__
+
+#include "dtype.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Probing of control byte groups (16 bytes).
+   The portable version is always available, so both can be compared. */
+
+#define OA_GROUP	16 /* control bytes per group */
+
+/* bit mask of control bytes equal to 'v' */
+static inline _u32 oa_group_match_c(const _u8 *ctrl, _u8 v) {
+	_u32 r = 0, i = 0;
+
+	for(; i < OA_GROUP; i++)
+		r |= (ctrl[i] == v) ? (1U << i) : 0;
+
+	return r;
+}
+
+/* bit mask of empty or deleted control bytes (high bit set) */
+static inline _u32 oa_group_free_c(const _u8 *ctrl) {
+	_u32 r = 0, i = 0;
+
+	for(; i < OA_GROUP; i++)
+		r |= (ctrl[i] & 0x80) ? (1U << i) : 0;
+
+	return r;
+}
+
+#ifdef __SSE2__
+static inline _u32 oa_group_match_sse2(const _u8 *ctrl, _u8 v) {
+	__m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+
+	return (_u32)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)v)));
+}
+
+static inline _u32 oa_group_free_sse2(const _u8 *ctrl) {
+	return (_u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+
+#define oa_group_match	oa_group_match_sse2
+#define oa_group_free	oa_group_free_sse2
+#else
+#define oa_group_match	oa_group_match_c
+#define oa_group_free	oa_group_free_c
+#endif
+
+#endif
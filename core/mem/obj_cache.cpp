@@ -0,0 +1,255 @@
+#include <string.h>
+#include <stdlib.h>
+#include <mutex>
+#include "obj_cache.h"
+
+#define OC_PTR(v)	((_oc_link_t *)((v) & OC_ADDR_MASK))
+#define OC_TAG(v)	((((v) >> 48) + 1) << 48) // next ABA tag
+
+struct oc_thread { // magazine of one thread for one cache
+	obj_cache	*p_owner; // NULL when cache is gone
+	_oc_thread_t	*next; // next in owner's list
+	_u64		gen; // owner generation (objects are valid while equal)
+	_u32		count;
+	_oc_link_t	*mag[OC_MAG_SIZE];
+};
+
+// protects owner lists and owner pointers
+// (used by thread registration, thread exit and cache destroy only)
+static std::mutex _g_oc_mutex_;
+static std::atomic<_u64> _g_oc_id_(0);
+
+static void oc_detach(_oc_thread_t *pt) {
+	obj_cache *p_owner = pt->p_owner;
+
+	if(p_owner) {
+		_oc_thread_t **pp = &p_owner->p_threads;
+
+		while(*pp && *pp != pt)
+			pp = &(*pp)->next;
+		if(*pp)
+			*pp = pt->next;
+		pt->p_owner = NULL;
+	}
+}
+
+struct oc_tls { // thread slots
+	_u64		*p_id;
+	_oc_thread_t	**pp_rec;
+	_u32		capacity;
+	_u32		last; // slot of last accessed cache
+
+	// make room for one more slot, returns false if out of memory
+	bool grow(void) {
+		bool r = false;
+		_u32 capacity = (this->capacity) ? this->capacity * 2 : OC_TLS_SLOTS;
+		_u64 *p_nid = (_u64 *)::calloc(capacity, sizeof(_u64));
+		_oc_thread_t **pp_nrec = (_oc_thread_t **)::calloc(capacity, sizeof(_oc_thread_t *));
+
+		if(p_nid && pp_nrec) {
+			if(this->capacity) {
+				memcpy(p_nid, p_id, this->capacity * sizeof(_u64));
+				memcpy(pp_nrec, pp_rec, this->capacity * sizeof(_oc_thread_t *));
+			}
+			::free(p_id);
+			::free(pp_rec);
+			p_id = p_nid;
+			pp_rec = pp_nrec;
+			this->capacity = capacity;
+			r = true;
+		} else {
+			::free(p_nid);
+			::free(pp_nrec);
+		}
+
+		return r;
+	}
+
+	~oc_tls() {
+		// thread exit
+		for(_u32 i = 0; i < capacity; i++) {
+			_oc_thread_t *pt = pp_rec[i];
+
+			if(pt) {
+				_g_oc_mutex_.lock();
+				if(pt->p_owner) {
+					if(pt->count && pt->gen == pt->p_owner->gen.load())
+						pt->p_owner->put_depot(pt->mag, pt->count);
+					oc_detach(pt);
+				}
+				_g_oc_mutex_.unlock();
+				::free(pt);
+			}
+		}
+
+		::free(p_id);
+		::free(pp_rec);
+		p_id = NULL;
+		pp_rec = NULL;
+		capacity = 0;
+	}
+};
+
+static thread_local oc_tls _g_oc_tls_;
+
+void obj_cache::init(void) {
+	depot = 0;
+	gen = 0;
+	p_threads = NULL;
+	id = ++_g_oc_id_;
+}
+
+void obj_cache::destroy(void) {
+	_g_oc_mutex_.lock();
+
+	while(p_threads)
+		// thread releases the record at exit
+		oc_detach(p_threads);
+
+	_g_oc_mutex_.unlock();
+	reset();
+}
+
+void obj_cache::put_depot(_oc_link_t **pp, _u32 count) {
+	_u64 head = depot.load(std::memory_order_relaxed);
+	_u64 nhead = 0;
+	_u32 n = 0;
+
+	// objects out of 48 bit address space can't be tagged
+	for(_u32 i = 0; i < count; i++) {
+		if(!((_u64)pp[i] & ~OC_ADDR_MASK))
+			pp[n++] = pp[i];
+	}
+
+	if(n) {
+		for(_u32 i = 0; i < n - 1; i++)
+			pp[i]->next.store(pp[i + 1], std::memory_order_relaxed);
+
+		do {
+			pp[n - 1]->next.store(OC_PTR(head), std::memory_order_relaxed);
+			nhead = (_u64)pp[0] | OC_TAG(head);
+		} while(!depot.compare_exchange_weak(head, nhead, std::memory_order_release,
+							std::memory_order_relaxed));
+	}
+}
+
+_u32 obj_cache::depot_pop(_oc_link_t **pp, _u32 count) {
+	_u32 r = 0;
+
+	while(r < count) {
+		_u64 head = depot.load(std::memory_order_acquire);
+		_oc_link_t *p = NULL;
+
+		do {
+			// 'next' of taken object is garbage, but the tag makes CAS fail
+			if(!(p = OC_PTR(head)))
+				break;
+		} while(!depot.compare_exchange_weak(head,
+				(_u64)p->next.load(std::memory_order_relaxed) | OC_TAG(head),
+				std::memory_order_acquire, std::memory_order_acquire));
+
+		if(!p)
+			break;
+
+		pp[r++] = p;
+	}
+
+	return r;
+}
+
+_oc_thread_t *obj_cache::thread(void) {
+	_oc_thread_t *r = NULL;
+	oc_tls *p_tls = &_g_oc_tls_;
+	_u32 i = p_tls->last;
+
+	if(i < p_tls->capacity && p_tls->p_id[i] == id)
+		r = p_tls->pp_rec[i];
+	else {
+		for(i = 0; i < p_tls->capacity; i++) {
+			if(p_tls->p_id[i] == id) {
+				r = p_tls->pp_rec[i];
+				p_tls->last = i;
+				break;
+			}
+		}
+	}
+
+	if(!r) {
+		// first access to this cache from current thread
+		_g_oc_mutex_.lock();
+
+		for(i = 0; i < p_tls->capacity; i++) {
+			if(!p_tls->pp_rec[i])
+				break;
+			if(!p_tls->pp_rec[i]->p_owner) {
+				// reuse slot of destroyed cache
+				::free(p_tls->pp_rec[i]);
+				p_tls->pp_rec[i] = NULL;
+				p_tls->p_id[i] = 0;
+				break;
+			}
+		}
+
+		if((i < p_tls->capacity || p_tls->grow()) &&
+				(r = (_oc_thread_t *)::calloc(1, sizeof(_oc_thread_t)))) {
+			r->p_owner = this;
+			r->gen = gen.load();
+			r->next = p_threads;
+			p_threads = r;
+			p_tls->pp_rec[i] = r;
+			p_tls->p_id[i] = id;
+			p_tls->last = i;
+		}
+
+		_g_oc_mutex_.unlock();
+	}
+
+	if(r && r->gen != gen.load(std::memory_order_relaxed)) {
+		// cache was reset
+		r->count = 0;
+		r->gen = gen.load();
+	}
+
+	return r;
+}
+
+_oc_link_t *obj_cache::get(void) {
+	_oc_link_t *r = NULL;
+	_oc_thread_t *pt = thread();
+
+	if(pt) {
+		if(!pt->count)
+			pt->count = depot_pop(pt->mag, OC_BATCH);
+		if(pt->count)
+			r = pt->mag[--pt->count];
+	} else
+		// out of memory for thread slot
+		depot_pop(&r, 1);
+
+	return r;
+}
+
+void obj_cache::put(_oc_link_t *p) {
+	_oc_thread_t *pt = NULL;
+
+	// object out of 48 bit address space can't be tagged in depot
+	// (it stays unused in owner's memory)
+	if(!((_u64)p & ~OC_ADDR_MASK)) {
+		if((pt = thread())) {
+			if(pt->count == OC_MAG_SIZE) {
+				// return the oldest half (keep the hot objects)
+				put_depot(pt->mag, OC_BATCH);
+				memmove(pt->mag, pt->mag + OC_BATCH, (OC_MAG_SIZE - OC_BATCH) * sizeof(_oc_link_t *));
+				pt->count -= OC_BATCH;
+			}
+			pt->mag[pt->count++] = p;
+		} else
+			put_depot(&p, 1);
+	}
+}
+
+void obj_cache::reset(void) {
+	depot = (depot.load() & ~OC_ADDR_MASK);
+	// invalidate thread magazines
+	gen++;
+}
@@ -0,0 +1,46 @@
+#ifndef __OBJ_CACHE_H__
+#define __OBJ_CACHE_H__
+
+#include <atomic>
+#include "dtype.h"
+
+// Lock free depot of free objects (Treiber stack with ABA tag) and per thread
+// magazines in front of it. Memory of objects must stay valid until reset
+// or destroy, because concurrent pop may read link of already taken object.
+// The tag takes upper 16 bits of object address, objects above 48 bit
+// address space are not cached (owner keeps them in its slabs).
+
+#define OC_MAG_SIZE	32 // objects per magazine
+#define OC_BATCH	(OC_MAG_SIZE / 2) // objects per refill/flush
+#define OC_TLS_SLOTS	32 // initial number of caches with magazines per thread
+#define OC_ADDR_MASK	0x0000ffffffffffffULL
+
+typedef struct oc_link _oc_link_t;
+struct oc_link { // part of free object
+	std::atomic<_oc_link_t *> next;
+};
+
+typedef struct oc_thread _oc_thread_t;
+
+struct obj_cache {
+	std::atomic<_u64>	depot; // first object | ABA tag in upper 16 bits
+	std::atomic<_u64>	gen; // incremented by reset
+	_u64			id; // unique (never reused) cache ID
+	_oc_thread_t		*p_threads; // magazines of all threads
+
+	void init(void);
+	// detach threads (objects in magazines are lost)
+	void destroy(void);
+	// returns NULL when cache is empty
+	_oc_link_t *get(void);
+	void put(_oc_link_t *p);
+	// put array of objects directly to depot
+	void put_depot(_oc_link_t **pp, _u32 count);
+	// forget all objects (in depot and magazines)
+	void reset(void);
+private:
+	_u32 depot_pop(_oc_link_t **pp, _u32 count);
+	_oc_thread_t *thread(void);
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <mutex>
+#include "page_arena.h"
+
+#define ARENA_MAX		4096 // max. number of arenas (8GB)
+#define ARENA_TABLE		(ARENA_MAX * 2) // arena lookup table
+#define ARENA_WORDS		(ARENA_PAGES / 64)
+#define ARENA_MAX_NODES		64
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED	1
+#endif
+
+typedef struct arena _arena_t;
+
+struct arena {
+	_u8		*base; // 2MB aligned
+	_u64		bitmap[ARENA_WORDS]; // busy pages
+	_u32		used; // number of busy pages
+	_u32		node; // NUMA node
+	_arena_t	*next; // next arena of the same node
+};
+
+typedef struct {
+	std::mutex	mutex;
+	_arena_t	*p_first;
+}_arena_node_t;
+
+static _arena_t _g_arena_[ARENA_MAX];
+static std::atomic<_u32> _g_arenas_(0);
+static std::atomic<_arena_t *> _g_arena_table_[ARENA_TABLE];
+static _arena_node_t _g_node_[ARENA_MAX_NODES];
+// cleared at first failure (no reserved huge pages)
+static std::atomic<bool> _g_hugetlb_(true);
+
+static _u32 arena_node(void) {
+	unsigned int cpu = 0, node = 0;
+
+	if(getcpu(&cpu, &node) != 0)
+		node = 0;
+
+	return node % ARENA_MAX_NODES;
+}
+
+static void arena_bind(void *ptr, _ulong size, _u32 node) {
+	_ulong mask = 1UL << node;
+
+	// prefer the node (don't fail when it's out of memory)
+	syscall(SYS_mbind, ptr, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+}
+
+static _u32 arena_hash(_u8 *base) {
+	_u64 h = ((_ulong)base / ARENA_SIZE) * 0x9e3779b97f4a7c15ULL;
+
+	return (h >> 32) % ARENA_TABLE;
+}
+
+static _arena_t *arena_lookup(void *ptr) {
+	_arena_t *r = NULL;
+	_u8 *base = (_u8 *)((_ulong)ptr & ~((_ulong)ARENA_SIZE - 1));
+	_u32 idx = arena_hash(base);
+
+	for(_u32 i = 0; i < ARENA_TABLE; i++) {
+		_arena_t *pa = _g_arena_table_[(idx + i) % ARENA_TABLE].load(std::memory_order_acquire);
+
+		if(!pa)
+			break;
+		if(pa->base == base) {
+			r = pa;
+			break;
+		}
+	}
+
+	return r;
+}
+
+static void arena_publish(_arena_t *pa) {
+	_u32 idx = arena_hash(pa->base);
+
+	for(_u32 i = 0; i < ARENA_TABLE; i++) {
+		_arena_t *p_empty = NULL;
+
+		if(_g_arena_table_[(idx + i) % ARENA_TABLE].compare_exchange_strong(p_empty, pa,
+				std::memory_order_release))
+			break;
+	}
+}
+
+static _u8 *arena_map(void) {
+	_u8 *r = NULL;
+
+	if(_g_hugetlb_.load(std::memory_order_relaxed)) {
+		void *p = mmap(NULL, ARENA_SIZE, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+
+		if(p != MAP_FAILED)
+			r = (_u8 *)p;
+		else
+			_g_hugetlb_ = false;
+	}
+
+	if(!r) {
+		// map double size and trim it to 2MB boundary
+		_u8 *p = (_u8 *)mmap(NULL, ARENA_SIZE * 2, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+		if(p != MAP_FAILED) {
+			_u8 *a = (_u8 *)(((_ulong)p + ARENA_SIZE - 1) & ~((_ulong)ARENA_SIZE - 1));
+			_ulong head = a - p;
+
+			if(head)
+				munmap(p, head);
+			munmap(a + ARENA_SIZE, ARENA_SIZE - head);
+			// transparent huge pages
+			madvise(a, ARENA_SIZE, MADV_HUGEPAGE);
+			r = a;
+		}
+	}
+
+	return r;
+}
+
+static _arena_t *arena_create(_u32 node) {
+	_arena_t *r = NULL;
+	_u32 idx = _g_arenas_.load();
+	_u8 *base = NULL;
+
+	if(idx < ARENA_MAX && (base = arena_map())) {
+		// take the slot for mapped arena only (failed mmap doesn't burn it)
+		while(idx < ARENA_MAX && !_g_arenas_.compare_exchange_weak(idx, idx + 1));
+
+		if(idx < ARENA_MAX) {
+			r = &_g_arena_[idx];
+			r->base = base;
+			r->used = 0;
+			r->node = node;
+			for(_u32 i = 0; i < ARENA_WORDS; i++)
+				r->bitmap[i] = 0;
+			arena_bind(base, ARENA_SIZE, node);
+			arena_publish(r);
+		} else
+			// other nodes took the last slots
+			munmap(base, ARENA_SIZE);
+	}
+
+	return r;
+}
+
+// returns index of first page in free run or -1
+static _s32 arena_find(_arena_t *pa, _u32 num_pages) {
+	_s32 r = -1;
+
+	if(num_pages == 1) {
+		for(_u32 i = 0; i < ARENA_WORDS; i++) {
+			if(~pa->bitmap[i]) {
+				r = i * 64 + __builtin_ctzll(~pa->bitmap[i]);
+				break;
+			}
+		}
+	} else {
+		_u32 run = 0;
+
+		for(_u32 i = 0; i < ARENA_PAGES; i++) {
+			if(pa->bitmap[i / 64] & (1ULL << (i % 64)))
+				run = 0;
+			else if(++run == num_pages) {
+				r = i + 1 - num_pages;
+				break;
+			}
+		}
+	}
+
+	return r;
+}
+
+static void arena_mark(_arena_t *pa, _u32 page, _u32 num_pages, bool busy) {
+	for(_u32 i = page; i < page + num_pages; i++) {
+		if(busy)
+			pa->bitmap[i / 64] |= (1ULL << (i % 64));
+		else
+			pa->bitmap[i / 64] &= ~(1ULL << (i % 64));
+	}
+
+	if(busy)
+		pa->used += num_pages;
+	else
+		pa->used -= num_pages;
+}
+
+static void *direct_alloc(_u32 num_pages, _u32 node) {
+	void *r = NULL;
+	_ulong size = (_ulong)num_pages * ARENA_PAGE_SIZE;
+	void *p = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+	if(p != MAP_FAILED) {
+		arena_bind(p, size, node);
+		r = p;
+	}
+
+	return r;
+}
+
+void *arena_page_alloc(_u32 num_pages) {
+	void *r = NULL;
+	_u32 node = arena_node();
+
+	if(num_pages && num_pages <= ARENA_MAX_RUN) {
+		_arena_node_t *pn = &_g_node_[node];
+		_arena_t *pa = NULL;
+		_s32 page = -1;
+
+		pn->mutex.lock();
+
+		for(pa = pn->p_first; pa; pa = pa->next) {
+			if(pa->used + num_pages <= ARENA_PAGES && (page = arena_find(pa, num_pages)) >= 0)
+				break;
+		}
+
+		if(!pa && (pa = arena_create(node))) {
+			pa->next = pn->p_first;
+			pn->p_first = pa;
+			page = 0;
+		}
+
+		if(pa) {
+			arena_mark(pa, page, num_pages, true);
+			r = pa->base + (_ulong)page * ARENA_PAGE_SIZE;
+		}
+
+		pn->mutex.unlock();
+	}
+
+	if(!r && num_pages)
+		// big request or no more arenas
+		r = direct_alloc(num_pages, node);
+
+	return r;
+}
+
+void arena_page_free(void *ptr, _u32 num_pages) {
+	_arena_t *pa = (num_pages <= ARENA_MAX_RUN) ? arena_lookup(ptr) : NULL;
+
+	if(pa) {
+		_arena_node_t *pn = &_g_node_[pa->node];
+		_u32 page = ((_u8 *)ptr - pa->base) / ARENA_PAGE_SIZE;
+
+		pn->mutex.lock();
+		arena_mark(pa, page, num_pages, false);
+		if(!pa->used && pa != pn->p_first)
+			// release memory but keep the address range
+			// (the newest arena of node stays resident)
+			madvise(pa->base, ARENA_SIZE, MADV_DONTNEED);
+		pn->mutex.unlock();
+	} else if(ptr)
+		munmap(ptr, (_ulong)num_pages * ARENA_PAGE_SIZE);
+}
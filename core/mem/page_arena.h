@@ -0,0 +1,19 @@
+#ifndef __PAGE_ARENA_H__
+#define __PAGE_ARENA_H__
+
+#include "dtype.h"
+
+// Page provider for zone allocator.
+// Pages are carved from 2MB arenas (huge pages when available), bound to
+// NUMA node of the calling thread. Empty arenas are returned to the OS
+// by madvise and stay mapped for reuse.
+
+#define ARENA_PAGE_SIZE		4096
+#define ARENA_SIZE		(2 * 1024 * 1024)
+#define ARENA_PAGES		(ARENA_SIZE / ARENA_PAGE_SIZE)
+#define ARENA_MAX_RUN		64 // larger requests are mapped separately
+
+void *arena_page_alloc(_u32 num_pages);
+void arena_page_free(void *ptr, _u32 num_pages);
+
+#endif
@@ -1,19 +1,62 @@
 #include <string.h>
-#include <assert.h>
+#include <atomic>
+#include <mutex>
 #include "iMemory.h"
 #include "iRepository.h"
+#include "iLog.h"
+#include "obj_cache.h"
 
 #define COL_FREE	0
 #define COL_BUSY	1
 
+// sharded mode
+#define POOL_ALIGN	16
+#define POOL_CHUNK	16384 // preferred chunk size in bytes
+#define POOL_CHUNK_MIN	4 // min. objects per chunk
+#define POOL_CHUNK_MAX	64 // max. objects per chunk
+
+#define POOL_ST_FREE	1
+#define POOL_ST_BUSY	2
+
+typedef struct { // object header (data follows)
+	_oc_link_t	link; // in free list
+	std::atomic<_u64> tag; // owner address | state
+}_pool_obj_t;
+
+typedef struct pool_chunk _pool_chunk_t;
+struct pool_chunk {
+	_pool_chunk_t	*next;
+	_u32		size; // in bytes
+	_u32		used; // carved objects
+	// objects follows
+};
+
 class cPool: public iPool {
 private:
 	iLlist	*mpi_list;
 	_u32 	m_data_size;
 	void *mp_udata;
 	void (*mp_cb)(_u8, void *, void *);
+	_u32	m_flags;
+	// sharded mode
+	iHeap	*mpi_heap;
+	bool	m_my_heap;
+	_u32	m_stride; // header + data
+	_u32	m_chunk_objs;
+	obj_cache	m_cache; // free objects
+	std::atomic<_u32> m_busy;
+	std::atomic<_u32> m_total;
+	std::mutex	m_mutex; // protects chunks
+	_pool_chunk_t	*mp_chunks;
 
 	void destroy(void) {
+		if(m_flags & POOL_SHARDED)
+			_destroy_sharded();
+		else if(mpi_list)
+			_destroy_list();
+	}
+
+	void _destroy_list(void) {
 		HMUTEX hm = mpi_list->lock();
 		_u32 sz = 0;
 
@@ -81,6 +124,161 @@ private:
 			rec = mpi_list->next(&size, hlock);
 		}
 	}
+
+	// double free or object of other pool (ignored)
+	void invalid_free(void *rec) {
+		iLog *pi_log = (iLog *)_gpi_repo_->object_by_iname(I_LOG, RF_ORIGINAL);
+
+		if(pi_log) {
+			pi_log->fwrite(LMT_ERROR, "iPool: invalid free of %p", rec);
+			_gpi_repo_->object_release(pi_log);
+		}
+	}
+
+	// sharded mode
+
+	_u64 tag(_u32 state) {
+		return (_u64)this | state;
+	}
+
+	_pool_obj_t *object(_pool_chunk_t *p_chunk, _u32 idx) {
+		return (_pool_obj_t *)((_u8 *)p_chunk + POOL_ALIGN + idx * m_stride);
+	}
+
+	// take never used object from chunks
+	_pool_obj_t *carve(void) {
+		_pool_obj_t *r = NULL;
+
+		m_mutex.lock();
+
+		if(!mp_chunks || mp_chunks->used == m_chunk_objs) {
+			_u32 size = POOL_ALIGN + m_chunk_objs * m_stride;
+			_pool_chunk_t *p_chunk = (_pool_chunk_t *)mpi_heap->alloc(size);
+
+			if(p_chunk) {
+				p_chunk->size = size;
+				p_chunk->used = 0;
+				p_chunk->next = mp_chunks;
+				mp_chunks = p_chunk;
+			}
+		}
+
+		if(mp_chunks && mp_chunks->used < m_chunk_objs) {
+			r = object(mp_chunks, mp_chunks->used);
+			mp_chunks->used++;
+			m_total++;
+		}
+
+		m_mutex.unlock();
+
+		return r;
+	}
+
+	void *_alloc_sharded(void) {
+		void *r = NULL;
+		_pool_obj_t *p = (_pool_obj_t *)m_cache.get();
+		bool is_new = false;
+
+		if(!p && (p = carve()))
+			is_new = true;
+
+		if(p) {
+			r = p + 1;
+			if(is_new)
+				memset(r, 0, m_data_size);
+			if(mp_cb)
+				mp_cb((is_new) ? POOL_OP_NEW : POOL_OP_BUSY, r, mp_udata);
+			p->tag.store(tag(POOL_ST_BUSY), std::memory_order_release);
+			m_busy++;
+		}
+
+		return r;
+	}
+
+	void _free_sharded(void *rec) {
+		_pool_obj_t *p = (_pool_obj_t *)rec - 1;
+		_u64 busy = tag(POOL_ST_BUSY);
+
+		if(p->tag.compare_exchange_strong(busy, tag(POOL_ST_FREE))) {
+			if(mp_cb)
+				mp_cb(POOL_OP_FREE, rec, mp_udata);
+			m_busy--;
+			m_cache.put(&p->link);
+		} else
+			invalid_free(rec);
+	}
+
+	void _free_all_sharded(void) {
+		m_mutex.lock();
+
+		for(_pool_chunk_t *p_chunk = mp_chunks; p_chunk; p_chunk = p_chunk->next) {
+			for(_u32 i = 0; i < p_chunk->used; i++) {
+				_pool_obj_t *p = object(p_chunk, i);
+				_u64 busy = tag(POOL_ST_BUSY);
+
+				if(p->tag.compare_exchange_strong(busy, tag(POOL_ST_FREE))) {
+					if(mp_cb)
+						mp_cb(POOL_OP_FREE, p + 1, mp_udata);
+					m_busy--;
+					m_cache.put(&p->link);
+				}
+			}
+		}
+
+		m_mutex.unlock();
+	}
+
+	// should not run in parallel with alloc/free
+	void _clear_sharded(void) {
+		_free_all_sharded();
+
+		m_mutex.lock();
+
+		while(mp_chunks) {
+			_pool_chunk_t *p_chunk = mp_chunks;
+
+			mp_chunks = p_chunk->next;
+			for(_u32 i = 0; i < p_chunk->used; i++) {
+				if(mp_cb)
+					mp_cb(POOL_OP_DELETE, object(p_chunk, i) + 1, mp_udata);
+			}
+			mpi_heap->free(p_chunk, p_chunk->size);
+		}
+
+		m_total = 0;
+		m_cache.reset();
+
+		m_mutex.unlock();
+	}
+
+	void _destroy_sharded(void) {
+		_clear_sharded();
+		m_cache.destroy();
+
+		if(m_my_heap)
+			_gpi_repo_->object_release(mpi_heap);
+	}
+
+	void _enumerate_sharded(_u32 state, _pool_enum_t *pcb, void *udata) {
+		m_mutex.lock();
+
+		for(_pool_chunk_t *p_chunk = mp_chunks; p_chunk; p_chunk = p_chunk->next) {
+			_u32 i = 0;
+
+			for(; i < p_chunk->used; i++) {
+				_pool_obj_t *p = object(p_chunk, i);
+
+				if(p->tag.load() == tag(state) && pcb(p + 1, m_data_size, udata) == ENUM_CANCEL)
+					break;
+			}
+
+			if(i < p_chunk->used)
+				break;
+		}
+
+		m_mutex.unlock();
+	}
+
 public:
 	BASE(cPool, "cPool", RF_CLONE, 1,0,0);
 
@@ -91,6 +289,11 @@ public:
 			case OCTL_INIT:
 				m_data_size = 0;
 				mpi_list = NULL;
+				m_flags = 0;
+				mpi_heap = NULL;
+				m_my_heap = false;
+				mp_chunks = NULL;
+				m_busy = m_total = 0;
 				r = true;
 				break;
 
@@ -106,15 +309,31 @@ public:
 	bool init(_u32 data_size,
 			void (*cb)(_u8, void *, void *),
 			void *udata,
-			iHeap *pi_heap) {
+			iHeap *pi_heap,
+			_u32 flags) {
 		bool r = false;
 
-		if((mpi_list = dynamic_cast<iLlist *>(_gpi_repo_->object_by_iname(I_LLIST, RF_CLONE|RF_NONOTIFY)))) {
-			m_data_size = data_size;
-			mp_cb = cb;
-			mp_udata = udata;
-			r = mpi_list->init(LL_VECTOR, 2, pi_heap);
-		}
+		m_data_size = data_size;
+		mp_cb = cb;
+		mp_udata = udata;
+		m_flags = flags;
+
+		if(flags & POOL_SHARDED) {
+			if(!(mpi_heap = pi_heap)) {
+				if((mpi_heap = (iHeap *)_gpi_repo_->object_by_iname(I_HEAP, RF_ORIGINAL)))
+					m_my_heap = true;
+			}
+
+			m_cache.init();
+			m_stride = sizeof(_pool_obj_t) + ((data_size + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1));
+			m_chunk_objs = POOL_CHUNK / m_stride;
+			if(m_chunk_objs < POOL_CHUNK_MIN)
+				m_chunk_objs = POOL_CHUNK_MIN;
+			if(m_chunk_objs > POOL_CHUNK_MAX)
+				m_chunk_objs = POOL_CHUNK_MAX;
+			r = (mpi_heap != NULL);
+		} else if((mpi_list = dynamic_cast<iLlist *>(_gpi_repo_->object_by_iname(I_LLIST, RF_CLONE|RF_NONOTIFY))))
+			r = mpi_list->init(LL_VECTOR|LL_SLAB, 2, pi_heap);
 
 		return r;
 	}
@@ -125,6 +344,17 @@ public:
 
 	void *alloc(void) {
 		void *r = NULL;
+
+		if(m_flags & POOL_SHARDED)
+			r = _alloc_sharded();
+		else
+			r = _alloc_list();
+
+		return r;
+	}
+
+	void *_alloc_list(void) {
+		void *r = NULL;
 		_u32 sz = 0;
 		HMUTEX hm = mpi_list->lock();
 
@@ -148,6 +378,13 @@ public:
 	}
 
 	void free(void *rec) {
+		if(m_flags & POOL_SHARDED)
+			_free_sharded(rec);
+		else
+			_free_list(rec);
+	}
+
+	void _free_list(void *rec) {
 		HMUTEX hm = mpi_list->lock();
 
 		mpi_list->col(COL_BUSY, hm);
@@ -155,73 +392,104 @@ public:
 			if(mp_cb)
 				mp_cb(POOL_OP_FREE, rec, mp_udata);
 			mpi_list->mov(rec, COL_FREE, hm);
-		} else {
-			assert(false);
-		}
+		} else
+			invalid_free(rec);
 
 		mpi_list->unlock(hm);
 	}
 
 	bool verify(void *rec) {// returns true if record is in BUSY state
 		bool r = false;
-		HMUTEX hm = mpi_list->lock();
 
-		mpi_list->col(COL_BUSY, hm);
-		r = mpi_list->sel(rec, hm);
+		if(m_flags & POOL_SHARDED) {
+			// record must come from this pool (objects are never returned to heap before clear)
+			if(rec)
+				r = (((_pool_obj_t *)rec - 1)->tag.load(std::memory_order_acquire) == tag(POOL_ST_BUSY));
+		} else {
+			HMUTEX hm = mpi_list->lock();
 
-		mpi_list->unlock(hm);
+			mpi_list->col(COL_BUSY, hm);
+			r = mpi_list->sel(rec, hm);
+
+			mpi_list->unlock(hm);
+		}
 
 		return r;
 
 	}
 	void free_all(void) {
-		_free_all(0);
+		if(m_flags & POOL_SHARDED)
+			_free_all_sharded();
+		else
+			_free_all(0);
 	}
 
 	void clear(void) {
-		_clear(0);
+		if(m_flags & POOL_SHARDED)
+			_clear_sharded();
+		else
+			_clear(0);
 	}
 
 	_u32 num_busy(void) {
 		_u32 r = 0;
-		HMUTEX hm = mpi_list->lock();
 
-		mpi_list->col(COL_BUSY, hm);
-		r = mpi_list->cnt(hm);
+		if(m_flags & POOL_SHARDED)
+			r = m_busy.load();
+		else {
+			HMUTEX hm = mpi_list->lock();
 
-		mpi_list->unlock(hm);
+			mpi_list->col(COL_BUSY, hm);
+			r = mpi_list->cnt(hm);
+
+			mpi_list->unlock(hm);
+		}
 
 		return r;
 	}
 
 	_u32 num_free(void) {
 		_u32 r = 0;
-		HMUTEX hm = mpi_list->lock();
 
-		mpi_list->col(COL_FREE, hm);
-		r = mpi_list->cnt(hm);
+		if(m_flags & POOL_SHARDED)
+			// including objects in thread magazines
+			r = m_total.load() - m_busy.load();
+		else {
+			HMUTEX hm = mpi_list->lock();
 
-		mpi_list->unlock(hm);
+			mpi_list->col(COL_FREE, hm);
+			r = mpi_list->cnt(hm);
+
+			mpi_list->unlock(hm);
+		}
 
 		return r;
 	}
 
 	void enum_busy(_pool_enum_t *pcb, void *udata) {
-		HMUTEX hm = mpi_list->lock();
+		if(m_flags & POOL_SHARDED)
+			_enumerate_sharded(POOL_ST_BUSY, pcb, udata);
+		else {
+			HMUTEX hm = mpi_list->lock();
 
-		mpi_list->col(COL_BUSY, hm);
-		enumerate(pcb, udata, hm);
+			mpi_list->col(COL_BUSY, hm);
+			enumerate(pcb, udata, hm);
 
-		mpi_list->unlock(hm);
+			mpi_list->unlock(hm);
+		}
 	}
 
 	void enum_free(_pool_enum_t *pcb, void *udata) {
-		HMUTEX hm = mpi_list->lock();
+		if(m_flags & POOL_SHARDED)
+			_enumerate_sharded(POOL_ST_FREE, pcb, udata);
+		else {
+			HMUTEX hm = mpi_list->lock();
 
-		mpi_list->col(COL_FREE, hm);
-		enumerate(pcb, udata, hm);
+			mpi_list->col(COL_FREE, hm);
+			enumerate(pcb, udata, hm);
 
-		mpi_list->unlock(hm);
+			mpi_list->unlock(hm);
+		}
 	}
 };
 
@@ -0,0 +1,256 @@
+#include <string.h>
+#include <atomic>
+#include "iRepository.h"
+#include "iMemory.h"
+#include "futex.h"
+
+#define Q_CACHE_LINE	64
+#define Q_MAX_CAPACITY	(1U << 31)
+#define Q_CELL(pos)	(mp_cells + ((pos) & m_mask) * m_cell_size)
+#define Q_SEQ(pcell)	((std::atomic<_u64> *)(pcell))
+#define Q_DATA(pcell)	((pcell) + sizeof(std::atomic<_u64>))
+
+// Vyukov's bounded MPMC queue. Every cell has a sequence number, which says
+// whether it's free for producer at 'pos' (seq == pos) or ready for consumer
+// (seq == pos + 1). SPSC mode uses the same cells without sequences.
+class cQueue: public iQueue {
+private:
+	iHeap		*mpi_heap;
+	bool		m_my_heap;
+	_u8		m_mode;
+	_u8		*mp_cells;
+	_u32		m_capacity;
+	_u32		m_mask;
+	_u32		m_item_size;
+	_u32		m_cell_size;
+	_futex_wq_t	m_not_empty;
+	_futex_wq_t	m_not_full;
+	_u8		m_pad0[Q_CACHE_LINE];
+	// producers
+	std::atomic<_u64> m_enqueue;
+	_u64		m_head_cache; // SPSC producer copy of m_dequeue
+	_u8		m_pad1[Q_CACHE_LINE];
+	// consumers
+	std::atomic<_u64> m_dequeue;
+	_u64		m_tail_cache; // SPSC consumer copy of m_enqueue
+	_u8		m_pad2[Q_CACHE_LINE];
+
+	// reserve up to 'count' cells for writing, returns number of cells
+	_u32 reserve_push(_u32 count, _u64 *p_pos) {
+		_u32 r = 0;
+		_u64 pos = m_enqueue.load(std::memory_order_relaxed);
+
+		if(!count)
+			return 0;
+
+		if(m_mode == Q_SPSC) {
+			if(pos + count - m_head_cache > m_capacity)
+				m_head_cache = m_dequeue.load(std::memory_order_acquire);
+			r = m_capacity - (_u32)(pos - m_head_cache);
+			if(r > count)
+				r = count;
+		} else {
+			for(;;) {
+				_s64 diff = 0;
+
+				for(r = 0; r < count; r++) {
+					if((diff = (_s64)Q_SEQ(Q_CELL(pos + r))->load(std::memory_order_acquire) - (_s64)(pos + r)))
+						break;
+				}
+
+				if(!r && diff < 0)
+					// full
+					break;
+				if(r && m_enqueue.compare_exchange_weak(pos, pos + r, std::memory_order_relaxed))
+					break;
+				if(!r)
+					pos = m_enqueue.load(std::memory_order_relaxed);
+			}
+		}
+
+		*p_pos = pos;
+		return r;
+	}
+
+	// reserve up to 'count' cells for reading, returns number of cells
+	_u32 reserve_pop(_u32 count, _u64 *p_pos) {
+		_u32 r = 0;
+		_u64 pos = m_dequeue.load(std::memory_order_relaxed);
+
+		if(!count)
+			return 0;
+
+		if(m_mode == Q_SPSC) {
+			if(pos + count > m_tail_cache)
+				m_tail_cache = m_enqueue.load(std::memory_order_acquire);
+			r = (_u32)(m_tail_cache - pos);
+			if(r > count)
+				r = count;
+		} else {
+			for(;;) {
+				_s64 diff = 0;
+
+				for(r = 0; r < count; r++) {
+					if((diff = (_s64)Q_SEQ(Q_CELL(pos + r))->load(std::memory_order_acquire) - (_s64)(pos + r + 1)))
+						break;
+				}
+
+				if(!r && diff < 0)
+					// empty
+					break;
+				if(r && m_dequeue.compare_exchange_weak(pos, pos + r, std::memory_order_relaxed))
+					break;
+				if(!r)
+					pos = m_dequeue.load(std::memory_order_relaxed);
+			}
+		}
+
+		*p_pos = pos;
+		return r;
+	}
+
+	void commit_push(_u64 pos, _u32 count) {
+		if(m_mode == Q_SPSC)
+			m_enqueue.store(pos + count, std::memory_order_release);
+		else {
+			for(_u32 i = 0; i < count; i++)
+				Q_SEQ(Q_CELL(pos + i))->store(pos + i + 1, std::memory_order_release);
+		}
+
+		futex_wq_notify(&m_not_empty, count);
+	}
+
+	void commit_pop(_u64 pos, _u32 count) {
+		if(m_mode == Q_SPSC)
+			m_dequeue.store(pos + count, std::memory_order_release);
+		else {
+			for(_u32 i = 0; i < count; i++)
+				Q_SEQ(Q_CELL(pos + i))->store(pos + i + m_capacity, std::memory_order_release);
+		}
+
+		futex_wq_notify(&m_not_full, count);
+	}
+
+public:
+	BASE(cQueue, "cQueue", RF_CLONE, 1,0,0);
+
+	bool object_ctl(_u32 cmd, void *arg, ...) {
+		bool r = false;
+
+		switch(cmd) {
+			case OCTL_INIT:
+				mpi_heap = 0;
+				m_my_heap = false;
+				mp_cells = 0;
+				m_capacity = 0;
+				r = true;
+				break;
+			case OCTL_UNINIT: {
+				iRepository *pi_repo = (iRepository *)arg;
+
+				destroy();
+				if(m_my_heap)
+					pi_repo->object_release(mpi_heap);
+				r = true;
+			} break;
+		}
+
+		return r;
+	}
+
+	bool init(_u32 capacity, _u32 item_size, _u8 mode=Q_MPMC, iHeap *pi_heap=0) {
+		bool r = false;
+
+		if(!mp_cells && capacity && capacity <= Q_MAX_CAPACITY && item_size) {
+			if(!(mpi_heap = pi_heap)) {
+				if((mpi_heap = (iHeap *)_gpi_repo_->object_by_iname(I_HEAP, RF_ORIGINAL)))
+					m_my_heap = true;
+			}
+
+			for(m_capacity = 2; m_capacity < capacity; m_capacity <<= 1);
+			m_mask = m_capacity - 1;
+			m_mode = mode;
+			m_item_size = item_size;
+			m_cell_size = (sizeof(std::atomic<_u64>) + item_size + 7) & ~7;
+			m_enqueue = m_dequeue = 0;
+			m_head_cache = m_tail_cache = 0;
+			futex_wq_init(&m_not_empty);
+			futex_wq_init(&m_not_full);
+
+			if(mpi_heap && (mp_cells = (_u8 *)mpi_heap->alloc(m_capacity * m_cell_size))) {
+				for(_u32 i = 0; i < m_capacity; i++)
+					// free for producer at position 'i'
+					Q_SEQ(mp_cells + i * m_cell_size)->store(i, std::memory_order_relaxed);
+				r = true;
+			}
+		}
+
+		return r;
+	}
+
+	void destroy(void) {
+		if(mp_cells) {
+			mpi_heap->free(mp_cells, m_capacity * m_cell_size);
+			mp_cells = 0;
+		}
+	}
+
+	bool push(const void *item) {
+		return (push_batch(item, 1) == 1);
+	}
+
+	bool pop(void *item) {
+		return (pop_batch(item, 1) == 1);
+	}
+
+	_u32 push_batch(const void *items, _u32 count) {
+		_u64 pos = 0;
+		_u32 r = reserve_push(count, &pos);
+
+		if(r) {
+			for(_u32 i = 0; i < r; i++)
+				memcpy(Q_DATA(Q_CELL(pos + i)), (_u8 *)items + i * m_item_size, m_item_size);
+			commit_push(pos, r);
+		}
+
+		return r;
+	}
+
+	_u32 pop_batch(void *items, _u32 count) {
+		_u64 pos = 0;
+		_u32 r = reserve_pop(count, &pos);
+
+		if(r) {
+			for(_u32 i = 0; i < r; i++)
+				memcpy((_u8 *)items + i * m_item_size, Q_DATA(Q_CELL(pos + i)), m_item_size);
+			commit_pop(pos, r);
+		}
+
+		return r;
+	}
+
+	bool push_wait(const void *item, _u32 timeout=0) {
+		return futex_wq_wait(&m_not_full, timeout, [&]()->bool {
+			return push(item);
+		});
+	}
+
+	bool pop_wait(void *item, _u32 timeout=0) {
+		return futex_wq_wait(&m_not_empty, timeout, [&]()->bool {
+			return pop(item);
+		});
+	}
+
+	_u32 size(void) {
+		_u64 enq = m_enqueue.load(std::memory_order_relaxed);
+		_u64 deq = m_dequeue.load(std::memory_order_relaxed);
+
+		return (enq > deq) ? (_u32)(enq - deq) : 0;
+	}
+
+	_u32 capacity(void) {
+		return m_capacity;
+	}
+};
+
+static cQueue _g_queue_;
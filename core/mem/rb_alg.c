@@ -1,5 +1,6 @@
 /* ring buffer algorithm implementation */
 
+#include <string.h>
 #include "rb_alg.h"
 
 typedef struct {
@@ -161,3 +162,118 @@ void rb_reset_pull(_rb_context_t *pcxt) {
 	rb_unlock(pcxt, hlock);
 }
 
+
+/* MPSC ring */
+
+typedef struct {
+	_u32 size;	/* message size */
+	_u32 flags;	/* RB_MSG_COMMITTED, RB_MSG_PAD */
+	_u8  data[];	/* message data */
+}_rb_mpsc_msg_t;
+
+#define RB_MPSC_RECORD(sz) \
+	((sizeof(_rb_mpsc_msg_t) + (sz) + RB_MPSC_ALIGN - 1) & ~(RB_MPSC_ALIGN - 1))
+#define RB_MPSC_MSG(pmpsc, pos) \
+	((_rb_mpsc_msg_t *)((_u8 *)(pmpsc)->addr + ((pos) & ((pmpsc)->size - 1))))
+
+void rb_mpsc_init(_rb_mpsc_t *pmpsc, void *buffer, _u32 size) {
+	pmpsc->addr = buffer;
+	pmpsc->size = size;
+	pmpsc->head = pmpsc->tail = 0;
+	/* zero flags means free space */
+	memset(buffer, 0, size);
+}
+
+void *rb_reserve(_rb_mpsc_t *pmpsc, _u32 sz) {
+	void *r = NULL;
+	_u32 need = RB_MPSC_RECORD(sz);
+
+	if(pmpsc->addr && need <= pmpsc->size / 2) {
+		_u64 head = __atomic_load_n(&pmpsc->head, __ATOMIC_RELAXED);
+		_u32 pad = 0;
+
+		for(;;) {
+			_u32 off = head & (pmpsc->size - 1);
+
+			/* message can't be split at end of buffer */
+			pad = (off + need > pmpsc->size) ? pmpsc->size - off : 0;
+			if(head + pad + need - __atomic_load_n(&pmpsc->tail, __ATOMIC_ACQUIRE) > pmpsc->size)
+				/* full */
+				break;
+			if(__atomic_compare_exchange_n(&pmpsc->head, &head, head + pad + need, 1,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				_rb_mpsc_msg_t *p_msg = NULL;
+
+				if(pad) {
+					p_msg = RB_MPSC_MSG(pmpsc, head);
+					p_msg->size = pad - sizeof(_rb_mpsc_msg_t);
+					__atomic_store_n(&p_msg->flags, RB_MSG_PAD | RB_MSG_COMMITTED, __ATOMIC_RELEASE);
+				}
+
+				p_msg = RB_MPSC_MSG(pmpsc, head + pad);
+				p_msg->size = sz;
+				r = p_msg->data;
+				break;
+			}
+		}
+	}
+
+	return r;
+}
+
+void rb_commit(void *msg) {
+	_rb_mpsc_msg_t *p_msg = (_rb_mpsc_msg_t *)((_u8 *)msg - sizeof(_rb_mpsc_msg_t));
+
+	__atomic_store_n(&p_msg->flags, RB_MSG_COMMITTED, __ATOMIC_SEQ_CST);
+}
+
+static void rb_mpsc_free(_rb_mpsc_t *pmpsc, _rb_mpsc_msg_t *p_msg) {
+	_u32 len = RB_MPSC_RECORD(p_msg->size);
+
+	/* headers of next messages may fall anywhere in this record */
+	p_msg->size = 0;
+	memset(p_msg->data, 0, len - sizeof(_rb_mpsc_msg_t));
+	__atomic_store_n(&p_msg->flags, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&pmpsc->tail, pmpsc->tail + len, __ATOMIC_RELEASE);
+}
+
+void *rb_read(_rb_mpsc_t *pmpsc, _u32 *psz) {
+	void *r = NULL;
+
+	while(pmpsc->addr) {
+		_rb_mpsc_msg_t *p_msg = RB_MPSC_MSG(pmpsc, pmpsc->tail);
+		_u32 flags = __atomic_load_n(&p_msg->flags, __ATOMIC_ACQUIRE);
+
+		if(!(flags & RB_MSG_COMMITTED))
+			break;
+		if(flags & RB_MSG_PAD)
+			rb_mpsc_free(pmpsc, p_msg);
+		else {
+			*psz = p_msg->size;
+			r = p_msg->data;
+			break;
+		}
+	}
+
+	return r;
+}
+
+void rb_release(_rb_mpsc_t *pmpsc) {
+	_rb_mpsc_msg_t *p_msg = RB_MPSC_MSG(pmpsc, pmpsc->tail);
+
+	if(pmpsc->addr && (__atomic_load_n(&p_msg->flags, __ATOMIC_RELAXED) & RB_MSG_COMMITTED))
+		rb_mpsc_free(pmpsc, p_msg);
+}
+
+_bool rb_pending(_rb_mpsc_t *pmpsc) {
+	_bool r = _false;
+
+	if(pmpsc->addr) {
+		_u64 tail = __atomic_load_n(&pmpsc->tail, __ATOMIC_SEQ_CST);
+
+		if(__atomic_load_n(&RB_MPSC_MSG(pmpsc, tail)->flags, __ATOMIC_SEQ_CST) & RB_MSG_COMMITTED)
+			r = _true;
+	}
+
+	return r;
+}
@@ -23,6 +23,26 @@ typedef struct {
 	void *rb_udata;
 }_rb_context_t;
 
+/* Lock free ring for multiple producers and single consumer.
+   Producers reserve space by CAS on 'head' and write messages in place,
+   consumer reads committed messages in order and releases them by
+   moving 'tail'. Positions are free running, the buffer size is power of 2. */
+#define RB_MPSC_ALIGN		8
+#define RB_MPSC_MIN		256
+#define RB_MPSC_MAX		(1U << 31)
+#define RB_MSG_COMMITTED	1
+#define RB_MSG_PAD		2 /* unused space at end of buffer */
+
+typedef struct {
+	void *addr;	/* address of ring buffer */
+	_u32 size;	/* size of ring buffer in bytes */
+	_u8  _pad0[64];
+	_u64 head;	/* reserved by producers */
+	_u8  _pad1[64];
+	_u64 tail;	/* released by consumer */
+	_u8  _pad2[64];
+}_rb_mpsc_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,6 +51,18 @@ void  rb_destroy(_rb_context_t *pcxt);
 void  rb_push(_rb_context_t *pcxt, void *data, _u16 sz);
 void *rb_pull(_rb_context_t *pcxt, _u16 *psz);
 void  rb_reset_pull(_rb_context_t *pcxt);
+/* initialize MPSC ring in 'buffer' ('size' must be power of 2) */
+void  rb_mpsc_init(_rb_mpsc_t *pmpsc, void *buffer, _u32 size);
+/* reserve space for message, returns NULL when the ring is full */
+void *rb_reserve(_rb_mpsc_t *pmpsc, _u32 sz);
+/* make reserved message visible to consumer */
+void  rb_commit(void *msg);
+/* returns the oldest committed message or NULL (consumer only) */
+void *rb_read(_rb_mpsc_t *pmpsc, _u32 *psz);
+/* release message returned by rb_read (consumer only) */
+void  rb_release(_rb_mpsc_t *pmpsc);
+/* returns 1 if committed message waits for consumer */
+_bool rb_pending(_rb_mpsc_t *pmpsc);
 #ifdef __cplusplus
 }
 #endif
@@ -2,6 +2,7 @@
 #include "iMemory.h"
 #include "iRepository.h"
 #include "rb_alg.h"
+#include "futex.h"
 
 extern "C" {
 	void *rb_mem_alloc(_u32 sz, void *udata);
@@ -17,6 +18,8 @@ private:
 	_rb_context_t m_cxt;
 	iHeap *mpi_heap;
 	iMutex *mpi_mutex;
+	_rb_mpsc_t m_mpsc;
+	_futex_wq_t m_wq; // consumer waits here
 
 	friend void *rb_mem_alloc(_u32 sz, void *udata);
 	friend void rb_mem_free(void *ptr, _u32 sz, void *udata);
@@ -39,6 +42,10 @@ public:
 
 	void destroy(void) {
 		rb_destroy(&m_cxt);
+		if(m_mpsc.addr) {
+			mpi_heap->free(m_mpsc.addr, m_mpsc.size);
+			m_mpsc.addr = NULL;
+		}
 	}
 
 	void push(void *msg, _u16 sz) {
@@ -53,6 +60,56 @@ public:
 		rb_reset_pull(&m_cxt);
 	}
 
+	bool init_mpsc(_u32 capacity) {
+		bool r = false;
+
+		if(!m_mpsc.addr && capacity <= RB_MPSC_MAX) {
+			_u32 size = RB_MPSC_MIN;
+			void *buffer = 0;
+
+			while(size < capacity)
+				size <<= 1;
+			if((buffer = mpi_heap->alloc(size))) {
+				rb_mpsc_init(&m_mpsc, buffer, size);
+				futex_wq_init(&m_wq);
+				r = true;
+			}
+		}
+
+		return r;
+	}
+
+	void *reserve(_u32 sz) {
+		return rb_reserve(&m_mpsc, sz);
+	}
+
+	void commit(void *msg) {
+		rb_commit(msg);
+		futex_wq_notify(&m_wq, 1);
+	}
+
+	void *read(_u32 *psz) {
+		return rb_read(&m_mpsc, psz);
+	}
+
+	void *read_wait(_u32 *psz, _u32 timeout=0) {
+		void *r = 0;
+
+		futex_wq_wait(&m_wq, timeout, [&]()->bool {
+			return (r = rb_read(&m_mpsc, psz)) != 0;
+		});
+
+		return r;
+	}
+
+	void release(void) {
+		rb_release(&m_mpsc);
+	}
+
+	bool pending(void) {
+		return rb_pending(&m_mpsc);
+	}
+
 	bool object_ctl(_u32 cmd, void *arg, ...) {
 		bool r = false;
 
@@ -61,6 +118,8 @@ public:
 				mpi_heap = 0;
 				mpi_mutex = 0;
 				memset(&m_cxt, 0, sizeof(m_cxt));
+				memset(&m_mpsc, 0, sizeof(m_mpsc));
+				futex_wq_init(&m_wq);
 				iRepository *repo = (iRepository*)arg;
 				mpi_heap = (iHeap*)repo->object_by_iname(I_HEAP, RF_ORIGINAL);
 				mpi_mutex = (iMutex*)repo->object_by_iname(I_MUTEX, RF_CLONE);
@@ -70,7 +129,7 @@ public:
 			}
 			case OCTL_UNINIT: {
 				iRepository *repo = (iRepository*)arg;
-				rb_destroy(&m_cxt);
+				destroy();
 				memset(&m_cxt, 0, sizeof(m_cxt));
 				repo->object_release(mpi_heap);
 				repo->object_release(mpi_mutex);
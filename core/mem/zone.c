@@ -159,16 +159,15 @@ static void *_zone_entry_alloc(_zone_context_t *p_zcxt, _zone_entry_t *p_entry,
 	return r;
 }
 
-static void *_zone_page_alloc(_zone_context_t *p_zcxt, _zone_page_t *p_zone, unsigned int aligned_size, unsigned long long limit) {
+/* must be called with locked zone context */
+static void *_zone_page_alloc_locked(_zone_context_t *p_zcxt, _zone_page_t *p_zone, unsigned int aligned_size, unsigned long long limit) {
 	void *r = (void *)0;
 	unsigned int max_objects = ZONE_MAX_ENTRIES;
 	_zone_page_t *p_current_page = p_zone;
-	unsigned long long mutex_handle = 0;
 
 	if(aligned_size < ZONE_PAGE_SIZE)
 		max_objects = (ZONE_MAX_ENTRIES * ZONE_PAGE_SIZE) / aligned_size;
 
-	mutex_handle = _lock(p_zcxt, 0);
 	while(p_current_page && p_current_page->header.objects == max_objects) {
 		if(!(p_current_page->header.next)) {
 			/* alloc new page header */
@@ -203,16 +202,24 @@ static void *_zone_page_alloc(_zone_context_t *p_zcxt, _zone_page_t *p_zone, uns
 			i++;
 		}
 	}
-	_unlock(p_zcxt, mutex_handle);
 
 	return r;
 }
 
-/* Allocates chunk of memory and returns pointer or NULL */
-void *zone_alloc(_zone_context_t *p_zcxt, unsigned int size, unsigned long long limit) {
+static void *_zone_page_alloc(_zone_context_t *p_zcxt, _zone_page_t *p_zone, unsigned int aligned_size, unsigned long long limit) {
 	void *r = (void *)0;
-	unsigned int aligned_size = 0;
-	_zone_page_t **pp_zone = _zone_page(p_zcxt, size, &aligned_size);
+	unsigned long long mutex_handle = _lock(p_zcxt, 0);
+
+	r = _zone_page_alloc_locked(p_zcxt, p_zone, aligned_size, limit);
+	_unlock(p_zcxt, mutex_handle);
+
+	return r;
+}
+
+/* returns first zone page for aligned size (allocate it if needed) */
+static _zone_page_t *_zone_first_page(_zone_context_t *p_zcxt, unsigned int size, unsigned long long limit, unsigned int *aligned_size) {
+	_zone_page_t *r = (_zone_page_t *)0;
+	_zone_page_t **pp_zone = _zone_page(p_zcxt, size, aligned_size);
 
 	if(pp_zone) {
 		_zone_page_t *p_zone = *pp_zone;
@@ -225,68 +232,122 @@ void *zone_alloc(_zone_context_t *p_zcxt, unsigned int size, unsigned long long
 
 				mutex_handle = _lock(p_zcxt, 0);
 				*pp_zone = p_zone;
-				p_zone->header.object_size = aligned_size;
+				p_zone->header.object_size = *aligned_size;
 				_unlock(p_zcxt, mutex_handle);
 			}
 		}
 
-		if(p_zone)
-			r = _zone_page_alloc(p_zcxt, p_zone, aligned_size, limit);
+		r = p_zone;
 	}
 
 	return r;
 }
 
+/* Allocates chunk of memory and returns pointer or NULL */
+void *zone_alloc(_zone_context_t *p_zcxt, unsigned int size, unsigned long long limit) {
+	void *r = (void *)0;
+	unsigned int aligned_size = 0;
+	_zone_page_t *p_zone = _zone_first_page(p_zcxt, size, limit, &aligned_size);
+
+	if(p_zone)
+		r = _zone_page_alloc(p_zcxt, p_zone, aligned_size, limit);
+
+	return r;
+}
+
+/* Allocates up to 'num' chunks with same size (under single lock) and returns number of allocated chunks */
+unsigned int zone_alloc_batch(_zone_context_t *p_zcxt, unsigned int size, unsigned long long limit, void **ptrs, unsigned int num) {
+	unsigned int r = 0;
+	unsigned int aligned_size = 0;
+	_zone_page_t *p_zone = _zone_first_page(p_zcxt, size, limit, &aligned_size);
+
+	if(p_zone) {
+		unsigned long long mutex_handle = _lock(p_zcxt, 0);
+
+		while(r < num && (ptrs[r] = _zone_page_alloc_locked(p_zcxt, p_zone, aligned_size, limit)))
+			r++;
+
+		_unlock(p_zcxt, mutex_handle);
+	}
+
+	return r;
+}
+
+/* must be called with locked zone context */
+static int _zone_free_locked(_zone_context_t *p_zcxt, _zone_page_t *p_zone, void *ptr, unsigned int aligned_size) {
+	int r = 1;
+
+	while(p_zone) {
+		unsigned int i = 0;
+
+		while(i < ZONE_MAX_ENTRIES) {
+			_zone_entry_t *p_entry = &p_zone->array[i];
+			void *data = (void *)p_entry->data;
+
+			if(ptr >= data && ptr < (data + ZONE_PAGE_SIZE)) {
+				if(aligned_size < ZONE_PAGE_SIZE) {
+					unsigned char bit = (ptr - data) / aligned_size;
+					unsigned long long *unit = _bitmap_unit_bit(p_entry, aligned_size, &bit);
+					unsigned long long mask = ((unsigned long long)1 << (ZONE_BITMAP_UNIT_BITS -1));
+
+					if(unit && (*unit & (mask >> bit))) {
+						*unit &= ~(mask >> bit);
+						p_entry->objects--;
+						p_zone->header.objects--;
+						r = 0;
+					}
+					goto _zone_free_end_;
+				} else {
+					if(p_entry->objects && p_entry->data_size == aligned_size) {
+						p_zcxt->pf_page_free(data, aligned_size / ZONE_PAGE_SIZE, p_zcxt->user_data);
+						p_entry->data_size = 0;
+						p_entry->data = 0;
+						p_entry->objects = 0;
+						p_zone->header.objects--;
+						r = 0;
+					}
+					goto _zone_free_end_;
+				}
+			}
+
+			i++;
+		}
+
+		p_zone = (_zone_page_t *)p_zone->header.next;
+	}
+_zone_free_end_:
+	return r;
+}
+
 /* Deallocate memory chunk */
 int zone_free(_zone_context_t *p_zcxt, void *ptr, unsigned int size) {
 	int r = 1;
 	unsigned int aligned_size = 0;
 	_zone_page_t **pp_zone = _zone_page(p_zcxt, size, &aligned_size);
-	unsigned long long mutex_handle = 0;
 
 	if(pp_zone) {
-		_zone_page_t *p_zone = *pp_zone;
+		unsigned long long mutex_handle = _lock(p_zcxt, 0);
 
-		mutex_handle = _lock(p_zcxt, mutex_handle);
-		while(p_zone) {
-			unsigned int i = 0;
+		r = _zone_free_locked(p_zcxt, *pp_zone, ptr, aligned_size);
+		_unlock(p_zcxt, mutex_handle);
+	}
 
-			while(i < ZONE_MAX_ENTRIES) {
-				_zone_entry_t *p_entry = &p_zone->array[i];
-				void *data = (void *)p_entry->data;
+	return r;
+}
 
-				if(ptr >= data && ptr < (data + ZONE_PAGE_SIZE)) {
-					if(aligned_size < ZONE_PAGE_SIZE) {
-						unsigned char bit = (ptr - data) / aligned_size;
-						unsigned long long *unit = _bitmap_unit_bit(p_entry, aligned_size, &bit);
-						unsigned long long mask = ((unsigned long long)1 << (ZONE_BITMAP_UNIT_BITS -1));
+/* Deallocate 'num' chunks with same size (under single lock) and returns number of failed ones */
+unsigned int zone_free_batch(_zone_context_t *p_zcxt, void **ptrs, unsigned int num, unsigned int size) {
+	unsigned int r = num;
+	unsigned int aligned_size = 0;
+	_zone_page_t **pp_zone = _zone_page(p_zcxt, size, &aligned_size);
 
-						if(unit && (*unit & (mask >> bit))) {
-							*unit &= ~(mask >> bit);
-							p_entry->objects--;
-							p_zone->header.objects--;
-							r = 0;
-						}
-						goto _zone_free_end_;
-					} else {
-						if(p_entry->objects && p_entry->data_size == aligned_size) {
-							p_zcxt->pf_page_free(data, aligned_size / ZONE_PAGE_SIZE, p_zcxt->user_data);
-							p_entry->data_size = 0;
-							p_entry->data = 0;
-							p_entry->objects = 0;
-							p_zone->header.objects--;
-							r = 0;
-						}
-						goto _zone_free_end_;
-					}
-				}
+	if(pp_zone) {
+		unsigned long long mutex_handle = _lock(p_zcxt, 0);
+		unsigned int i = 0;
 
-				i++;
-			}
+		for(r = 0; i < num; i++)
+			r += _zone_free_locked(p_zcxt, *pp_zone, ptrs[i], aligned_size);
 
-			p_zone = (_zone_page_t *)p_zone->header.next;
-		}
-_zone_free_end_:
 		_unlock(p_zcxt, mutex_handle);
 	}
 
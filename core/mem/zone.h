@@ -63,8 +63,12 @@ extern "C" {
 int zone_init(_zone_context_t *p_zcxt);
 /* Allocates chunk of memory and returns pointer or NULL */
 void *zone_alloc(_zone_context_t *p_zcxt, unsigned int size, unsigned long long limit);
+/* Allocates up to 'num' chunks with same size and returns number of allocated chunks */
+unsigned int zone_alloc_batch(_zone_context_t *p_zcxt, unsigned int size, unsigned long long limit, void **ptrs, unsigned int num);
 /* Deallocate memory chunk and returns 0 for siccess */
 int zone_free(_zone_context_t *p_zcxt, void *ptr, unsigned int size);
+/* Deallocate 'num' chunks with same size and returns number of failed ones */
+unsigned int zone_free_batch(_zone_context_t *p_zcxt, void **ptrs, unsigned int num, unsigned int size);
 /* Verify pointer. Returns 1 if pointer and size, belongs to active object */
 int zone_verify(_zone_context_t *p_zcxt, void *ptr, unsigned int size);
 /* Destroy zone context */
@@ -1,13 +1,17 @@
 #include <malloc.h>
 #include <assert.h>
+#include <string.h>
 #include <mutex>
 #include "iMemory.h"
 #include "zone.h"
+#include "heap_cache.h"
+#include "page_arena.h"
 
 class cZoneHeap: public iHeap {
 private:
 	_zone_context_t m_zone;
 	std::mutex	m_mutex;
+	heap_cache	m_cache;
 
 	void init_zone_context(void) {
 		m_zone.user_data = this;
@@ -15,11 +19,11 @@ private:
 		m_zone.zones = NULL;
 
 		m_zone.pf_page_alloc = [](_u32 num_pages, _u64 limit, void *udata)->void* {
-			return ::malloc(num_pages * ZONE_PAGE_SIZE);
+			return arena_page_alloc(num_pages);
 		};
 
 		m_zone.pf_page_free = [](void *ptr, _u32 num_pages, void *udata) {
-			::free(ptr);
+			arena_page_free(ptr, num_pages);
 		};
 
 		m_zone.pf_mutex_lock = [](_u64 mutex_handle, void *udata)->_u64 {
@@ -35,6 +39,21 @@ private:
 			p->m_mutex.unlock();
 		};
 	}
+
+	void init_cache(void) {
+		m_cache.init([](_u32 size, void **ptrs, _u32 n, void *udata)->_u32 {
+			cZoneHeap *p = (cZoneHeap *)udata;
+
+			return zone_alloc_batch(&p->m_zone, size, ZONE_DEFAULT_LIMIT, ptrs, n);
+		}, [](_u32 size, void **ptrs, _u32 n, void *udata) {
+			cZoneHeap *p = (cZoneHeap *)udata;
+#ifndef NDEBUG
+			assert(!zone_free_batch(&p->m_zone, ptrs, n, size));
+#else
+			zone_free_batch(&p->m_zone, ptrs, n, size);
+#endif
+		}, this);
+	}
 public:
 	BASE(cZoneHeap, "cZoneHeap", RF_ORIGINAL | RF_CLONE, 1,0,0);
 
@@ -44,10 +63,13 @@ public:
 		switch(cmd) {
 			case OCTL_INIT:
 				init_zone_context();
-				if(zone_init(&m_zone) == 0)
+				if(zone_init(&m_zone) == 0) {
+					init_cache();
 					r = true;
+				}
 				break;
 			case OCTL_UNINIT:
+				m_cache.destroy();
 				zone_destroy(&m_zone);
 				r = true;
 				break;
@@ -57,17 +79,25 @@ public:
 	}
 
 	void *alloc(_u32 size) {
-		return zone_alloc(&m_zone, size, ZONE_DEFAULT_LIMIT);
+		void *r = m_cache.alloc(size);
+
+		if(!r)
+			r = zone_alloc(&m_zone, size, ZONE_DEFAULT_LIMIT);
+
+		return r;
 	}
 
 	void free(void *ptr, _u32 size) {
+		if(!m_cache.free(ptr, size)) {
 #ifndef NDEBUG
-		assert(!zone_free(&m_zone, ptr, size));
+			assert(!zone_free(&m_zone, ptr, size));
 #else
-		zone_free(&m_zone, ptr, size);
+			zone_free(&m_zone, ptr, size);
 #endif
+		}
 	}
 
+	// objects in thread magazines are verified as active
 	bool verify(void *ptr, _u32 size) {
 		bool r = false;
 
@@ -78,6 +108,15 @@ public:
 	}
 
 	void status(_heap_status_t *p_hs) {
+		_hc_status_t hcs;
+
+		memset(p_hs, 0, sizeof(_heap_status_t));
+		m_cache.status(&hcs);
+		p_hs->cobj = hcs.objects;
+		p_hs->cthreads = hcs.threads;
+		p_hs->chits = hcs.alloc;
+		p_hs->crefill = hcs.refill;
+		p_hs->cflush = hcs.flush;
 	}
 };
 
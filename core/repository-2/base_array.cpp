@@ -1,7 +1,27 @@
 #include <string.h>
+#include <atomic>
 #include "private.h"
 
+// Lookup cache (per thread, direct mapped). Names are mostly I_* and C_*
+// literals with stable addresses, so the slot is selected by key pointer
+// and verified by pointer compare first. Every change of base map makes
+// a new generation, which invalidates all cached results (including misses).
+#define LC_SLOTS	128
+#define LC_POINTER	0
+#define LC_INAME	1
+#define LC_CNAME	2
+
+typedef struct {
+	_u32		gen; // 0 means empty
+	_u8		type; // LC_POINTER/LC_INAME/LC_CNAME
+	const void	*key; // name or object pointer
+	_base_entry_t	*p_bentry; // result (can be NULL)
+	_char_t		name[MAX_INAME];
+}_lc_entry_t;
+
 static _map_t _g_base_map_;
+static std::atomic<_u32> _g_base_gen_(1);
+static thread_local _lc_entry_t _g_lc_[LC_SLOTS];
 
 
 static bool add_iname(_base_entry_t *pb_entry) {
@@ -88,6 +108,8 @@ void add_base_array(_base_entry_t *pb_entry, _u32 count) {
 		add_cname(p);
 		add_pointer(p);
 	}
+
+	_g_base_gen_++;
 }
 
 static void remove_iname(_base_entry_t *pb_entry) {
@@ -143,6 +165,8 @@ void remove_base_array(_base_entry_t *pb_entry, _u32 count) {
 		remove_cname(p);
 		remove_pointer(p);
 	}
+
+	_g_base_gen_++;
 }
 
 _base_entry_t *find_object(_base_key_t *p_key) {
@@ -156,30 +180,73 @@ _base_entry_t *find_object(_base_key_t *p_key) {
 	return r;
 }
 
-_base_entry_t *find_object_by_iname(_cstr_t iname) {
-	_base_key_t key;
+static _lc_entry_t *lc_slot(const void *key, _u8 type) {
+	_u64 h = ((_u64)key + type) * 0x9e3779b97f4a7c15ULL;
 
-	memset(&key, 0, sizeof(_base_key_t));
-	strncpy(key.iname, iname, sizeof(key.iname)-1);
-	return find_object(&key);
+	return &_g_lc_[(h >> 32) & (LC_SLOTS - 1)];
 }
 
-_base_entry_t *find_object_by_cname(_cstr_t cname) {
-	_base_key_t key;
+static bool lc_match(_lc_entry_t *pe, const void *key, _u8 type, _u32 gen) {
+	bool r = false;
 
-	memset(&key, 0, sizeof(_base_key_t));
-	strncpy(key.cname, cname, sizeof(key.cname)-1);
-	return find_object(&key);
+	if(pe->gen == gen && pe->key == key && pe->type == type) {
+		// the same address can hold another name (not a literal)
+		if(type == LC_POINTER || strncmp(pe->name, (_cstr_t)key, sizeof(pe->name) - 1) == 0)
+			r = true;
+	}
+
+	return r;
 }
 
-_base_entry_t *find_object_by_pointer(iBase *pi_base) {
-	_base_key_t key;
+static _base_entry_t *lc_find(const void *key, _u8 type) {
+	_base_entry_t *r = NULL;
+	_u32 gen = _g_base_gen_.load(std::memory_order_acquire);
+	_lc_entry_t *pe = lc_slot(key, type);
+
+	if(lc_match(pe, key, type, gen))
+		r = pe->p_bentry;
+	else {
+		_base_key_t bkey;
+
+		memset(&bkey, 0, sizeof(_base_key_t));
+		switch(type) {
+			case LC_POINTER:
+				bkey.pi_base = (iBase *)key;
+				break;
+			case LC_INAME:
+				strncpy(bkey.iname, (_cstr_t)key, sizeof(bkey.iname)-1);
+				break;
+			case LC_CNAME:
+				strncpy(bkey.cname, (_cstr_t)key, sizeof(bkey.cname)-1);
+				break;
+		}
 
-	memset(&key, 0, sizeof(_base_key_t));
-	key.pi_base = pi_base;
-	return find_object(&key);
+		r = find_object(&bkey);
+		// store with generation taken before the lookup
+		pe->gen = gen;
+		pe->type = type;
+		pe->key = key;
+		pe->p_bentry = r;
+		if(type != LC_POINTER)
+			strncpy(pe->name, (_cstr_t)key, sizeof(pe->name) - 1);
+	}
+
+	return r;
+}
+
+_base_entry_t *find_object_by_iname(_cstr_t iname) {
+	return lc_find(iname, LC_INAME);
+}
+
+_base_entry_t *find_object_by_cname(_cstr_t cname) {
+	return lc_find(cname, LC_CNAME);
+}
+
+_base_entry_t *find_object_by_pointer(iBase *pi_base) {
+	return lc_find(pi_base, LC_POINTER);
 }
 
 void destroy_base_array_storage(void) {
 	_g_base_map_.destroy();
+	_g_base_gen_++;
 }
@@ -1,33 +1,116 @@
 #include <string.h>
+#include <stddef.h>
+#include <new>
+#include <atomic>
 #include "private.h"
-
-static _list_t	_gl_dcs_;
-
+#include "obj_cache.h"
+
+// Contexts of cloned objects are carved from per class slabs. Released
+// contexts are recycled by the same class through lock free free list
+// (with per thread magazines), so no global lock is taken on the way.
+
+#define DCS_CLASSES	1024 // size of class table (power of 2)
+#define DCS_ALIGN	16
+#define DCS_SLAB_SIZE	16384 // preferred slab size in bytes
+#define DCS_SLAB_MIN	4 // min. contexts per slab
+#define DCS_SLAB_MAX	128 // max. contexts per slab
+
+typedef struct dcs_class _dcs_class_t;
+typedef struct dcs_slab _dcs_slab_t;
+
+typedef struct { // context header (object follows)
+	_dcs_class_t	*p_class; // NULL for context out of slabs
+	_base_entry_t	*p_bentry; // prototype
+	_oc_link_t	link; // in free list of class
+	_u32		size; // object size
+	_cstat_t	state;
+} __attribute__((aligned(DCS_ALIGN))) _dcs_hdr_t;
+
+struct dcs_slab {
+	_dcs_slab_t	*next;
+	_u32		count; // number of contexts
+	std::atomic<_u32> used; // carved contexts (can exceed count)
+	// contexts follows
+};
+
+struct dcs_class {
+	_base_entry_t	*p_bentry;
+	_u32		size; // object size
+	_u32		stride; // header + object
+	_u32		slab_count; // contexts per slab
+	obj_cache	cache; // released contexts
+	std::atomic<_dcs_slab_t *> p_slab; // current slab
+	_dcs_slab_t	*p_slabs; // all slabs
+};
+
+#define DCS_SLAB_CONTEXT(pc, ps, i) \
+	((_dcs_hdr_t *)((_u8 *)(ps) + sizeof(_dcs_slab_t) + (i) * (pc)->stride))
+#define DCS_HEADER(pi_base) ((_dcs_hdr_t *)(pi_base) - 1)
+
+static _mutex_t	_g_dcs_mutex_; // protects class table updates and slab lists
+static std::atomic<_dcs_class_t *> _g_dcs_class_[DCS_CLASSES];
 
 _mutex_handle_t dcs_lock(_mutex_handle_t hlock) {
-	return _gl_dcs_.lock(hlock);
+	return _g_dcs_mutex_.lock(hlock);
 }
 
 void dcs_unlock(_mutex_handle_t hlock) {
-	_gl_dcs_.unlock(hlock);
+	_g_dcs_mutex_.unlock(hlock);
 }
 
-iBase *dcs_create_context(_base_entry_t *p_bentry, _rf_t flags, _mutex_handle_t hlock) {
-	iBase *r = NULL;
-	_object_info_t info;
+static _u32 dcs_hash(_base_entry_t *p_bentry) {
+	_u64 h = (_u64)p_bentry * 0x9e3779b97f4a7c15ULL;
 
-	p_bentry->pi_base->object_info(&info);
+	return (_u32)(h >> 32) & (DCS_CLASSES - 1);
+}
 
-	if((info.flags & flags) & RF_CLONE) {
-		_mutex_handle_t hm = dcs_lock(hlock);
-		_u32 size = info.size + sizeof(_cstat_t); // one byte more space to keep state
-		_cstat_t *p_state = NULL;
+static _dcs_class_t *dcs_find_class(_base_entry_t *p_bentry, _u32 size, _u32 *p_free) {
+	_dcs_class_t *r = NULL;
+	_u32 idx = dcs_hash(p_bentry);
+	_u32 i = 0;
 
-		if((r = (iBase *)_gl_dcs_.add(p_bentry->pi_base, size, hm))) {
-			_u8 *p = (_u8 *)r;
+	for(; i < DCS_CLASSES; i++) {
+		_dcs_class_t *pc = _g_dcs_class_[(idx + i) & (DCS_CLASSES - 1)].load(std::memory_order_acquire);
 
-			p_state = (_cstat_t *)(p + info.size);
-			*p_state = 0;
+		if(!pc)
+			break;
+		// the same entry can be reused by another extension (compare size too)
+		if(pc->p_bentry == p_bentry && pc->size == size) {
+			r = pc;
+			break;
+		}
+	}
+
+	if(p_free)
+		*p_free = (i < DCS_CLASSES) ? (idx + i) & (DCS_CLASSES - 1) : DCS_CLASSES;
+
+	return r;
+}
+
+// returns NULL when class table is full
+static _dcs_class_t *dcs_class(_base_entry_t *p_bentry, _u32 size, _mutex_handle_t hlock) {
+	_dcs_class_t *r = NULL;
+
+	if(!(r = dcs_find_class(p_bentry, size, NULL))) {
+		_mutex_handle_t hm = dcs_lock(hlock);
+		_u32 idx = DCS_CLASSES;
+
+		if(!(r = dcs_find_class(p_bentry, size, &idx)) && idx < DCS_CLASSES) {
+			if((r = (_dcs_class_t *)zalloc(sizeof(_dcs_class_t)))) {
+				new (r) _dcs_class_t;
+				r->p_bentry = p_bentry;
+				r->size = size;
+				r->stride = sizeof(_dcs_hdr_t) + ((size + DCS_ALIGN - 1) & ~(DCS_ALIGN - 1));
+				r->slab_count = DCS_SLAB_SIZE / r->stride;
+				if(r->slab_count < DCS_SLAB_MIN)
+					r->slab_count = DCS_SLAB_MIN;
+				if(r->slab_count > DCS_SLAB_MAX)
+					r->slab_count = DCS_SLAB_MAX;
+				r->cache.init();
+				r->p_slab = NULL;
+				r->p_slabs = NULL;
+				_g_dcs_class_[idx].store(r, std::memory_order_release);
+			}
 		}
 
 		dcs_unlock(hm);
@@ -36,40 +119,131 @@ iBase *dcs_create_context(_base_entry_t *p_bentry, _rf_t flags, _mutex_handle_t
 	return r;
 }
 
-_cstat_t dcs_get_context_state(iBase *pi_base) {
-	_cstat_t r = 0;
+static _dcs_hdr_t *dcs_alloc(_dcs_class_t *pc, _mutex_handle_t hlock) {
+	_dcs_hdr_t *r = NULL;
+	_oc_link_t *pl = pc->cache.get();
+
+	if(pl)
+		// recycled context
+		r = (_dcs_hdr_t *)((_u8 *)pl - offsetof(_dcs_hdr_t, link));
+	else {
+		for(;;) {
+			_dcs_slab_t *ps = pc->p_slab.load(std::memory_order_acquire);
+
+			if(ps) {
+				_u32 i = ps->used.fetch_add(1, std::memory_order_relaxed);
+
+				if(i < ps->count) {
+					r = DCS_SLAB_CONTEXT(pc, ps, i);
+					break;
+				}
+			}
+
+			// slab is full
+			_mutex_handle_t hm = dcs_lock(hlock);
+
+			if(pc->p_slab.load() == ps) {
+				_u32 size = sizeof(_dcs_slab_t) + pc->slab_count * pc->stride;
+				_dcs_slab_t *p_new = (_dcs_slab_t *)zalloc(size);
+
+				if(p_new) {
+					p_new->count = pc->slab_count;
+					p_new->used = 0;
+					p_new->next = pc->p_slabs;
+					pc->p_slabs = p_new;
+					pc->p_slab.store(p_new, std::memory_order_release);
+				}
+			}
+
+			dcs_unlock(hm);
+
+			if(!pc->p_slab.load())
+				break;
+		}
+	}
+
+	if(r)
+		r->p_class = pc;
+
+	return r;
+}
+
+iBase *dcs_create_context(_base_entry_t *p_bentry, _rf_t flags, _mutex_handle_t hlock) {
+	iBase *r = NULL;
 	_object_info_t info;
-	_cstat_t *p_state = NULL;
-	_u8 *p = (_u8 *)pi_base;
 
-	pi_base->object_info(&info);
-	p_state = (_cstat_t *)(p + info.size);
-	r = *p_state;
+	p_bentry->pi_base->object_info(&info);
+
+	if((info.flags & flags) & RF_CLONE) {
+		_dcs_class_t *pc = dcs_class(p_bentry, info.size, hlock);
+		_dcs_hdr_t *ph = NULL;
+
+		if(pc)
+			ph = dcs_alloc(pc, hlock);
+		else if((ph = (_dcs_hdr_t *)zalloc(sizeof(_dcs_hdr_t) + info.size)))
+			// out of class table
+			ph->p_class = NULL;
+
+		if(ph) {
+			ph->p_bentry = p_bentry;
+			ph->size = info.size;
+			ph->state = 0;
+			r = (iBase *)(ph + 1);
+			memcpy((void *)r, (void *)p_bentry->pi_base, info.size);
+		}
+	}
 
 	return r;
 }
 
+_cstat_t dcs_get_context_state(iBase *pi_base) {
+	return DCS_HEADER(pi_base)->state;
+}
+
 void dcs_set_context_state(iBase *pi_base, _cstat_t state) {
-	_object_info_t info;
-	_cstat_t *p_state = NULL;
-	_u8 *p = (_u8 *)pi_base;
+	DCS_HEADER(pi_base)->state = state;
+}
 
-	pi_base->object_info(&info);
-	p_state = (_cstat_t *)(p + info.size);
-	*p_state = state;
+_base_entry_t *dcs_get_context_entry(iBase *pi_base) {
+	return DCS_HEADER(pi_base)->p_bentry;
 }
 
 bool dcs_remove_context(iBase *pi_base, _mutex_handle_t hlock) {
 	bool r = false;
-	_mutex_handle_t hm = dcs_lock(hlock);
 
-	if((r = _gl_dcs_.sel(pi_base, hm)))
-		_gl_dcs_.del(hm);
+	if(pi_base) {
+		_dcs_hdr_t *ph = DCS_HEADER(pi_base);
+
+		if(ph->p_class)
+			ph->p_class->cache.put(&ph->link);
+		else
+			zfree(ph, sizeof(_dcs_hdr_t) + ph->size);
+		r = true;
+	}
 
-	dcs_unlock(hm);
 	return r;
 }
 
 void dcs_destroy_storage(void) {
-	_gl_dcs_.destroy();
+	_mutex_handle_t hm = dcs_lock();
+
+	for(_u32 i = 0; i < DCS_CLASSES; i++) {
+		_dcs_class_t *pc = _g_dcs_class_[i].load();
+
+		if(pc) {
+			while(pc->p_slabs) {
+				_dcs_slab_t *ps = pc->p_slabs;
+
+				pc->p_slabs = ps->next;
+				zfree(ps, sizeof(_dcs_slab_t) + ps->count * pc->stride);
+			}
+
+			pc->cache.destroy();
+			pc->~_dcs_class_t();
+			zfree(pc, sizeof(_dcs_class_t));
+			_g_dcs_class_[i] = NULL;
+		}
+	}
+
+	dcs_unlock(hm);
 }
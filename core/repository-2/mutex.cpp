@@ -1,22 +1,36 @@
+#include <assert.h>
 #include "private.h"
 
-_u64 mutex::get_handle(void) {
-	return  ((((_u64)m_hcount) << 32) | (_u32)(_u64)this);
+_mutex_handle_t mutex::acquired(void) {
+	m_owner = futex_tid();
+	m_lcount = 1;
+	// never 0, and different for different mutexes
+	m_handle = (((_u64)this) << 16) ^ ++m_hcount;
+	if(!m_handle)
+		m_handle = ++m_hcount;
+
+	return m_handle;
+}
+
+bool mutex::is_owner(_mutex_handle_t h) {
+	// handle is written by owner only
+	return (h && __atomic_load_n(&m_owner, __ATOMIC_RELAXED) == futex_tid() &&
+		h == m_handle);
 }
 
 mutex::mutex() {
-	m_lcount = m_hcount = 0;
+	futex_mutex_init(&m_mutex);
+	m_owner = m_handle = m_hcount = 0;
+	m_lcount = 0;
 }
 
 mutex::~mutex() {}
 
 _mutex_handle_t mutex::lock(_mutex_handle_t h) {
 	_mutex_handle_t r = 0;
-	if(h != get_handle()) {
-		m_mutex.lock();
-		m_lcount = 1;
-		m_hcount++;
-		r = get_handle();
+	if(!is_owner(h)) {
+		futex_mutex_lock(&m_mutex);
+		r = acquired();
 	} else {
 		r = h;
 		m_lcount++;
@@ -26,12 +40,9 @@ _mutex_handle_t mutex::lock(_mutex_handle_t h) {
 
 _mutex_handle_t mutex::try_lock(_mutex_handle_t h) {
 	_mutex_handle_t r = 0;
-	if(h != get_handle()) {
-		if(m_mutex.try_lock()) {
-			m_lcount = 1;
-			m_hcount++;
-			r = get_handle();
-		}
+	if(!is_owner(h)) {
+		if(futex_mutex_try_lock(&m_mutex))
+			r = acquired();
 	} else {
 		r = h;
 		m_lcount++;
@@ -40,10 +51,15 @@ _mutex_handle_t mutex::try_lock(_mutex_handle_t h) {
 }
 
 void mutex::unlock(_mutex_handle_t h) {
-	if(h == get_handle()) {
+	if(is_owner(h)) {
 		if(m_lcount)
 			m_lcount--;
-		if(!m_lcount)
-			m_mutex.unlock();
-	}
+		if(!m_lcount) {
+			__atomic_store_n(&m_owner, 0, __ATOMIC_RELAXED);
+			m_handle = 0;
+			futex_mutex_unlock(&m_mutex);
+		}
+	} else
+		// not owner or wrong handle
+		assert(false);
 }
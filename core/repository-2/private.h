@@ -10,6 +10,7 @@
 #include "sha1.h"
 #include "iRepository.h"
 #include "err.h"
+#include "futex.h"
 
 typedef struct 	mutex 		_mutex_t;
 typedef _u64			_mutex_handle_t;
@@ -19,11 +20,14 @@ typedef struct extension 	_extension_t;
 
 struct mutex {
 private:
-	std::mutex	m_mutex;
+	_futex_mutex_t	m_mutex;
+	_u64		m_owner; // thread ID
+	_u64		m_handle; // handle of current acquisition
+	_u64		m_hcount; // handle count
 	_u32		m_lcount; // lock count
-	_u32		m_hcount; // handle count
 
-	_u64 get_handle(void);
+	_mutex_handle_t acquired(void);
+	bool is_owner(_mutex_handle_t h);
 
 public:
 	mutex();
@@ -220,6 +224,17 @@ void remove_monitoring(iBase *pi_handler);
 void enum_monitoring(iBase *pi_handler, _monitoring_enum_cb_t *pcb, void *udata);
 void destroy_monitoring_storage(void);
 
+// Trace
+#define TRACE_MAX_EVENTS	8192
+
+void trace_enable(bool enable);
+_u64 trace_now(void);
+// returns start time, or 0 when trace is disabled
+_u64 trace_begin(void);
+void trace_end(_u64 ts, _cstr_t cat, _cstr_t name, _u32 count=0);
+void trace_enum(_cb_trace_t *pcb, void *udata);
+void trace_clear(void);
+
 // Dynamic Context Storage (DCS)
 _mutex_handle_t dcs_lock(_mutex_handle_t hlock=0);
 void dcs_unlock(_mutex_handle_t hlock);
@@ -227,6 +242,7 @@ iBase *dcs_create_context(_base_entry_t *p_bentry, _rf_t flags, _mutex_handle_t
 bool dcs_remove_context(iBase *pi_base, _mutex_handle_t hlock=0);
 _cstat_t dcs_get_context_state(iBase *pi_base);
 void dcs_set_context_state(iBase *pi_base, _cstat_t state);
+_base_entry_t *dcs_get_context_entry(iBase *pi_base);
 void dcs_destroy_storage(void);
 
 // Link map
@@ -1,8 +1,15 @@
 #include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 #include "startup.h"
 #include "private.h"
 #include "iTaskMaker.h"
 #include "iMemory.h"
+#include "iLog.h"
+
+#define INIT_POOL	"repository-init" // thread pool for parallel initialization
 
 class cRepository: public iRepository {
 private:
@@ -10,6 +17,16 @@ private:
 	_set_pi_object_t	ms_pending; // set for  pending objects
 	_set_pi_object_t::iterator ms_it_pending; // iterator for pending objects
 	iTaskMaker *mpi_tasks;
+	std::recursive_mutex m_state_mutex; // pending list and users (parallel init)
+
+	typedef struct { // node of initialization graph
+		_base_entry_t	*p_bentry;
+		_cstr_t		alias;
+		_u32		deps; // number of not initialized dependencies
+		std::vector<_u32> users; // indexes of dependent nodes
+		_u32		init_time; // microseconds
+	}_init_node_t;
+	typedef std::vector<_init_node_t> _init_graph_t;
 
 	void enum_pending(_enum_cb_t *pcb, void *udata) {
 		ms_it_pending = ms_pending.begin();
@@ -34,6 +51,15 @@ private:
 		return mpi_tasks;
 	}
 
+	void trace_object(_u64 ts, _cstr_t cat, iBase *pi_base, _u32 count=0) {
+		if(ts) {
+			_object_info_t oi;
+
+			pi_base->object_info(&oi);
+			trace_end(ts, cat, oi.cname, count);
+		}
+	}
+
 	bool is_original(iBase *pi_base) {
 		bool r = false;
 		_base_entry_t *p_bentry = find_object_by_pointer(pi_base);
@@ -78,12 +104,8 @@ private:
 	_base_entry_t *find_object_entry(iBase *pi_base) {
 		_base_entry_t *r = find_object_by_pointer(pi_base);
 
-		if(!r) { // cloning may be
-			_object_info_t oi;
-
-			pi_base->object_info(&oi);
-			r = find_object_by_cname(oi.cname);
-		}
+		if(!r) // cloning may be
+			r = dcs_get_context_entry(pi_base);
 
 		return r;
 	}
@@ -150,6 +172,9 @@ private:
 
 	// Process original pending list.
 	void process_pending_list(void) {
+		_u64 ts = trace_begin();
+		_u32 n = ms_pending.size();
+
 		enum_pending([](iBase *pi_base, void *udata)->_s32 {
 			_s32 r = ENUM_CONTINUE;
 			cRepository *p_repo = (cRepository *)udata;
@@ -193,6 +218,8 @@ private:
 
 			return r;
 		}, this);
+
+		trace_end(ts, "pending", "", n);
 	}
 
 	void scan_base_array(iBase *pi_base, _base_entry_t *p_exclude_array=NULL, _u32 count=0) {
@@ -204,6 +231,7 @@ private:
 		}_enum_t;
 
 		_enum_t e = {pi_base, this, p_exclude_array, count};
+		_u64 ts = trace_begin();
 
 		enum_base_array([](_base_entry_t *p_base_entry, void *udata) {
 			_enum_t *pe = (_enum_t *)udata;
@@ -227,6 +255,8 @@ private:
 					pe->p_repo->update_users(pe->pi_base);
 			}
 		}, &e);
+
+		trace_object(ts, "scan", pi_base);
 	}
 
 	void process_pending_list(_base_entry_t *p_bentry) {
@@ -235,6 +265,8 @@ private:
 			_base_entry_t	*p_bentry;
 		}_enum_info_t;
 		_enum_info_t e = {this, p_bentry};
+		_u64 ts = trace_begin();
+		_u32 n = ms_pending.size();
 
 		enum_pending([](iBase *pi_base, void *udata)->_s32 {
 			_s32 r = ENUM_CONTINUE;
@@ -258,6 +290,8 @@ private:
 
 			return r;
 		}, &e);
+
+		trace_object(ts, "pending", p_bentry->pi_base, n);
 	}
 
 	bool init_object(iBase *pi_base) {
@@ -265,6 +299,8 @@ private:
 		_cstat_t state = get_context_state(pi_base);
 
 		if(!(r = (state & ST_INITIALIZED))) {
+			_u64 ts = trace_begin();
+
 			lm_clean(pi_base);
 
 			_u32 lmr = lm_init(pi_base, [](const _link_info_t *pl, void *udata)->iBase* {
@@ -285,11 +321,18 @@ private:
 				return p_repo->object_request(&orq, pl->flags);
 			}, this);
 
+			trace_object(ts, "link", pi_base);
+
 			if(lmr & PLMR_READY) {
-				if((r = pi_base->object_ctl(OCTL_INIT, this))) {
+				ts = trace_begin();
+				r = pi_base->object_ctl(OCTL_INIT, this);
+				trace_object(ts, "init", pi_base);
+
+				if(r) {
 					_object_info_t oi;
 
 					state |= ST_INITIALIZED;
+					m_state_mutex.lock();
 					if(lmr & PLMR_KEEP_PENDING) {
 						// insert in pending list
 						ms_pending.insert(pi_base);
@@ -297,6 +340,7 @@ private:
 					}
 					set_context_state(pi_base, state);
 					update_users(pi_base);
+					m_state_mutex.unlock();
 
 					pi_base->object_info(&oi);
 					if(oi.flags & RF_TASK) {
@@ -329,6 +373,137 @@ private:
 		}
 	}
 
+	_s32 init_node_index(_init_graph_t &graph, _base_entry_t *p_bentry) {
+		_s32 r = -1;
+
+		for(_u32 i = 0; i < graph.size(); i++) {
+			if(graph[i].p_bentry == p_bentry) {
+				r = i;
+				break;
+			}
+		}
+
+		return r;
+	}
+
+	// Collect dependencies of node 'idx' from link map of 'pi_base'.
+	// Links to clones are followed, because cloning initializes the links of clone.
+	void init_node_deps(_init_graph_t &graph, _u32 idx, iBase *pi_base, std::vector<_base_entry_t *> &visited) {
+		_u32 count = 0;
+		const _link_info_t *pl = pi_base->object_link(&count);
+
+		for(_u32 i = 0; pl && i < count; i++) {
+			_base_entry_t *p_bentry = NULL;
+
+			if(pl[i].ppi_base && !(pl[i].flags & RF_POST_INIT)) {
+				if(pl[i].cname)
+					p_bentry = find_object_by_cname(pl[i].cname);
+				else if(pl[i].iname)
+					p_bentry = find_object_by_iname(pl[i].iname);
+			}
+
+			if(p_bentry && std::find(visited.begin(), visited.end(), p_bentry) == visited.end()) {
+				_s32 n = init_node_index(graph, p_bentry);
+
+				visited.push_back(p_bentry);
+				if(n >= 0) {
+					if((_u32)n != idx) {
+						graph[n].users.push_back(idx);
+						graph[idx].deps++;
+					}
+				} else if(!(p_bentry->state & ST_INITIALIZED))
+					init_node_deps(graph, idx, p_bentry->pi_base, visited);
+			}
+		}
+	}
+
+	void init_node(_init_node_t *p_node) {
+		std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+
+		init_object(p_node->p_bentry->pi_base);
+		p_node->init_time = std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::steady_clock::now() - t).count();
+	}
+
+	void init_level(_init_graph_t &graph, std::vector<_u32> &level, _u32 flags) {
+		iThreadPool *pi_pool = NULL;
+
+		if((flags & EXT_PARALLEL) && level.size() > 1 && get_task_maker())
+			// owned by task maker
+			pi_pool = mpi_tasks->pool(INIT_POOL);
+
+		if(pi_pool) {
+			typedef struct {
+				cRepository	*p_repo;
+				_init_node_t	*p_node;
+			}_init_job_t;
+			std::vector<_init_job_t> v_job(level.size());
+			std::vector<HJOB> v_hj(level.size());
+
+			for(_u32 i = 0; i < level.size(); i++) {
+				v_job[i].p_repo = this;
+				v_job[i].p_node = &graph[level[i]];
+				if(!(v_hj[i] = pi_pool->submit([](void *arg)->void* {
+							_init_job_t *pj = (_init_job_t *)arg;
+
+							pj->p_repo->init_node(pj->p_node);
+							return NULL;
+						}, &v_job[i])))
+					init_node(v_job[i].p_node);
+			}
+
+			for(_u32 i = 0; i < level.size(); i++) {
+				if(v_hj[i])
+					pi_pool->wait(v_hj[i]);
+			}
+		} else {
+			for(_u32 i = 0; i < level.size(); i++)
+				init_node(&graph[level[i]]);
+		}
+	}
+
+	// Topological initialization (level by level)
+	void init_graph(_init_graph_t &graph, _u32 flags) {
+		std::vector<_u32> level, next;
+		_u32 done = 0;
+
+		for(_u32 i = 0; i < graph.size(); i++) {
+			std::vector<_base_entry_t *> visited;
+
+			init_node_deps(graph, i, graph[i].p_bentry->pi_base, visited);
+		}
+
+		for(_u32 i = 0; i < graph.size(); i++) {
+			if(!graph[i].deps)
+				level.push_back(i);
+		}
+
+		while(level.size()) {
+			init_level(graph, level, flags);
+			next.clear();
+
+			for(_u32 i = 0; i < level.size(); i++) {
+				_init_node_t *p_node = &graph[level[i]];
+
+				done++;
+				for(_u32 j = 0; j < p_node->users.size(); j++) {
+					if(--graph[p_node->users[j]].deps == 0)
+						next.push_back(p_node->users[j]);
+				}
+			}
+
+			level.swap(next);
+		}
+
+		if(done < graph.size()) {
+			// dependency cycle (recursive initialization as usual)
+			for(_u32 i = 0; i < graph.size(); i++) {
+				if(graph[i].deps)
+					init_node(&graph[i]);
+			}
+		}
+	}
+
 	bool uninit_object(iBase *pi_base) {
 		bool r = false;
 		_cstat_t state = get_context_state(pi_base);
@@ -397,6 +572,64 @@ private:
 		return r;
 	}
 
+	bool has_links(iBase *pi_base) {
+		_u32 count = 0;
+
+		return pi_base->object_link(&count) && count;
+	}
+
+	// Clone without links has no users and can't be pending,
+	// so the links and users bookkeeping is left to objects which need it.
+	bool init_clone(iBase *pi_base) {
+		bool r = false;
+
+		if(has_links(pi_base))
+			r = init_object(pi_base);
+		else {
+			_u64 ts = trace_begin();
+
+			if((r = pi_base->object_ctl(OCTL_INIT, this))) {
+				_object_info_t oi;
+
+				dcs_set_context_state(pi_base, ST_INITIALIZED);
+				pi_base->object_info(&oi);
+				if(oi.flags & RF_TASK) {
+					iTaskMaker *pi_tasks = get_task_maker();
+
+					if(pi_tasks)
+						pi_tasks->start(pi_base);
+				}
+			}
+
+			trace_object(ts, "init", pi_base);
+		}
+
+		return r;
+	}
+
+	bool uninit_clone(iBase *pi_base) {
+		bool r = true;
+
+		if(has_links(pi_base))
+			r = uninit_object(pi_base);
+		else if(dcs_get_context_state(pi_base) & ST_INITIALIZED) {
+			_object_info_t oi;
+
+			pi_base->object_info(&oi);
+			if(oi.flags & RF_TASK) {
+				iTaskMaker *pi_tasks = get_task_maker();
+
+				if(pi_tasks)
+					pi_tasks->stop(pi_tasks->handle(pi_base));
+			}
+
+			if((r = pi_base->object_ctl(OCTL_UNINIT, this)))
+				dcs_set_context_state(pi_base, 0);
+		}
+
+		return r;
+	}
+
 	void uninit_base_array(_base_entry_t *p_bentry, _u32 count) {
 		typedef struct {
 			cRepository 	*p_repo;
@@ -441,6 +674,8 @@ public:
 			case OCTL_INIT:
 				mpi_tasks = NULL;
 				zinit();
+				if(getenv("PULSE_TRACE"))
+					::trace_enable(true);
 				break;
 			case OCTL_UNINIT:
 				destroy();
@@ -473,14 +708,18 @@ public:
 			if(p_bentry) {
 				if(p_bentry->pi_base != pi_base) {
 					// cloning
-					if((unref = uninit_object(pi_base))) {
+					if((unref = uninit_clone(pi_base))) {
 						pi_base->~iBase();
 						dcs_remove_context(pi_base);
 					}
 				}
 
-				if(p_bentry->ref_cnt && unref)
-					p_bentry->ref_cnt--;
+				if(unref) {
+					_u32 cnt = __atomic_load_n(&p_bentry->ref_cnt, __ATOMIC_RELAXED);
+
+					while(cnt && !__atomic_compare_exchange_n(&p_bentry->ref_cnt, &cnt, cnt - 1,
+										true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+				}
 			}
 		}
 	}
@@ -508,12 +747,12 @@ public:
 			if(info.flags & flags) { // validate flags
 				if((info.flags & flags) & RF_CLONE) {
 					if((r = dcs_create_context(bentry, flags))) {
-						if(!init_object(r)) {
-							uninit_object(r);
+						if(!init_clone(r)) {
+							uninit_clone(r);
 							dcs_remove_context(r);
 							r = NULL;
 						} else {
-							bentry->ref_cnt++;
+							__atomic_add_fetch(&bentry->ref_cnt, 1, __ATOMIC_RELAXED);
 							if(dcs_get_context_state(r) & ST_PENDING)
 								scan_base_array(r);
 						}
@@ -521,7 +760,7 @@ public:
 				} else if((info.flags & flags) & RF_ORIGINAL) {
 					if(init_object(bentry->pi_base)) {
 						r = bentry->pi_base;
-						bentry->ref_cnt++;
+						__atomic_add_fetch(&bentry->ref_cnt, 1, __ATOMIC_RELAXED);
 					}
 				}
 			}
@@ -570,10 +809,13 @@ public:
 		_err_t r = ERR_UNKNOWN;
 		_char_t path[1024]="";
 		_extension_t *p_ext = NULL;
+		_u64 ts = trace_begin();
 
 		sprintf(path, "%s/%s", m_ext_dir, file);
+		r = load_extension(path, alias, &p_ext);
+		trace_end(ts, "dlopen", file);
 
-		if((r = load_extension(path, alias, &p_ext)) == ERR_NONE) {
+		if(r == ERR_NONE) {
 			if((r = p_ext->init(this)) == ERR_NONE) {
 				_u32 count = 0, limit = 0;
 				_base_entry_t *p_base_array = p_ext->array(&count, &limit);
@@ -591,6 +833,93 @@ public:
 		return r;
 	}
 
+	_err_t extension_load_list(_ext_load_t *p_list, _u32 count, _u32 flags=0,
+					_cb_init_report_t *pcb=0, void *udata=0) {
+		_err_t r = ERR_NONE;
+		_init_graph_t graph;
+		std::vector<_extension_t *> v_ext;
+
+		// load all extensions first (dlopen is serialized by dynamic loader anyway)
+		for(_u32 i = 0; i < count; i++) {
+			_char_t path[1024]="";
+			_extension_t *p_ext = NULL;
+			std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+			_u64 ts = trace_begin();
+
+			sprintf(path, "%s/%s", m_ext_dir, p_list[i].file);
+			p_list[i].err = load_extension(path, p_list[i].alias, &p_ext);
+			trace_end(ts, "dlopen", p_list[i].file);
+
+			if(p_list[i].err == ERR_NONE) {
+				if((p_list[i].err = p_ext->init(this)) == ERR_NONE) {
+					_u32 _count = 0, limit = 0;
+					_base_entry_t *p_base_array = p_ext->array(&_count, &limit);
+
+					if(p_base_array) {
+						add_base_array(p_base_array, _count);
+						v_ext.push_back(p_ext);
+
+						for(_u32 j = 0; j < _count; j++) {
+							_object_info_t oi;
+
+							p_base_array[j].pi_base->object_info(&oi);
+							if((oi.flags & RF_ORIGINAL) && !(p_base_array[j].state & ST_INITIALIZED)) {
+								_init_node_t node;
+
+								node.p_bentry = &p_base_array[j];
+								node.alias = p_ext->alias();
+								node.deps = 0;
+								node.init_time = 0;
+								graph.push_back(node);
+							}
+						}
+					} else {
+						p_list[i].err = ERR_UNKNOWN;
+						p_ext->unload();
+					}
+				}
+			}
+
+			p_list[i].load_time = std::chrono::duration_cast<std::chrono::microseconds>(
+						std::chrono::steady_clock::now() - t).count();
+			if(r == ERR_NONE)
+				r = p_list[i].err;
+		}
+
+		init_graph(graph, flags);
+
+		// post initialization (the same as init_base_array)
+		for(_u32 i = 0; i < v_ext.size(); i++) {
+			_u32 _count = 0, limit = 0;
+			_base_entry_t *p_base_array = v_ext[i]->array(&_count, &limit);
+
+			for(_u32 j = 0; j < _count; j++) {
+				_object_info_t oi;
+				bool post_init = true;
+
+				p_base_array[j].pi_base->object_info(&oi);
+				if(oi.flags & RF_ORIGINAL) {
+					if((post_init = (p_base_array[j].state & ST_INITIALIZED)))
+						scan_base_array(p_base_array[j].pi_base, p_base_array, _count);
+				}
+
+				if(post_init)
+					process_pending_list(&p_base_array[j]);
+			}
+		}
+
+		if(pcb) {
+			for(_u32 i = 0; i < graph.size(); i++) {
+				_object_info_t oi;
+
+				graph[i].p_bentry->pi_base->object_info(&oi);
+				pcb(graph[i].alias, oi.cname, graph[i].init_time, graph[i].p_bentry->state, udata);
+			}
+		}
+
+		return r;
+	}
+
 	_err_t extension_unload(_cstr_t alias) {
 		_err_t r = ERR_UNKNOWN;
 		_extension_t *p_ext = find_extension(alias);
@@ -634,6 +963,18 @@ public:
 		}, &e);
 	}
 
+	void trace_enable(bool enable) {
+		::trace_enable(enable);
+	}
+
+	void trace_enum(_cb_trace_t *pcb, void *udata) {
+		::trace_enum(pcb, udata);
+	}
+
+	void trace_clear(void) {
+		::trace_clear();
+	}
+
 	void destroy(void) {
 		// remove extensions
 		enum_extensions([](_extension_t *p_ext, void *udata)->_s32 {
@@ -645,6 +986,14 @@ public:
 			return ENUM_CONTINUE;
 		}, this);
 
+		// stop the log flusher and close the log file
+		iLog *pi_log = (iLog *)object_by_iname(I_LOG, RF_ORIGINAL);
+
+		if(pi_log) {
+			object_release(pi_log);
+			uninit_object(pi_log);
+		}
+
 		iHeap *pi_heap = (iHeap *)object_by_iname(I_HEAP, RF_ORIGINAL);
 
 		if(pi_heap)
@@ -0,0 +1,63 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <chrono>
+#include "private.h"
+
+// Recording of initialization events. Events are appended by atomic index
+// to static array and the rest is dropped, when array is full.
+
+static _trace_event_t		_g_trace_[TRACE_MAX_EVENTS];
+static std::atomic<_u32>	_g_trace_count_(0);
+static std::atomic<bool>	_g_trace_enable_(false);
+
+void trace_enable(bool enable) {
+	_g_trace_enable_ = enable;
+}
+
+_u64 trace_now(void) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+_u64 trace_begin(void) {
+	_u64 r = 0;
+
+	if(_g_trace_enable_.load(std::memory_order_relaxed))
+		r = trace_now();
+
+	return r;
+}
+
+void trace_end(_u64 ts, _cstr_t cat, _cstr_t name, _u32 count) {
+	if(ts) {
+		_u32 idx = _g_trace_count_++;
+
+		if(idx < TRACE_MAX_EVENTS) {
+			_trace_event_t *p = &_g_trace_[idx];
+
+			strncpy(p->name, (name) ? name : "", sizeof(p->name) - 1);
+			p->name[sizeof(p->name) - 1] = 0;
+			p->cat = cat;
+			p->ts = ts;
+			p->dur = (_u32)(trace_now() - ts);
+			p->tid = (_u32)syscall(SYS_gettid);
+			p->count = count;
+		}
+	}
+}
+
+void trace_enum(_cb_trace_t *pcb, void *udata) {
+	_u32 count = _g_trace_count_.load();
+
+	if(count > TRACE_MAX_EVENTS)
+		count = TRACE_MAX_EVENTS;
+
+	for(_u32 i = 0; i < count; i++)
+		pcb(&_g_trace_[i], udata);
+}
+
+void trace_clear(void) {
+	_g_trace_count_ = 0;
+}
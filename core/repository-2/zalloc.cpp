@@ -2,6 +2,7 @@
 #include <assert.h>
 #include "private.h"
 #include "zone.h"
+#include "page_arena.h"
 
 static _mutex_t _g_zmutex_;
 static bool _g_is_init_ = false;
@@ -15,11 +16,11 @@ static void zunlock(_mutex_handle_t hlock, void *udata) {
 }
 
 static void *zpage_alloc(_u32 num, _u64 limit, void *udata) {
-	return malloc(num * ZONE_PAGE_SIZE);
+	return arena_page_alloc(num);
 }
 
 static void zpage_free(void *ptr, _u32 num, void *udata) {
-	free(ptr);
+	arena_page_free(ptr, num);
 }
 
 static _zone_context_t _g_zcontext_ = {
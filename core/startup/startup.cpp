@@ -134,14 +134,23 @@ _err_t _EXPORT_ init(int argc, char *argv[]) {
 		}
 		// init log
 		iLog *pi_log = 0;
-		if(ei[2].p_entry &&
-				!(ei[2].p_entry->state & ST_INITIALIZED) &&
-				(pi_log = (iLog*)ei[2].p_entry->pi_base)) {
+		if(ei[2].p_entry && (pi_log = (iLog*)ei[2].p_entry->pi_base)) {
 			// log is here
-			if(pi_log->object_ctl(OCTL_INIT, _gpi_repo_)) {
+			if(!(ei[2].p_entry->state & ST_INITIALIZED) &&
+					pi_log->object_ctl(OCTL_INIT, _gpi_repo_)) {
 				ei[2].p_entry->state |= ST_INITIALIZED;
 				ei[2].p_entry->ref_cnt++;
 			}
+
+			// log options (the log can be initialized before arguments)
+			if(pi_args && (ei[2].p_entry->state & ST_INITIALIZED)) {
+				_str_t log_file = pi_args->value("log-file");
+
+				if(log_file)
+					pi_log->sink(log_file);
+				if(pi_args->check("log-async"))
+					pi_log->mode(LOG_ASYNC, (pi_args->check("log-drop")) ? LOG_DROP : LOG_BLOCK);
+			}
 		}
 
 		r = ERR_NONE;
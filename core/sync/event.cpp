@@ -1,12 +1,17 @@
-#include <unistd.h>
+#include <limits.h>
 #include <atomic>
 #include "iSync.h"
+#include "futex.h"
+
+// waiters of more than one event (wait_any)
+static _futex_wq_t _g_multi_wq_ = {{0}, {0}};
 
 class cEvent: public iEvent {
 private:
 	std::atomic<_evt_t> m_state;
+	_futex_wq_t	m_wq;
 public:
-	BASE(cEvent, "cEvent", RF_CLONE, 1,0,0);
+	BASE(cEvent, "cEvent", RF_CLONE, 2,0,0);
 
 	bool object_ctl(_u32 cmd, void *arg, ...) {
 		bool r = false;
@@ -14,6 +19,7 @@ public:
 		switch(cmd) {
 			case OCTL_INIT:
 				m_state = 0;
+				futex_wq_init(&m_wq);
 				r = true;
 				break;
 			case OCTL_UNINIT:
@@ -25,31 +31,50 @@ public:
 	}
 
 	_evt_t check(_evt_t mask) {
-		_evt_t state = m_state;
-		_evt_t r = state & ~mask;
+		_evt_t r = m_state.fetch_and(~mask);
 
-		r = m_state.exchange(r);
 		if(mask)
 			r &= mask;
 
 		return r;
 	}
 
-	_evt_t wait(_evt_t mask, _u32 sleep=0) {
+	_evt_t wait(_evt_t mask, _u32 timeout=0) {
 		_evt_t r = 0;
 
-		while(!(r = check(mask))) {
-			if(sleep)
-				usleep(sleep);
-		}
+		futex_wq_wait(&m_wq, timeout, [&]()->bool {
+			return ((r = check(mask)) != 0);
+		});
 
 		return r;
 	}
 
 	void set(_evt_t mask) {
-		_evt_t state = m_state;
-		_evt_t r = mask | state;
-		m_state.exchange(r);
+		m_state.fetch_or(mask);
+		futex_wq_notify(&m_wq, INT_MAX);
+		futex_wq_notify(&_g_multi_wq_, INT_MAX);
+	}
+
+	_s32 wait_any(iEvent *events[], _evt_t masks[], _u32 count,
+			_evt_t *p_evt, _u32 timeout=0) {
+		_s32 r = -1;
+
+		futex_wq_wait(&_g_multi_wq_, timeout, [&]()->bool {
+			for(_u32 i = 0; i < count; i++) {
+				_evt_t evt = events[i]->check(masks[i]);
+
+				if(evt) {
+					if(p_evt)
+						*p_evt = evt;
+					r = i;
+					break;
+				}
+			}
+
+			return (r >= 0);
+		});
+
+		return r;
 	}
 };
 
@@ -1,22 +1,49 @@
-#include <mutex>
+#include <assert.h>
 #include "iSync.h"
+#include "futex.h"
 
-#define GET_HANDLE() ((((_u64)m_hcount) << 32) | (_u32)(_u64)this)
-
+// Recursive by handle: the handle is unique for every (not recursive)
+// acquisition and works only in the owner thread.
 class cMutex:public iMutex {
 private:
-	std::mutex	m_mutex;
+	_futex_mutex_t	m_mutex;
+	_u64		m_owner; // thread ID
+	_u64		m_handle; // handle of current acquisition
+	_u64		m_hcount; // handle count
+	_u64		m_locks;
 	_u32		m_lcount; // lock count
-	_u32		m_hcount; // handle count
+
+	HMUTEX acquired(void) {
+		m_owner = futex_tid();
+		m_lcount = 1;
+		m_locks++;
+		// never 0, and different for different mutexes
+		m_handle = (((_u64)this) << 16) ^ ++m_hcount;
+		if(!m_handle)
+			m_handle = ++m_hcount;
+
+		return m_handle;
+	}
+
+	bool is_owner(HMUTEX h) {
+		// handle is written by owner only
+		return (h && __atomic_load_n(&m_owner, __ATOMIC_RELAXED) == futex_tid() &&
+			h == m_handle);
+	}
+
 public:
-	BASE(cMutex, "cMutex", RF_CLONE, 1, 0, 0);
+	BASE(cMutex, "cMutex", RF_CLONE, 2, 0, 0);
 
 	bool object_ctl(_u32 cmd, void *arg, ...) {
 		bool r = false;
 		switch(cmd) {
 			case OCTL_INIT:
-				m_lcount = 0;
+				futex_mutex_init(&m_mutex);
+				m_owner = 0;
+				m_handle = 0;
 				m_hcount = 0;
+				m_locks = 0;
+				m_lcount = 0;
 				r = true;
 				break;
 			case OCTL_UNINIT:
@@ -28,11 +55,9 @@ public:
 
 	HMUTEX lock(HMUTEX h) {
 		HMUTEX r = 0;
-		if(h != GET_HANDLE()) {
-			m_mutex.lock();
-			m_lcount = 1;
-			m_hcount++;
-			r = GET_HANDLE();
+		if(!is_owner(h)) {
+			futex_mutex_lock(&m_mutex);
+			r = acquired();
 		} else {
 			r = h;
 			m_lcount++;
@@ -42,12 +67,9 @@ public:
 
 	HMUTEX try_lock(HMUTEX h) {
 		HMUTEX r = 0;
-		if(h != GET_HANDLE()) {
-			if(m_mutex.try_lock()) {
-				m_lcount = 1;
-				m_hcount++;
-				r = GET_HANDLE();
-			}
+		if(!is_owner(h)) {
+			if(futex_mutex_try_lock(&m_mutex))
+				r = acquired();
 		} else {
 			r = h;
 			m_lcount++;
@@ -56,12 +78,27 @@ public:
 	}
 
 	void unlock(HMUTEX h) {
-		if(h == GET_HANDLE()) {
+		if(is_owner(h)) {
 			if(m_lcount)
 				m_lcount--;
-			if(!m_lcount)
-				m_mutex.unlock();
-		}
+			if(!m_lcount) {
+				__atomic_store_n(&m_owner, 0, __ATOMIC_RELAXED);
+				m_handle = 0;
+				futex_mutex_unlock(&m_mutex);
+			}
+		} else
+			// not owner or wrong handle
+			assert(false);
+	}
+
+	void stat(_lock_stat_t *p_stat) {
+		p_stat->locks = m_locks;
+		p_stat->contended = m_mutex.stat.contended.load(std::memory_order_relaxed);
+		p_stat->spins = m_mutex.stat.spins.load(std::memory_order_relaxed);
+		p_stat->wait_time = m_mutex.stat.wait_ns.load(std::memory_order_relaxed);
+		p_stat->owner = __atomic_load_n(&m_owner, __ATOMIC_RELAXED);
+		p_stat->readers = 0;
+		p_stat->max_readers = 0;
 	}
 };
 
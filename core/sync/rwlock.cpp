@@ -0,0 +1,115 @@
+#include <assert.h>
+#include "iSync.h"
+#include "futex.h"
+
+// Exclusive part is recursive by handle (like cMutex)
+class cRWLock:public iRWLock {
+private:
+	_futex_rwlock_t	m_lock;
+	_u64		m_owner; // thread ID of writer
+	_u64		m_handle; // handle of current exclusive acquisition
+	_u64		m_hcount; // handle count
+	_u64		m_locks;
+	_u32		m_lcount; // lock count
+
+	HMUTEX acquired(void) {
+		m_owner = futex_tid();
+		m_lcount = 1;
+		m_locks++;
+		m_handle = (((_u64)this) << 16) ^ ++m_hcount;
+		if(!m_handle)
+			m_handle = ++m_hcount;
+
+		return m_handle;
+	}
+
+	bool is_owner(HMUTEX h) {
+		// handle is written by owner only
+		return (h && __atomic_load_n(&m_owner, __ATOMIC_RELAXED) == futex_tid() &&
+			h == m_handle);
+	}
+
+public:
+	BASE(cRWLock, "cRWLock", RF_CLONE, 1, 0, 0);
+
+	bool object_ctl(_u32 cmd, void *arg, ...) {
+		bool r = false;
+		switch(cmd) {
+			case OCTL_INIT:
+				futex_rw_init(&m_lock);
+				m_owner = 0;
+				m_handle = 0;
+				m_hcount = 0;
+				m_locks = 0;
+				m_lcount = 0;
+				r = true;
+				break;
+			case OCTL_UNINIT:
+				r = true;
+				break;
+		}
+		return r;
+	}
+
+	HMUTEX lock(HMUTEX h) {
+		HMUTEX r = 0;
+		if(!is_owner(h)) {
+			futex_rw_wlock(&m_lock);
+			r = acquired();
+		} else {
+			r = h;
+			m_lcount++;
+		}
+		return r;
+	}
+
+	HMUTEX try_lock(HMUTEX h) {
+		HMUTEX r = 0;
+		if(!is_owner(h)) {
+			if(futex_rw_try_wlock(&m_lock))
+				r = acquired();
+		} else {
+			r = h;
+			m_lcount++;
+		}
+		return r;
+	}
+
+	void unlock(HMUTEX h) {
+		if(is_owner(h)) {
+			if(m_lcount)
+				m_lcount--;
+			if(!m_lcount) {
+				__atomic_store_n(&m_owner, 0, __ATOMIC_RELAXED);
+				m_handle = 0;
+				futex_rw_wunlock(&m_lock);
+			}
+		} else
+			// not owner or wrong handle
+			assert(false);
+	}
+
+	bool try_rlock(void) {
+		return futex_rw_try_rlock(&m_lock);
+	}
+
+	void rlock(void) {
+		futex_rw_rlock(&m_lock);
+	}
+
+	void runlock(void) {
+		futex_rw_runlock(&m_lock);
+	}
+
+	void stat(_lock_stat_t *p_stat) {
+		p_stat->locks = m_locks;
+		p_stat->contended = m_lock.stat.contended.load(std::memory_order_relaxed);
+		p_stat->spins = m_lock.stat.spins.load(std::memory_order_relaxed);
+		p_stat->wait_time = m_lock.stat.wait_ns.load(std::memory_order_relaxed);
+		p_stat->owner = __atomic_load_n(&m_owner, __ATOMIC_RELAXED);
+		p_stat->readers = m_lock.state.load(std::memory_order_relaxed) & FUTEX_RW_READERS;
+		p_stat->max_readers = m_lock.max_readers.load(std::memory_order_relaxed);
+	}
+};
+
+static cRWLock _g_object_;
@@ -0,0 +1,75 @@
+#include <string.h>
+#include "iMemory.h"
+#include "private.h"
+
+#define BMAP_TEST_BUFFERS	40
+
+static _u32 _g_bio_write_ = 0;
+
+static _u32 bmap_bio(_u8 op, void *buffer, _u32 size, void *udata) {
+	if(op == BIO_WRITE)
+		_g_bio_write_++;
+
+	return size;
+}
+
+// slab mode of buffer map (shares object cache with sharded pool)
+void test_bmap(iRepository *pi_repo) {
+	iBufferMap *pi_bmap = (iBufferMap *)pi_repo->object_by_iname(I_BUFFER_MAP, RF_CLONE);
+	HBUFFER hb[BMAP_TEST_BUFFERS];
+	_bmap_status_t st;
+	bool zero = true;
+
+	CHECK(pi_bmap);
+	if(!pi_bmap)
+		return;
+
+	pi_bmap->init(8192, bmap_bio, NULL, BMAP_SLAB|BMAP_ZERO);
+	CHECK(pi_bmap->size() == 8192);
+
+	for(_u32 i = 0; i < BMAP_TEST_BUFFERS; i++) {
+		_u8 *p = NULL;
+
+		CHECK((hb[i] = pi_bmap->alloc()));
+		if(hb[i] && (p = (_u8 *)pi_bmap->ptr(hb[i]))) {
+			CHECK(((_ulong)p & 4095) == 0);
+			memset(p, 0xaa, 8192);
+		}
+	}
+
+	pi_bmap->status(&st);
+	CHECK(st.b_busy == BMAP_TEST_BUFFERS);
+
+	pi_bmap->dirty(hb[0]);
+	pi_bmap->status(&st);
+	CHECK(st.b_dirty == 1 && st.b_busy == BMAP_TEST_BUFFERS - 1);
+
+	// dirty buffer is written on free, double free is ignored
+	pi_bmap->free(hb[0]);
+	pi_bmap->free(hb[0]);
+	CHECK(_g_bio_write_ == 1);
+	pi_bmap->free(hb[1]);
+	pi_bmap->status(&st);
+	CHECK(st.b_dirty == 0 && st.b_busy == BMAP_TEST_BUFFERS - 2);
+
+	// reused buffers are zeroed (BMAP_ZERO)
+	for(_u32 i = 0; i < 2; i++) {
+		_u8 *p = NULL;
+
+		if((hb[i] = pi_bmap->alloc()) && (p = (_u8 *)pi_bmap->ptr(hb[i]))) {
+			for(_u32 j = 0; j < 8192; j++)
+				zero &= (p[j] == 0);
+		} else
+			CHECK(false);
+	}
+	CHECK(zero);
+	CHECK(hb[0] != hb[1]);
+
+	for(_u32 i = 0; i < BMAP_TEST_BUFFERS; i++)
+		pi_bmap->free(hb[i]);
+	pi_bmap->status(&st);
+	CHECK(st.b_busy == 0 && st.b_free == st.b_all);
+
+	pi_bmap->uninit();
+	pi_repo->object_release(pi_bmap);
+}
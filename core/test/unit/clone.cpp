@@ -0,0 +1,58 @@
+#include <thread>
+#include <atomic>
+#include "iMemory.h"
+#include "private.h"
+
+#define CLONE_TEST_OBJECTS	200
+#define CLONE_TEST_THREADS	4
+
+// cloned objects from per class storage
+void test_clone(iRepository *pi_repo) {
+	iLlist *pi_list[CLONE_TEST_OBJECTS];
+	std::thread *p_thread[CLONE_TEST_THREADS];
+	std::atomic<_u32> failed(0);
+
+	for(_u32 i = 0; i < CLONE_TEST_OBJECTS; i++) {
+		// object is initialized
+		if((pi_list[i] = (iLlist *)pi_repo->object_by_iname(I_LLIST, RF_CLONE))) {
+			CHECK(pi_list[i]->init(LL_VECTOR, 1));
+			CHECK(pi_list[i]->add(&i, sizeof(i)));
+		} else
+			CHECK(false);
+	}
+
+	for(_u32 i = 0; i < CLONE_TEST_OBJECTS; i++) {
+		_u32 sz = 0;
+		_u32 *p = (_u32 *)pi_list[i]->get(0, &sz);
+
+		CHECK(p && *p == i && pi_list[i]->cnt() == 1);
+	}
+
+	// released context is recycled
+	iBase *pi_last = pi_list[CLONE_TEST_OBJECTS - 1];
+
+	for(_u32 i = 0; i < CLONE_TEST_OBJECTS; i++)
+		pi_repo->object_release(pi_list[i]);
+	CHECK((pi_list[0] = (iLlist *)pi_repo->object_by_iname(I_LLIST, RF_CLONE)) == pi_last);
+	pi_repo->object_release(pi_list[0]);
+
+	for(_u32 t = 0; t < CLONE_TEST_THREADS; t++) {
+		p_thread[t] = new std::thread([pi_repo, &failed]() {
+			for(_u32 n = 0; n < 10000; n++) {
+				iMap *pi_map = (iMap *)pi_repo->object_by_iname(I_MAP, RF_CLONE);
+
+				if(pi_map)
+					pi_repo->object_release(pi_map);
+				else
+					failed++;
+			}
+		});
+	}
+
+	for(_u32 t = 0; t < CLONE_TEST_THREADS; t++) {
+		p_thread[t]->join();
+		delete p_thread[t];
+	}
+
+	CHECK(failed.load() == 0);
+}
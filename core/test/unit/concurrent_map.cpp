@@ -0,0 +1,262 @@
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include "iMemory.h"
+#include "private.h"
+
+#define CM_TEST_KEYS		4096
+#define CM_TEST_SHARDS		4
+#define CM_TEST_WRITERS		2
+#define CM_TEST_READERS		4
+#define CM_TEST_OPS		200000
+#define CM_TEST_FILL		14
+#define CM_TEST_POISON		0xdd
+// retired blocks per shard before reclaim (CM_RECLAIM) + table
+#define CM_TEST_RETIRED		(64 + 1)
+
+typedef struct {
+	_u32	key;
+	_u32	ver;
+	_u32	fill[CM_TEST_FILL];
+}_cm_test_rec_t;
+
+// Forwards to the system heap, counts outstanding blocks and poisons
+// released memory, so a reader of reclaimed node sees broken record.
+class cCountHeap: public iHeap {
+	iHeap *mpi_heap;
+
+public:
+	std::atomic<_s64> blocks;
+	std::atomic<_s64> max_blocks;
+
+	cCountHeap(iHeap *pi_heap) {
+		mpi_heap = pi_heap;
+		blocks = max_blocks = 0;
+	}
+
+	OBJECT_INFO(cCountHeap, "cCountHeap", RF_CLONE, 1,0,0);
+
+	bool object_ctl(_u32 cmd, void *arg, ...) {
+		return true;
+	}
+
+	void *alloc(_u32 size) {
+		void *r = mpi_heap->alloc(size);
+
+		if(r) {
+			_s64 n = ++blocks;
+			_s64 m = max_blocks.load();
+
+			while(n > m && !max_blocks.compare_exchange_weak(m, n));
+		}
+
+		return r;
+	}
+
+	void free(void *ptr, _u32 size) {
+		memset(ptr, CM_TEST_POISON, size);
+		blocks--;
+		mpi_heap->free(ptr, size);
+	}
+
+	bool verify(void *ptr, _u32 size) {
+		return mpi_heap->verify(ptr, size);
+	}
+
+	void status(_heap_status_t *p_hs) {
+		mpi_heap->status(p_hs);
+	}
+};
+
+static void cm_rec_set(_cm_test_rec_t *p_rec, _u32 key, _u32 ver) {
+	p_rec->key = key;
+	p_rec->ver = ver;
+	for(_u32 i = 0; i < CM_TEST_FILL; i++)
+		p_rec->fill[i] = key ^ ver ^ i;
+}
+
+// record belongs to the key and is not torn or released
+static bool cm_rec_valid(void *data, _u32 sz, _u32 key) {
+	bool r = (data && sz == sizeof(_cm_test_rec_t));
+	_cm_test_rec_t *p_rec = (_cm_test_rec_t *)data;
+
+	if(r) {
+		r = (p_rec->key == key);
+		for(_u32 i = 0; r && i < CM_TEST_FILL; i++)
+			r = (p_rec->fill[i] == (key ^ p_rec->ver ^ i));
+	}
+
+	return r;
+}
+
+// readers see only whole records while writers replace and remove them
+static void test_concurrent_map_load(iConcurrentMap *pi_cmap) {
+	std::atomic<bool> stop(false);
+	std::atomic<_u32> bad(0);
+	std::atomic<_u64> found(0);
+	std::thread *writer[CM_TEST_WRITERS];
+	std::thread *reader[CM_TEST_READERS];
+
+	for(_u32 w = 0; w < CM_TEST_WRITERS; w++) {
+		writer[w] = new std::thread([pi_cmap, w]() {
+			_cm_test_rec_t rec;
+			_u32 seed = w + 1;
+
+			for(_u32 n = 0; n < CM_TEST_OPS; n++) {
+				seed = seed * 1103515245 + 12345;
+
+				_u32 key = (seed >> 8) % CM_TEST_KEYS;
+
+				cm_rec_set(&rec, key, n);
+				switch(n % 4) {
+					case 0:
+						pi_cmap->add(&key, sizeof(key), &rec, sizeof(rec));
+						break;
+					case 1:
+					case 2:
+						pi_cmap->set(&key, sizeof(key), &rec, sizeof(rec));
+						break;
+					case 3:
+						pi_cmap->del(&key, sizeof(key));
+						break;
+				}
+			}
+		});
+	}
+
+	for(_u32 r = 0; r < CM_TEST_READERS; r++) {
+		reader[r] = new std::thread([pi_cmap, r, &stop, &bad, &found]() {
+			_u32 keys[8];
+			_cmap_key_t batch[8];
+			_cm_test_rec_t rec;
+			_u32 seed = r + 100;
+			_u32 sz = 0;
+
+			while(!stop.load()) {
+				seed = seed * 1103515245 + 12345;
+
+				_u32 key = (seed >> 8) % CM_TEST_KEYS;
+
+				// pointer lookups inside read section
+				pi_cmap->read_lock();
+				for(_u32 i = 0; i < 8; i++) {
+					keys[i] = (key + i) % CM_TEST_KEYS;
+
+					void *data = pi_cmap->get(&keys[i], sizeof(_u32), &sz);
+
+					if(data) {
+						found++;
+						if(!cm_rec_valid(data, sz, keys[i]))
+							bad++;
+					}
+
+					batch[i].key = &keys[i];
+					batch[i].sz_key = sizeof(_u32);
+				}
+
+				pi_cmap->get_batch(batch, 8);
+				for(_u32 i = 0; i < 8; i++) {
+					if(batch[i].data && !cm_rec_valid(batch[i].data, batch[i].sz_data, keys[i]))
+						bad++;
+				}
+				pi_cmap->read_unlock();
+
+				// copy out of read section
+				sz = sizeof(rec);
+				if(pi_cmap->copy(&key, sizeof(key), &rec, &sz) && !cm_rec_valid(&rec, sz, key))
+					bad++;
+			}
+		});
+	}
+
+	for(_u32 w = 0; w < CM_TEST_WRITERS; w++) {
+		writer[w]->join();
+		delete writer[w];
+	}
+
+	stop = true;
+	for(_u32 r = 0; r < CM_TEST_READERS; r++) {
+		reader[r]->join();
+		delete reader[r];
+	}
+
+	CHECK(bad.load() == 0);
+	CHECK(found.load() > 0);
+}
+
+void test_concurrent_map(iRepository *pi_repo) {
+	iHeap *pi_heap = (iHeap *)pi_repo->object_by_iname(I_HEAP, RF_ORIGINAL);
+	iConcurrentMap *pi_cmap = (iConcurrentMap *)pi_repo->object_by_iname(I_CONCURRENT_MAP, RF_CLONE);
+	_cm_test_rec_t rec;
+	_u32 sz = 0;
+
+	CHECK(pi_heap && pi_cmap);
+	if(!pi_heap || !pi_cmap)
+		return;
+
+	cCountHeap heap(pi_heap);
+
+	CHECK(pi_cmap->init(CM_TEST_KEYS / 8, CM_TEST_SHARDS, &heap));
+
+	// add/set/copy/del round trip
+	_u32 key = 7;
+
+	cm_rec_set(&rec, key, 1);
+	CHECK(pi_cmap->add(&key, sizeof(key), &rec, sizeof(rec)));
+	cm_rec_set(&rec, key, 2);
+	CHECK(!pi_cmap->add(&key, sizeof(key), &rec, sizeof(rec)));
+	CHECK(pi_cmap->set(&key, sizeof(key), &rec, sizeof(rec)));
+	memset(&rec, 0, sizeof(rec));
+	sz = sizeof(rec);
+	CHECK(pi_cmap->copy(&key, sizeof(key), &rec, &sz) && cm_rec_valid(&rec, sz, key) && rec.ver == 2);
+	pi_cmap->del(&key, sizeof(key));
+	CHECK(!pi_cmap->get(&key, sizeof(key), &sz));
+	CHECK(pi_cmap->cnt() == 0);
+
+	// pinned reader keeps replaced record alive
+	cm_rec_set(&rec, key, 1);
+	pi_cmap->set(&key, sizeof(key), &rec, sizeof(rec));
+	pi_cmap->read_lock();
+
+	void *pinned = pi_cmap->get(&key, sizeof(key), &sz);
+	_s64 blocks = heap.blocks.load();
+
+	for(_u32 i = 2; i < CM_TEST_SHARDS * CM_TEST_RETIRED * 4; i++) {
+		cm_rec_set(&rec, key, i);
+		pi_cmap->set(&key, sizeof(key), &rec, sizeof(rec));
+	}
+	CHECK(cm_rec_valid(pinned, sz, key) && ((_cm_test_rec_t *)pinned)->ver == 1);
+	CHECK(heap.blocks.load() > blocks + CM_TEST_RETIRED);
+	pi_cmap->read_unlock();
+
+	// ... and released after reader leaves (replaced records in every shard)
+	for(_u32 i = 0; i < CM_TEST_SHARDS * CM_TEST_RETIRED * 2; i++) {
+		key = i % (CM_TEST_SHARDS * 8);
+		cm_rec_set(&rec, key, i);
+		pi_cmap->set(&key, sizeof(key), &rec, sizeof(rec));
+	}
+	CHECK(heap.blocks.load() <= (_s64)pi_cmap->cnt() + CM_TEST_SHARDS * CM_TEST_RETIRED + 1);
+	pi_cmap->clr();
+	CHECK(pi_cmap->cnt() == 0);
+
+	// readers during writes and deletes, memory stays bounded
+	heap.max_blocks = heap.blocks.load();
+	test_concurrent_map_load(pi_cmap);
+	CHECK(heap.max_blocks.load() < CM_TEST_KEYS * 2 + CM_TEST_SHARDS * CM_TEST_RETIRED * 2);
+
+	// every record is valid after load
+	_u32 valid = 0;
+
+	for(_u32 i = 0; i < CM_TEST_KEYS; i++) {
+		void *data = pi_cmap->get(&i, sizeof(i), &sz);
+
+		if(data && cm_rec_valid(data, sz, i))
+			valid++;
+	}
+	CHECK(valid == pi_cmap->cnt());
+
+	// all memory returns to heap
+	pi_repo->object_release(pi_cmap);
+	CHECK(heap.blocks.load() == 0);
+	pi_repo->object_release(pi_heap);
+}
@@ -0,0 +1,75 @@
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "iGatn.h"
+#include "private.h"
+
+#define DOC_PORT	18768
+#define DOC_ROOT	"/tmp/unit-doc-root"
+#define DOC_CONTENT	"static document\n"
+
+static _u32 count(_cstr_t str, _cstr_t sub) {
+	_u32 r = 0;
+
+	while((str = strstr(str, sub))) {
+		str += strlen(sub);
+		r++;
+	}
+
+	return r;
+}
+
+void test_document(iRepository *pi_repo) {
+	iGatn *pi_gatn = NULL;
+	_server_t *p_srv = NULL;
+	FILE *pf = NULL;
+
+	mkdir(DOC_ROOT, 0755);
+	if((pf = fopen(DOC_ROOT "/doc.txt", "w"))) {
+		fputs(DOC_CONTENT, pf);
+		fclose(pf);
+	}
+
+	pi_repo->extension_load("extht.so");
+	pi_repo->extension_load("extfs.so");
+	pi_repo->extension_load("extnet.so");
+	pi_repo->extension_load("extgatn.so");
+	CHECK((pi_gatn = (iGatn *)pi_repo->object_by_iname(I_GATN, RF_ORIGINAL)));
+	if(!pi_gatn)
+		return;
+
+	CHECK((p_srv = pi_gatn->create_server("document-test", DOC_PORT, DOC_ROOT, "/tmp",
+					NULL, NULL, 8192, 2, 16, 10)));
+	if(p_srv) {
+		for(_u32 i = 0; i < 100 && !p_srv->is_running(); i++) {
+			usleep(10000);
+			p_srv->start();
+		}
+
+		_char_t buffer[2048];
+		_char_t cl[64];
+
+		snprintf(cl, sizeof(cl), "Content-Length: %u\r\n", (_u32)strlen(DOC_CONTENT));
+
+		// first response prepares header block, second one uses it
+		for(_u32 i = 0; i < 2; i++) {
+			CHECK(http_get(DOC_PORT, "/doc.txt", buffer, sizeof(buffer)) == HTTPRC_OK);
+			CHECK(strcmp(http_body(buffer), DOC_CONTENT) == 0);
+			CHECK(count(buffer, "Content-Length:") == 1);
+			CHECK(strstr(buffer, cl));
+			CHECK(count(buffer, "Date: ") == 1);
+			CHECK(count(buffer, "Server: industrial-gatn [document-test]") == 1);
+			CHECK(strstr(buffer, "Last-Modified: "));
+		}
+
+		CHECK(http_get(DOC_PORT, "/missing.txt", buffer, sizeof(buffer)) == HTTPRC_NOT_FOUND);
+		CHECK(count(buffer, "Server: industrial-gatn [document-test]") == 1);
+
+		pi_gatn->remove_server(p_srv);
+	}
+
+	pi_repo->object_release(pi_gatn);
+	unlink(DOC_ROOT "/doc.txt");
+	rmdir(DOC_ROOT);
+}
@@ -0,0 +1,58 @@
+#include <thread>
+#include <unistd.h>
+#include "iSync.h"
+#include "private.h"
+
+void test_event(iRepository *pi_repo) {
+	iEvent *pi_evt[2] = {
+		(iEvent *)pi_repo->object_by_iname(I_EVENT, RF_CLONE),
+		(iEvent *)pi_repo->object_by_iname(I_EVENT, RF_CLONE)
+	};
+	_evt_t masks[2] = {0x0f, 0xf0};
+	_evt_t evt = 0;
+	_u64 t = 0;
+
+	CHECK(pi_evt[0] && pi_evt[1]);
+	if(!pi_evt[0] || !pi_evt[1])
+		return;
+
+	// only bits of mask are returned and cleared
+	pi_evt[0]->set(0x11);
+	CHECK(pi_evt[0]->check(0) == 0x11);
+	CHECK(pi_evt[0]->check(0x01) == 0x01);
+	CHECK(pi_evt[0]->check(0x0f) == 0);
+	CHECK(pi_evt[0]->wait(0x10, 10) == 0x10);
+
+	// timeout
+	t = time_ms();
+	CHECK(pi_evt[0]->wait(0xff, 50) == 0);
+	t = time_ms() - t;
+	CHECK(t >= 45 && t < 1000);
+
+	// waiter is woken by other thread
+	std::thread ts([pi_evt]() {
+		usleep(20000);
+		pi_evt[0]->set(0x04);
+	});
+	t = time_ms();
+	CHECK(pi_evt[0]->wait(0x0c) == 0x04);
+	CHECK(time_ms() - t < 1000);
+	ts.join();
+
+	// any of events, by separate masks
+	CHECK(pi_evt[0]->wait_any(pi_evt, masks, 2, &evt, 10) == -1);
+	pi_evt[1]->set(0x0f); // not in mask of second event
+	CHECK(pi_evt[0]->wait_any(pi_evt, masks, 2, &evt, 10) == -1);
+
+	std::thread ta([pi_evt]() {
+		usleep(20000);
+		pi_evt[1]->set(0x20);
+	});
+	CHECK(pi_evt[0]->wait_any(pi_evt, masks, 2, &evt, 5000) == 1);
+	CHECK(evt == 0x20);
+	ta.join();
+	CHECK(pi_evt[1]->check(0) == 0x0f);
+
+	pi_repo->object_release(pi_evt[0]);
+	pi_repo->object_release(pi_evt[1]);
+}
@@ -0,0 +1,39 @@
+#include <string.h>
+#include <atomic>
+#include "private.h"
+
+typedef struct {
+	std::atomic<_u32>	reported;
+	std::atomic<_u32>	initialized;
+}_ext_report_t;
+
+// parallel initialization of extension list
+void test_extension(iRepository *pi_repo) {
+	_ext_load_t list[] = {
+		{ "extcmd.so",		"unit-cmd",	ERR_NONE, 0 },
+		{ "extnetcmd.so",	"unit-netcmd",	ERR_NONE, 0 },
+		{ "missing.so",		"unit-missing",	ERR_NONE, 0 }
+	};
+	_ext_report_t report;
+
+	report.reported = 0;
+	report.initialized = 0;
+
+	CHECK(pi_repo->extension_load_list(list, 3, EXT_PARALLEL,
+		[](_cstr_t alias, _cstr_t cname, _u32 init_time, _cstat_t state, void *udata) {
+			_ext_report_t *pr = (_ext_report_t *)udata;
+
+			pr->reported++;
+			if(state & ST_INITIALIZED)
+				pr->initialized++;
+		}, &report) != ERR_NONE);
+
+	CHECK(list[0].err == ERR_NONE);
+	CHECK(list[1].err == ERR_NONE);
+	CHECK(list[2].err != ERR_NONE);
+	CHECK(report.reported.load() > 0);
+	CHECK(report.initialized.load() == report.reported.load());
+
+	pi_repo->extension_unload("unit-netcmd");
+	pi_repo->extension_unload("unit-cmd");
+}
@@ -0,0 +1,155 @@
+#include <string.h>
+#include <stdlib.h>
+#include "iMemory.h"
+#include "oa_alg.h"
+#include "private.h"
+
+#define FM_TEST_RECORDS	20000
+#define FM_TEST_LIVE	100
+#define FM_TEST_CHURN	100000
+
+static _u32 fm_key(_char_t *key, _u32 sz, _u32 n) {
+	return snprintf(key, sz, "key-%u", n);
+}
+
+// every key in [first, last) is found with its data, 'gone' ones are not
+static bool fm_verify(iMap *pi_map, _u32 first, _u32 last, _u32 gone_first, _u32 gone_last) {
+	bool r = true;
+	_char_t key[32];
+	_u32 sz = 0;
+
+	for(_u32 i = first; r && i < last; i++) {
+		_u32 *p = (_u32 *)pi_map->get(key, fm_key(key, sizeof(key), i), &sz);
+
+		r = (p && sz == sizeof(_u32) && *p == i);
+	}
+	for(_u32 i = gone_first; r && i < gone_last; i++)
+		r = (pi_map->get(key, fm_key(key, sizeof(key), i), &sz) == NULL);
+
+	return r;
+}
+
+// SSE2 and portable probes of control groups give the same masks
+static void test_fast_map_probe(void) {
+	_u8 ctrl[OA_GROUP];
+	bool match = true;
+
+	srand(1);
+	for(_u32 n = 0; n < 10000; n++) {
+		for(_u32 i = 0; i < OA_GROUP; i++) {
+			_u32 x = rand() % 4;
+
+			ctrl[i] = (x == 0) ? OA_EMPTY : (x == 1) ? OA_DELETED : (_u8)(rand() & 0x7f);
+		}
+
+		_u8 v = (n & 1) ? ctrl[n % OA_GROUP] : (_u8)(rand() & 0x7f);
+
+		match &= (oa_group_match(ctrl, v) == oa_group_match_c(ctrl, v));
+		match &= (oa_group_match(ctrl, OA_EMPTY) == oa_group_match_c(ctrl, OA_EMPTY));
+		match &= (oa_group_free(ctrl) == oa_group_free_c(ctrl));
+	}
+
+	CHECK(match);
+}
+
+void test_fast_map(iRepository *pi_repo) {
+	iMap *pi_map = (iMap *)pi_repo->object_by_cname(CLASS_NAME_FAST_MAP, RF_CLONE);
+	_map_status_t st;
+	_char_t key[32];
+	_u32 sz = 0;
+	_u32 capacity = 0;
+	_u32 *p_first = NULL;
+	bool ok = true;
+
+	test_fast_map_probe();
+
+	CHECK(pi_map);
+	if(!pi_map)
+		return;
+
+	CHECK(pi_map->init(0));
+
+	// add/set/get/del round trip
+	_u32 v = 1, *p = NULL;
+
+	CHECK((p = (_u32 *)pi_map->add("one", 3, &v, sizeof(v))) && *p == 1);
+	v = 2;
+	CHECK(pi_map->add("one", 3, &v, sizeof(v)) == p && *p == 1);
+	CHECK((p = (_u32 *)pi_map->set("one", 3, &v, sizeof(v))) && *p == 2);
+	CHECK((p = (_u32 *)pi_map->get("one", 3, &sz)) && *p == 2 && sz == sizeof(v));
+	CHECK(pi_map->get("on", 2, &sz) == NULL);
+	pi_map->del("one", 3);
+	CHECK(pi_map->get("one", 3, &sz) == NULL);
+	CHECK(pi_map->cnt() == 0);
+
+	// grow past several doublings, check every key as soon as the table is replaced
+	// (records are still in old table) and in the middle of migration
+	pi_map->status(&st);
+	capacity = st.capacity;
+	for(_u32 i = 0; i < FM_TEST_RECORDS; i++) {
+		_u32 *p_rec = (_u32 *)pi_map->add(key, fm_key(key, sizeof(key), i), &i, sizeof(i));
+
+		if(!p_first)
+			p_first = p_rec;
+
+		pi_map->status(&st);
+		if(st.capacity != capacity) {
+			capacity = st.capacity;
+			ok &= fm_verify(pi_map, 0, i + 1, i + 1, i + 2);
+		} else if(capacity >= 1024 && (i % 64) == 0)
+			ok &= fm_verify(pi_map, 0, i + 1, 0, 0);
+	}
+	CHECK(ok);
+	CHECK(pi_map->cnt() == FM_TEST_RECORDS);
+	CHECK(capacity >= FM_TEST_RECORDS && capacity <= FM_TEST_RECORDS * 4);
+	// record data does not move
+	CHECK(p_first && *p_first == 0);
+
+	// enumeration sees every record once
+	_map_enum_t me = pi_map->enum_open();
+	_u32 n = 0;
+
+	if(me) {
+		for(void *d = pi_map->enum_first(me, &sz); d; d = pi_map->enum_next(me, &sz))
+			n++;
+		pi_map->enum_close(me);
+	}
+	CHECK(n == FM_TEST_RECORDS);
+
+	// delete down past shrink threshold, deleted keys disappear during migration
+	ok = true;
+	for(_u32 i = 0; i < FM_TEST_RECORDS - FM_TEST_LIVE; i++) {
+		pi_map->del(key, fm_key(key, sizeof(key), i));
+
+		pi_map->status(&st);
+		if(st.capacity != capacity) {
+			capacity = st.capacity;
+			ok &= fm_verify(pi_map, i + 1, FM_TEST_RECORDS, 0, i + 1);
+		} else if((i % 512) == 0)
+			ok &= fm_verify(pi_map, i + 1, FM_TEST_RECORDS, i - (i > 64 ? 64 : i), i + 1);
+	}
+	CHECK(ok);
+	CHECK(pi_map->cnt() == FM_TEST_LIVE);
+	CHECK(fm_verify(pi_map, FM_TEST_RECORDS - FM_TEST_LIVE, FM_TEST_RECORDS, 0, FM_TEST_RECORDS - FM_TEST_LIVE));
+	pi_map->status(&st);
+	CHECK(st.capacity < 1024);
+
+	// deleted slots are reused, table does not grow with constant number of records
+	for(_u32 i = FM_TEST_RECORDS; i < FM_TEST_RECORDS + FM_TEST_CHURN; i++) {
+		_u32 old = i - FM_TEST_LIVE;
+
+		pi_map->add(key, fm_key(key, sizeof(key), i), &i, sizeof(i));
+		pi_map->del(key, fm_key(key, sizeof(key), old));
+	}
+	pi_map->status(&st);
+	CHECK(pi_map->cnt() == FM_TEST_LIVE);
+	CHECK(st.capacity < 1024);
+	CHECK(fm_verify(pi_map, FM_TEST_RECORDS + FM_TEST_CHURN - FM_TEST_LIVE, FM_TEST_RECORDS + FM_TEST_CHURN,
+			FM_TEST_RECORDS, FM_TEST_RECORDS + FM_TEST_CHURN - FM_TEST_LIVE));
+
+	pi_map->clr();
+	CHECK(pi_map->cnt() == 0);
+	CHECK(fm_verify(pi_map, 0, 0, FM_TEST_RECORDS, FM_TEST_RECORDS + FM_TEST_CHURN));
+
+	pi_repo->object_release(pi_map);
+}
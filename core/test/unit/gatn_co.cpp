@@ -0,0 +1,128 @@
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "private.h"
+#include "gatn_co.h"
+
+#define CO_PORT		18767
+#define CO_CLIENTS	8
+
+#if defined(__cpp_impl_coroutine)
+static std::atomic<_response_t *> _g_lost_(NULL);
+
+static void *co_sleep(void *arg) {
+	usleep(300000);
+	return arg;
+}
+
+// two blocking calls, the HTTP worker is released by the first one
+static _gatn_co_t co_on_slow(_u8 evt, _request_t *req, _response_t *res, void *udata) {
+	if(evt == HTTP_ON_REQUEST) {
+		void *a = co_await gatn_co_call(co_sleep, (void *)"a");
+		void *b = co_await gatn_co_call(co_sleep, (void *)"b");
+
+		res->_end(HTTPRC_OK, "%s%s", (_cstr_t)a, (_cstr_t)b);
+	}
+}
+
+// suspended, but not resumed by handler
+static void co_on_lost(_u8 evt, _request_t *req, _response_t *res, void *udata) {
+	if(evt == HTTP_ON_REQUEST && res->suspend())
+		_g_lost_ = res;
+}
+
+static void co_complete_lost(void) {
+	_response_t *res = _g_lost_.exchange(NULL);
+
+	if(res) {
+		res->end(HTTPRC_OK, "late");
+		res->resume();
+	}
+}
+
+void test_gatn_co(iRepository *pi_repo) {
+	iGatn *pi_gatn = NULL;
+	_server_t *p_srv = NULL;
+
+	pi_repo->extension_load("extht.so");
+	pi_repo->extension_load("extfs.so");
+	pi_repo->extension_load("extnet.so");
+	pi_repo->extension_load("extgatn.so");
+	CHECK((pi_gatn = (iGatn *)pi_repo->object_by_iname(I_GATN, RF_ORIGINAL)));
+	if(!pi_gatn)
+		return;
+
+	// two workers, suspended connections expire after 2 seconds
+	CHECK((p_srv = pi_gatn->create_server("co-test", CO_PORT, "/tmp", "/tmp",
+					NULL, NULL, 8192, 2, 64, 2)));
+	if(p_srv) {
+		for(_u32 i = 0; i < 100 && !p_srv->is_running(); i++) {
+			usleep(10000);
+			p_srv->start();
+		}
+
+		p_srv->on_route(HTTP_METHOD_GET, "/slow", gatn_co_route<co_on_slow>);
+		p_srv->on_route(HTTP_METHOD_GET, "/lost", co_on_lost);
+
+		// more clients than workers
+		_u16 rc[CO_CLIENTS];
+		_char_t res[CO_CLIENTS][1024];
+		std::thread *clients[CO_CLIENTS];
+		_u64 t = time_ms();
+
+		for(_u32 i = 0; i < CO_CLIENTS; i++) {
+			clients[i] = new std::thread([i, &rc, &res]() {
+				rc[i] = http_get(CO_PORT, "/slow", res[i], sizeof(res[i]));
+			});
+		}
+
+		for(_u32 i = 0; i < CO_CLIENTS; i++) {
+			clients[i]->join();
+			delete clients[i];
+			CHECK(rc[i] == HTTPRC_OK);
+			CHECK(strcmp(http_body(res[i]), "ab") == 0);
+		}
+		CHECK(time_ms() - t < 1500);
+
+		// client of handler that doesn't resume is disconnected after deadline
+		_char_t buffer[1024];
+
+		t = time_ms();
+		CHECK(http_get(CO_PORT, "/lost", buffer, sizeof(buffer)) == 0);
+		t = time_ms() - t;
+		CHECK(t >= 2000 && t < 5000);
+
+		// late resume releases the connection
+		CHECK(_g_lost_.load() != NULL);
+		co_complete_lost();
+		CHECK(http_get(CO_PORT, "/slow", buffer, sizeof(buffer)) == HTTPRC_OK);
+
+		// stop waits for suspended handler
+		std::thread lost([&buffer]() {
+			http_get(CO_PORT, "/lost", buffer, sizeof(buffer));
+		});
+
+		for(_u32 i = 0; i < 100 && !_g_lost_.load(); i++)
+			usleep(10000);
+		CHECK(_g_lost_.load() != NULL);
+
+		std::thread late([]() {
+			usleep(300000);
+			co_complete_lost();
+		});
+
+		t = time_ms();
+		pi_gatn->remove_server(p_srv);
+		CHECK(time_ms() - t >= 250);
+		late.join();
+		lost.join();
+	}
+
+	pi_repo->object_release(pi_gatn);
+}
+#else
+void test_gatn_co(iRepository *pi_repo) {
+	printf("\tC++20 coroutines are not supported\n");
+}
+#endif
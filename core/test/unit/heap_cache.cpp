@@ -0,0 +1,211 @@
+#include <string.h>
+#include <stdlib.h>
+#include <set>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include "iMemory.h"
+#include "heap_cache.h"
+#include "private.h"
+
+#define HC_TEST_OBJECTS		100
+#define HC_TEST_CROSS		10000
+#define HC_TEST_THREADS		4
+#define HC_TEST_ROUNDS		2000
+
+// heap behind magazines, every object is known
+typedef struct {
+	std::mutex		mutex;
+	std::set<void *>	out; // objects taken from heap
+	_u32			refill;
+	_u32			flush;
+	_u32			bad; // foreign or double free
+}_hc_test_heap_t;
+
+static _u32 hc_test_alloc(_u32 size, void **ptrs, _u32 n, void *udata) {
+	_hc_test_heap_t *p = (_hc_test_heap_t *)udata;
+	std::lock_guard<std::mutex> lock(p->mutex);
+
+	for(_u32 i = 0; i < n; i++) {
+		ptrs[i] = malloc(size);
+		p->out.insert(ptrs[i]);
+	}
+	p->refill++;
+
+	return n;
+}
+
+static void hc_test_free(_u32 size, void **ptrs, _u32 n, void *udata) {
+	_hc_test_heap_t *p = (_hc_test_heap_t *)udata;
+	std::lock_guard<std::mutex> lock(p->mutex);
+
+	for(_u32 i = 0; i < n; i++) {
+		if(p->out.erase(ptrs[i]))
+			free(ptrs[i]);
+		else
+			p->bad++;
+	}
+	p->flush++;
+}
+
+static _u32 hc_test_out(_hc_test_heap_t *p) {
+	std::lock_guard<std::mutex> lock(p->mutex);
+
+	return p->out.size();
+}
+
+// refill and flush of magazines of one thread
+static void test_heap_cache_thread(heap_cache *p_cache, _hc_test_heap_t *p_heap) {
+	void *ptr[HC_TEST_OBJECTS];
+	_hc_status_t hcs;
+
+	for(_u32 i = 0; i < HC_TEST_OBJECTS; i++)
+		memset((ptr[i] = p_cache->alloc(64)), 0xaa, 64);
+	p_cache->status(&hcs);
+	CHECK(hcs.alloc == HC_TEST_OBJECTS);
+	CHECK(hcs.refill == (HC_TEST_OBJECTS + HC_BATCH - 1) / HC_BATCH);
+	CHECK(hc_test_out(p_heap) == HC_TEST_OBJECTS + hcs.objects);
+
+	for(_u32 i = 0; i < HC_TEST_OBJECTS; i++)
+		CHECK(p_cache->free(ptr[i], 64));
+	p_cache->status(&hcs);
+	CHECK(hcs.free == HC_TEST_OBJECTS);
+	CHECK(hcs.objects > 0 && hcs.objects <= HC_MAG_SIZE);
+	CHECK(hcs.flush > 0);
+	CHECK(hc_test_out(p_heap) == hcs.objects);
+
+	// the last freed object is the next one allocated (same size class)
+	void *p = p_cache->alloc(40);
+
+	CHECK(p == ptr[HC_TEST_OBJECTS - 1]);
+	p_cache->free(p, 33);
+
+	// sizes out of classes are not cached
+	CHECK(p_cache->alloc(0) == NULL);
+	CHECK(p_cache->alloc(HC_MAX_SIZE + 1) == NULL);
+	CHECK(!p_cache->free(p, HC_MAX_SIZE + 1));
+
+	p_cache->flush();
+	p_cache->status(&hcs);
+	CHECK(hcs.objects == 0);
+	CHECK(hc_test_out(p_heap) == 0);
+}
+
+// objects are freed by other threads, magazines return to heap at thread exit
+static void test_heap_cache_cross(heap_cache *p_cache, _hc_test_heap_t *p_heap) {
+	std::vector<void *> objects;
+	std::mutex mutex;
+	_hc_status_t hcs;
+
+	std::thread producer([p_cache, &objects]() {
+		for(_u32 i = 0; i < HC_TEST_CROSS; i++)
+			objects.push_back(p_cache->alloc(16 << (i % HC_CLASSES)));
+	});
+	producer.join();
+	CHECK(hc_test_out(p_heap) >= HC_TEST_CROSS);
+
+	std::thread consumer([p_cache, &objects]() {
+		for(_u32 i = 0; i < HC_TEST_CROSS; i++)
+			p_cache->free(objects[i], 16 << (i % HC_CLASSES));
+	});
+	consumer.join();
+	objects.clear();
+
+	p_cache->status(&hcs);
+	CHECK(hcs.threads == 1 && hcs.objects == 0);
+	CHECK(hc_test_out(p_heap) == 0);
+
+	// all threads allocate and free objects of each other
+	std::thread *pt[HC_TEST_THREADS];
+
+	for(_u32 t = 0; t < HC_TEST_THREADS; t++) {
+		pt[t] = new std::thread([p_cache, t, &objects, &mutex]() {
+			for(_u32 n = 0; n < HC_TEST_ROUNDS; n++) {
+				_u32 size = 16 << ((t + n) % HC_CLASSES);
+				void *p = p_cache->alloc(size);
+				void *q = NULL;
+
+				*(_u32 *)p = size;
+				mutex.lock();
+				objects.push_back(p);
+				if(objects.size() > HC_TEST_THREADS * 8) {
+					q = objects[n % objects.size()];
+					objects[n % objects.size()] = objects.back();
+					objects.pop_back();
+				}
+				mutex.unlock();
+
+				if(q)
+					p_cache->free(q, *(_u32 *)q);
+			}
+		});
+	}
+	for(_u32 t = 0; t < HC_TEST_THREADS; t++) {
+		pt[t]->join();
+		delete pt[t];
+	}
+
+	for(void *p : objects)
+		p_cache->free(p, *(_u32 *)p);
+	objects.clear();
+	p_cache->flush();
+	CHECK(hc_test_out(p_heap) == 0);
+}
+
+// magazines in front of system heap
+static void test_heap_cache_zone(iRepository *pi_repo) {
+	iHeap *pi_heap = (iHeap *)pi_repo->object_by_cname("cZoneHeap", RF_CLONE);
+	std::vector<void *> objects;
+	_heap_status_t hs;
+	bool ok = true;
+
+	CHECK(pi_heap);
+	if(!pi_heap)
+		return;
+
+	// counters of thread are gone with its magazines
+	std::thread producer([pi_heap, &objects, &ok, &hs]() {
+		for(_u32 i = 0; i < HC_TEST_CROSS; i++) {
+			void *p = pi_heap->alloc(24);
+
+			memset(p, 0x55, 24);
+			objects.push_back(p);
+		}
+		for(void *p : objects)
+			ok &= pi_heap->verify(p, 24);
+		pi_heap->status(&hs);
+	});
+	producer.join();
+	CHECK(ok);
+	CHECK(hs.chits >= HC_TEST_CROSS);
+	CHECK(hs.crefill >= HC_TEST_CROSS / HC_BATCH);
+
+	std::thread consumer([pi_heap, &objects, &hs]() {
+		for(void *p : objects)
+			pi_heap->free(p, 24);
+		pi_heap->status(&hs);
+	});
+	consumer.join();
+	CHECK(hs.cflush >= (HC_TEST_CROSS - HC_MAG_SIZE) / HC_BATCH);
+	CHECK(hs.cobj <= HC_MAG_SIZE);
+
+	pi_heap->status(&hs);
+	CHECK(hs.cobj == 0 && hs.cthreads == 0);
+
+	pi_repo->object_release(pi_heap);
+}
+
+void test_heap_cache(iRepository *pi_repo) {
+	_hc_test_heap_t heap;
+	heap_cache cache;
+
+	heap.refill = heap.flush = heap.bad = 0;
+	cache.init(hc_test_alloc, hc_test_free, &heap);
+
+	test_heap_cache_thread(&cache, &heap);
+	test_heap_cache_cross(&cache, &heap);
+	CHECK(heap.bad == 0);
+
+	cache.destroy();
+	test_heap_cache_zone(pi_repo);
+}
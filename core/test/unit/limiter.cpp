@@ -0,0 +1,63 @@
+#include <string.h>
+#include <unistd.h>
+#include "iGatn.h"
+#include "private.h"
+
+#define LIM_PORT	18767
+
+static void lim_on_index(_u8 evt, _request_t *req, _response_t *res, void *udata) {
+	if(evt == HTTP_ON_REQUEST)
+		res->end(HTTPRC_OK, "ok");
+}
+
+void test_limiter(iRepository *pi_repo) {
+	iGatn *pi_gatn = NULL;
+	_server_t *p_srv = NULL;
+
+	pi_repo->extension_load("extht.so");
+	pi_repo->extension_load("extfs.so");
+	pi_repo->extension_load("extnet.so");
+	pi_repo->extension_load("extgatn.so");
+	CHECK((pi_gatn = (iGatn *)pi_repo->object_by_iname(I_GATN, RF_ORIGINAL)));
+	if(!pi_gatn)
+		return;
+
+	// two connections at most
+	CHECK((p_srv = pi_gatn->create_server("limiter-test", LIM_PORT, "/tmp", "/tmp",
+					NULL, NULL, 8192, 2, 2, 10)));
+	if(p_srv) {
+		for(_u32 i = 0; i < 100 && !p_srv->is_running(); i++) {
+			usleep(10000);
+			p_srv->start();
+		}
+
+		_char_t buffer[1024];
+
+		p_srv->on_route(HTTP_METHOD_GET, "/index", lim_on_index);
+
+		// released connections must not count against the limit
+		for(_u32 i = 0; i < 8; i++)
+			CHECK(http_get(LIM_PORT, "/index", buffer, sizeof(buffer)) == HTTPRC_OK);
+
+		// two idle connections fill the server
+		int s1 = tcp_connect(LIM_PORT);
+		int s2 = tcp_connect(LIM_PORT);
+
+		usleep(100000);
+		CHECK(http_get(LIM_PORT, "/index", buffer, sizeof(buffer)) == HTTPRC_SERVICE_UNAVAILABLE);
+		close(s1);
+		close(s2);
+		usleep(300000);
+		CHECK(http_get(LIM_PORT, "/index", buffer, sizeof(buffer)) == HTTPRC_OK);
+
+		// 1 req/s, burst 2 for 127.0.0.1
+		CHECK(p_srv->limit_route("/index", 1, 2));
+		CHECK(http_get(LIM_PORT, "/index", buffer, sizeof(buffer)) == HTTPRC_OK);
+		CHECK(http_get(LIM_PORT, "/index", buffer, sizeof(buffer)) == HTTPRC_OK);
+		CHECK(http_get(LIM_PORT, "/index", buffer, sizeof(buffer)) == HTTPRC_TOO_MANY_REQUESTS);
+
+		pi_gatn->remove_server(p_srv);
+	}
+
+	pi_repo->object_release(pi_gatn);
+}
@@ -0,0 +1,189 @@
+#include <string.h>
+#include <vector>
+#include "iMemory.h"
+#include "private.h"
+
+#define LL_TEST_ITEMS	200 // more than one slab
+
+// every record is found by its index
+static bool llist_match(iLlist *pi_list, std::vector<_u32> &ref) {
+	bool r = (pi_list->cnt() == ref.size());
+	_u32 sz = 0;
+
+	// backward, than forward (both directions from current)
+	for(_u32 i = ref.size(); r && i > 0; i--) {
+		_u32 *p = (_u32 *)pi_list->get(i - 1, &sz);
+
+		r = (p && *p == ref[i - 1]);
+	}
+	for(_u32 i = 0; r && i < ref.size(); i++) {
+		_u32 *p = (_u32 *)pi_list->get(i, &sz);
+
+		r = (p && *p == ref[i]);
+	}
+
+	return r;
+}
+
+// index array is kept in sync with the list
+static void test_llist_index(iRepository *pi_repo, _u8 mode) {
+	iLlist *pi_list = (iLlist *)pi_repo->object_by_iname(I_LLIST, RF_CLONE);
+	std::vector<_u32> ref;
+	_u32 sz = 0;
+	_u32 *p = NULL;
+
+	CHECK(pi_list);
+	if(!pi_list)
+		return;
+
+	CHECK(pi_list->init(mode|LL_INDEX, 2));
+
+	// more than initial capacity of index
+	for(_u32 i = 0; i < LL_TEST_ITEMS; i++) {
+		CHECK(pi_list->add(&i, sizeof(i)));
+		ref.push_back(i);
+	}
+	CHECK(llist_match(pi_list, ref));
+
+	// insert in the middle
+	for(_u32 i = 0; i < 50; i++) {
+		_u32 v = 1000 + i;
+		_u32 pos = (i * 7) % ref.size();
+
+		CHECK((p = (_u32 *)pi_list->ins(pos, &v, sizeof(v))) && *p == v);
+		ref.insert(ref.begin() + pos, v);
+	}
+	CHECK(llist_match(pi_list, ref));
+
+	// remove by index from the middle, first and last
+	for(_u32 i = 0; i < 30; i++) {
+		_u32 pos = (i * 13) % ref.size();
+
+		pi_list->rem(pos);
+		ref.erase(ref.begin() + pos);
+	}
+	pi_list->rem(0);
+	ref.erase(ref.begin());
+	pi_list->rem(ref.size() - 1);
+	ref.pop_back();
+	CHECK(llist_match(pi_list, ref));
+
+	// delete current
+	for(_u32 i = 0; i < 20; i++) {
+		_u32 pos = (i * 11) % ref.size();
+
+		pi_list->get(pos, &sz);
+		pi_list->del();
+		ref.erase(ref.begin() + pos);
+	}
+	CHECK(llist_match(pi_list, ref));
+
+	// move to second column
+	std::vector<_u32> ref1;
+
+	for(_u32 i = 0; i < 10; i++) {
+		_u32 pos = (i * 17) % ref.size();
+
+		CHECK((p = (_u32 *)pi_list->get(pos, &sz)) && pi_list->mov(p, 1));
+		ref1.push_back(ref[pos]);
+		ref.erase(ref.begin() + pos);
+	}
+	CHECK(llist_match(pi_list, ref));
+	pi_list->col(1);
+	CHECK(llist_match(pi_list, ref1));
+	pi_list->col(0);
+
+	if(mode == LL_RING) {
+		pi_list->roll();
+		ref.push_back(ref[0]);
+		ref.erase(ref.begin());
+		CHECK(llist_match(pi_list, ref));
+	}
+
+	// cleared list starts with new index
+	pi_list->clr();
+	ref.clear();
+	for(_u32 i = 0; i < 20; i++) {
+		CHECK(pi_list->add(&i, sizeof(i)));
+		ref.push_back(i);
+	}
+	CHECK(llist_match(pi_list, ref));
+
+	pi_list->uninit();
+	pi_repo->object_release(pi_list);
+}
+
+void test_llist(iRepository *pi_repo) {
+	iLlist *pi_list = (iLlist *)pi_repo->object_by_iname(I_LLIST, RF_CLONE);
+	_u32 sz = 0;
+
+	CHECK(pi_list);
+	if(!pi_list)
+		return;
+
+	CHECK(pi_list->init(LL_VECTOR|LL_SLAB, 2));
+
+	// records of two slab classes, 16 bytes aligned
+	for(_u32 i = 0; i < LL_TEST_ITEMS; i++) {
+		_u8 rec[100];
+		_u32 *p = NULL;
+
+		memset(rec, 0, sizeof(rec));
+		memcpy(rec, &i, sizeof(i));
+		CHECK((p = (_u32 *)pi_list->add(rec, (i & 1) ? sizeof(rec) : sizeof(i))));
+		if(p) {
+			CHECK(((_ulong)p & 15) == 0);
+			CHECK(*p == i);
+		}
+	}
+	CHECK(pi_list->cnt() == LL_TEST_ITEMS);
+
+	// insert in front
+	_u32 v = 1000;
+	_u32 *p = (_u32 *)pi_list->ins(0, &v, sizeof(v));
+
+	CHECK(p && *p == 1000);
+	CHECK(pi_list->cnt() == LL_TEST_ITEMS + 1);
+	CHECK((p = (_u32 *)pi_list->get(1, &sz)) && *p == 0);
+	pi_list->rem(0);
+
+	// move odd records to column 1
+	for(_u32 i = 1; i < LL_TEST_ITEMS; i += 2) {
+		_u32 *p = NULL;
+
+		pi_list->col(0);
+		// records ahead of 'i' are already moved
+		if((p = (_u32 *)pi_list->get(i / 2 + 1, &sz)) && *p == i)
+			CHECK(pi_list->mov(p, 1));
+		else
+			CHECK(false);
+	}
+	pi_list->col(0);
+	CHECK(pi_list->cnt() == LL_TEST_ITEMS / 2);
+	pi_list->col(1);
+	CHECK(pi_list->cnt() == LL_TEST_ITEMS / 2);
+	CHECK((p = (_u32 *)pi_list->get(0, &sz)) && *p == 1);
+
+	// delete column 1 one by one (slabs are returned as they get empty)
+	while(pi_list->cnt()) {
+		pi_list->get(0, &sz);
+		pi_list->del();
+	}
+	pi_list->col(0);
+	CHECK(pi_list->cnt() == LL_TEST_ITEMS / 2);
+
+	// reuse released items
+	for(_u32 i = 0; i < LL_TEST_ITEMS; i++)
+		CHECK(pi_list->add(&i, sizeof(i)));
+	CHECK(pi_list->cnt() == LL_TEST_ITEMS + LL_TEST_ITEMS / 2);
+	CHECK((p = (_u32 *)pi_list->get(LL_TEST_ITEMS / 2, &sz)) && *p == 0);
+
+	pi_list->clr();
+	CHECK(pi_list->cnt() == 0);
+	pi_list->uninit();
+	pi_repo->object_release(pi_list);
+
+	test_llist_index(pi_repo, LL_VECTOR);
+	test_llist_index(pi_repo, LL_VECTOR|LL_SLAB);
+	test_llist_index(pi_repo, LL_RING);
+}
@@ -0,0 +1,142 @@
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+#include "iSync.h"
+#include "private.h"
+
+#define LOCK_TEST_THREADS	4
+#define LOCK_TEST_LOOPS		100000
+
+static void test_lock_mutex(iMutex *pi_mutex) {
+	std::thread *p_thread[LOCK_TEST_THREADS];
+	volatile _u32 counter = 0;
+	_lock_stat_t st;
+
+	// recursion by handle
+	HMUTEX hm = pi_mutex->lock();
+
+	CHECK(hm != 0);
+	CHECK(pi_mutex->lock(hm) == hm);
+	CHECK(pi_mutex->try_lock(hm) == hm);
+	pi_mutex->unlock(hm);
+	pi_mutex->unlock(hm);
+
+	// handle of other thread doesn't enter the lock
+	std::thread t([pi_mutex, hm]() {
+		CHECK(pi_mutex->try_lock(hm) == 0);
+		CHECK(pi_mutex->try_lock() == 0);
+	});
+	t.join();
+
+	pi_mutex->stat(&st);
+	CHECK(st.owner != 0);
+	pi_mutex->unlock(hm);
+	pi_mutex->stat(&st);
+	CHECK(st.owner == 0);
+
+	for(_u32 i = 0; i < LOCK_TEST_THREADS; i++) {
+		p_thread[i] = new std::thread([pi_mutex, &counter]() {
+			for(_u32 n = 0; n < LOCK_TEST_LOOPS; n++) {
+				HMUTEX hm = pi_mutex->lock();
+
+				counter = counter + 1;
+				pi_mutex->unlock(hm);
+			}
+		});
+	}
+
+	for(_u32 i = 0; i < LOCK_TEST_THREADS; i++) {
+		p_thread[i]->join();
+		delete p_thread[i];
+	}
+
+	CHECK(counter == LOCK_TEST_THREADS * LOCK_TEST_LOOPS);
+	pi_mutex->stat(&st);
+	CHECK(st.locks >= LOCK_TEST_THREADS * LOCK_TEST_LOOPS);
+}
+
+static void test_lock_rw(iRWLock *pi_rw) {
+	std::atomic<_u32> inside(0);
+	std::atomic<bool> excl(true);
+	std::thread *p_thread[LOCK_TEST_THREADS];
+	_lock_stat_t st;
+
+	// readers at the same time
+	for(_u32 i = 0; i < LOCK_TEST_THREADS; i++) {
+		p_thread[i] = new std::thread([pi_rw, &inside]() {
+			pi_rw->rlock();
+			inside++;
+			while(inside.load() < LOCK_TEST_THREADS)
+				usleep(100);
+			pi_rw->runlock();
+		});
+	}
+
+	for(_u32 i = 0; i < LOCK_TEST_THREADS; i++) {
+		p_thread[i]->join();
+		delete p_thread[i];
+	}
+
+	pi_rw->stat(&st);
+	CHECK(st.max_readers == LOCK_TEST_THREADS);
+	CHECK(st.readers == 0);
+
+	// writer excludes readers and writers
+	HMUTEX hm = pi_rw->lock();
+
+	CHECK(!pi_rw->try_rlock());
+	std::thread t([pi_rw]() {
+		CHECK(!pi_rw->try_rlock());
+		CHECK(pi_rw->try_lock() == 0);
+	});
+	t.join();
+	pi_rw->unlock(hm);
+	CHECK(pi_rw->try_rlock());
+	pi_rw->runlock();
+
+	inside = 0;
+	for(_u32 i = 0; i < LOCK_TEST_THREADS; i++) {
+		p_thread[i] = new std::thread([pi_rw, &inside, &excl, i]() {
+			for(_u32 n = 0; n < LOCK_TEST_LOOPS / 10; n++) {
+				if(i & 1) {
+					HMUTEX hm = pi_rw->lock();
+
+					if(inside++ != 0)
+						excl = false;
+					inside--;
+					pi_rw->unlock(hm);
+				} else {
+					pi_rw->rlock();
+					if(inside.load() != 0)
+						excl = false;
+					pi_rw->runlock();
+				}
+			}
+		});
+	}
+
+	for(_u32 i = 0; i < LOCK_TEST_THREADS; i++) {
+		p_thread[i]->join();
+		delete p_thread[i];
+	}
+
+	CHECK(excl.load());
+}
+
+void test_lock(iRepository *pi_repo) {
+	iMutex *pi_mutex = (iMutex *)pi_repo->object_by_iname(I_MUTEX, RF_CLONE);
+	iRWLock *pi_rw = (iRWLock *)pi_repo->object_by_iname(I_RW_LOCK, RF_CLONE);
+
+	CHECK(pi_mutex);
+	if(pi_mutex) {
+		test_lock_mutex(pi_mutex);
+		pi_repo->object_release(pi_mutex);
+	}
+
+	CHECK(pi_rw);
+	if(pi_rw) {
+		test_lock_mutex(pi_rw);
+		test_lock_rw(pi_rw);
+		pi_repo->object_release(pi_rw);
+	}
+}
@@ -0,0 +1,221 @@
+#include <time.h>
+#include <glob.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "iLog.h"
+#include "private.h"
+
+#define LOG_TEST_THREADS	4
+#define LOG_TEST_MESSAGES	2000
+#define LOG_TEST_SEGMENT	(64 * 1024)
+#define LOG_TEST_RECORDS	10000
+
+typedef struct {
+	_u8		lmt;
+	_u64		time;
+	std::string	msg;
+}_log_rec_t;
+
+typedef std::vector<_log_rec_t> _log_seg_t;
+
+// format longer than max. record
+static _char_t _g_long_fmt_[70000];
+
+static std::atomic<_u32> _g_received_(0);
+
+// slow listener, the queue of pending messages becomes full
+static void log_slow_listener(_u8 lmt, _cstr_t msg) {
+	if(lmt == LMT_INFO) {
+		_g_received_++;
+		usleep(100);
+	}
+}
+
+static _u64 thread_cpu_ms(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (_u64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// blocked writers of asynchronous mode sleep
+static void test_log_block(iLog *pi_log) {
+	std::thread *p_thread[LOG_TEST_THREADS];
+	std::atomic<_u64> cpu(0);
+	_log_stat_t st;
+	_u64 t = 0;
+
+	CHECK(pi_log->mode(LOG_ASYNC, LOG_BLOCK));
+	pi_log->add_listener(log_slow_listener);
+	t = time_ms();
+
+	for(_u32 i = 0; i < LOG_TEST_THREADS; i++) {
+		p_thread[i] = new std::thread([pi_log, &cpu, i]() {
+			_u64 c = thread_cpu_ms();
+
+			for(_u32 n = 0; n < LOG_TEST_MESSAGES; n++)
+				pi_log->fwrite(LMT_INFO, "writer %u message %u, padding to fill the queue faster", i, n);
+			cpu += thread_cpu_ms() - c;
+		});
+	}
+
+	for(_u32 i = 0; i < LOG_TEST_THREADS; i++) {
+		p_thread[i]->join();
+		delete p_thread[i];
+	}
+
+	pi_log->flush();
+	t = time_ms() - t;
+	pi_log->stat(&st);
+
+	CHECK(_g_received_.load() == LOG_TEST_THREADS * LOG_TEST_MESSAGES);
+	CHECK(st.dropped == 0);
+	CHECK(st.messages == st.flushed);
+	// writers spent the most of time in futex wait
+	CHECK(cpu.load() < t / 4);
+
+	pi_log->remove_listener(log_slow_listener);
+	CHECK(pi_log->mode(LOG_SYNC));
+}
+
+// decoded segments of 'path', ordered by time
+static std::vector<_log_seg_t> log_read(iLog *pi_log, _cstr_t path) {
+	std::vector<_log_seg_t> r;
+	_char_t pattern[256];
+	glob_t g;
+
+	snprintf(pattern, sizeof(pattern), "%s.*", path);
+	if(glob(pattern, 0, NULL, &g) == 0) {
+		for(size_t i = 0; i < g.gl_pathc; i++) {
+			_log_seg_t seg;
+
+			CHECK(pi_log->decode(g.gl_pathv[i], [](_u8 lmt, _u64 time, _cstr_t msg, void *udata) {
+				((_log_seg_t *)udata)->push_back({lmt, time, msg});
+			}, &seg));
+			if(seg.size())
+				r.push_back(seg);
+			unlink(g.gl_pathv[i]);
+		}
+		globfree(&g);
+	}
+
+	std::sort(r.begin(), r.end(), [](const _log_seg_t &a, const _log_seg_t &b) {
+		return a[0].time < b[0].time;
+	});
+
+	return r;
+}
+
+static _u64 real_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (_u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// encode and decode of text and binary records
+static void test_log_codec(iLog *pi_log, _cstr_t path) {
+	_u64 t[4];
+
+	CHECK(pi_log->sink(path, LOG_TEST_SEGMENT));
+	CHECK(pi_log->mode(LOG_ASYNC));
+	pi_log->write(LMT_WARNING, "text");
+	pi_log->bfwrite(LMT_INFO, "i=%d u=%u s=%s d=%.2f x=%x %%", -5, 7u, "str", 1.5, 255);
+	pi_log->bfwrite(LMT_ERROR, "null=[%s] short", (_cstr_t)NULL);
+
+	// text is stamped by writer, not by the consumer
+	HMUTEX hm = pi_log->lock();
+
+	t[0] = real_ns();
+	pi_log->fwrite(LMT_INFO, "stamped %u", 1);
+	t[1] = real_ns();
+	pi_log->bfwrite(LMT_INFO, "stamped %u", 2);
+	t[2] = real_ns();
+	usleep(50000);
+	pi_log->unlock(hm);
+
+	// too long format is stored as text
+	memset(_g_long_fmt_, 'a', sizeof(_g_long_fmt_) - 1);
+	_g_long_fmt_[sizeof(_g_long_fmt_) - 1] = 0;
+	pi_log->bfwrite(LMT_INFO, _g_long_fmt_);
+	pi_log->write(LMT_INFO, "after");
+	pi_log->flush();
+	t[3] = real_ns();
+	CHECK(pi_log->mode(LOG_SYNC));
+	CHECK(pi_log->sink(NULL));
+
+	std::vector<_log_seg_t> v = log_read(pi_log, path);
+
+	CHECK(v.size() == 1);
+	if(v.size() == 1 && v[0].size() == 7) {
+		_log_seg_t &seg = v[0];
+
+		CHECK(seg[0].lmt == LMT_WARNING && seg[0].msg == "text");
+		CHECK(seg[1].lmt == LMT_INFO && seg[1].msg == "i=-5 u=7 s=str d=1.50 x=ff %");
+		CHECK(seg[2].lmt == LMT_ERROR && seg[2].msg == "null=[] short");
+		CHECK(seg[3].msg == "stamped 1" && seg[3].time >= t[0] && seg[3].time <= t[1]);
+		CHECK(seg[4].msg == "stamped 2" && seg[4].time >= t[1] && seg[4].time <= t[2]);
+		CHECK(seg[5].msg.size() > 0 && seg[5].msg.find_first_not_of('a') == std::string::npos);
+		CHECK(seg[6].msg == "after");
+
+		for(_u32 i = 1; i < seg.size(); i++)
+			CHECK(seg[i].time >= seg[i - 1].time && seg[i].time <= t[3]);
+	} else
+		CHECK(false);
+}
+
+// segments are switched by size, every one decodes on its own
+static void test_log_rotate(iLog *pi_log, _cstr_t path) {
+	std::vector<_log_seg_t> v;
+	_u32 n = 0;
+	bool order = true;
+
+	CHECK(pi_log->sink(path, LOG_TEST_SEGMENT));
+	for(_u32 i = 0; i < LOG_TEST_RECORDS; i++) {
+		if(i & 1)
+			pi_log->bfwrite(LMT_INFO, "record %u of %s", i, "rotation test");
+		else
+			pi_log->fwrite(LMT_INFO, "record %u of %s", i, "rotation test");
+	}
+	CHECK(pi_log->sink(NULL));
+
+	v = log_read(pi_log, path);
+	CHECK(v.size() >= 3);
+
+	for(_u32 s = 0; s < v.size(); s++) {
+		for(_u32 i = 0; i < v[s].size(); i++) {
+			_char_t expect[64];
+
+			snprintf(expect, sizeof(expect), "record %u of rotation test", n++);
+			order &= (v[s][i].msg == expect);
+		}
+	}
+
+	CHECK(order);
+	CHECK(n == LOG_TEST_RECORDS);
+	// prepared, but unused segment is removed
+	CHECK(access((std::string(path) + ".next").c_str(), F_OK) != 0);
+}
+
+void test_log(iRepository *pi_repo) {
+	iLog *pi_log = (iLog *)pi_repo->object_by_iname(I_LOG, RF_CLONE);
+
+	CHECK(pi_log);
+	if(!pi_log)
+		return;
+
+	test_log_block(pi_log);
+
+	_char_t path[64];
+
+	snprintf(path, sizeof(path), "/tmp/unit-log-%d", getpid());
+	test_log_codec(pi_log, path);
+	test_log_rotate(pi_log, path);
+
+	pi_repo->object_release(pi_log);
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "startup.h"
+#include "iRepository.h"
+#include "private.h"
+
+IMPLEMENT_BASE_ARRAY("unit_test", 1024);
+
+_u32 _g_failed_ = 0;
+
+static _test_t _g_test_[] = {
+	{ "websocket",		test_websocket },
+	{ "rcache",		test_rcache },
+	{ "limiter",		test_limiter },
+	{ "document",		test_document },
+	{ "llist",		test_llist },
+	{ "queue",		test_queue },
+	{ "rbuffer",		test_rbuffer },
+	{ "pool",		test_pool },
+	{ "bmap",		test_bmap },
+	{ "clone",		test_clone },
+	{ "extension",		test_extension },
+	{ "lock",		test_lock },
+	{ "event",		test_event },
+	{ "tpool",		test_tpool },
+	{ "gatn_co",		test_gatn_co },
+	{ "log",		test_log },
+	{ "proxy",		test_proxy },
+	{ "fast_map",		test_fast_map },
+	{ "concurrent_map",	test_concurrent_map },
+	{ "map",		test_map },
+	{ "heap_cache",		test_heap_cache },
+	{ "page_arena",		test_page_arena },
+	{ NULL,			NULL }
+};
+
+// usage: unit [test name ...]
+_err_t main(int argc, char *argv[]) {
+	_err_t r = init(argc, argv);
+
+	if(r == ERR_NONE) {
+		handle(SIGSEGV, [](int sig, siginfo_t *info, void*) {
+			dump_stack();
+			exit(1);
+		});
+		handle(SIGPIPE, [](int sig, siginfo_t *info, void*) {});
+
+		iRepository *pi_repo = get_repository();
+		_cstr_t ext_dir = getenv("LD_LIBRARY_PATH");
+
+		pi_repo->extension_dir((ext_dir) ? ext_dir : ".");
+
+		for(_u32 i = 0; _g_test_[i].name; i++) {
+			bool run = (argc < 2);
+
+			for(int j = 1; j < argc && !run; j++)
+				run = (strcmp(argv[j], _g_test_[i].name) == 0);
+
+			if(run) {
+				_u32 failed = _g_failed_;
+
+				printf("[%s]\n", _g_test_[i].name);
+				_g_test_[i].proc(pi_repo);
+				printf("[%s] %s\n", _g_test_[i].name, (failed == _g_failed_) ? "ok" : "FAILED");
+			}
+		}
+
+		uninit();
+		r = (_g_failed_) ? ERR_UNKNOWN : ERR_NONE;
+	}
+
+	return r;
+}
@@ -0,0 +1,138 @@
+#include <string.h>
+#include <stdlib.h>
+#include "map_alg.h"
+#include "private.h"
+
+#define MAP_TEST_CAPACITY	15
+#define MAP_TEST_RECORDS	20000
+#define MAP_TEST_LIVE		100
+
+// allocated bytes
+static void *map_test_alloc(_u32 size, void *udata) {
+	*(_s64 *)udata += size;
+	return malloc(size);
+}
+
+static void map_test_free(void *ptr, _u32 size, void *udata) {
+	*(_s64 *)udata -= size;
+	free(ptr);
+}
+
+static _u32 map_test_key(_char_t *key, _u32 sz, _u32 n) {
+	return snprintf(key, sz, "key-%u", n);
+}
+
+// every key in [first, last) is found with its data, 'gone' ones are not
+static bool map_test_verify(_map_context_t *p_mcxt, _u32 first, _u32 last, _u32 gone_first, _u32 gone_last) {
+	bool r = true;
+	_char_t key[32];
+	_u32 sz = 0;
+
+	for(_u32 i = first; r && i < last; i++) {
+		_u32 *p = (_u32 *)map_get(p_mcxt, key, map_test_key(key, sizeof(key), i), &sz);
+
+		r = (p && sz == sizeof(_u32) && *p == i);
+	}
+	for(_u32 i = gone_first; r && i < gone_last; i++)
+		r = (map_get(p_mcxt, key, map_test_key(key, sizeof(key), i), &sz) == NULL);
+
+	return r;
+}
+
+void test_map(iRepository *pi_repo) {
+	_s64 allocated = 0;
+	_map_context_t mcxt;
+	_char_t key[32];
+	_u32 sz = 0;
+	_u32 doublings = 0, shrinks = 0, migrating = 0;
+	bool ok = true;
+
+	memset(&mcxt, 0, sizeof(mcxt));
+	mcxt.capacity = MAP_TEST_CAPACITY;
+	mcxt.pf_mem_alloc = map_test_alloc;
+	mcxt.pf_mem_free = map_test_free;
+	mcxt.udata = &allocated;
+	CHECK(map_init(&mcxt));
+
+	// grow past several doublings, every key is found while records
+	// are split between old and new table
+	_u32 capacity = mcxt.capacity;
+
+	for(_u32 i = 0; i < MAP_TEST_RECORDS; i++) {
+		map_add(&mcxt, key, map_test_key(key, sizeof(key), i), &i, sizeof(i));
+
+		if(mcxt.capacity != capacity) {
+			capacity = mcxt.capacity;
+			doublings++;
+		}
+		if(mcxt.pp_old) {
+			migrating++;
+			if(mcxt.migrate == 0 || (i % 4) == 0)
+				ok &= map_test_verify(&mcxt, 0, i + 1, i + 1, i + 2);
+		}
+	}
+	CHECK(ok);
+	CHECK(doublings >= 8);
+	CHECK(migrating > 0);
+	CHECK(mcxt.records == MAP_TEST_RECORDS);
+	CHECK(map_test_verify(&mcxt, 0, MAP_TEST_RECORDS, MAP_TEST_RECORDS, MAP_TEST_RECORDS + 1));
+
+	// set of record still in old table replaces it
+	for(_u32 i = MAP_TEST_RECORDS; !mcxt.pp_old; i++)
+		map_add(&mcxt, key, map_test_key(key, sizeof(key), i), &i, sizeof(i));
+
+	_u32 records = mcxt.records;
+	_u32 v = MAP_TEST_RECORDS * 2;
+	_u32 *p = (_u32 *)map_set(&mcxt, key, map_test_key(key, sizeof(key), 0), &v, sizeof(v));
+
+	CHECK(p && *p == v && mcxt.records == records);
+	CHECK((p = (_u32 *)map_get(&mcxt, key, map_test_key(key, sizeof(key), 0), &sz)) && *p == v);
+	v = 0;
+	map_set(&mcxt, key, map_test_key(key, sizeof(key), 0), &v, sizeof(v));
+	for(_u32 i = MAP_TEST_RECORDS; i < records; i++)
+		map_del(&mcxt, key, map_test_key(key, sizeof(key), i));
+	CHECK(mcxt.records == MAP_TEST_RECORDS);
+
+	// delete down past shrink threshold (records < capacity / 8), deleted
+	// keys disappear and live ones stay while table is migrating
+	ok = true;
+	migrating = 0;
+	for(_u32 i = 0; i < MAP_TEST_RECORDS - MAP_TEST_LIVE; i++) {
+		map_del(&mcxt, key, map_test_key(key, sizeof(key), i));
+
+		if(mcxt.capacity < capacity) {
+			ok &= (mcxt.records < capacity / 8);
+			capacity = mcxt.capacity;
+			shrinks++;
+		}
+		if(mcxt.pp_old) {
+			migrating++;
+			if(mcxt.migrate == 0 || (i % 4) == 0)
+				ok &= map_test_verify(&mcxt, i + 1, MAP_TEST_RECORDS, i - (i > 64 ? 64 : i), i + 1);
+		}
+	}
+	CHECK(ok);
+	CHECK(shrinks >= 4);
+	CHECK(migrating > 0);
+	CHECK(mcxt.records == MAP_TEST_LIVE);
+	CHECK(mcxt.capacity < MAP_TEST_LIVE * 16);
+	CHECK(map_test_verify(&mcxt, MAP_TEST_RECORDS - MAP_TEST_LIVE, MAP_TEST_RECORDS, 0, MAP_TEST_RECORDS - MAP_TEST_LIVE));
+
+	// never below initial capacity
+	for(_u32 i = MAP_TEST_RECORDS - MAP_TEST_LIVE; i < MAP_TEST_RECORDS; i++)
+		map_del(&mcxt, key, map_test_key(key, sizeof(key), i));
+	for(_u32 i = 0; i < MAP_TEST_CAPACITY * 8; i++)
+		map_del(&mcxt, key, map_test_key(key, sizeof(key), i));
+	CHECK(mcxt.records == 0);
+	CHECK(mcxt.capacity >= MAP_TEST_CAPACITY && !mcxt.pp_old);
+
+	// clear in the middle of migration releases both tables
+	for(_u32 i = 0; !mcxt.pp_old; i++)
+		map_add(&mcxt, key, map_test_key(key, sizeof(key), i), &i, sizeof(i));
+	map_clr(&mcxt);
+	CHECK(mcxt.records == 0 && !mcxt.pp_old);
+	CHECK(map_test_verify(&mcxt, 0, 0, 0, MAP_TEST_RECORDS));
+
+	map_destroy(&mcxt);
+	CHECK(allocated == 0);
+}
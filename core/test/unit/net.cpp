@@ -0,0 +1,69 @@
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "private.h"
+
+int tcp_connect(_u32 port) {
+	int r = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	struct timeval tv = {5, 0};
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	setsockopt(r, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	// server may be starting
+	for(_u32 i = 0; i < 100; i++) {
+		if(connect(r, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+			return r;
+		usleep(10000);
+	}
+
+	close(r);
+	return -1;
+}
+
+_u16 http_get(_u32 port, _cstr_t path, _char_t *res, _u32 sz_res) {
+	_u16 r = 0;
+	int sock = tcp_connect(port);
+
+	res[0] = 0;
+	if(sock >= 0) {
+		_char_t req[512];
+		_u32 n = snprintf(req, sizeof(req), "GET %s HTTP/1.0\r\nHost: localhost\r\n\r\n", path);
+		ssize_t l = 0;
+
+		send(sock, req, n, 0);
+		n = 0;
+		// HTTP/1.0 response ends by close
+		while(n < sz_res - 1 && (l = recv(sock, res + n, sz_res - 1 - n, 0)) > 0)
+			n += l;
+		res[n] = 0;
+		close(sock);
+
+		if(strncmp(res, "HTTP/1.", 7) == 0 && n > 12)
+			r = atoi(res + 9);
+	}
+
+	return r;
+}
+
+_cstr_t http_body(_cstr_t res) {
+	_cstr_t r = strstr(res, "\r\n\r\n");
+
+	return (r) ? r + 4 : "";
+}
+
+_u64 time_ms(void) {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (_u64)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
@@ -0,0 +1,84 @@
+#include <string.h>
+#include <set>
+#include <vector>
+#include "page_arena.h"
+#include "private.h"
+
+#define PA_TEST_PAGES		(ARENA_PAGES + ARENA_PAGES / 2)
+#define PA_TEST_RUNS		(ARENA_PAGES / ARENA_MAX_RUN + 2)
+
+static _ulong pa_arena(void *ptr) {
+	return (_ulong)ptr / ARENA_SIZE;
+}
+
+// allocate single pages, returns number of distinct arenas
+static _u32 pa_alloc_pages(std::vector<void *> &pages, bool *p_ok) {
+	std::set<void *> unique;
+	std::set<_ulong> arenas;
+
+	for(_u32 i = 0; i < PA_TEST_PAGES; i++) {
+		_u8 *p = (_u8 *)arena_page_alloc(1);
+
+		if(p && ((_ulong)p % ARENA_PAGE_SIZE) == 0) {
+			// page is writable and not given twice
+			memset(p, (_u8)i, ARENA_PAGE_SIZE);
+			*p_ok &= unique.insert(p).second;
+			arenas.insert(pa_arena(p));
+			pages.push_back(p);
+		} else
+			*p_ok = false;
+	}
+
+	for(_u32 i = 0; i < pages.size(); i++)
+		*p_ok &= (((_u8 *)pages[i])[ARENA_PAGE_SIZE - 1] == (_u8)i);
+
+	return arenas.size();
+}
+
+void test_page_arena(iRepository *pi_repo) {
+	std::vector<void *> pages;
+	bool ok = true;
+
+	// more pages than one arena holds
+	_u32 arenas = pa_alloc_pages(pages, &ok);
+
+	CHECK(ok);
+	CHECK(pages.size() == PA_TEST_PAGES);
+	CHECK(arenas >= 2);
+
+	for(void *p : pages)
+		arena_page_free(p, 1);
+	pages.clear();
+
+	// freed pages are reused, no new arenas needed
+	CHECK(pa_alloc_pages(pages, &ok) <= arenas + 1);
+	CHECK(ok);
+	for(void *p : pages)
+		arena_page_free(p, 1);
+	pages.clear();
+
+	// runs never cross arena boundary
+	for(_u32 i = 0; i < PA_TEST_RUNS; i++) {
+		_u8 *p = (_u8 *)arena_page_alloc(ARENA_MAX_RUN);
+
+		ok &= (p && pa_arena(p) == pa_arena(p + ARENA_MAX_RUN * ARENA_PAGE_SIZE - 1));
+		if(p) {
+			memset(p, 0x5a, ARENA_MAX_RUN * ARENA_PAGE_SIZE);
+			pages.push_back(p);
+		}
+	}
+	CHECK(ok);
+	for(void *p : pages)
+		arena_page_free(p, ARENA_MAX_RUN);
+	pages.clear();
+
+	// big request is mapped out of arenas
+	_u8 *p = (_u8 *)arena_page_alloc(ARENA_MAX_RUN + 1);
+
+	CHECK(p);
+	if(p) {
+		memset(p, 0xa5, (ARENA_MAX_RUN + 1) * ARENA_PAGE_SIZE);
+		arena_page_free(p, ARENA_MAX_RUN + 1);
+	}
+	CHECK(arena_page_alloc(0) == NULL);
+}
@@ -0,0 +1,97 @@
+#include <string.h>
+#include <thread>
+#include <atomic>
+#include "iMemory.h"
+#include "private.h"
+
+#define POOL_TEST_POOLS		80 // more than initial thread slots of object cache
+#define POOL_TEST_THREADS	4
+#define POOL_TEST_OBJECTS	64
+
+typedef struct {
+	_u32	owner;
+	_u32	value;
+}_pool_test_obj_t;
+
+// sharded pool (object cache with per thread magazines)
+static void test_pool_sharded(iPool *pi_pool) {
+	_pool_test_obj_t *p[POOL_TEST_OBJECTS];
+
+	CHECK(pi_pool->init(sizeof(_pool_test_obj_t), NULL, NULL, NULL, POOL_SHARDED));
+
+	for(_u32 i = 0; i < POOL_TEST_OBJECTS; i++) {
+		if((p[i] = (_pool_test_obj_t *)pi_pool->alloc())) {
+			CHECK(p[i]->owner == 0 && p[i]->value == 0); // new objects are zeroed
+			CHECK(((_ulong)p[i] & 15) == 0);
+			p[i]->value = i;
+		} else
+			CHECK(false);
+	}
+	CHECK(pi_pool->num_busy() == POOL_TEST_OBJECTS);
+
+	// recently freed object comes back first
+	pi_pool->free(p[10]);
+	CHECK(!pi_pool->verify(p[10]));
+	CHECK(pi_pool->num_busy() == POOL_TEST_OBJECTS - 1);
+	CHECK(pi_pool->alloc() == p[10]);
+
+	// double free is reported and ignored
+	pi_pool->free(p[20]);
+	pi_pool->free(p[20]);
+	CHECK(pi_pool->num_busy() == POOL_TEST_OBJECTS - 1);
+	CHECK(pi_pool->alloc() == p[20]);
+	CHECK(pi_pool->alloc() != p[20]);
+
+	pi_pool->free_all();
+	CHECK(pi_pool->num_busy() == 0);
+}
+
+void test_pool(iRepository *pi_repo) {
+	iPool *pi_pool[POOL_TEST_POOLS];
+	std::thread *p_thread[POOL_TEST_THREADS];
+	std::atomic<bool> owner(true);
+
+	memset(pi_pool, 0, sizeof(pi_pool));
+	for(_u32 i = 0; i < POOL_TEST_POOLS; i++) {
+		CHECK((pi_pool[i] = (iPool *)pi_repo->object_by_iname(I_POOL, RF_CLONE)));
+		if(!pi_pool[i])
+			return;
+	}
+
+	test_pool_sharded(pi_pool[0]);
+	for(_u32 i = 1; i < POOL_TEST_POOLS; i++)
+		CHECK(pi_pool[i]->init(sizeof(_pool_test_obj_t), NULL, NULL, NULL, POOL_SHARDED));
+
+	// every thread has magazines in all pools
+	for(_u32 t = 0; t < POOL_TEST_THREADS; t++) {
+		p_thread[t] = new std::thread([&pi_pool, &owner, t]() {
+			_pool_test_obj_t *p[POOL_TEST_OBJECTS];
+
+			for(_u32 n = 0; n < 50; n++) {
+				for(_u32 i = 0; i < POOL_TEST_POOLS; i++) {
+					for(_u32 j = 0; j < POOL_TEST_OBJECTS; j++) {
+						if((p[j] = (_pool_test_obj_t *)pi_pool[i]->alloc()))
+							p[j]->owner = t + 1;
+					}
+					for(_u32 j = 0; j < POOL_TEST_OBJECTS; j++) {
+						if(!p[j] || p[j]->owner != t + 1)
+							owner = false;
+						else
+							pi_pool[i]->free(p[j]);
+					}
+				}
+			}
+		});
+	}
+
+	for(_u32 t = 0; t < POOL_TEST_THREADS; t++) {
+		p_thread[t]->join();
+		delete p_thread[t];
+	}
+
+	CHECK(owner);
+	for(_u32 i = 0; i < POOL_TEST_POOLS; i++) {
+		CHECK(pi_pool[i]->num_busy() == 0);
+		pi_repo->object_release(pi_pool[i]);
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef __UNIT_PRIVATE_H__
+#define __UNIT_PRIVATE_H__
+
+#include <stdio.h>
+#include "iRepository.h"
+
+// number of failed checks
+extern _u32 _g_failed_;
+
+#define CHECK(cond) \
+	do { \
+		if(!(cond)) { \
+			printf("\tfailed %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			_g_failed_++; \
+		} \
+	} while(0)
+
+typedef void _test_proc_t(iRepository *pi_repo);
+
+typedef struct {
+	_cstr_t		name;
+	_test_proc_t	*proc;
+}_test_t;
+
+// helpers
+int tcp_connect(_u32 port);
+// simple HTTP/1.0 GET, returns response code
+_u16 http_get(_u32 port, _cstr_t path, _char_t *res, _u32 sz_res);
+_cstr_t http_body(_cstr_t res);
+_u64 time_ms(void);
+
+// test cases
+void test_websocket(iRepository *pi_repo);
+void test_rcache(iRepository *pi_repo);
+void test_limiter(iRepository *pi_repo);
+void test_document(iRepository *pi_repo);
+void test_llist(iRepository *pi_repo);
+void test_queue(iRepository *pi_repo);
+void test_rbuffer(iRepository *pi_repo);
+void test_pool(iRepository *pi_repo);
+void test_bmap(iRepository *pi_repo);
+void test_clone(iRepository *pi_repo);
+void test_extension(iRepository *pi_repo);
+void test_lock(iRepository *pi_repo);
+void test_event(iRepository *pi_repo);
+void test_tpool(iRepository *pi_repo);
+void test_gatn_co(iRepository *pi_repo);
+void test_log(iRepository *pi_repo);
+void test_proxy(iRepository *pi_repo);
+void test_fast_map(iRepository *pi_repo);
+void test_concurrent_map(iRepository *pi_repo);
+void test_map(iRepository *pi_repo);
+void test_heap_cache(iRepository *pi_repo);
+void test_page_arena(iRepository *pi_repo);
+
+#endif
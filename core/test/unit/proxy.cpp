@@ -0,0 +1,176 @@
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <thread>
+#include "iGatn.h"
+#include "private.h"
+
+#define PROXY_PORT	18769
+#define UPSTREAM_PORT	18770
+#define PROXY_CONFIG	"/tmp/unit-proxy.json"
+
+static _cstr_t _g_proxy_config_ =
+	"{\"server\": [{"
+		"\"name\": \"proxy-test\", \"port\": %u, \"root\": \"/tmp\", \"buffer\": 8, \"threads\": 2, \"connections\": 16, \"timeout\": 10,"
+		"\"proxy\": [{"
+			"\"location\": \"/api/\", \"timeout\": 5, \"keep-alive\": 2,"
+			"\"upstream\": [\"127.0.0.1:%u\"]"
+		"}]"
+	"}]}";
+
+// partial content with end-to-end headers out of any fixed list
+static _cstr_t _g_upstream_response_ =
+	"HTTP/1.1 206 Partial Content\r\n"
+	"Content-Length: 5\r\n"
+	"Content-Range: bytes 0-4/10\r\n"
+	"Accept-Ranges: bytes\r\n"
+	"Access-Control-Allow-Origin: *\r\n"
+	"Retry-After: 120\r\n"
+	"X-App-Version: 7\r\n"
+	"Set-Cookie: a=1\r\n"
+	"Set-Cookie: b=2\r\n"
+	"Keep-Alive: timeout=5\r\n"
+	"Date: Thu, 01 Jan 1970 00:00:00 GMT\r\n"
+	"Connection: close\r\n"
+	"\r\n"
+	"hello";
+
+static int listen_tcp(_u32 port) {
+	int r = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	int on = 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	setsockopt(r, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	if(bind(r, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(r, 4) != 0) {
+		close(r);
+		r = -1;
+	}
+
+	return r;
+}
+
+// receive request header
+static _u32 recv_header(int sock, _char_t *buffer, _u32 size) {
+	_u32 r = 0;
+	ssize_t l = 0;
+
+	buffer[0] = 0;
+	while(r < size - 1 && !strstr(buffer, "\r\n\r\n") && (l = recv(sock, buffer + r, size - 1 - r, 0)) > 0) {
+		r += l;
+		buffer[r] = 0;
+	}
+
+	return r;
+}
+
+static _u32 count(_cstr_t str, _cstr_t sub) {
+	_u32 r = 0;
+
+	while((str = strstr(str, sub))) {
+		str += strlen(sub);
+		r++;
+	}
+
+	return r;
+}
+
+void test_proxy(iRepository *pi_repo) {
+	iGatn *pi_gatn = NULL;
+	_server_t *p_srv = NULL;
+	_char_t upstream_req[4096] = "";
+	int lsock = listen_tcp(UPSTREAM_PORT);
+	FILE *pf = NULL;
+
+	CHECK(lsock >= 0);
+	if(lsock < 0)
+		return;
+
+	if((pf = fopen(PROXY_CONFIG, "w"))) {
+		fprintf(pf, _g_proxy_config_, PROXY_PORT, UPSTREAM_PORT);
+		fclose(pf);
+	}
+
+	pi_repo->extension_load("extht.so");
+	pi_repo->extension_load("extfs.so");
+	pi_repo->extension_load("extnet.so");
+	pi_repo->extension_load("extgatn.so");
+	CHECK((pi_gatn = (iGatn *)pi_repo->object_by_iname(I_GATN, RF_ORIGINAL)));
+	if(pi_gatn) {
+		pi_gatn->configure(PROXY_CONFIG);
+		CHECK((p_srv = pi_gatn->server_by_name("proxy-test")));
+	}
+
+	if(p_srv) {
+		for(_u32 i = 0; i < 100 && !p_srv->is_running(); i++) {
+			usleep(10000);
+			p_srv->start();
+		}
+
+		// one request to upstream
+		std::thread upstream([lsock, &upstream_req]() {
+			int sock = accept(lsock, NULL, NULL);
+
+			if(sock >= 0) {
+				recv_header(sock, upstream_req, sizeof(upstream_req));
+				send(sock, _g_upstream_response_, strlen(_g_upstream_response_), 0);
+				close(sock);
+			}
+		});
+
+		_char_t buffer[4096] = "";
+		int sock = tcp_connect(PROXY_PORT);
+
+		CHECK(sock >= 0);
+		if(sock >= 0) {
+			_cstr_t req = "GET /api/range HTTP/1.0\r\n"
+					"Host: localhost\r\n"
+					"X-Forwarded-For: 10.0.0.1\r\n"
+					"Range: bytes=0-4\r\n"
+					"\r\n";
+			_u32 n = 0;
+			ssize_t l = 0;
+
+			send(sock, req, strlen(req), 0);
+			while(n < sizeof(buffer) - 1 && (l = recv(sock, buffer + n, sizeof(buffer) - 1 - n, 0)) > 0)
+				n += l;
+			buffer[n] = 0;
+			close(sock);
+		}
+
+		upstream.join();
+
+		// client chain is extended by the peer address
+		CHECK(strstr(upstream_req, "X-Forwarded-For: 10.0.0.1, 127.0.0.1\r\n"));
+		CHECK(count(upstream_req, "X-Forwarded-For:") == 1);
+		CHECK(strstr(upstream_req, "Range: bytes=0-4\r\n"));
+
+		// every end-to-end header of upstream is forwarded
+		CHECK(strncmp(buffer, "HTTP/1.1 206", 12) == 0);
+		CHECK(strstr(buffer, "Content-Range: bytes 0-4/10\r\n"));
+		CHECK(strstr(buffer, "Accept-Ranges: bytes\r\n"));
+		CHECK(strstr(buffer, "Access-Control-Allow-Origin: *\r\n"));
+		CHECK(strstr(buffer, "Retry-After: 120\r\n"));
+		CHECK(strstr(buffer, "X-App-Version: 7\r\n"));
+		CHECK(strstr(buffer, "Set-Cookie: a=1\r\n") && strstr(buffer, "Set-Cookie: b=2\r\n"));
+		// hop-by-hop headers and 'Date' are not
+		CHECK(!strstr(buffer, "Keep-Alive:"));
+		CHECK(count(buffer, "Date: ") == 1);
+		CHECK(!strstr(buffer, "1970"));
+		CHECK(strcmp(http_body(buffer), "hello") == 0);
+
+		pi_gatn->remove_server(p_srv);
+	}
+
+	close(lsock);
+	unlink(PROXY_CONFIG);
+	if(pi_gatn)
+		pi_repo->object_release(pi_gatn);
+}
@@ -0,0 +1,98 @@
+#include <thread>
+#include <atomic>
+#include "iMemory.h"
+#include "private.h"
+
+#define Q_TEST_PRODUCERS	4
+#define Q_TEST_ITEMS		100000 // per producer
+
+static void test_queue_basic(iQueue *pi_queue, _u8 mode) {
+	_u32 items[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	_u32 out[8] = {0};
+	_u32 v = 0;
+
+	CHECK(pi_queue->init(5, sizeof(_u32), mode));
+	CHECK(pi_queue->capacity() == 8);
+
+	// zero length batches must not block
+	CHECK(pi_queue->push_batch(items, 0) == 0);
+	CHECK(pi_queue->pop_batch(out, 0) == 0);
+
+	CHECK(!pi_queue->pop(&v));
+	CHECK(!pi_queue->pop_wait(&v, 10));
+	CHECK(pi_queue->push_batch(items, 6) == 6);
+	CHECK(pi_queue->size() == 6);
+	// partial batch when full
+	CHECK(pi_queue->push_batch(items + 6, 2) == 2);
+	CHECK(!pi_queue->push(&v));
+	CHECK(!pi_queue->push_wait(&v, 10));
+
+	CHECK(pi_queue->pop_batch(out, 3) == 3);
+	CHECK(out[0] == 1 && out[1] == 2 && out[2] == 3);
+	CHECK(pi_queue->pop_batch(out, 8) == 5);
+	CHECK(out[0] == 4 && out[4] == 8);
+	CHECK(pi_queue->size() == 0);
+
+	pi_queue->destroy();
+}
+
+// every item pushed by producers must be popped exactly once
+static void test_queue_threads(iQueue *pi_queue, _u32 producers) {
+	std::atomic<_u64> sum(0);
+	std::atomic<_u32> popped(0);
+	std::thread *p_thread[Q_TEST_PRODUCERS * 2];
+	_u32 total = producers * Q_TEST_ITEMS;
+	_u64 expect = 0;
+
+	CHECK(pi_queue->init(64, sizeof(_u32), (producers == 1) ? Q_SPSC : Q_MPMC));
+
+	for(_u32 i = 0; i < producers; i++) {
+		p_thread[i] = new std::thread([pi_queue, i]() {
+			for(_u32 n = 0; n < Q_TEST_ITEMS; n++) {
+				_u32 v = i * Q_TEST_ITEMS + n;
+
+				pi_queue->push_wait(&v);
+			}
+		});
+		p_thread[producers + i] = new std::thread([pi_queue, &sum, &popped, total]() {
+			_u32 v = 0;
+
+			while(popped.load() < total) {
+				if(pi_queue->pop_wait(&v, 10)) {
+					sum += v;
+					popped++;
+				}
+			}
+		});
+	}
+
+	for(_u32 i = 0; i < producers * 2; i++) {
+		p_thread[i]->join();
+		delete p_thread[i];
+	}
+
+	for(_u32 i = 0; i < total; i++)
+		expect += i;
+
+	CHECK(popped.load() == total);
+	CHECK(sum.load() == expect);
+	CHECK(pi_queue->size() == 0);
+
+	pi_queue->destroy();
+}
+
+void test_queue(iRepository *pi_repo) {
+	iQueue *pi_queue = (iQueue *)pi_repo->object_by_iname(I_QUEUE, RF_CLONE);
+
+	CHECK(pi_queue);
+	if(!pi_queue)
+		return;
+
+	test_queue_basic(pi_queue, Q_MPMC);
+	test_queue_basic(pi_queue, Q_SPSC);
+	test_queue_threads(pi_queue, 1);
+	test_queue_threads(pi_queue, Q_TEST_PRODUCERS);
+	CHECK(!pi_queue->init(0x80000001, sizeof(_u32)));
+
+	pi_repo->object_release(pi_queue);
+}
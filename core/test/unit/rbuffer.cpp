@@ -0,0 +1,136 @@
+#include <string.h>
+#include <thread>
+#include "iMemory.h"
+#include "private.h"
+
+#define RB_TEST_PRODUCERS	4
+#define RB_TEST_MESSAGES	50000 // per producer
+
+typedef struct {
+	_u32	producer;
+	_u32	seq;
+	_u8	data[20];
+}_rb_test_msg_t;
+
+static void test_rbuffer_basic(iRingBuffer *pi_rb) {
+	_u32 sz = 0;
+	_char_t *p = NULL;
+	_u32 n = 0;
+
+	CHECK(pi_rb->init_mpsc(256));
+	CHECK(!pi_rb->init_mpsc(256)); // already initialized
+	CHECK(!pi_rb->read(&sz));
+	CHECK(!pi_rb->pending());
+	CHECK(!pi_rb->read_wait(&sz, 10));
+	// larger than half of buffer
+	CHECK(!pi_rb->reserve(200));
+
+	// messages are read in reservation order, after commit only
+	_char_t *p1 = (_char_t *)pi_rb->reserve(6);
+	_char_t *p2 = (_char_t *)pi_rb->reserve(6);
+
+	CHECK(p1 && p2);
+	if(p1 && p2) {
+		strcpy(p2, "world");
+		pi_rb->commit(p2);
+		CHECK(!pi_rb->read(&sz)); // first is not committed
+		strcpy(p1, "hello");
+		pi_rb->commit(p1);
+		CHECK((p = (_char_t *)pi_rb->read(&sz)) && sz == 6 && strcmp(p, "hello") == 0);
+		pi_rb->release();
+		CHECK((p = (_char_t *)pi_rb->read(&sz)) && sz == 6 && strcmp(p, "world") == 0);
+		pi_rb->release();
+	}
+	CHECK(!pi_rb->pending());
+
+	// fill, then wrap around the end of buffer
+	while((p = (_char_t *)pi_rb->reserve(40))) {
+		memset(p, 'a' + n % 26, 40);
+		pi_rb->commit(p);
+		n++;
+	}
+	CHECK(n > 0 && n < 256 / 40);
+	for(_u32 i = 0; i < n + 3; i++) {
+		if((p = (_char_t *)pi_rb->read(&sz))) {
+			CHECK(sz == 40 && p[0] == (_char_t)('a' + i % 26) && p[39] == p[0]);
+			pi_rb->release();
+		} else
+			CHECK(false);
+
+		if(i < 3 && (p = (_char_t *)pi_rb->reserve(40))) {
+			memset(p, 'a' + (n + i) % 26, 40);
+			pi_rb->commit(p);
+		}
+	}
+	CHECK(!pi_rb->pending());
+
+	pi_rb->destroy();
+}
+
+// producers write sequenced messages, consumer checks per producer order
+static void test_rbuffer_threads(iRingBuffer *pi_rb) {
+	std::thread *p_thread[RB_TEST_PRODUCERS];
+	_u32 next[RB_TEST_PRODUCERS];
+	_u32 total = 0;
+	bool order = true;
+
+	CHECK(pi_rb->init_mpsc(4096));
+	memset(next, 0, sizeof(next));
+
+	for(_u32 i = 0; i < RB_TEST_PRODUCERS; i++) {
+		p_thread[i] = new std::thread([pi_rb, i]() {
+			for(_u32 n = 0; n < RB_TEST_MESSAGES; n++) {
+				_rb_test_msg_t *p = NULL;
+
+				while(!(p = (_rb_test_msg_t *)pi_rb->reserve(sizeof(_rb_test_msg_t))))
+					std::this_thread::yield();
+
+				p->producer = i;
+				p->seq = n;
+				memset(p->data, n & 0xff, sizeof(p->data));
+				pi_rb->commit(p);
+			}
+		});
+	}
+
+	while(total < RB_TEST_PRODUCERS * RB_TEST_MESSAGES) {
+		_u32 sz = 0;
+		_rb_test_msg_t *p = (_rb_test_msg_t *)pi_rb->read_wait(&sz, 1000);
+
+		if(!p)
+			break;
+		if(sz != sizeof(_rb_test_msg_t) || p->producer >= RB_TEST_PRODUCERS ||
+				p->seq != next[p->producer] || p->data[19] != (p->seq & 0xff))
+			order = false;
+		else
+			next[p->producer]++;
+		pi_rb->release();
+		total++;
+	}
+
+	for(_u32 i = 0; i < RB_TEST_PRODUCERS; i++) {
+		p_thread[i]->join();
+		delete p_thread[i];
+	}
+
+	CHECK(order);
+	CHECK(total == RB_TEST_PRODUCERS * RB_TEST_MESSAGES);
+	CHECK(!pi_rb->pending());
+
+	pi_rb->destroy();
+}
+
+void test_rbuffer(iRepository *pi_repo) {
+	iRingBuffer *pi_rb = (iRingBuffer *)pi_repo->object_by_iname(I_RING_BUFFER, RF_CLONE);
+
+	CHECK(pi_rb);
+	if(!pi_rb)
+		return;
+
+	test_rbuffer_basic(pi_rb);
+	test_rbuffer_threads(pi_rb);
+	// can't be rounded up to power of 2
+	CHECK(!pi_rb->init_mpsc(0x80000001));
+
+	pi_repo->object_release(pi_rb);
+}
@@ -0,0 +1,103 @@
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "iGatn.h"
+#include "private.h"
+
+#define RC_PORT		18766
+#define RC_CLIENTS	6
+
+static std::atomic<_u32> _g_fills_(0);
+
+// slow origin, counts executions
+static void rc_on_slow(_u8 evt, _request_t *req, _response_t *res, void *udata) {
+	if(evt == HTTP_ON_REQUEST) {
+		usleep(1000000);
+		res->_end(HTTPRC_OK, "v%u", (_u32)++_g_fills_);
+	}
+}
+
+static void rc_on_fast(_u8 evt, _request_t *req, _response_t *res, void *udata) {
+	if(evt == HTTP_ON_REQUEST)
+		res->end(HTTPRC_OK, "fast");
+}
+
+void test_rcache(iRepository *pi_repo) {
+	iGatn *pi_gatn = NULL;
+	_server_t *p_srv = NULL;
+
+	pi_repo->extension_load("extht.so");
+	pi_repo->extension_load("extfs.so");
+	pi_repo->extension_load("extnet.so");
+	pi_repo->extension_load("extgatn.so");
+	CHECK((pi_gatn = (iGatn *)pi_repo->object_by_iname(I_GATN, RF_ORIGINAL)));
+	if(!pi_gatn)
+		return;
+
+	// two workers only
+	CHECK((p_srv = pi_gatn->create_server("rcache-test", RC_PORT, "/tmp", "/tmp",
+					NULL, NULL, 8192, 2, 64, 10)));
+	if(p_srv) {
+		for(_u32 i = 0; i < 100 && !p_srv->is_running(); i++) {
+			usleep(10000);
+			p_srv->start();
+		}
+
+		p_srv->on_route(HTTP_METHOD_GET, "/slow", rc_on_slow);
+		p_srv->on_route(HTTP_METHOD_GET, "/fast", rc_on_fast);
+		CHECK(p_srv->cache_route(HTTP_METHOD_GET, "/slow", 2, 30));
+		// cache hits don't enter route handlers (serialized by vhost lock)
+		CHECK(p_srv->cache_route(HTTP_METHOD_GET, "/fast", 60));
+
+		_char_t buffer[1024];
+
+		CHECK(http_get(RC_PORT, "/fast", buffer, sizeof(buffer)) == HTTPRC_OK);
+
+		// concurrent misses on one key must not hold the workers
+		_u16 rc[RC_CLIENTS];
+		_char_t res[RC_CLIENTS][1024];
+		std::thread *clients[RC_CLIENTS];
+
+		for(_u32 i = 0; i < RC_CLIENTS; i++) {
+			clients[i] = new std::thread([i, &rc, &res]() {
+				rc[i] = http_get(RC_PORT, "/slow", res[i], sizeof(res[i]));
+			});
+		}
+
+		usleep(200000);
+
+		_u64 t = time_ms();
+
+		CHECK(http_get(RC_PORT, "/fast", buffer, sizeof(buffer)) == HTTPRC_OK);
+		CHECK(time_ms() - t < 500);
+		CHECK(strstr(buffer, "X-Cache: HIT"));
+		CHECK(strcmp(http_body(buffer), "fast") == 0);
+
+		for(_u32 i = 0; i < RC_CLIENTS; i++) {
+			clients[i]->join();
+			delete clients[i];
+			CHECK(rc[i] == HTTPRC_OK);
+			CHECK(strcmp(http_body(res[i]), "v1") == 0);
+		}
+		CHECK(_g_fills_ == 1);
+
+		// expired entry is served immediately, refresh runs in background
+		usleep(2200000);
+		t = time_ms();
+		CHECK(http_get(RC_PORT, "/slow", buffer, sizeof(buffer)) == HTTPRC_OK);
+		CHECK(time_ms() - t < 500);
+		CHECK(strstr(buffer, "X-Cache: STALE"));
+		CHECK(strcmp(http_body(buffer), "v1") == 0);
+
+		usleep(1500000);
+		CHECK(http_get(RC_PORT, "/slow", buffer, sizeof(buffer)) == HTTPRC_OK);
+		CHECK(strstr(buffer, "X-Cache: HIT"));
+		CHECK(strcmp(http_body(buffer), "v2") == 0);
+		CHECK(_g_fills_ == 2);
+
+		pi_gatn->remove_server(p_srv);
+	}
+
+	pi_repo->object_release(pi_gatn);
+}
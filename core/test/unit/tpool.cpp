@@ -0,0 +1,119 @@
+#include <string.h>
+#include <atomic>
+#include <unistd.h>
+#include "private.h"
+#include "iTaskMaker.h"
+
+#define TPOOL_TEST_JOBS	1000
+
+typedef struct {
+	std::atomic<bool>	started;
+	std::atomic<bool>	stop;
+	std::atomic<bool>	done;
+}_tpool_task_t;
+
+static void *tpool_square(void *arg) {
+	_ulong n = (_ulong)arg;
+
+	return (void *)(n * n);
+}
+
+static void *tpool_sleep(void *arg) {
+	usleep((_ulong)arg * 1000);
+	return arg;
+}
+
+// the task returns a while after the stop signal
+static void *tpool_task(_u8 sig, void *arg) {
+	_tpool_task_t *pt = (_tpool_task_t *)arg;
+
+	if(sig == TM_SIG_START) {
+		pt->started = true;
+		while(!pt->stop.load())
+			usleep(1000);
+		usleep(200000);
+		pt->done = true;
+	} else if(sig == TM_SIG_STOP)
+		pt->stop = true;
+
+	return NULL;
+}
+
+void test_tpool(iRepository *pi_repo) {
+	iTaskMaker *pi_tmaker = (iTaskMaker *)pi_repo->object_by_iname(I_TASK_MAKER, RF_ORIGINAL);
+	iThreadPool *pi_tpool = NULL;
+	HJOB hj[TPOOL_TEST_JOBS];
+	_tpool_stat_t st;
+	_tpool_task_t task;
+	void *res = NULL;
+	bool ok = true;
+
+	CHECK(pi_tmaker);
+	if(!pi_tmaker)
+		return;
+
+	// shared by name
+	CHECK((pi_tpool = pi_tmaker->pool("unit-tpool", 4)));
+	CHECK(pi_tmaker->pool("unit-tpool") == pi_tpool);
+	if(!pi_tpool) {
+		pi_repo->object_release(pi_tmaker);
+		return;
+	}
+
+	CHECK(strcmp(pi_tpool->name(), "unit-tpool") == 0);
+
+	for(_ulong i = 0; i < TPOOL_TEST_JOBS; i++)
+		hj[i] = pi_tpool->submit(tpool_square, (void *)i, i % JOB_PRIO_COUNT);
+
+	for(_ulong i = 0; i < TPOOL_TEST_JOBS; i++) {
+		if(!hj[i] || !pi_tpool->wait(hj[i], &res) || (_ulong)res != i * i)
+			ok = false;
+	}
+	CHECK(ok);
+
+	pi_tpool->stat(&st);
+	CHECK(st.threads == 4);
+	CHECK(st.done >= TPOOL_TEST_JOBS);
+	CHECK(st.pending == 0);
+
+	// timeout leaves the job valid
+	HJOB h = pi_tpool->submit(tpool_sleep, (void *)200);
+
+	CHECK(h);
+	CHECK(!pi_tpool->wait(h, &res, 10));
+	CHECK(pi_tpool->wait(h, &res));
+	CHECK((_ulong)res == 200);
+
+	// released job is freed by the pool after completion
+	CHECK((h = pi_tpool->submit(tpool_sleep, (void *)10)));
+	pi_tpool->release(h);
+
+	// stop blocks until the task is idle
+	task.started = false;
+	task.stop = false;
+	task.done = false;
+
+	HTASK ht = pi_tmaker->start(tpool_task, &task, "unit-task");
+
+	CHECK(ht);
+	if(ht) {
+		while(!task.started.load())
+			usleep(1000);
+		CHECK(pi_tmaker->stop(ht));
+		CHECK(task.done.load());
+	}
+
+	// stopped right after start, the procedure is not called after stop
+	task.started = false;
+	task.stop = false;
+	task.done = false;
+	CHECK((ht = pi_tmaker->start(tpool_task, &task, "unit-task")));
+	if(ht) {
+		CHECK(pi_tmaker->stop(ht));
+		CHECK(task.started.load() == task.done.load());
+		usleep(200000);
+		CHECK(task.started.load() == task.done.load());
+	}
+
+	pi_repo->object_release(pi_tmaker);
+}
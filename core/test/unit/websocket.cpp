@@ -0,0 +1,145 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "iNet.h"
+#include "private.h"
+
+#define WS_PORT	18765
+
+// echo every message back to the sender
+static void ws_on_request(iHttpServerConnection *pi_httpc, void *udata) {
+	pi_httpc->ws_upgrade();
+}
+
+static void ws_on_message(iHttpServerConnection *pi_httpc, void *udata) {
+	_u32 size = 0;
+	_u8 opcode = 0;
+	_u8 *msg = pi_httpc->ws_message(&size, &opcode);
+
+	if(msg)
+		pi_httpc->ws_send(opcode, msg, size);
+	else
+		// message without data pointer
+		pi_httpc->ws_send(WS_OP_TEXT, "null", 4);
+}
+
+// append masked client frame to buffer and return its size
+static _u32 ws_client_frame(_u8 *buffer, _u8 fin_opcode, _cstr_t data, _u32 size) {
+	_u8 mask[4] = {0x11, 0x22, 0x33, 0x44};
+	_u32 r = 0;
+
+	buffer[r++] = fin_opcode;
+	buffer[r++] = 0x80 | size; // small frames only
+	memcpy(buffer + r, mask, sizeof(mask));
+	r += sizeof(mask);
+	for(_u32 i = 0; i < size; i++)
+		buffer[r++] = data[i] ^ mask[i & 3];
+
+	return r;
+}
+
+// read one (small) server frame
+static bool ws_read_frame(int sock, _u8 *opcode, _char_t *data, _u32 *size) {
+	_u8 hdr[2];
+	_u32 n = 0;
+
+	while(n < sizeof(hdr)) {
+		ssize_t l = recv(sock, hdr + n, sizeof(hdr) - n, 0);
+		if(l <= 0)
+			return false;
+		n += l;
+	}
+
+	*opcode = hdr[0] & 0x0f;
+	*size = hdr[1] & 0x7f;
+	n = 0;
+	while(n < *size) {
+		ssize_t l = recv(sock, data + n, *size - n, 0);
+		if(l <= 0)
+			return false;
+		n += l;
+	}
+	data[n] = 0;
+
+	return (hdr[0] & 0x80) && !(hdr[1] & 0x80);
+}
+
+static bool ws_expect(int sock, _u8 opcode, _cstr_t data) {
+	_u8 op = 0;
+	_char_t buffer[128];
+	_u32 size = 0;
+
+	return ws_read_frame(sock, &op, buffer, &size) &&
+		op == opcode && size == strlen(data) && memcmp(buffer, data, size) == 0;
+}
+
+void test_websocket(iRepository *pi_repo) {
+	iNet *pi_net = NULL;
+	iHttpServer *pi_http = NULL;
+	int sock = -1;
+
+	pi_repo->extension_load("extnet.so");
+	CHECK((pi_net = (iNet *)pi_repo->object_by_iname(I_NET, RF_ORIGINAL)));
+	if(!pi_net)
+		return;
+
+	CHECK((pi_http = pi_net->create_http_server(WS_PORT, 8192, 2, 8, 5)));
+	if(pi_http) {
+		pi_http->on_event(HTTP_ON_REQUEST, ws_on_request);
+		pi_http->on_event(HTTP_ON_WS_MESSAGE, ws_on_message);
+
+		CHECK((sock = tcp_connect(WS_PORT)) >= 0);
+		if(sock >= 0) {
+			_cstr_t req = "GET /ws HTTP/1.1\r\n"
+				"Host: localhost\r\n"
+				"Upgrade: websocket\r\n"
+				"Connection: Upgrade\r\n"
+				"Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+				"Sec-WebSocket-Version: 13\r\n\r\n";
+			_char_t res[1024] = "";
+			_u32 n = 0;
+
+			send(sock, req, strlen(req), 0);
+			// response header (read byte by byte to keep frames in socket)
+			while(n < sizeof(res) - 1 && !strstr(res, "\r\n\r\n")) {
+				if(recv(sock, res + n, 1, 0) != 1)
+					break;
+				res[++n] = 0;
+			}
+			CHECK(strstr(res, " 101 "));
+			CHECK(strstr(res, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo="));
+
+			// pipelined frames in one write: empty message, control frame
+			// between fragments and fragmented message
+			_u8 frames[256];
+			_u32 sz = 0;
+
+			sz += ws_client_frame(frames + sz, 0x81, "hello", 5);
+			sz += ws_client_frame(frames + sz, 0x81, "", 0);
+			sz += ws_client_frame(frames + sz, 0x02, "ab", 2);
+			sz += ws_client_frame(frames + sz, 0x89, "p", 1);
+			sz += ws_client_frame(frames + sz, 0x80, "c", 1);
+			send(sock, frames, sz, 0);
+
+			CHECK(ws_expect(sock, WS_OP_TEXT, "hello"));
+			CHECK(ws_expect(sock, WS_OP_TEXT, ""));
+			CHECK(ws_expect(sock, WS_OP_PONG, "p"));
+			CHECK(ws_expect(sock, WS_OP_BINARY, "abc"));
+
+			CHECK(pi_http->ws_broadcast(WS_OP_TEXT, "all", 3) == 1);
+			CHECK(ws_expect(sock, WS_OP_TEXT, "all"));
+
+			// close handshake
+			_u8 status[2] = {0x03, 0xe8};
+
+			sz = ws_client_frame(frames, 0x88, (_cstr_t)status, sizeof(status));
+			send(sock, frames, sz, 0);
+			CHECK(ws_expect(sock, WS_OP_CLOSE, "\x03\xe8"));
+			close(sock);
+		}
+
+		pi_repo->object_release(pi_http);
+	}
+
+	pi_repo->object_release(pi_net);
+}
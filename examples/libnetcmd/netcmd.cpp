@@ -73,7 +73,7 @@ public:
 			case OCTL_INIT: {
 				iRepository *pi_repo = (iRepository *)arg;
 
-				m_running = false;
+				m_running = true; // cleared by OCTL_STOP, even before OCTL_START
 				m_stopped = true;
 				mpi_cmd_host = 0;
 				mpi_net = 0;
@@ -111,7 +111,6 @@ public:
 			} break;
 			case OCTL_START: {
 				m_stopped = false;
-				m_running = true;
 
 				mpi_log->fwrite(LMT_INFO, "%sStart thread", NC_LOG_PREFIX);
 				while(m_running) {
@@ -183,16 +182,11 @@ public:
 			} break;
 			case OCTL_STOP: {
 				if(m_running) {
-					_u32 t = 10;
-
 					mpi_log->fwrite(LMT_INFO, "%sStop thread", NC_LOG_PREFIX);
 					m_running = false;
-					while(!m_stopped && t) {
-						t--;
-						usleep(10000);
-					}
 				}
-				r = m_stopped;
+				// task maker waits until the thread leaves OCTL_START
+				r = true;
 			} break;
 		}
 
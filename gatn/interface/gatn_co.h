@@ -0,0 +1,181 @@
+#ifndef __GATN_CO_H__
+#define __GATN_CO_H__
+
+// C++20 coroutines for route handlers (the extension must be compiled with -std=c++20).
+//
+//	_gatn_co_t on_slow(_u8 evt, _request_t *req, _response_t *res, void *udata) {
+//		if(evt == ON_REQUEST) {
+//			void *result = co_await gatn_co_call(query, req);
+//			res->end(HTTPRC_OK, (_cstr_t)result);
+//		}
+//	}
+//	...
+//	p_srv->on_route(HTTP_METHOD_GET, "/slow", gatn_co_route<on_slow>);
+//
+// The first co_await suspends the connection and releases the HTTP worker. The
+// blocking operation runs in thread pool and the handler continues there, the
+// connection is resumed at the end of handler. For requests with content, wait
+// for the whole content (ON_DATA) before co_await.
+//
+// A pool thread is blocked for the whole call, so the number of calls in
+// progress is limited by GATN_CO_THREADS (the others wait in pool queue);
+// define it before including this file, or pass own pool to awaitable.
+// The handler must finish within connection timeout of server, otherwise the
+// client is disconnected.
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include "iRepository.h"
+#include "iGatn.h"
+#include "iTaskMaker.h"
+
+#define GATN_CO_POOL		"gatn-co"
+#ifndef GATN_CO_THREADS
+#define GATN_CO_THREADS		32
+#endif
+
+// return type of coroutine route handler
+struct _gatn_co_t {
+	struct promise_type {
+		_response_t	*p_res;
+		bool		suspended; // connection suspended by co_await
+
+		promise_type(_u8 evt, _request_t *req, _response_t *res, void *udata) {
+			p_res = res;
+			suspended = false;
+		}
+
+		_gatn_co_t get_return_object(void) {
+			return {};
+		}
+
+		std::suspend_never initial_suspend(void) noexcept {
+			return {};
+		}
+
+		// the frame is destroyed at the end of handler
+		std::suspend_never final_suspend(void) noexcept {
+			if(suspended)
+				p_res->resume();
+			return {};
+		}
+
+		void return_void(void) {}
+		void unhandled_exception(void) {}
+	};
+};
+
+typedef _gatn_co_t _gatn_co_route_t(_u8, _request_t *, _response_t *, void *);
+
+// adapter to _gatn_route_event_t
+template<_gatn_co_route_t *co>
+void gatn_co_route(_u8 evt, _request_t *req, _response_t *res, void *udata) {
+	co(evt, req, res, udata);
+}
+
+// shared thread pool for blocking operations
+static inline iThreadPool *gatn_co_pool(void) {
+	// initialized once, by the first caller
+	static iThreadPool *pi_pool = []() {
+		iThreadPool *r = NULL;
+		iTaskMaker *pi_tmaker = (iTaskMaker *)_gpi_repo_->object_by_iname(I_TASK_MAKER, RF_ORIGINAL);
+
+		if(pi_tmaker) {
+			r = pi_tmaker->pool(GATN_CO_POOL, GATN_CO_THREADS);
+			_gpi_repo_->object_release(pi_tmaker);
+		}
+
+		return r;
+	}();
+
+	return pi_pool;
+}
+
+// Awaitable blocking call (SQL query, socket I/O, ...): co_await returns the result
+// of 'proc(arg)'. Without thread pool (or suspend) the call is synchronous.
+struct gatn_co_call {
+	_job_proc_t	*mp_proc;
+	void		*mp_arg;
+	void		*mp_result;
+	iThreadPool	*mpi_pool;
+	std::coroutine_handle<> m_handle;
+
+	gatn_co_call(_job_proc_t *proc, void *arg, iThreadPool *pi_pool=NULL) {
+		mp_proc = proc;
+		mp_arg = arg;
+		mp_result = NULL;
+		mpi_pool = (pi_pool) ? pi_pool : gatn_co_pool();
+	}
+
+	static void *job(void *udata) {
+		gatn_co_call *p = (gatn_co_call *)udata;
+
+		p->mp_result = p->mp_proc(p->mp_arg);
+		// continue the handler in pool thread
+		p->m_handle.resume();
+		return NULL;
+	}
+
+	bool await_ready(void) {
+		return false;
+	}
+
+	bool await_suspend(std::coroutine_handle<_gatn_co_t::promise_type> h) {
+		bool r = false;
+		_gatn_co_t::promise_type &p = h.promise();
+		iThreadPool *pi_pool = mpi_pool;
+
+		if(pi_pool && !p.suspended)
+			p.suspended = p.p_res->suspend();
+
+		if(pi_pool && p.suspended) {
+			HJOB hj = NULL;
+
+			m_handle = h;
+			// don't touch 'this' after submit (the handler can be finished)
+			if((hj = pi_pool->submit(job, this))) {
+				pi_pool->release(hj);
+				r = true;
+			}
+		}
+
+		if(!r)
+			mp_result = mp_proc(mp_arg);
+
+		return r;
+	}
+
+	void *await_resume(void) {
+		return mp_result;
+	}
+};
+
+// Awaitable HTTP client request, co_await returns result of send()
+struct gatn_co_http_send: gatn_co_call {
+	iHttpClientConnection	*mpi_httpc;
+	_u32			m_timeout;
+	_on_http_response_t	*mp_cb_resp;
+	void			*mp_udata;
+
+	gatn_co_http_send(iHttpClientConnection *pi_httpc, _u32 timeout,
+			_on_http_response_t *p_cb_resp=NULL, void *udata=NULL, iThreadPool *pi_pool=NULL)
+			:gatn_co_call(send, this, pi_pool) {
+		mpi_httpc = pi_httpc;
+		m_timeout = timeout;
+		mp_cb_resp = p_cb_resp;
+		mp_udata = udata;
+	}
+
+	static void *send(void *udata) {
+		gatn_co_http_send *p = (gatn_co_http_send *)udata;
+
+		return (void *)(_ulong)p->mpi_httpc->send(p->m_timeout, p->mp_cb_resp, p->mp_udata);
+	}
+
+	bool await_resume(void) {
+		return (mp_result != NULL);
+	}
+};
+
+#endif // __cpp_impl_coroutine
+#endif
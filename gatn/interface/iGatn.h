@@ -37,6 +37,11 @@ typedef struct {
 	virtual void redirect(_cstr_t uri)=0;
 	virtual _cstr_t text(_u16 rc)=0;
 	virtual _u16 error(void)=0;
+	// Asynchronous response: suspend releases the HTTP worker after the route
+	// handler returns, the response is completed by end() and resume()
+	// from any thread (within connection timeout of server).
+	virtual bool suspend(void)=0;
+	virtual void resume(void)=0;
 
 #define RNDR_DONE		(1<<0) // done flag (end of transmission)
 #define RNDR_CACHE		(1<<1) // use file cache
@@ -60,6 +65,7 @@ typedef struct {
 #define ON_ERROR		HTTP_ON_ERROR
 #define ON_CLOSE_DOCUMENT	HTTP_ON_CLOSE_DOCUMENT
 #define ON_DISCONNECT		HTTP_ON_CLOSE
+#define ON_WS_MESSAGE		HTTP_ON_WS_MESSAGE
 
 // event handler return values
 #define	EHR_CONTINUE	0
@@ -86,6 +92,21 @@ struct gatn_server {
 	virtual bool stop_virtual_host(_cstr_t host)=0;
 	virtual bool attach_class(_cstr_t cname, _cstr_t options=NULL, _cstr_t host=NULL)=0;
 	virtual bool detach_class(_cstr_t cname, _cstr_t host=NULL, bool remove=true)=0;
+	// cache responses of route (method + path) for 'ttl' seconds and serve
+	// stale content up to 'stale' seconds after that, while one request refreshes it.
+	// 'vary' is a list of request headers (or cookie.name) in cache key (name1:name2:...)
+	virtual bool cache_route(_u8 method, _cstr_t path, _u32 ttl, _u32 stale=0,
+				_cstr_t vary=NULL, _cstr_t host=NULL)=0;
+	// memory limit of response cache in bytes
+	virtual void cache_limit(_ulong max_memory, _cstr_t host=NULL)=0;
+	// token bucket limits per client IP (requests per second, burst)
+	// and max. number of connections per client IP (default host only)
+	virtual bool limit_client(_u32 rate, _u32 burst=0, _u32 max_conns=0, _cstr_t host=NULL)=0;
+	// token bucket limit per client IP for URLs starting with 'path'
+	virtual bool limit_route(_cstr_t path, _u32 rate, _u32 burst=0, _cstr_t host=NULL)=0;
+	// send WebSocket frame to all (filtered) upgraded connections
+	virtual _u32 ws_broadcast(_u8 opcode, const void *data, _u32 size,
+				_ws_filter_t *pcb_filter=NULL, void *udata=NULL)=0;
 };
 
 class iGatnExtension: public iBase {
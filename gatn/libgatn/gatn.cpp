@@ -6,6 +6,7 @@
 #include "iHT.h"
 #include "private.h"
 #include "tString.h"
+#include "tSTLVector.h"
 
 IMPLEMENT_BASE_ARRAY("libgatn", 10);
 
@@ -198,20 +199,187 @@ private:
 			if(mpi_json->type(htv_ext_array) == JVT_ARRAY) {
 				_u32 idx = 0;
 				HTVALUE htv_ext = NULL;
+				tSTLVector<tString> v_module, v_alias;
+				tSTLVector<_ext_load_t> v_load;
 
 				while((htv_ext = mpi_json->by_index(htv_ext_array, idx))) {
-					tString module = json_string(jcxt, "module", htv_ext);
-					tString alias = json_string(jcxt, "alias", htv_ext);
+					v_module.push_back(json_string(jcxt, "module", htv_ext));
+					v_alias.push_back(json_string(jcxt, "alias", htv_ext));
+					idx++;
+				}
 
-					_gpi_repo_->extension_load(module.c_str(), alias.c_str());
+				for(_u32 i = 0; i < v_module.size(); i++) {
+					_ext_load_t el = {v_module[i].c_str(), v_alias[i].c_str(), ERR_NONE, 0};
 
-					idx++;
+					v_load.push_back(el);
+				}
+
+				// load all, then initialize in order of dependencies
+				if(v_load.size()) {
+					HTVALUE htv_parallel = mpi_json->select(jcxt, "parallel-init", NULL);
+					_u32 flags = (htv_parallel && mpi_json->type(htv_parallel) == JVT_TRUE) ? EXT_PARALLEL : 0;
+
+					_gpi_repo_->extension_load_list(v_load.data(), v_load.size(), flags,
+						[](_cstr_t alias, _cstr_t cname, _u32 init_time, _cstat_t state, void *udata) {
+							iLog *pi_log = (iLog *)udata;
+
+							if(state & ST_INITIALIZED)
+								pi_log->fwrite(LMT_INFO, "Gatn: '%s' (%s) initialized in %u us", cname, alias, init_time);
+							else
+								pi_log->fwrite(LMT_WARNING, "Gatn: '%s' (%s) is not initialized", cname, alias);
+						}, mpi_log);
+
+					for(_u32 i = 0; i < v_load.size(); i++) {
+						if(v_load[i].err != ERR_NONE)
+							mpi_log->fwrite(LMT_ERROR, "Gatn: Unable to load extension '%s' (%d)",
+									v_load[i].file, v_load[i].err);
+					}
 				}
 			} else
 				mpi_log->write(LMT_ERROR, "Gatn: Requres array 'extension: []'");
 		}
 	}
 
+	_u8 proxy_balance(_cstr_t balance) {
+		_u8 r = BALANCE_ROUND_ROBIN;
+
+		if(strcmp(balance, "least-connections") == 0)
+			r = BALANCE_LEAST_CONN;
+		else if(strcmp(balance, "hash") == 0)
+			r = BALANCE_HASH;
+
+		return r;
+	}
+
+	void configure_proxy(HTCONTEXT jcxt, HTVALUE htv_parent, _server_t *pi_srv, _cstr_t host=NULL) {
+		HTVALUE htv_proxy_array = mpi_json->select(jcxt, "proxy", htv_parent);
+
+		if(htv_proxy_array) {
+			if(mpi_json->type(htv_proxy_array) == JVT_ARRAY) {
+				server *psrv = dynamic_cast<server *>(pi_srv);
+				HTVALUE htv_proxy = NULL;
+				_u32 idx = 0;
+
+				while(psrv && (htv_proxy = mpi_json->by_index(htv_proxy_array, idx))) {
+					tString location = json_string(jcxt, "location", htv_proxy);
+					tString balance = json_string(jcxt, "balance", htv_proxy);
+					tString timeout = json_string(jcxt, "timeout", htv_proxy);
+					tString keep_alive = json_string(jcxt, "keep-alive", htv_proxy);
+					tString health_url = json_string(jcxt, "health.url", htv_proxy);
+					tString health_interval = json_string(jcxt, "health.interval", htv_proxy);
+					tString health_fails = json_string(jcxt, "health.fails", htv_proxy);
+					HTVALUE htv_upstream_array = mpi_json->select(jcxt, "upstream", htv_proxy);
+					_upstream_t *pu = psrv->add_proxy(location.c_str(),
+								proxy_balance(balance.c_str()),
+								atoi(timeout.c_str()),
+								atoi(keep_alive.c_str()),
+								health_url.c_str(),
+								atoi(health_interval.c_str()),
+								atoi(health_fails.c_str()),
+								host);
+
+					if(pu && htv_upstream_array && mpi_json->type(htv_upstream_array) == JVT_ARRAY) {
+						_u32 n = 0;
+						tString upstream;
+
+						while((upstream = json_string(htv_upstream_array, n)).length()) {
+							_cstr_t str = upstream.c_str();
+							_cstr_t port = strrchr(str, ':');
+
+							if(port) {
+								tString uhost(str, port - str);
+
+								pu->add_host(uhost.c_str(), atoi(port + 1));
+							} else
+								pu->add_host(str, 80);
+
+							n++;
+						}
+					} else
+						mpi_log->write(LMT_ERROR, "Gatn: Requires array 'proxy.upstream: []'");
+
+					idx++;
+				}
+			} else
+				mpi_log->write(LMT_ERROR, "Gatn: Requires array 'proxy: []'");
+		}
+	}
+
+	_u8 route_method(_cstr_t method) {
+		_u8 r = HTTP_METHOD_GET;
+
+		if(strcasecmp(method, "POST") == 0)
+			r = HTTP_METHOD_POST;
+		else if(strcasecmp(method, "HEAD") == 0)
+			r = HTTP_METHOD_HEAD;
+
+		return r;
+	}
+
+	void configure_rcache(HTCONTEXT jcxt, HTVALUE htv_parent, _server_t *pi_srv, _cstr_t host=NULL) {
+		HTVALUE htv_rcache = mpi_json->select(jcxt, "response-cache", htv_parent);
+
+		if(htv_rcache) {
+			tString memory = json_string(jcxt, "memory", htv_rcache);
+			HTVALUE htv_route_array = mpi_json->select(jcxt, "route", htv_rcache);
+
+			if(memory.length())
+				pi_srv->cache_limit((_ulong)atoi(memory.c_str()) * 1024, host);
+
+			if(htv_route_array && mpi_json->type(htv_route_array) == JVT_ARRAY) {
+				HTVALUE htv_route = NULL;
+				_u32 idx = 0;
+
+				while((htv_route = mpi_json->by_index(htv_route_array, idx))) {
+					tString method = json_string(jcxt, "method", htv_route);
+					tString path = json_string(jcxt, "path", htv_route);
+					tString ttl = json_string(jcxt, "ttl", htv_route);
+					tString stale = json_string(jcxt, "stale", htv_route);
+					tString vary = json_array_to_path(mpi_json->select(jcxt, "vary", htv_route));
+
+					pi_srv->cache_route(route_method(method.c_str()), path.c_str(),
+							atoi(ttl.c_str()), atoi(stale.c_str()),
+							vary.c_str(), host);
+					idx++;
+				}
+			} else
+				mpi_log->write(LMT_ERROR, "Gatn: Requires array 'response-cache.route: []'");
+		}
+	}
+
+	void configure_limit(HTCONTEXT jcxt, HTVALUE htv_parent, _server_t *pi_srv, _cstr_t host=NULL) {
+		HTVALUE htv_limit = mpi_json->select(jcxt, "limit", htv_parent);
+
+		if(htv_limit) {
+			tString rate = json_string(jcxt, "rate", htv_limit);
+			tString burst = json_string(jcxt, "burst", htv_limit);
+			tString connections = json_string(jcxt, "connections", htv_limit);
+			HTVALUE htv_route_array = mpi_json->select(jcxt, "route", htv_limit);
+
+			if(rate.length() || connections.length())
+				pi_srv->limit_client(atoi(rate.c_str()), atoi(burst.c_str()),
+							atoi(connections.c_str()), host);
+
+			if(htv_route_array) {
+				if(mpi_json->type(htv_route_array) == JVT_ARRAY) {
+					HTVALUE htv_route = NULL;
+					_u32 idx = 0;
+
+					while((htv_route = mpi_json->by_index(htv_route_array, idx))) {
+						tString path = json_string(jcxt, "path", htv_route);
+						tString route_rate = json_string(jcxt, "rate", htv_route);
+						tString route_burst = json_string(jcxt, "burst", htv_route);
+
+						pi_srv->limit_route(path.c_str(), atoi(route_rate.c_str()),
+								atoi(route_burst.c_str()), host);
+						idx++;
+					}
+				} else
+					mpi_log->write(LMT_ERROR, "Gatn: Requires array 'limit.route: []'");
+			}
+		}
+	}
+
 	void configure_hosts(HTCONTEXT jcxt, HTVALUE htv_server, _server_t *pi_srv) {
 		HTVALUE htv_vhost_array = mpi_json->select(jcxt, "vhost", htv_server);
 
@@ -235,6 +403,9 @@ private:
 							HTVALUE htv_class_array = mpi_json->select(jcxt, "attach", htv_vhost);
 
 							attach_class(jcxt, htv_class_array, pi_srv, host.c_str());
+							configure_proxy(jcxt, htv_vhost, pi_srv, host.c_str());
+							configure_rcache(jcxt, htv_vhost, pi_srv, host.c_str());
+							configure_limit(jcxt, htv_vhost, pi_srv, host.c_str());
 						}
 					}
 
@@ -286,6 +457,9 @@ private:
 							HTVALUE htv_class_array = mpi_json->select(jcxt, "attach", htv_srv);
 
 							attach_class(jcxt, htv_class_array, pi_srv);
+							configure_proxy(jcxt, htv_srv, pi_srv);
+							configure_rcache(jcxt, htv_srv, pi_srv);
+							configure_limit(jcxt, htv_srv, pi_srv);
 							configure_hosts(jcxt, htv_srv, pi_srv);
 						}
 					} else
@@ -0,0 +1,199 @@
+#include <string.h>
+#include <time.h>
+#include "iRepository.h"
+#include "private.h"
+
+#define TOKEN	1000 // bucket resolution
+
+static _u64 limit_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (_u64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static _u32 limit_hash(_u32 ip, _u32 route) {
+	_u32 h = ip * 0x9e3779b1;
+
+	h ^= route * 0x85ebca6b;
+	h ^= h >> 16;
+	return h;
+}
+
+bool limiter::init(void) {
+	bool r = true;
+
+	memset(m_shard, 0, sizeof(m_shard));
+	memset(m_route, 0, sizeof(m_route));
+	m_rate = m_burst = m_max_conns = m_routes = 0;
+
+	for(_u32 i = 0; i < LIMIT_SHARDS; i++) {
+		if(!(m_shard[i].pi_mutex = dynamic_cast<iMutex *>(_gpi_repo_->object_by_iname(I_MUTEX, RF_CLONE|RF_NONOTIFY))))
+			r = false;
+	}
+
+	return r;
+}
+
+void limiter::destroy(void) {
+	for(_u32 i = 0; i < LIMIT_SHARDS; i++) {
+		if(m_shard[i].pi_mutex) {
+			_gpi_repo_->object_release(m_shard[i].pi_mutex);
+			m_shard[i].pi_mutex = NULL;
+		}
+	}
+}
+
+void limiter::client(_u32 rate, _u32 burst, _u32 max_conns) {
+	m_rate = rate;
+	m_burst = (burst) ? burst : rate;
+	m_max_conns = max_conns;
+}
+
+bool limiter::add_route(_cstr_t path, _u32 rate, _u32 burst) {
+	bool r = false;
+
+	if(m_routes < MAX_LIMIT_ROUTES && rate && path && *path) {
+		_limit_route_t *pr = &m_route[m_routes];
+
+		strncpy(pr->path, path, sizeof(pr->path)-1);
+		pr->sz_path = strlen(pr->path);
+		pr->rate = rate;
+		pr->burst = (burst) ? burst : rate;
+		m_routes++;
+		r = true;
+	}
+
+	return r;
+}
+
+_limit_shard_t *limiter::shard(_u32 ip, _u32 route) {
+	return &m_shard[limit_hash(ip, route) & (LIMIT_SHARDS - 1)];
+}
+
+_bucket_t *limiter::bucket(_limit_shard_t *ps, _u32 ip, _u32 route, _u64 now) {
+	_bucket_t *r = NULL;
+	_bucket_t *p_free = NULL;
+	_bucket_t *p_old = NULL;
+	// low bits select the shard, so use the high ones for slot
+	_u32 idx = limit_hash(ip, route) >> 16;
+
+	for(_u32 i = 0; i < LIMIT_PROBE; i++) {
+		_bucket_t *pb = &ps->bucket[(idx + i) & (LIMIT_SHARD_SIZE - 1)];
+
+		if(pb->ip == ip && pb->route == route) {
+			r = pb;
+			break;
+		}
+
+		if(!pb->ip) {
+			if(!p_free)
+				p_free = pb;
+		} else if(!pb->conns && (!p_old || pb->stamp < p_old->stamp))
+			p_old = pb;
+	}
+
+	if(!r && (r = (p_free) ? p_free : p_old)) {
+		// new (or replaced) bucket starts full
+		r->ip = ip;
+		r->route = route;
+		r->tokens = 0xffffffff;
+		r->conns = 0;
+		r->stamp = now;
+	}
+
+	return r;
+}
+
+bool limiter::take(_bucket_t *pb, _u32 rate, _u32 burst, _u64 now) {
+	bool r = false;
+	_u64 max = (_u64)burst * TOKEN;
+	// rate tokens per second is rate/1000 per ms
+	_u64 tokens = (_u64)pb->tokens + (now - pb->stamp) * rate;
+
+	pb->tokens = (tokens > max) ? max : tokens;
+	pb->stamp = now;
+
+	if(pb->tokens >= TOKEN) {
+		pb->tokens -= TOKEN;
+		r = true;
+	}
+
+	return r;
+}
+
+bool limiter::connect(_u32 ip) {
+	bool r = true;
+
+	// unknown peer (ip 0) would share one bucket with all others
+	if(m_max_conns && ip) {
+		_limit_shard_t *ps = shard(ip, 0);
+		HMUTEX hm = ps->pi_mutex->lock();
+		_bucket_t *pb = bucket(ps, ip, 0, limit_time());
+
+		// accept when table is full of busy clients
+		if(pb) {
+			if(pb->conns < m_max_conns)
+				pb->conns++;
+			else
+				r = false;
+		}
+
+		ps->pi_mutex->unlock(hm);
+	}
+
+	return r;
+}
+
+void limiter::disconnect(_u32 ip) {
+	if(m_max_conns && ip) {
+		_limit_shard_t *ps = shard(ip, 0);
+		HMUTEX hm = ps->pi_mutex->lock();
+		_bucket_t *pb = bucket(ps, ip, 0, limit_time());
+
+		if(pb && pb->conns)
+			pb->conns--;
+
+		ps->pi_mutex->unlock(hm);
+	}
+}
+
+_u16 limiter::request(_u32 ip, _cstr_t url) {
+	_u16 r = 0;
+	_u64 now = limit_time();
+
+	if(!ip)
+		// unknown peer is not limited
+		return r;
+
+	if(m_rate) {
+		_limit_shard_t *ps = shard(ip, 0);
+		HMUTEX hm = ps->pi_mutex->lock();
+		_bucket_t *pb = bucket(ps, ip, 0, now);
+
+		if(pb && !take(pb, m_rate, m_burst, now))
+			r = HTTPRC_TOO_MANY_REQUESTS;
+
+		ps->pi_mutex->unlock(hm);
+	}
+
+	if(!r && url) {
+		for(_u32 i = 0; i < m_routes; i++) {
+			_limit_route_t *pr = &m_route[i];
+
+			if(strncmp(url, pr->path, pr->sz_path) == 0) {
+				_limit_shard_t *ps = shard(ip, i + 1);
+				HMUTEX hm = ps->pi_mutex->lock();
+				_bucket_t *pb = bucket(ps, ip, i + 1, now);
+
+				if(pb && !take(pb, pr->rate, pr->burst, now))
+					r = HTTPRC_TOO_MANY_REQUESTS;
+
+				ps->pi_mutex->unlock(hm);
+				break;
+			}
+		}
+	}
+
+	return r;
+}
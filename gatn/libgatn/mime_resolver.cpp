@@ -578,14 +578,15 @@ static _mime_t _g_mime_map_[]= {
 };
 
 static bool _g_is_init_mime_type_resolver_ = false;
-static iMap *_g_map_ = NULL;
+// read only after init (lookups from all workers without locking)
+static iConcurrentMap *_g_map_ = NULL;
 
 void init_mime_type_resolver(void) {
 	_u32 n = 0;
 
 	if(!_g_is_init_mime_type_resolver_) {
-		if((_g_map_ = dynamic_cast<iMap *>(_gpi_repo_->object_by_iname(I_MAP, RF_CLONE)))) {
-			if(_g_map_->init(255)) {
+		if((_g_map_ = dynamic_cast<iConcurrentMap *>(_gpi_repo_->object_by_iname(I_CONCURRENT_MAP, RF_CLONE)))) {
+			if(_g_map_->init(1024)) {
 				while(_g_mime_map_[n].ext) {
 					_g_map_->add(_g_mime_map_[n].ext, strlen(_g_mime_map_[n].ext),
 							_g_mime_map_[n].type, strlen(_g_mime_map_[n].type));
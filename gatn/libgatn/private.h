@@ -1,9 +1,12 @@
 #include <string.h>
+#include <atomic>
 #include "iMemory.h"
 #include "iGatn.h"
 #include "iLog.h"
 #include "iStr.h"
 #include "iSync.h"
+#include "err.h"
+#include "iTaskMaker.h"
 
 struct request: public _request_t{
 	iHttpServerConnection *mpi_httpc;
@@ -41,6 +44,8 @@ struct request: public _request_t{
 #define MAX_HOSTNAME		256
 #define MAX_ROUTE_PATH		256
 #define IDX_CONNECTION		7
+#define GATN_SERVER_PREFIX	"industrial-gatn"
+#define MAX_GATN_SERVER_NAME	256
 
 typedef struct {
 	HFCACHE	hfc; // handle from file cache
@@ -85,10 +90,9 @@ private:
 	_u32		m_sz_nocache;
 	_str_t		m_disabled;
 	_u32		m_sz_disabled;
-	iMutex		*mpi_mutex;
+	iRWLock		*mpi_lock; // read mostly lists
 	iPool		*mpi_handle_pool;
 	iStr		*mpi_str;
-	HMUTEX		m_hlock;
 	bool		m_my_heap;
 
 	void object_release(iBase **ppi);
@@ -111,6 +115,8 @@ public:
 	void close(HDOCUMENT);
 	time_t mtime(HDOCUMENT);
 	_cstr_t mime(HDOCUMENT);
+	_u32 header(HDOCUMENT, void *buffer, _u32 size);
+	bool set_header(HDOCUMENT, const void *data, _u32 size);
 	void stop(void);
 	void start(void);
 	volatile bool is_enabled(void) {
@@ -136,6 +142,11 @@ struct response: public _response_t {
 	_root_t *mpi_root;
 	iFileCache *mpi_fcache;
 	iFS *mpi_fs;
+	HBUFFER m_hbvars; // captured header variables (response cache)
+	_u32 m_sz_vars;
+	bool m_capture; // capture header variables
+	bool m_nostore; // response can't be cached
+	bool m_async; // suspended by route handler
 
 	iHttpServerConnection *connection(void) {
 		return mpi_httpc;
@@ -163,6 +174,10 @@ struct response: public _response_t {
 	void redirect(_cstr_t uri);
 	_cstr_t text(_u16 rc);
 	_u16 error(void);
+	bool suspend(void);
+	void resume(void);
+	void capture(bool enable);
+	bool content(_u8 *p_dst, _u32 size);
 	bool render(_cstr_t fname,
 		_u8 flags=RNDR_DONE|RNDR_CACHE|RNDR_RESOLVE_MT|RNDR_SET_MTIME|RNDR_USE_DOCROOT);
 	void cookie(_cstr_t name,
@@ -178,6 +193,430 @@ void init_mime_type_resolver(void);
 void uninit_mime_type_resolver(void);
 _cstr_t resolve_mime_type(_cstr_t fname);
 
+// reverse proxy
+#define MAX_PROXY_LOCATION	256
+#define MAX_UPSTREAM_HOSTS	16
+#define UPSTREAM_RING_POINTS	32 // virtual nodes per host in consistent hash ring
+#define UPSTREAM_BUFFER_SIZE	16384
+
+// balancing methods
+#define BALANCE_ROUND_ROBIN	1
+#define BALANCE_LEAST_CONN	2
+#define BALANCE_HASH		3 // consistent hash of client IP
+
+typedef struct {
+	_char_t		host[MAX_HOSTNAME];
+	_u32		port;
+	_u32		active; // connections in use
+	_u32		failures; // consecutive failures
+	time_t		down; // time of last failure (0 for healthy host)
+	time_t		checked; // time of last health check
+	iLlist		*pi_idle; // idle keep-alive connections
+}_upstream_host_t;
+
+typedef struct {
+	_u32	hash;
+	_u8	host; // index in host array
+}_ring_point_t;
+
+struct upstream {
+private:
+	_char_t			m_location[MAX_PROXY_LOCATION];
+	_u32			m_sz_location;
+	_u8			m_balance;
+	_u32			m_timeout; // in seconds
+	_u32			m_keep_alive; // max. idle connections per host
+	_u32			m_buffer_size;
+	_char_t			m_health_url[MAX_ROUTE_PATH];
+	_u32			m_health_interval; // in seconds
+	_u32			m_max_fails;
+	_upstream_host_t	m_host[MAX_UPSTREAM_HOSTS];
+	_u32			m_count;
+	_u32			m_next; // round robin cursor
+	_ring_point_t		m_ring[MAX_UPSTREAM_HOSTS * UPSTREAM_RING_POINTS];
+	_u32			m_ring_size;
+	_server_t		*mpi_server;
+	iMutex			*mpi_mutex;
+	iLog			*mpi_log;
+
+	HMUTEX lock(HMUTEX hlock=0);
+	void unlock(HMUTEX hlock);
+	void build_ring(void);
+	bool available(_upstream_host_t *ph, time_t now);
+	_upstream_host_t *select(_u32 key);
+	bool probe(_upstream_host_t *ph);
+	iHttpClientConnection *create_connection(_upstream_host_t *ph);
+public:
+	bool init(_server_t *pi_server, _cstr_t location, _u8 balance,
+		_u32 timeout, _u32 keep_alive, _u32 buffer_size,
+		_cstr_t health_url, _u32 health_interval, _u32 max_fails);
+	void destroy(void);
+	bool add_host(_cstr_t host, _u32 port);
+	bool match(_cstr_t url);
+	_cstr_t location(void) {
+		return m_location;
+	}
+	_u32 hosts(void) {
+		return m_count;
+	}
+	_upstream_host_t *host(_u32 idx) {
+		return (idx < m_count) ? &m_host[idx] : NULL;
+	}
+	_upstream_host_t *acquire(_u32 key, iHttpClientConnection **ppi_httpc);
+	void release(_upstream_host_t *ph, iHttpClientConnection *pi_httpc, bool keep);
+	void failure(_upstream_host_t *ph);
+	void success(_upstream_host_t *ph);
+	bool health_url(void) {
+		return m_health_url[0] != 0;
+	}
+	// probe hosts with expired health interval
+	void health_check(time_t now);
+	_u32 timeout(void) {
+		return m_timeout;
+	}
+};
+
+typedef struct upstream _upstream_t;
+
+typedef struct { // proxy state of client connection
+	_upstream_t		*p_upstream;
+	_upstream_host_t	*p_host;
+	iHttpClientConnection	*pi_httpc;
+	_u32			content_len; // request content to forward
+	_u32			content_rcv; // forwarded request content
+	bool			stream; // response content comes from upstream
+
+	// return upstream connection
+	void finish(bool keep) {
+		if(p_upstream && pi_httpc)
+			p_upstream->release(p_host, pi_httpc, keep);
+		p_upstream = NULL;
+		p_host = NULL;
+		pi_httpc = NULL;
+	}
+
+	void release(void) {
+		finish(false);
+		content_len = content_rcv = 0;
+		stream = false;
+	}
+}_proxy_request_t;
+
+// response cache
+#define MAX_RCACHE_VARY		4 // request headers (or cookies) in cache key
+#define MAX_RCACHE_VARY_NAME	64
+#define MAX_RCACHE_KEY		2048
+#define RCACHE_MEMORY		(16 * 1024 * 1024) // default memory limit
+#define RCACHE_MAX_OBJECT	8 // max. object size as part of memory limit (1/n)
+#define RCACHE_SKETCH_SIZE	4096 // frequency counters (admission policy)
+#define RCACHE_POOL		"gatn-rcache" // thread pool for background revalidation
+#define RCACHE_THREADS		2
+#define RCACHE_VARY_COOKIE	"cookie." // prefix for cookie names in vary list
+
+// entry state
+#define RCE_FILL	1 // handler is running
+#define RCE_READY	2 // response is available
+#define RCE_DETACHED	3 // removed from cache, but still in use
+
+// lookup result
+#define RC_BYPASS	0 // not cacheable
+#define RC_HIT		1
+#define RC_STALE	2 // expired, but still usable
+#define RC_FILL		3 // caller must run the handler and store result
+#define RC_WAIT		4 // same request is in progress
+#define RC_REVALIDATE	5 // expired (send it), and refresh it in background
+
+// coalesced request (suspended until the entry is filled)
+typedef struct rc_waiter {
+	struct rc_waiter	*next;
+	iHttpServerConnection	*p_httpc;
+	bool			retry; // resumed, don't wait again
+}_rc_waiter_t;
+
+typedef struct {
+	_u8	method;
+	_u32	ttl; // in seconds
+	_u32	stale; // stale-while-revalidate period in seconds
+	_u32	nvary;
+	_char_t	vary[MAX_RCACHE_VARY][MAX_RCACHE_VARY_NAME];
+}_rc_policy_t;
+
+typedef struct rc_entry {
+	struct rc_entry	*prev; // LRU (most recent first)
+	struct rc_entry	*next;
+	struct rc_entry	*p_stale; // entry under revalidation (for RC_FILL)
+	_rc_waiter_t	*p_waiters; // coalesced requests
+	_u8		state;
+	bool		revalidate;
+	_u32		refs;
+	_u32		hash; // key hash
+	time_t		stime; // store time
+	time_t		expire;
+	time_t		stale;
+	_u16		code;
+	_u32		sz_alloc;
+	_u32		sz_key;
+	_u32		sz_vars;
+	_u32		sz_content;
+
+	// layout: [entry][key][header variables][content]
+	_u8 *key(void) {
+		return (_u8 *)(this + 1);
+	}
+	_u8 *vars(void) {
+		return key() + sz_key;
+	}
+	_u8 *content(void) {
+		return vars() + sz_vars;
+	}
+}_rc_entry_t;
+
+struct rcache {
+private:
+	iMap		*mpi_entry_map; // key -> _rc_entry_t *
+	iMap		*mpi_policy_map; // _route_key_t -> _rc_policy_t
+	iHeap		*mpi_heap;
+	_rc_entry_t	*mp_first; // LRU list
+	_rc_entry_t	*mp_last;
+	_ulong		m_memory; // used memory
+	_ulong		m_max_memory;
+	_u32		m_additions; // sketch aging
+	_u8		m_sketch[RCACHE_SKETCH_SIZE];
+
+	void lru_add(_rc_entry_t *pe);
+	void lru_remove(_rc_entry_t *pe);
+	void touch(_u32 hash);
+	_u8 frequency(_u32 hash);
+	bool admit(_rc_entry_t *pe, _u32 size, HMUTEX hlock);
+	void evict(_rc_entry_t *pe, HMUTEX hlock);
+	void free_entry(_rc_entry_t *pe);
+	_rc_entry_t *alloc_entry(_cstr_t key, _u32 sz_key, _u32 size);
+	_rc_waiter_t *detach_waiters(_rc_entry_t *pf);
+	void wake(_rc_waiter_t *pw);
+public:
+	bool init(iHeap *pi_heap, _ulong max_memory);
+	void destroy(void);
+	void limit(_ulong max_memory) {
+		m_max_memory = (max_memory) ? max_memory : RCACHE_MEMORY;
+	}
+	bool add_policy(_u8 method, _cstr_t path, _u32 ttl, _u32 stale, _cstr_t vary);
+	bool policy(_u8 method, _cstr_t url, _rc_policy_t *p_policy);
+	_u8 lookup(_cstr_t key, _u32 sz_key, _rc_entry_t **pp_entry, _rc_entry_t **pp_fill);
+	bool wait(_cstr_t key, _u32 sz_key, _rc_waiter_t *pw);
+	bool store(_rc_entry_t *pf, _u32 ttl, _u32 stale, _u16 code, response *p_res);
+	void abort(_rc_entry_t *pf);
+	void release(_rc_entry_t *pe);
+	void clear(void);
+};
+
+typedef struct rcache _rcache_t;
+
+#define CLASS_NAME_RC_CONNECTION	"cRcConnection"
+#define RC_MAX_VARS		64 // request header variables
+#define RC_MAX_UDATA		8
+
+typedef void _rc_done_t(iHttpServerConnection *, void *);
+
+// Request replayed without client, to refresh response cache in background.
+// The response is captured by _response_t, the rest is ignored.
+class cRcConnection: public iHttpServerConnection {
+private:
+	iHeap		*mpi_heap;
+	_str_t		mp_data; // copy of request
+	_u32		m_sz_data;
+	_u8		m_method;
+	_u32		m_peer_ip;
+	_cstr_t		m_header;
+	_cstr_t		m_uri;
+	_cstr_t		m_url;
+	_cstr_t		m_urn;
+	_cstr_t		m_protocol;
+	_cstr_t		m_var_name[RC_MAX_VARS];
+	_cstr_t		m_var_value[RC_MAX_VARS];
+	_u32		m_vars;
+	_ulong		m_udata[RC_MAX_UDATA];
+	_u16		m_res_code;
+	_ulong		m_res_content_len;
+	std::atomic<_u32> m_refs; // handler + suspend
+	_rc_done_t	*mpf_done;
+	void		*mp_udata;
+
+	_str_t copy(_str_t dst, _cstr_t src);
+	void parse_header(_str_t hdr);
+	void release_data(void);
+public:
+	BASE(cRcConnection, CLASS_NAME_RC_CONNECTION, RF_CLONE, 1,0,0);
+
+	bool object_ctl(_u32 cmd, void *arg, ...);
+	// copy request from client connection
+	bool init(iHttpServerConnection *p_httpc, iHeap *pi_heap, _rc_done_t *pf_done, void *udata);
+	// end of request handler (done callback follows the response)
+	void done(void);
+
+	bool alive(void) {
+		return true;
+	}
+	void close(void) {}
+	bool peer_ip(_str_t strip, _u32 len);
+	_u32 peer_ip(void) {
+		return m_peer_ip;
+	}
+	void set_udata(_ulong udata, _u8 index=0) {
+		if(index < RC_MAX_UDATA)
+			m_udata[index] = udata;
+	}
+	_ulong get_udata(_u8 index=0) {
+		return (index < RC_MAX_UDATA) ? m_udata[index] : 0;
+	}
+	_u8 req_method(void) {
+		return m_method;
+	}
+	_cstr_t req_header(void) {
+		return m_header;
+	}
+	_cstr_t req_uri(void) {
+		return m_uri;
+	}
+	_cstr_t req_url(void) {
+		return m_url;
+	}
+	_cstr_t req_urn(void) {
+		return m_urn;
+	}
+	_cstr_t req_var(_cstr_t name);
+	_u8 *req_data(_u32 *size) {
+		*size = 0;
+		return NULL;
+	}
+	_cstr_t req_protocol(void) {
+		return m_protocol;
+	}
+	bool req_parse_content(void) {
+		return false;
+	}
+	bool res_var(_cstr_t name, _cstr_t value) {
+		return true;
+	}
+	bool res_header(const void *data, _u32 size, _u8 flags=0) {
+		return true;
+	}
+	_u16 error_code(void) {
+		return m_res_code;
+	}
+	void res_code(_u16 httprc) {
+		m_res_code = httprc;
+	}
+	_cstr_t res_text(_u16 rc) {
+		return "";
+	}
+	void res_protocol(_cstr_t protocol) {}
+	bool res_content_len(_ulong content_len) {
+		m_res_content_len = content_len;
+		return true;
+	}
+	void res_chunked(void) {
+		// not captured (see cache_response)
+		m_res_content_len = (_ulong)-1;
+	}
+	void res_content_type(_cstr_t ctype) {}
+	void res_content(void *p_doc, _ulong sz_doc) {
+		// not captured
+		m_res_content_len = (_ulong)-1;
+	}
+	_ulong res_content_len(void) {
+		return m_res_content_len;
+	}
+	void res_cookie(_cstr_t name, _cstr_t value, _u8 flags=0, _cstr_t expires=NULL,
+			_cstr_t max_age=NULL, _cstr_t path=NULL, _cstr_t domain=NULL) {}
+	_ulong res_content_sent(void) {
+		return 0;
+	}
+	void res_mtime(time_t mtime) {}
+	_u32 req_content_len(void) {
+		return 0;
+	}
+	_ulong res_remainder(void) {
+		return 0;
+	}
+	_u32 res_write(_u8 *data, _u32 size) {
+		return size;
+	}
+	_u32 res_write(_cstr_t str) {
+		return strlen(str);
+	}
+	void reject(_u16 httprc) {
+		m_res_code = httprc;
+	}
+	bool ws_upgrade(_cstr_t protocol=NULL) {
+		return false;
+	}
+	bool is_websocket(void) {
+		return false;
+	}
+	_u8 *ws_message(_u32 *size, _u8 *opcode=NULL) {
+		return NULL;
+	}
+	bool ws_send(_u8 opcode, const void *data, _u32 size) {
+		return false;
+	}
+	bool ws_close(_u16 code=WS_CLOSE_NORMAL) {
+		return false;
+	}
+	bool suspend(void);
+	void resume(bool replay=false);
+};
+
+// rate limiting
+#define LIMIT_SHARDS		16 // must be power of 2
+#define LIMIT_SHARD_SIZE	256 // buckets per shard (power of 2)
+#define LIMIT_PROBE		8 // max. probes in shard
+#define MAX_LIMIT_ROUTES	32
+
+typedef struct { // token bucket
+	_u32	ip;
+	_u32	route; // route index + 1 (0 for client bucket)
+	_u32	tokens; // in 1/1000 of token
+	_u32	conns; // open connections (client bucket)
+	_u64	stamp; // last refill (ms)
+}_bucket_t;
+
+typedef struct {
+	_char_t	path[MAX_ROUTE_PATH];
+	_u32	sz_path;
+	_u32	rate; // requests per second
+	_u32	burst;
+}_limit_route_t;
+
+typedef struct {
+	iMutex		*pi_mutex;
+	_bucket_t	bucket[LIMIT_SHARD_SIZE];
+}_limit_shard_t;
+
+struct limiter {
+private:
+	_limit_shard_t	m_shard[LIMIT_SHARDS];
+	_u32		m_rate; // requests per second per client
+	_u32		m_burst;
+	_u32		m_max_conns; // connections per client
+	_limit_route_t	m_route[MAX_LIMIT_ROUTES];
+	_u32		m_routes;
+
+	_bucket_t *bucket(_limit_shard_t *ps, _u32 ip, _u32 route, _u64 now);
+	bool take(_bucket_t *pb, _u32 rate, _u32 burst, _u64 now);
+	_limit_shard_t *shard(_u32 ip, _u32 route);
+public:
+	bool init(void);
+	void destroy(void);
+	void client(_u32 rate, _u32 burst, _u32 max_conns);
+	bool add_route(_cstr_t path, _u32 rate, _u32 burst);
+	// clients without address (ip 0) are not limited
+	bool connect(_u32 ip);
+	void disconnect(_u32 ip);
+	_u16 request(_u32 ip, _cstr_t url);
+};
+
+typedef struct limiter _limiter_t;
+
 typedef struct {
 	_gatn_http_event_t	*pcb;
 	void			*udata;
@@ -186,29 +625,52 @@ typedef struct {
 struct vhost {
 private:
 	iMutex		*pi_mutex;
-	HMUTEX		m_hlock;
 	_char_t		host[MAX_HOSTNAME];	// host name
 	_server_t	*pi_server;
+	_char_t		server_name[MAX_GATN_SERVER_NAME]; // 'Server' header value
 	_root_t		root;			// document root
 	iMap		*pi_route_map;		// URL routing map
 	iMap		*pi_class_map;		// class (plugin) map
+	iLlist		*pi_proxy_list;		// reverse proxy locations
+	_rcache_t	*p_rcache;		// response cache
+	_limiter_t	*p_limiter;		// rate limits
 	iHeap		*pi_heap;
 	iLog		*pi_log;
 	_event_data_t 	event[HTTP_MAX_EVENTS];	// HTTP event handlers
 	volatile bool	m_running;
+	iTaskMaker	*pi_tmaker;
+	HTASK		m_health_task;		// active health checks of upstreams
+	volatile bool	m_health_run;
+	iThreadPool	*pi_rc_pool;		// background revalidation
+	std::atomic<_u32> m_revalidations;	// in progress
 
 	iMutex *get_mutex(void);
 	iMap *get_route_map(void);
 	iMap *get_class_map(void);
+	iLlist *get_proxy_list(void);
+	void remove_proxies(void);
+	_upstream_t *get_proxy(_cstr_t url);
+	void proxy_request(_u8 evt, iHttpServerConnection *p_httpc);
+	void start_health(void);
+	void stop_health(void);
+	_rcache_t *get_rcache(void);
+	void remove_rcache(void);
+	bool cached_request(iHttpServerConnection *p_httpc);
+	void cache_response(iHttpServerConnection *p_httpc);
+	void cached_content(iHttpServerConnection *p_httpc, _rc_entry_t *pe, _cstr_t xcache);
+	bool revalidate(iHttpServerConnection *p_httpc, _rc_entry_t *pf);
+	void revalidated(iHttpServerConnection *p_httpc);
+	void route(_u8 evt, iHttpServerConnection *p_httpc);
+	_limiter_t *get_limiter(void);
+	void remove_limiter(void);
 	HMUTEX lock(HMUTEX hlock=0);
 	void unlock(HMUTEX hlock);
-	void _lock(void);
-	void _unlock(void);
 	void clear_events(void);
 	void start_extensions(HMUTEX hlock=0);
 	void stop_extensions(HMUTEX hlock=0);
 	void remove_extensions(void);
 	void send_content(iHttpServerConnection *p_httpc, _u8 *p_doc, _ulong sz_doc);
+	void document_header(iHttpServerConnection *p_httpc, HDOCUMENT hdoc, _ulong doc_sz);
 	void send_error(iHttpServerConnection *p_httpc, _u16 err_rc, _cstr_t err_text);
 public:
 
@@ -235,8 +697,21 @@ public:
 	bool attach_class(_cstr_t cname, _cstr_t options);
 	bool detach_class(_cstr_t cname, bool remove=true);
 	void restore_class(_cstr_t cname);
+	_upstream_t *add_proxy(_cstr_t location, _u8 balance, _u32 timeout, _u32 keep_alive,
+			_cstr_t health_url, _u32 health_interval, _u32 max_fails);
+	void enum_proxies(void (*)(_upstream_t *, void *), void *udata=NULL);
+	void proxy_response(iHttpServerConnection *p_httpc);
+	void health_thread(_u8 sig);
+	bool cache_route(_u8 method, _cstr_t path, _u32 ttl, _u32 stale, _cstr_t vary);
+	void cache_limit(_ulong max_memory);
+	bool limit_client(_u32 rate, _u32 burst, _u32 max_conns);
+	bool limit_route(_cstr_t path, _u32 rate, _u32 burst);
+	bool admit_connection(iHttpServerConnection *p_httpc);
+	void release_connection(iHttpServerConnection *p_httpc);
+	bool admit_request(iHttpServerConnection *p_httpc);
 	_s32 call_handler(_u8 evt, iHttpServerConnection *p_httpc);
 	void call_route_handler(_u8 evt, iHttpServerConnection *p_httpc);
+	void resume_response(iHttpServerConnection *p_httpc);
 };
 
 typedef struct {
@@ -245,10 +720,30 @@ typedef struct {
 	_cstr_t		url;
 	_vhost_t	*p_vhost;
 	HDOCUMENT	hdoc;
+	_proxy_request_t proxy;
+	_rcache_t	*p_rcache;
+	_rc_entry_t	*rce; // cached response in use
+	_rc_entry_t	*rce_fill; // cache entry to fill with response
+	_rc_waiter_t	rc_wait; // coalesced with request in progress
+	_u32		peer_ip; // counted by limiter (connection admission)
+
+	void release_cache(void) {
+		if(p_rcache) {
+			if(rce_fill)
+				p_rcache->abort(rce_fill);
+			if(rce)
+				p_rcache->release(rce);
+		}
+		p_rcache = NULL;
+		rce = rce_fill = NULL;
+	}
 
 	void clear(void) {
 		if(hdoc && p_vhost) // close handle
 			p_vhost->get_root()->close(hdoc);
+		proxy.release();
+		release_cache();
+		rc_wait.retry = false;
 		res.clear();
 		url = NULL;
 		hdoc = NULL;
@@ -258,6 +753,8 @@ typedef struct {
 	void destroy(void) {
 		if(hdoc && p_vhost) // close handle
 			p_vhost->get_root()->close(hdoc);
+		proxy.release();
+		release_cache();
 		req.destroy();
 		res.destroy();
 		url = NULL;
@@ -324,6 +821,8 @@ struct server: public _server_t {
 		return m_ssl_context;
 	}
 	void remove_route(_u8 method, _cstr_t path, _cstr_t host=NULL);
+	_u32 ws_broadcast(_u8 opcode, const void *data, _u32 size,
+			_ws_filter_t *pcb_filter=NULL, void *udata=NULL);
 	bool add_virtual_host(_cstr_t host, _cstr_t root, _cstr_t cache_path, _cstr_t cache_key,
 				_cstr_t cache_exclude=NULL, _cstr_t path_disable=NULL);
 	_vhost_t *get_virtual_host(_cstr_t host);
@@ -335,6 +834,14 @@ struct server: public _server_t {
 	bool detach_class(_cstr_t cname, _cstr_t host=NULL, bool remove=true);
 	void release_class(_cstr_t cname, bool remove=true);
 	void restore_class(_cstr_t cname);
+	_upstream_t *add_proxy(_cstr_t location, _u8 balance, _u32 timeout, _u32 keep_alive,
+			_cstr_t health_url, _u32 health_interval, _u32 max_fails,
+			_cstr_t host=NULL);
+	bool cache_route(_u8 method, _cstr_t path, _u32 ttl, _u32 stale=0,
+			_cstr_t vary=NULL, _cstr_t host=NULL);
+	void cache_limit(_ulong max_memory, _cstr_t host=NULL);
+	bool limit_client(_u32 rate, _u32 burst=0, _u32 max_conns=0, _cstr_t host=NULL);
+	bool limit_route(_cstr_t path, _u32 rate, _u32 burst=0, _cstr_t host=NULL);
 };
 
 // SSL
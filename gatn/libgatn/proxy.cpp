@@ -0,0 +1,678 @@
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "iRepository.h"
+#include "private.h"
+
+#define MAX_HEADER_NAME		128
+#define MAX_HEADER_VALUE	4096
+#define HEALTH_TICK		100 // milliseconds between checks for stop
+#define HEALTH_PERIOD		10 // ticks between health checks
+
+// FNV-1a
+static _u32 proxy_hash(const void *data, _u32 size, _u32 h=2166136261U) {
+	const _u8 *p = (const _u8 *)data;
+
+	for(_u32 i = 0; i < size; i++) {
+		h ^= p[i];
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+bool upstream::init(_server_t *pi_server, _cstr_t location, _u8 balance,
+		_u32 timeout, _u32 keep_alive, _u32 buffer_size,
+		_cstr_t health_url, _u32 health_interval, _u32 max_fails) {
+	bool r = false;
+
+	memset(m_location, 0, sizeof(m_location));
+	strncpy(m_location, location, sizeof(m_location)-1);
+	m_sz_location = strlen(m_location);
+	m_balance = (balance) ? balance : BALANCE_ROUND_ROBIN;
+	m_timeout = (timeout) ? timeout : HTTP_CONNECTION_TIMEOUT;
+	m_keep_alive = keep_alive;
+	m_buffer_size = (buffer_size) ? buffer_size : UPSTREAM_BUFFER_SIZE;
+	memset(m_health_url, 0, sizeof(m_health_url));
+	if(health_url)
+		strncpy(m_health_url, health_url, sizeof(m_health_url)-1);
+	m_health_interval = (health_interval) ? health_interval : 10;
+	m_max_fails = (max_fails) ? max_fails : 1;
+	memset(m_host, 0, sizeof(m_host));
+	m_count = m_next = m_ring_size = 0;
+	mpi_server = pi_server;
+	mpi_log = dynamic_cast<iLog *>(_gpi_repo_->object_by_iname(I_LOG, RF_ORIGINAL));
+
+	if((mpi_mutex = dynamic_cast<iMutex *>(_gpi_repo_->object_by_iname(I_MUTEX, RF_CLONE|RF_NONOTIFY))))
+		r = (m_sz_location) ? true : false;
+
+	return r;
+}
+
+void upstream::destroy(void) {
+	HMUTEX hm = lock();
+
+	for(_u32 i = 0; i < m_count; i++) {
+		_upstream_host_t *ph = &m_host[i];
+
+		if(ph->pi_idle) {
+			_u32 sz = 0;
+			iHttpClientConnection **ppi_httpc = NULL;
+
+			while((ppi_httpc = (iHttpClientConnection **)ph->pi_idle->first(&sz))) {
+				_gpi_repo_->object_release(*ppi_httpc);
+				ph->pi_idle->del();
+			}
+
+			_gpi_repo_->object_release(ph->pi_idle);
+			ph->pi_idle = NULL;
+		}
+	}
+
+	m_count = m_ring_size = 0;
+	unlock(hm);
+
+	if(mpi_mutex) {
+		_gpi_repo_->object_release(mpi_mutex);
+		mpi_mutex = NULL;
+	}
+	if(mpi_log) {
+		_gpi_repo_->object_release(mpi_log);
+		mpi_log = NULL;
+	}
+}
+
+HMUTEX upstream::lock(HMUTEX hlock) {
+	HMUTEX r = 0;
+
+	if(mpi_mutex)
+		r = mpi_mutex->lock(hlock);
+
+	return r;
+}
+
+void upstream::unlock(HMUTEX hlock) {
+	if(mpi_mutex)
+		mpi_mutex->unlock(hlock);
+}
+
+bool upstream::add_host(_cstr_t host, _u32 port) {
+	bool r = false;
+	HMUTEX hm = lock();
+
+	if(m_count < MAX_UPSTREAM_HOSTS) {
+		_upstream_host_t *ph = &m_host[m_count];
+
+		memset(ph, 0, sizeof(_upstream_host_t));
+		strncpy(ph->host, host, sizeof(ph->host)-1);
+		ph->port = port;
+
+		if((ph->pi_idle = dynamic_cast<iLlist *>(_gpi_repo_->object_by_iname(I_LLIST, RF_CLONE|RF_NONOTIFY)))) {
+			ph->pi_idle->init(LL_VECTOR, 1);
+			m_count++;
+			build_ring();
+			r = true;
+		}
+	}
+
+	unlock(hm);
+
+	return r;
+}
+
+void upstream::build_ring(void) {
+	m_ring_size = 0;
+
+	for(_u32 i = 0; i < m_count; i++) {
+		_char_t point[MAX_HOSTNAME + 32]="";
+
+		for(_u32 j = 0; j < UPSTREAM_RING_POINTS; j++) {
+			_u32 sz = snprintf(point, sizeof(point), "%s:%u#%u", m_host[i].host, m_host[i].port, j);
+
+			m_ring[m_ring_size].hash = proxy_hash(point, sz);
+			m_ring[m_ring_size].host = i;
+			m_ring_size++;
+		}
+	}
+
+	qsort(m_ring, m_ring_size, sizeof(_ring_point_t), [](const void *p1, const void *p2)->int {
+		_u32 h1 = ((_ring_point_t *)p1)->hash;
+		_u32 h2 = ((_ring_point_t *)p2)->hash;
+
+		return (h1 < h2) ? -1 : (h1 > h2) ? 1 : 0;
+	});
+}
+
+bool upstream::match(_cstr_t url) {
+	return (url && strncmp(url, m_location, m_sz_location) == 0);
+}
+
+bool upstream::available(_upstream_host_t *ph, time_t now) {
+	bool r = false;
+
+	if(!ph->down)
+		r = true;
+	else if(!m_health_url[0] && (now - ph->down) >= (time_t)m_health_interval) {
+		// no health checks, give one request a chance to verify the host
+		ph->down = now;
+		r = true;
+	}
+
+	return r;
+}
+
+_upstream_host_t *upstream::select(_u32 key) {
+	_upstream_host_t *r = NULL;
+	time_t now = time(NULL);
+
+	if(m_count) {
+		switch(m_balance) {
+			case BALANCE_LEAST_CONN: {
+				for(_u32 i = 0; i < m_count; i++) {
+					_upstream_host_t *ph = &m_host[(m_next + i) % m_count];
+
+					if(!ph->down && (!r || ph->active < r->active))
+						r = ph;
+				}
+
+				m_next++;
+			} break;
+			case BALANCE_HASH: {
+				_u32 h = proxy_hash(&key, sizeof(key));
+				_u32 lo = 0, hi = m_ring_size;
+
+				// first point with hash >= h
+				while(lo < hi) {
+					_u32 mid = (lo + hi) / 2;
+
+					if(m_ring[mid].hash < h)
+						lo = mid + 1;
+					else
+						hi = mid;
+				}
+
+				for(_u32 i = 0; i < m_ring_size; i++) {
+					_upstream_host_t *ph = &m_host[m_ring[(lo + i) % m_ring_size].host];
+
+					if(!ph->down) {
+						r = ph;
+						break;
+					}
+				}
+			} break;
+			default: // round robin
+				for(_u32 i = 0; i < m_count; i++) {
+					_upstream_host_t *ph = &m_host[m_next % m_count];
+
+					m_next++;
+					if(!ph->down) {
+						r = ph;
+						break;
+					}
+				}
+				break;
+		}
+
+		if(!r) {
+			// all hosts are down, try one of them (if retry interval expired)
+			for(_u32 i = 0; i < m_count; i++) {
+				_upstream_host_t *ph = &m_host[(m_next + i) % m_count];
+
+				if(available(ph, now)) {
+					r = ph;
+					break;
+				}
+			}
+		}
+	}
+
+	return r;
+}
+
+iHttpClientConnection *upstream::create_connection(_upstream_host_t *ph) {
+	iHttpClientConnection *r = NULL;
+	server *psrv = (server *)mpi_server;
+
+	if(psrv && psrv->mpi_net)
+		r = psrv->mpi_net->create_http_client(ph->host, ph->port, m_buffer_size);
+
+	return r;
+}
+
+bool upstream::probe(_upstream_host_t *ph) {
+	bool r = false;
+	iHttpClientConnection *pi_httpc = create_connection(ph);
+
+	if(pi_httpc) {
+		// only the status line matters
+		pi_httpc->req_method(HTTP_METHOD_GET);
+		pi_httpc->req_protocol("HTTP/1.1");
+		pi_httpc->req_url(m_health_url);
+		pi_httpc->req_var("Connection", "close");
+		if(pi_httpc->request(m_timeout))
+			r = (pi_httpc->res_code() && pi_httpc->res_code() < HTTPRC_INTERNAL_SERVER_ERROR);
+		_gpi_repo_->object_release(pi_httpc);
+	}
+
+	return r;
+}
+
+void upstream::health_check(time_t now) {
+	if(m_health_url[0]) {
+		for(_u32 i = 0; i < m_count; i++) {
+			_upstream_host_t *ph = &m_host[i];
+
+			if((now - ph->checked) >= (time_t)m_health_interval) {
+				ph->checked = now;
+				// state changes are logged by success/failure
+				if(probe(ph))
+					success(ph);
+				else
+					failure(ph);
+			}
+		}
+	}
+}
+
+_upstream_host_t *upstream::acquire(_u32 key, iHttpClientConnection **ppi_httpc) {
+	_upstream_host_t *r = NULL;
+	iHttpClientConnection *pi_httpc = NULL;
+	HMUTEX hm = lock();
+
+	if((r = select(key))) {
+		_u32 sz = 0;
+		iHttpClientConnection **ppi = NULL;
+
+		// reuse idle keep-alive connection
+		while(!pi_httpc && (ppi = (iHttpClientConnection **)r->pi_idle->last(&sz, hm))) {
+			pi_httpc = *ppi;
+			r->pi_idle->del(hm);
+
+			if(!pi_httpc->alive()) {
+				_gpi_repo_->object_release(pi_httpc);
+				pi_httpc = NULL;
+			}
+		}
+
+		r->active++;
+	}
+
+	unlock(hm);
+
+	if(r && !pi_httpc) {
+		if(!(pi_httpc = create_connection(r))) {
+			failure(r);
+			hm = lock();
+			r->active--;
+			unlock(hm);
+			r = NULL;
+		}
+	}
+
+	*ppi_httpc = pi_httpc;
+
+	return r;
+}
+
+void upstream::release(_upstream_host_t *ph, iHttpClientConnection *pi_httpc, bool keep) {
+	HMUTEX hm = lock();
+
+	if(ph->active)
+		ph->active--;
+
+	if(keep && pi_httpc->alive() && ph->pi_idle->cnt(hm) < m_keep_alive) {
+		ph->pi_idle->col(0, hm);
+		ph->pi_idle->add(&pi_httpc, sizeof(pi_httpc), hm);
+	} else
+		_gpi_repo_->object_release(pi_httpc);
+
+	unlock(hm);
+}
+
+void upstream::failure(_upstream_host_t *ph) {
+	HMUTEX hm = lock();
+
+	ph->failures++;
+	if(ph->failures >= m_max_fails) {
+		if(!ph->down && mpi_log)
+			mpi_log->fwrite(LMT_WARNING, "Gatn: upstream '%s:%u' (%s) is down",
+					ph->host, ph->port, m_location);
+		ph->down = time(NULL);
+	}
+
+	unlock(hm);
+}
+
+void upstream::success(_upstream_host_t *ph) {
+	HMUTEX hm = lock();
+
+	if(ph->down && mpi_log)
+		mpi_log->fwrite(LMT_INFO, "Gatn: upstream '%s:%u' (%s) is up",
+				ph->host, ph->port, m_location);
+	ph->failures = 0;
+	ph->down = 0;
+
+	unlock(hm);
+}
+
+// return true for hop-by-hop headers (must not be forwarded)
+static bool hop_by_hop(_cstr_t name) {
+	static _cstr_t _hop[] = {
+		"Connection", "Keep-Alive", "Proxy-Authenticate", "Proxy-Authorization",
+		"TE", "Trailer", "Transfer-Encoding", "Upgrade", "Host", "Content-Length",
+		"Expect", NULL
+	};
+	bool r = false;
+
+	for(_u32 i = 0; _hop[i]; i++) {
+		if(strcasecmp(name, _hop[i]) == 0) {
+			r = true;
+			break;
+		}
+	}
+
+	return r;
+}
+
+typedef void _on_header_t(_cstr_t name, _cstr_t value, void *udata);
+
+// call 'pcb' for every header line after the start line
+static void enum_headers(_cstr_t hdr, _u32 size, _on_header_t *pcb, void *udata) {
+	_char_t name[MAX_HEADER_NAME]="";
+	_char_t value[MAX_HEADER_VALUE]="";
+	_cstr_t end = hdr + size;
+	_cstr_t eol = (_cstr_t)memmem(hdr, size, "\r\n", 2);
+
+	while(eol) {
+		_cstr_t line = eol + 2;
+		_cstr_t colon = NULL;
+
+		if(line >= end)
+			break;
+
+		eol = (_cstr_t)memmem(line, end - line, "\r\n", 2);
+		_u32 sz_line = (eol) ? (eol - line) : (end - line);
+
+		if(sz_line && (colon = (_cstr_t)memchr(line, ':', sz_line))) {
+			_u32 sz_name = colon - line;
+			_cstr_t val = colon + 1;
+
+			while(*val == ' ' && val < line + sz_line)
+				val++;
+
+			_u32 sz_value = (line + sz_line) - val;
+
+			if(sz_name < sizeof(name) && sz_value < sizeof(value)) {
+				memcpy(name, line, sz_name);
+				name[sz_name] = 0;
+				memcpy(value, val, sz_value);
+				value[sz_value] = 0;
+				pcb(name, value, udata);
+			}
+		}
+	}
+}
+
+typedef struct {
+	iHttpClientConnection	*pi_httpc;
+	_char_t			fwd[MAX_HEADER_VALUE]; // X-Forwarded-For of client
+}_copy_request_t;
+
+// copy request line target and end-to-end headers from original request
+static void copy_request(iHttpServerConnection *p_httpc, iHttpClientConnection *pi_httpc) {
+	_cstr_t hdr = p_httpc->req_header();
+	_char_t value[MAX_HEADER_VALUE]="";
+	_char_t peer[32]="";
+	_copy_request_t cr;
+
+	cr.pi_httpc = pi_httpc;
+	cr.fwd[0] = 0;
+
+	pi_httpc->req_method(p_httpc->req_method());
+	pi_httpc->req_protocol("HTTP/1.1");
+
+	if(hdr) {
+		// keep the original (not decoded) request target
+		_cstr_t target = strchr(hdr, ' ');
+		_cstr_t eol = strstr(hdr, "\r\n");
+
+		if(target) {
+			_cstr_t end = strchr(++target, ' ');
+
+			if(end && (!eol || end < eol)) {
+				_u32 sz = end - target;
+
+				if(sz >= sizeof(value))
+					sz = sizeof(value) - 1;
+				memcpy(value, target, sz);
+				value[sz] = 0;
+				pi_httpc->req_url(value);
+			}
+		}
+
+		enum_headers(hdr, strlen(hdr), [](_cstr_t name, _cstr_t value, void *udata) {
+			_copy_request_t *pcr = (_copy_request_t *)udata;
+
+			if(strcasecmp(name, "X-Forwarded-For") == 0)
+				snprintf(pcr->fwd, sizeof(pcr->fwd), "%s", value);
+			else if(!hop_by_hop(name))
+				pcr->pi_httpc->req_var(name, value);
+		}, &cr);
+	} else
+		pi_httpc->req_url(p_httpc->req_uri());
+
+	if(p_httpc->peer_ip(peer, sizeof(peer))) {
+		// keep the chain of proxies in front of us
+		if(cr.fwd[0]) {
+			_char_t chain[sizeof(cr.fwd) + sizeof(peer) + 2];
+
+			snprintf(chain, sizeof(chain), "%s, %s", cr.fwd, peer);
+			pi_httpc->req_var("X-Forwarded-For", chain);
+		} else
+			pi_httpc->req_var("X-Forwarded-For", peer);
+	} else if(cr.fwd[0])
+		pi_httpc->req_var("X-Forwarded-For", cr.fwd);
+	if((hdr = p_httpc->req_var("Host")))
+		pi_httpc->req_var("X-Forwarded-Host", hdr);
+	pi_httpc->req_var("Connection", "keep-alive");
+}
+
+// copy end-to-end response headers from upstream
+static void copy_response(iHttpClientConnection *pi_httpc, iHttpServerConnection *p_httpc) {
+	_u32 sz = 0;
+	_cstr_t hdr = pi_httpc->res_header(&sz);
+
+	if(hdr) {
+		enum_headers(hdr, sz, [](_cstr_t name, _cstr_t value, void *udata) {
+			// 'Date' is set by the server
+			if(!hop_by_hop(name) && strcasecmp(name, "Date") != 0)
+				((iHttpServerConnection *)udata)->res_var(name, value);
+		}, p_httpc);
+	}
+}
+
+_upstream_t *vhost::get_proxy(_cstr_t url) {
+	_upstream_t *r = NULL;
+
+	if(pi_proxy_list && url) {
+		_u32 sz = 0;
+		HMUTEX hm = pi_proxy_list->lock();
+		_upstream_t *p = (_upstream_t *)pi_proxy_list->first(&sz, hm);
+
+		while(p) {
+			if(p->match(url)) {
+				r = p;
+				break;
+			}
+
+			p = (_upstream_t *)pi_proxy_list->next(&sz, hm);
+		}
+
+		pi_proxy_list->unlock(hm);
+	}
+
+	return r;
+}
+
+void vhost::proxy_request(_u8 evt, iHttpServerConnection *p_httpc) {
+	_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
+	_proxy_request_t *pr = &pc->proxy;
+	_u32 sz = 0;
+	_u8 *data = NULL;
+
+	if(evt == HTTP_ON_REQUEST) {
+		if((pr->p_host = pr->p_upstream->acquire(p_httpc->peer_ip(), &pr->pi_httpc))) {
+			pr->pi_httpc->reset();
+			copy_request(p_httpc, pr->pi_httpc);
+			pr->content_len = p_httpc->req_content_len();
+			pr->content_rcv = 0;
+			pr->stream = false;
+		} else {
+			pr->p_upstream = NULL;
+			send_error(p_httpc, HTTPRC_SERVICE_UNAVAILABLE, "Service unavailable !\n");
+			return;
+		}
+	}
+
+	if(!pr->pi_httpc || pr->stream)
+		return;
+
+	if(evt == HTTP_ON_REQUEST || evt == HTTP_ON_REQUEST_DATA) {
+		// forward request content
+		if((data = p_httpc->req_data(&sz)) && sz) {
+			pr->pi_httpc->req_write(data, sz);
+			pr->content_rcv += sz;
+		}
+
+		if(pr->content_rcv >= pr->content_len) {
+			// complete request, wait for response header only
+			iHttpClientConnection *pi_httpc = pr->pi_httpc;
+
+			if(pi_httpc->request(pr->p_upstream->timeout())) {
+				pr->p_upstream->success(pr->p_host);
+				copy_response(pi_httpc, p_httpc);
+				p_httpc->res_protocol("HTTP/1.1");
+				p_httpc->res_code(pi_httpc->res_code());
+
+				if(pi_httpc->res_complete())
+					// no content
+					p_httpc->res_content_len(0);
+				else if(!pi_httpc->res_var("Transfer-Encoding") && pi_httpc->res_var("Content-Length"))
+					p_httpc->res_content_len(pi_httpc->res_content_len());
+				else
+					p_httpc->res_chunked();
+
+				// content goes to client by HTTP_ON_RESPONSE_DATA
+				pr->stream = true;
+				proxy_response(p_httpc);
+			} else {
+				pr->p_upstream->failure(pr->p_host);
+				pr->release();
+				send_error(p_httpc, HTTPRC_BAD_GATEWAY, "Bad gateway !\n");
+			}
+		}
+	} else if(evt == HTTP_ON_ERROR)
+		pr->release();
+}
+
+void vhost::proxy_response(iHttpServerConnection *p_httpc) {
+	_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
+	_proxy_request_t *pr = &pc->proxy;
+	iHttpClientConnection *pi_httpc = pr->pi_httpc;
+
+	if(pi_httpc) {
+		// one output buffer of client connection at time
+		_u8 buffer[UPSTREAM_BUFFER_SIZE];
+		_u32 sz = ((server *)pi_server)->m_buffer_size;
+		_u32 n = 0;
+
+		if(!sz || sz > sizeof(buffer))
+			sz = sizeof(buffer);
+
+		if((n = pi_httpc->res_read(buffer, sz, pr->p_upstream->timeout())))
+			p_httpc->res_write(buffer, n);
+
+		if(pi_httpc->res_complete()) {
+			_cstr_t conn = pi_httpc->res_var("Connection");
+
+			pr->finish(!(conn && strcasecmp(conn, "close") == 0));
+		} else if(!n) {
+			// upstream failed in the middle of content
+			pr->p_upstream->failure(pr->p_host);
+			pr->finish(false);
+			p_httpc->close();
+		}
+	}
+}
+
+static void *_health_thread(_u8 sig, void *arg) {
+	vhost *pvhost = (vhost *)arg;
+
+	pvhost->health_thread(sig);
+
+	return NULL;
+}
+
+void vhost::health_thread(_u8 sig) {
+	if(sig == TM_SIG_START) {
+		_u32 tick = 0;
+
+		while(m_health_run) {
+			if(!(tick++ % HEALTH_PERIOD)) {
+				// probes run outside of proxy list lock (proxies are removed after stop)
+				_u32 n = 0, sz = 0;
+				_upstream_t **pp_list = NULL;
+				HMUTEX hm = pi_proxy_list->lock();
+				_u32 cnt = pi_proxy_list->cnt(hm);
+
+				if(cnt && (pp_list = (_upstream_t **)pi_heap->alloc(cnt * sizeof(_upstream_t *)))) {
+					_upstream_t *p = (_upstream_t *)pi_proxy_list->first(&sz, hm);
+
+					while(p && n < cnt) {
+						pp_list[n++] = p;
+						p = (_upstream_t *)pi_proxy_list->next(&sz, hm);
+					}
+				}
+
+				pi_proxy_list->unlock(hm);
+
+				if(pp_list) {
+					time_t now = time(NULL);
+
+					for(_u32 i = 0; i < n && m_health_run; i++)
+						pp_list[i]->health_check(now);
+					pi_heap->free(pp_list, cnt * sizeof(_upstream_t *));
+				}
+			}
+
+			usleep(HEALTH_TICK * 1000);
+		}
+	} else if(sig == TM_SIG_STOP)
+		m_health_run = false;
+}
+
+void vhost::start_health(void) {
+	if(!m_health_task) {
+		if(!pi_tmaker)
+			pi_tmaker = dynamic_cast<iTaskMaker *>(_gpi_repo_->object_by_iname(I_TASK_MAKER, RF_ORIGINAL));
+
+		if(pi_tmaker) {
+			m_health_run = true;
+			if(!(m_health_task = pi_tmaker->start(_health_thread, this, "gatn-health")))
+				m_health_run = false;
+		}
+	}
+}
+
+void vhost::stop_health(void) {
+	if(m_health_task) {
+		// blocks until the thread returns (upstreams are destroyed after that)
+		pi_tmaker->stop(m_health_task);
+		m_health_task = NULL;
+	}
+
+	if(pi_tmaker) {
+		_gpi_repo_->object_release(pi_tmaker);
+		pi_tmaker = NULL;
+	}
+}
@@ -0,0 +1,176 @@
+#include <string.h>
+#include <strings.h>
+#include <arpa/inet.h>
+#include "iRepository.h"
+#include "private.h"
+
+bool cRcConnection::object_ctl(_u32 cmd, void *arg, ...) {
+	bool r = false;
+
+	switch(cmd) {
+		case OCTL_INIT:
+			mpi_heap = NULL;
+			mp_data = NULL;
+			m_sz_data = 0;
+			m_vars = 0;
+			mpf_done = NULL;
+			mp_udata = NULL;
+			r = true;
+			break;
+		case OCTL_UNINIT:
+			release_data();
+			r = true;
+			break;
+	}
+
+	return r;
+}
+
+void cRcConnection::release_data(void) {
+	if(mp_data && mpi_heap) {
+		mpi_heap->free(mp_data, m_sz_data);
+		mp_data = NULL;
+		m_sz_data = 0;
+	}
+}
+
+_str_t cRcConnection::copy(_str_t dst, _cstr_t src) {
+	_u32 sz = strlen(src) + 1;
+
+	memcpy(dst, src, sz);
+
+	return dst + sz;
+}
+
+// split 'name: value' lines of header copy
+void cRcConnection::parse_header(_str_t hdr) {
+	_str_t p = strstr(hdr, "\r\n"); // skip request line
+
+	m_vars = 0;
+	while(p && m_vars < RC_MAX_VARS) {
+		_str_t name = p + 2;
+		_str_t colon = NULL;
+
+		if((p = strstr(name, "\r\n")))
+			*p = 0;
+		if((colon = strchr(name, ':'))) {
+			_str_t value = colon + 1;
+
+			*colon = 0;
+			while(*value == ' ')
+				value++;
+			m_var_name[m_vars] = name;
+			m_var_value[m_vars] = value;
+			m_vars++;
+		}
+	}
+}
+
+bool cRcConnection::init(iHttpServerConnection *p_httpc, iHeap *pi_heap,
+			_rc_done_t *pf_done, void *udata) {
+	bool r = false;
+	_cstr_t hdr = p_httpc->req_header();
+	_cstr_t uri = p_httpc->req_uri();
+	_cstr_t url = p_httpc->req_url();
+	_cstr_t urn = p_httpc->req_urn();
+	_cstr_t protocol = p_httpc->req_protocol();
+
+	release_data();
+	mpi_heap = pi_heap;
+	m_method = p_httpc->req_method();
+	m_peer_ip = p_httpc->peer_ip();
+	m_res_code = 0;
+	m_res_content_len = 0;
+	m_refs = 1;
+	mpf_done = pf_done;
+	mp_udata = udata;
+	memset(m_udata, 0, sizeof(m_udata));
+
+	if(!hdr)
+		hdr = "";
+	if(!uri)
+		uri = "";
+	if(!urn)
+		urn = "";
+	if(!protocol)
+		protocol = "HTTP/1.1";
+
+	if(url && mpi_heap) {
+		// header (twice: as is and parsed), URI, URL, URN, protocol
+		m_sz_data = strlen(hdr) * 2 + strlen(uri) + strlen(url) + strlen(urn) +
+				strlen(protocol) + 6;
+
+		if((mp_data = (_str_t)mpi_heap->alloc(m_sz_data))) {
+			_str_t p = mp_data;
+			_str_t parsed = NULL;
+
+			m_header = p;
+			p = copy(p, hdr);
+			parsed = p;
+			p = copy(p, hdr);
+			m_uri = p;
+			p = copy(p, uri);
+			m_url = p;
+			p = copy(p, url);
+			m_urn = p;
+			p = copy(p, urn);
+			m_protocol = p;
+			copy(p, protocol);
+			parse_header(parsed);
+			r = true;
+		} else
+			m_sz_data = 0;
+	}
+
+	return r;
+}
+
+bool cRcConnection::peer_ip(_str_t strip, _u32 len) {
+	struct in_addr addr;
+
+	addr.s_addr = m_peer_ip;
+
+	return inet_ntop(AF_INET, &addr, strip, len) != NULL;
+}
+
+_cstr_t cRcConnection::req_var(_cstr_t name) {
+	_cstr_t r = NULL;
+
+	if(strcmp(name, VAR_REQ_HEADER) == 0)
+		r = m_header;
+	else if(strcmp(name, VAR_REQ_URI) == 0)
+		r = m_uri;
+	else if(strcmp(name, VAR_REQ_URL) == 0)
+		r = m_url;
+	else if(strcmp(name, VAR_REQ_URN) == 0)
+		r = m_urn;
+	else if(strcmp(name, VAR_REQ_PROTOCOL) == 0)
+		r = m_protocol;
+	else {
+		for(_u32 i = 0; i < m_vars; i++) {
+			if(strcasecmp(name, m_var_name[i]) == 0) {
+				r = m_var_value[i];
+				break;
+			}
+		}
+	}
+
+	return r;
+}
+
+bool cRcConnection::suspend(void) {
+	// asynchronous handler
+	m_refs++;
+	return true;
+}
+
+void cRcConnection::resume(bool replay) {
+	done();
+}
+
+void cRcConnection::done(void) {
+	if(--m_refs == 0 && mpf_done)
+		mpf_done(this, mp_udata);
+}
+
+static cRcConnection _g_rc_connection_;
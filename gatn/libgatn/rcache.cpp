@@ -0,0 +1,466 @@
+#include <string.h>
+#include <time.h>
+#include "iRepository.h"
+#include "private.h"
+
+#define SKETCH_DEPTH	4 // counters per key
+#define SKETCH_MAX	15 // counter saturation
+#define SKETCH_AGING	(RCACHE_SKETCH_SIZE * 8) // halve counters after n additions
+
+// FNV-1a
+static _u32 rc_hash(const void *data, _u32 size) {
+	const _u8 *p = (const _u8 *)data;
+	_u32 h = 2166136261U;
+
+	for(_u32 i = 0; i < size; i++) {
+		h ^= p[i];
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+bool rcache::init(iHeap *pi_heap, _ulong max_memory) {
+	bool r = false;
+
+	mpi_heap = pi_heap;
+	mp_first = mp_last = NULL;
+	m_memory = 0;
+	m_additions = 0;
+	memset(m_sketch, 0, sizeof(m_sketch));
+	limit(max_memory);
+	mpi_entry_map = dynamic_cast<iMap *>(_gpi_repo_->object_by_iname(I_MAP, RF_CLONE|RF_NONOTIFY));
+	mpi_policy_map = dynamic_cast<iMap *>(_gpi_repo_->object_by_iname(I_MAP, RF_CLONE|RF_NONOTIFY));
+
+	if(mpi_heap && mpi_entry_map && mpi_policy_map) {
+		r = mpi_entry_map->init(1024, mpi_heap);
+		r &= mpi_policy_map->init(31, mpi_heap);
+	}
+
+	return r;
+}
+
+void rcache::destroy(void) {
+	clear();
+
+	if(mpi_entry_map) {
+		_gpi_repo_->object_release(mpi_entry_map);
+		mpi_entry_map = NULL;
+	}
+
+	if(mpi_policy_map) {
+		_gpi_repo_->object_release(mpi_policy_map);
+		mpi_policy_map = NULL;
+	}
+}
+
+void rcache::clear(void) {
+	if(mpi_entry_map) {
+		HMUTEX hm = mpi_entry_map->lock();
+
+		while(mp_first)
+			evict(mp_first, hm);
+
+		mpi_entry_map->clr(hm);
+		m_memory = 0;
+		mpi_entry_map->unlock(hm);
+	}
+}
+
+bool rcache::add_policy(_u8 method, _cstr_t path, _u32 ttl, _u32 stale, _cstr_t vary) {
+	bool r = false;
+	_route_key_t key;
+	_rc_policy_t pol;
+
+	memset(&key, 0, sizeof(_route_key_t));
+	key.method = method;
+	strncpy(key.path, path, sizeof(key.path)-1);
+
+	memset(&pol, 0, sizeof(_rc_policy_t));
+	pol.method = method;
+	pol.ttl = ttl;
+	pol.stale = stale;
+
+	if(vary) {
+		// name1:name2:cookie.name3...
+		_cstr_t p = vary;
+
+		while(*p && pol.nvary < MAX_RCACHE_VARY) {
+			_cstr_t e = strchr(p, ':');
+			_u32 sz = (e) ? (e - p) : strlen(p);
+
+			if(sz && sz < MAX_RCACHE_VARY_NAME) {
+				memcpy(pol.vary[pol.nvary], p, sz);
+				pol.nvary++;
+			}
+
+			p += sz;
+			if(*p == ':')
+				p++;
+		}
+	}
+
+	if(ttl && mpi_policy_map->set(&key, key.size(), &pol, sizeof(_rc_policy_t)))
+		r = true;
+
+	return r;
+}
+
+bool rcache::policy(_u8 method, _cstr_t url, _rc_policy_t *p_policy) {
+	bool r = false;
+	_route_key_t key;
+	_u32 sz = 0;
+
+	memset(&key, 0, sizeof(_route_key_t));
+	key.method = method;
+	strncpy(key.path, url, sizeof(key.path)-1);
+
+	HMUTEX hm = mpi_policy_map->lock();
+	_rc_policy_t *p = (_rc_policy_t *)mpi_policy_map->get(&key, key.size(), &sz, hm);
+
+	if(p) {
+		memcpy(p_policy, p, sizeof(_rc_policy_t));
+		r = true;
+	}
+
+	mpi_policy_map->unlock(hm);
+
+	return r;
+}
+
+void rcache::lru_add(_rc_entry_t *pe) {
+	pe->prev = NULL;
+	pe->next = mp_first;
+	if(mp_first)
+		mp_first->prev = pe;
+	mp_first = pe;
+	if(!mp_last)
+		mp_last = pe;
+}
+
+void rcache::lru_remove(_rc_entry_t *pe) {
+	if(pe->prev)
+		pe->prev->next = pe->next;
+	else
+		mp_first = pe->next;
+
+	if(pe->next)
+		pe->next->prev = pe->prev;
+	else
+		mp_last = pe->prev;
+
+	pe->prev = pe->next = NULL;
+}
+
+void rcache::touch(_u32 hash) {
+	_u32 h = hash;
+
+	for(_u32 i = 0; i < SKETCH_DEPTH; i++) {
+		_u8 *pc = &m_sketch[h % RCACHE_SKETCH_SIZE];
+
+		if(*pc < SKETCH_MAX)
+			(*pc)++;
+		h = (h >> 11 | h << 21) * 0x9e3779b1;
+	}
+
+	if(++m_additions >= SKETCH_AGING) {
+		// aging (keep the recent popularity)
+		for(_u32 i = 0; i < RCACHE_SKETCH_SIZE; i++)
+			m_sketch[i] >>= 1;
+		m_additions = 0;
+	}
+}
+
+_u8 rcache::frequency(_u32 hash) {
+	_u8 r = SKETCH_MAX;
+	_u32 h = hash;
+
+	for(_u32 i = 0; i < SKETCH_DEPTH; i++) {
+		_u8 c = m_sketch[h % RCACHE_SKETCH_SIZE];
+
+		if(c < r)
+			r = c;
+		h = (h >> 11 | h << 21) * 0x9e3779b1;
+	}
+
+	return r;
+}
+
+_rc_entry_t *rcache::alloc_entry(_cstr_t key, _u32 sz_key, _u32 size) {
+	_u32 sz_alloc = sizeof(_rc_entry_t) + sz_key + size;
+	_rc_entry_t *r = (_rc_entry_t *)mpi_heap->alloc(sz_alloc);
+
+	if(r) {
+		memset(r, 0, sizeof(_rc_entry_t));
+		r->sz_alloc = sz_alloc;
+		r->sz_key = sz_key;
+		r->hash = rc_hash(key, sz_key);
+		memcpy(r->key(), key, sz_key);
+	}
+
+	return r;
+}
+
+void rcache::free_entry(_rc_entry_t *pe) {
+	mpi_heap->free(pe, pe->sz_alloc);
+}
+
+void rcache::evict(_rc_entry_t *pe, HMUTEX hlock) {
+	_u32 sz = 0;
+	_rc_entry_t **pp = (_rc_entry_t **)mpi_entry_map->get(pe->key(), pe->sz_key, &sz, hlock);
+
+	if(pp && *pp == pe)
+		mpi_entry_map->del(pe->key(), pe->sz_key, hlock);
+
+	lru_remove(pe);
+	m_memory -= pe->sz_alloc;
+	pe->state = RCE_DETACHED;
+
+	if(!pe->refs)
+		// nobody sends it
+		free_entry(pe);
+}
+
+bool rcache::admit(_rc_entry_t *pe, _u32 size, HMUTEX hlock) {
+	bool r = false;
+
+	if(size <= m_max_memory / RCACHE_MAX_OBJECT) {
+		_u8 freq = frequency(pe->hash);
+
+		r = true;
+		while(m_memory + size > m_max_memory) {
+			_rc_entry_t *victim = mp_last;
+
+			// keep the victim if it's more popular than candidate
+			if(!victim || frequency(victim->hash) > freq) {
+				r = false;
+				break;
+			}
+
+			evict(victim, hlock);
+		}
+	}
+
+	return r;
+}
+
+_u8 rcache::lookup(_cstr_t key, _u32 sz_key, _rc_entry_t **pp_entry, _rc_entry_t **pp_fill) {
+	_u8 r = RC_BYPASS;
+	_u32 sz = 0;
+	time_t now = time(NULL);
+	HMUTEX hm = mpi_entry_map->lock();
+	_rc_entry_t **pp = (_rc_entry_t **)mpi_entry_map->get(key, sz_key, &sz, hm);
+	_rc_entry_t *pe = (pp) ? *pp : NULL;
+
+	touch(rc_hash(key, sz_key));
+
+	if(pe) {
+		if(pe->state == RCE_READY) {
+			if(now < pe->expire) {
+				pe->refs++;
+				lru_remove(pe);
+				lru_add(pe);
+				*pp_entry = pe;
+				r = RC_HIT;
+			} else if(!pe->revalidate) {
+				// this request refreshes the entry
+				_rc_entry_t *pf = alloc_entry(key, sz_key, 0);
+
+				if(pf) {
+					pf->state = RCE_FILL;
+					pf->p_stale = pe;
+					pe->revalidate = true;
+					pe->refs++;
+					if(now < pe->stale) {
+						// send stale content, refresh it in background
+						pe->refs++;
+						*pp_entry = pe;
+						*pp_fill = pf;
+						r = RC_REVALIDATE;
+					} else {
+						*pp_entry = pf;
+						r = RC_FILL;
+					}
+				}
+			} else if(now < pe->stale) {
+				// serve stale content while revalidating
+				pe->refs++;
+				*pp_entry = pe;
+				r = RC_STALE;
+			} else
+				r = RC_WAIT;
+		} else
+			// coalesce with request in progress
+			r = RC_WAIT;
+	} else {
+		_rc_entry_t *pf = alloc_entry(key, sz_key, 0);
+
+		if(pf) {
+			pf->state = RCE_FILL;
+			if(mpi_entry_map->add(key, sz_key, &pf, sizeof(pf), hm)) {
+				*pp_entry = pf;
+				r = RC_FILL;
+			} else
+				free_entry(pf);
+		}
+	}
+
+	mpi_entry_map->unlock(hm);
+
+	return r;
+}
+
+bool rcache::wait(_cstr_t key, _u32 sz_key, _rc_waiter_t *pw) {
+	bool r = false;
+	_u32 sz = 0;
+	HMUTEX hm = mpi_entry_map->lock();
+	_rc_entry_t **pp = (_rc_entry_t **)mpi_entry_map->get(key, sz_key, &sz, hm);
+	_rc_entry_t *pe = (pp) ? *pp : NULL;
+
+	if(pe && (pe->state == RCE_FILL || pe->revalidate)) {
+		// resumed by store or abort
+		pw->retry = true;
+		pw->next = pe->p_waiters;
+		pe->p_waiters = pw;
+		r = true;
+	}
+
+	mpi_entry_map->unlock(hm);
+
+	return r;
+}
+
+// under lock
+_rc_waiter_t *rcache::detach_waiters(_rc_entry_t *pf) {
+	_rc_waiter_t *r = pf->p_waiters;
+
+	pf->p_waiters = NULL;
+	if(pf->p_stale && pf->p_stale->p_waiters) {
+		_rc_waiter_t *pw = pf->p_stale->p_waiters;
+
+		while(pw->next)
+			pw = pw->next;
+		pw->next = r;
+		r = pf->p_stale->p_waiters;
+		pf->p_stale->p_waiters = NULL;
+	}
+
+	return r;
+}
+
+void rcache::wake(_rc_waiter_t *pw) {
+	while(pw) {
+		// waiter can be reused after resume
+		_rc_waiter_t *next = pw->next;
+
+		pw->next = NULL;
+		pw->p_httpc->resume(true);
+		pw = next;
+	}
+}
+
+bool rcache::store(_rc_entry_t *pf, _u32 ttl, _u32 stale, _u16 code, response *p_res) {
+	bool r = false;
+	_u32 sz_vars = p_res->m_sz_vars;
+	_u32 sz_content = p_res->m_content_len;
+	_rc_entry_t *pe = alloc_entry((_cstr_t)pf->key(), pf->sz_key, sz_vars + sz_content);
+
+	if(pe) {
+		// copy response outside the lock
+		_u8 *vars = (sz_vars) ? (_u8 *)p_res->mpi_bmap->ptr(p_res->m_hbvars) : NULL;
+
+		if(vars)
+			memcpy(pe->vars(), vars, sz_vars);
+		pe->sz_vars = sz_vars;
+		pe->sz_content = sz_content;
+		if(!p_res->content(pe->content(), sz_content)) {
+			free_entry(pe);
+			pe = NULL;
+		}
+	}
+
+	HMUTEX hm = mpi_entry_map->lock();
+	_rc_waiter_t *pw = detach_waiters(pf);
+
+	if(pf->p_stale) {
+		// replace entry under revalidation
+		_rc_entry_t *ps = pf->p_stale;
+
+		ps->refs--;
+		ps->revalidate = false;
+		if(pe && ps->state == RCE_READY)
+			evict(ps, hm);
+		else if(ps->state == RCE_DETACHED && !ps->refs)
+			free_entry(ps);
+		pf->p_stale = NULL;
+	}
+
+	if(pe && admit(pe, pe->sz_alloc, hm)) {
+		time_t now = time(NULL);
+
+		pe->state = RCE_READY;
+		pe->code = code;
+		pe->stime = now;
+		pe->expire = now + ttl;
+		pe->stale = pe->expire + stale;
+		if(mpi_entry_map->set(pe->key(), pe->sz_key, &pe, sizeof(pe), hm)) {
+			lru_add(pe);
+			m_memory += pe->sz_alloc;
+			r = true;
+		}
+	}
+
+	if(!r) {
+		_u32 sz = 0;
+		_rc_entry_t **pp = (_rc_entry_t **)mpi_entry_map->get(pf->key(), pf->sz_key, &sz, hm);
+
+		// remove placeholder (wake up coalesced requests)
+		if(pp && *pp == pf)
+			mpi_entry_map->del(pf->key(), pf->sz_key, hm);
+	}
+
+	mpi_entry_map->unlock(hm);
+
+	if(pe && !r)
+		free_entry(pe);
+	free_entry(pf);
+	wake(pw);
+
+	return r;
+}
+
+void rcache::abort(_rc_entry_t *pf) {
+	HMUTEX hm = mpi_entry_map->lock();
+	_rc_waiter_t *pw = detach_waiters(pf);
+
+	if(pf->p_stale) {
+		// next request will try to refresh it
+		_rc_entry_t *ps = pf->p_stale;
+
+		ps->revalidate = false;
+		ps->refs--;
+		if(ps->state == RCE_DETACHED && !ps->refs)
+			free_entry(ps);
+	} else {
+		_u32 sz = 0;
+		_rc_entry_t **pp = (_rc_entry_t **)mpi_entry_map->get(pf->key(), pf->sz_key, &sz, hm);
+
+		if(pp && *pp == pf)
+			mpi_entry_map->del(pf->key(), pf->sz_key, hm);
+	}
+
+	mpi_entry_map->unlock(hm);
+	free_entry(pf);
+	wake(pw);
+}
+
+void rcache::release(_rc_entry_t *pe) {
+	HMUTEX hm = mpi_entry_map->lock();
+
+	if(pe->refs)
+		pe->refs--;
+	if(pe->state == RCE_DETACHED && !pe->refs)
+		free_entry(pe);
+
+	mpi_entry_map->unlock(hm);
+}
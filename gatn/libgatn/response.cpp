@@ -53,6 +53,31 @@ void response::clear(void) {
 
 	m_content_len = 0;
 	m_buffers = 0;
+
+	if(m_hbvars) {
+		mpi_bmap->free(m_hbvars);
+		m_hbvars = NULL;
+	}
+	m_sz_vars = 0;
+	m_capture = m_nostore = m_async = false;
+}
+
+bool response::suspend(void) {
+	bool r = false;
+
+	if((r = mpi_httpc->suspend()))
+		m_async = true;
+
+	return r;
+}
+
+void response::resume(void) {
+	_connection_t *pc = (_connection_t *)mpi_httpc->get_udata(IDX_CONNECTION);
+
+	if(m_async && pc && pc->p_vhost)
+		pc->p_vhost->resume_response(mpi_httpc);
+	else
+		mpi_httpc->resume();
 }
 
 _u32 response::capacity(void) {
@@ -67,6 +92,55 @@ _u32 response::remainder(void) {
 void response::var(_cstr_t name, _cstr_t value) {
 	if(mpi_httpc)
 		mpi_httpc->res_var(name, value);
+
+	if(m_capture) {
+		// keep it for response cache as 'name\0value\0'
+		_u32 sz_name = strlen(name) + 1;
+		_u32 sz_value = strlen(value) + 1;
+
+		if(!m_hbvars)
+			m_hbvars = mpi_bmap->alloc();
+
+		if(m_hbvars && m_sz_vars + sz_name + sz_value <= mpi_bmap->size()) {
+			_u8 *ptr = (_u8 *)mpi_bmap->ptr(m_hbvars);
+
+			memcpy(ptr + m_sz_vars, name, sz_name);
+			memcpy(ptr + m_sz_vars + sz_name, value, sz_value);
+			m_sz_vars += sz_name + sz_value;
+		} else
+			m_nostore = true;
+	}
+}
+
+void response::capture(bool enable) {
+	m_capture = enable;
+	if(enable) {
+		m_sz_vars = 0;
+		m_nostore = false;
+	}
+}
+
+bool response::content(_u8 *p_dst, _u32 size) {
+	bool r = false;
+	_u32 bs = mpi_bmap->size();
+	_u32 n = 0;
+
+	if(size <= m_content_len) {
+		while(n < size) {
+			HBUFFER hb = mp_hbarray[n / bs];
+			_u32 sz = ((size - n) < bs) ? (size - n) : bs;
+
+			if(!hb)
+				break;
+
+			memcpy(p_dst + n, mpi_bmap->ptr(hb), sz);
+			n += sz;
+		}
+
+		r = (n == size);
+	}
+
+	return r;
 }
 
 void response::_var(_cstr_t name, _cstr_t fmt, ...) {
@@ -155,6 +229,10 @@ _u32 response::_end(_u16 response_code, _cstr_t fmt, ...) {
 }
 
 void response::destroy(void) {
+	if(m_hbvars) {
+		mpi_bmap->free(m_hbvars);
+		m_hbvars = NULL;
+	}
 	if(mp_hbarray && m_hbcount) {
 		for(_u32 i = 0; i < m_hbcount; i++) {
 			if(mp_hbarray[i])
@@ -277,6 +355,9 @@ void response::cookie(_cstr_t name,
 		_cstr_t path,
 		_cstr_t domain) {
 
+	if(m_capture)
+		// don't share personal responses
+		m_nostore = true;
 	if(mpi_httpc)
 		mpi_httpc->res_cookie(name, value, flags, expires, max_age, path, domain);
 }
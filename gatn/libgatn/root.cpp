@@ -30,9 +30,9 @@ bool root::init(_cstr_t doc_root, _cstr_t cache_path,
 	m_sz_disabled = 0;
 	mpi_handle_pool = dynamic_cast<iPool *>(_gpi_repo_->object_by_iname(I_POOL, RF_CLONE | RF_NONOTIFY));
 	mpi_str = dynamic_cast<iStr *>(_gpi_repo_->object_by_iname(I_STR, RF_ORIGINAL));
-	mpi_mutex = dynamic_cast<iMutex *>(_gpi_repo_->object_by_iname(I_MUTEX, RF_CLONE|RF_NONOTIFY));
+	mpi_lock = dynamic_cast<iRWLock *>(_gpi_repo_->object_by_iname(I_RW_LOCK, RF_CLONE|RF_NONOTIFY));
 
-	if(mpi_handle_pool && mpi_str && mpi_heap && mpi_mutex) {
+	if(mpi_handle_pool && mpi_str && mpi_heap && mpi_lock) {
 		cache_exclude(cache_exclude_path);
 		disable_path(path_disable);
 
@@ -78,7 +78,7 @@ void root::destroy(void) {
 	object_release((iBase **)&mpi_fcache);
 	object_release((iBase **)&mpi_fs);
 	object_release((iBase **)&mpi_str);
-	object_release((iBase **)&mpi_mutex);
+	object_release((iBase **)&mpi_lock);
 	if(m_my_heap)
 		object_release((iBase **)&mpi_heap);
 }
@@ -138,10 +138,10 @@ void root::cache_exclude(_cstr_t path) {
 			else
 				fmt = (m_nocache) ? ":%s" : "%s";
 
-			HMUTEX hm = mpi_mutex->lock();
+			HMUTEX hm = mpi_lock->lock();
 			if(realloc_nocache(sz + 4))
 				snprintf(m_nocache + sz_old, m_sz_nocache - sz_old, fmt, path);
-			mpi_mutex->unlock(hm);
+			mpi_lock->unlock(hm);
 		}
 	}
 }
@@ -163,10 +163,10 @@ void root::disable_path(_cstr_t path) {
 			else
 				fmt = (m_disabled) ? ":%s" : "%s";
 
-			HMUTEX hm = mpi_mutex->lock();
+			HMUTEX hm = mpi_lock->lock();
 			if(realloc_path_disable(sz + 4))
 				snprintf(m_disabled + sz_old, m_sz_disabled - sz_old, fmt, path);
-			mpi_mutex->unlock(hm);
+			mpi_lock->unlock(hm);
 		}
 	}
 }
@@ -184,7 +184,7 @@ bool root::cacheable(_cstr_t path, _u32 len) {
 	bool r = true;
 
 	if(m_nocache && m_sz_nocache) {
-		m_hlock = mpi_mutex->lock(m_hlock);
+		mpi_lock->rlock();
 
 		for(_u32 i = 0, j = 0; i < m_sz_nocache; i++) {
 			if(m_nocache[i] == ':' || m_nocache[i] == 0) {
@@ -201,7 +201,7 @@ bool root::cacheable(_cstr_t path, _u32 len) {
 			}
 		}
 
-		mpi_mutex->unlock(m_hlock);
+		mpi_lock->runlock();
 	}
 
 	return r;
@@ -211,7 +211,7 @@ bool root::disabled(_cstr_t path, _u32 len) {
 	bool r = false;
 
 	if(m_disabled && m_sz_disabled) {
-		m_hlock = mpi_mutex->lock(m_hlock);
+		mpi_lock->rlock();
 
 		for(_u32 i = 0, j = 0; i < m_sz_disabled; i++) {
 			if(m_disabled[i] == ':' || m_disabled[i] == 0) {
@@ -228,7 +228,7 @@ bool root::disabled(_cstr_t path, _u32 len) {
 			}
 		}
 
-		mpi_mutex->unlock(m_hlock);
+		mpi_lock->runlock();
 	}
 
 	return r;
@@ -315,6 +315,32 @@ time_t root::mtime(HDOCUMENT hdoc) {
 	return r;
 }
 
+_u32 root::header(HDOCUMENT hdoc, void *buffer, _u32 size) {
+	_u32 r = 0;
+
+	if(mpi_handle_pool) {
+		_handle_t *ph = (_handle_t *)hdoc;
+
+		if(ph->hfc && mpi_fcache)
+			r = mpi_fcache->header(ph->hfc, buffer, size);
+	}
+
+	return r;
+}
+
+bool root::set_header(HDOCUMENT hdoc, const void *data, _u32 size) {
+	bool r = false;
+
+	if(mpi_handle_pool) {
+		_handle_t *ph = (_handle_t *)hdoc;
+
+		if(ph->hfc && mpi_fcache)
+			r = mpi_fcache->set_header(ph->hfc, data, size);
+	}
+
+	return r;
+}
+
 _cstr_t root::mime(HDOCUMENT hdoc) {
 	_cstr_t r = NULL;
 
@@ -33,9 +33,18 @@ bool server::init(_cstr_t name, _u32 port, _cstr_t root,
 						tmp.res.m_buffers = 0;
 						tmp.res.m_content_len = 0;
 						tmp.res.mpi_fs = p_srv->mpi_fs;
+						tmp.res.m_hbvars = NULL;
+						tmp.res.m_sz_vars = 0;
+						tmp.res.m_capture = tmp.res.m_nostore = false;
+						tmp.res.m_async = false;
 						tmp.url = NULL;
 						tmp.hdoc = NULL;
 						tmp.p_vhost = NULL;
+						memset(&tmp.proxy, 0, sizeof(tmp.proxy));
+						tmp.p_rcache = NULL;
+						tmp.rce = tmp.rce_fill = NULL;
+						memset(&tmp.rc_wait, 0, sizeof(tmp.rc_wait));
+						tmp.peer_ip = 0;
 						memcpy((void *)pcnt, (void *)&tmp, sizeof(_connection_t));
 					} break;
 				case POOL_OP_FREE:
@@ -43,7 +52,7 @@ bool server::init(_cstr_t name, _u32 port, _cstr_t root,
 					pcnt->destroy();
 					break;
 			};
-		}, this, mpi_heap);
+		}, this, mpi_heap, POOL_SHARDED);
 	}
 	mpi_net = NULL;
 	mpi_fs = NULL;
@@ -52,14 +61,8 @@ bool server::init(_cstr_t name, _u32 port, _cstr_t root,
 	m_autorestore = false;
 	m_buffer_size = buffer_size;
 	if((mpi_bmap = dynamic_cast<iBufferMap *>(_gpi_repo_->object_by_iname(I_BUFFER_MAP, RF_CLONE|RF_NONOTIFY)))) {
-		mpi_bmap->init(m_buffer_size, [](_u8 op, void *bptr, _u32 sz, void *udata)->_u32 {
-			_u32 r = 0;
-
-			if(op == BIO_INIT)
-				memset(bptr, 0, sz);
-
-			return r;
-		});
+		// response buffers are accessed by content length, so no zeroing
+		mpi_bmap->init(m_buffer_size, NULL, NULL, BMAP_SLAB);
 	}
 	m_max_workers = max_workers;
 	m_max_connections = max_connections;
@@ -161,7 +164,9 @@ void server::set_handlers(void) {
 		server *p_srv = (server *)udata;
 
 		p_srv->create_connection(p_httpc);
-		p_srv->call_handler(HTTP_ON_OPEN, p_httpc);
+		// virtual host is unknown yet (use limits of default host)
+		if(p_srv->host.admit_connection(p_httpc))
+			p_srv->call_handler(HTTP_ON_OPEN, p_httpc);
 	}, this);
 
 	mpi_server->on_event(HTTP_ON_REQUEST, [](iHttpServerConnection *p_httpc, void *udata) {
@@ -174,10 +179,22 @@ void server::set_handlers(void) {
 		pc->res.mpi_root = pc->p_vhost->get_root();
 		pc->res.mpi_fcache = pc->p_vhost->get_root()->get_file_cache();
 
+		// reject it before handlers and request content
+		if(!pc->p_vhost->admit_request(p_httpc))
+			return;
+
 		if(p_srv->call_handler(HTTP_ON_REQUEST, p_httpc) == EHR_CONTINUE)
 			p_srv->call_route_handler(HTTP_ON_REQUEST, p_httpc);
 	}, this);
 
+	mpi_server->on_event(HTTP_ON_RESUME, [](iHttpServerConnection *p_httpc, void *udata) {
+		_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
+
+		// coalesced request (response cache) after the first one is done
+		if(pc && pc->p_vhost)
+			pc->p_vhost->call_route_handler(HTTP_ON_REQUEST, p_httpc);
+	}, this);
+
 	mpi_server->on_event(HTTP_ON_REQUEST_DATA, [](iHttpServerConnection *p_httpc, void *udata) {
 		server *p_srv = (server *)udata;
 
@@ -205,9 +222,18 @@ void server::set_handlers(void) {
 			p_srv->call_route_handler(HTTP_ON_CLOSE_DOCUMENT, p_httpc);
 	}, this);
 
+	mpi_server->on_event(HTTP_ON_WS_MESSAGE, [](iHttpServerConnection *p_httpc, void *udata) {
+		server *p_srv = (server *)udata;
+
+		// delivered to the route handler that accepted the upgrade
+		if(p_srv->call_handler(HTTP_ON_WS_MESSAGE, p_httpc) == EHR_CONTINUE)
+			p_srv->call_route_handler(HTTP_ON_WS_MESSAGE, p_httpc);
+	}, this);
+
 	mpi_server->on_event(HTTP_ON_CLOSE, [](iHttpServerConnection *p_httpc, void *udata) {
 		server *p_srv = (server *)udata;
 
+		p_srv->host.release_connection(p_httpc);
 		if(p_srv->call_handler(HTTP_ON_CLOSE, p_httpc) == EHR_CONTINUE)
 			p_srv->destroy_connection(p_httpc);
 	}, this);
@@ -311,7 +337,11 @@ void server::update_response(iHttpServerConnection *p_httpc) {
 	_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
 
 	if(pc) {
-		if(pc->hdoc) {
+		if(pc->proxy.stream) {
+			// next part of content from upstream
+			if(pc->p_vhost)
+				pc->p_vhost->proxy_response(p_httpc);
+		} else if(pc->hdoc) {
 			// update content from file cache
 			_ulong sz = 0;
 			_vhost_t *pvhost = pc->p_vhost;
@@ -360,6 +390,41 @@ void server::remove_route(_u8 method, _cstr_t path, _cstr_t host) {
 	pvhost->remove_route_handler(method, path);
 }
 
+bool server::cache_route(_u8 method, _cstr_t path, _u32 ttl, _u32 stale,
+			_cstr_t vary, _cstr_t host) {
+	_vhost_t *pvhost = get_host(host);
+
+	return pvhost->cache_route(method, path, ttl, stale, vary);
+}
+
+void server::cache_limit(_ulong max_memory, _cstr_t host) {
+	_vhost_t *pvhost = get_host(host);
+
+	pvhost->cache_limit(max_memory);
+}
+
+bool server::limit_client(_u32 rate, _u32 burst, _u32 max_conns, _cstr_t host) {
+	_vhost_t *pvhost = get_host(host);
+
+	return pvhost->limit_client(rate, burst, max_conns);
+}
+
+bool server::limit_route(_cstr_t path, _u32 rate, _u32 burst, _cstr_t host) {
+	_vhost_t *pvhost = get_host(host);
+
+	return pvhost->limit_route(path, rate, burst);
+}
+
+_u32 server::ws_broadcast(_u8 opcode, const void *data, _u32 size,
+			_ws_filter_t *pcb_filter, void *udata) {
+	_u32 r = 0;
+
+	if(mpi_server)
+		r = mpi_server->ws_broadcast(opcode, data, size, pcb_filter, udata);
+
+	return r;
+}
+
 bool server::add_virtual_host(_cstr_t host, _cstr_t root, _cstr_t cache_path, _cstr_t cache_key,
 				_cstr_t cache_exclude, _cstr_t path_disable) {
 	bool r = false;
@@ -505,3 +570,12 @@ void server::restore_class(_cstr_t cname) {
 
 	host.restore_class(cname);
 }
+
+_upstream_t *server::add_proxy(_cstr_t location, _u8 balance, _u32 timeout, _u32 keep_alive,
+			_cstr_t health_url, _u32 health_interval, _u32 max_fails,
+			_cstr_t _host) {
+	_vhost_t *pvhost = get_host(_host);
+
+	return pvhost->add_proxy(location, balance, timeout, keep_alive,
+				health_url, health_interval, max_fails);
+}
@@ -1,12 +1,11 @@
 #include <string.h>
+#include <unistd.h>
+#include <time.h>
 #include "err.h"
 #include "private.h"
 #include "iRepository.h"
 #include "iLog.h"
 
-#define GATN_SERVER_PREFIX	"industrial-gatn"
-#define MAX_GATN_SERVER_NAME	256
-
 typedef struct {
 	iGatnExtension	*pi_ext;
 	_str_t		options;
@@ -19,11 +18,19 @@ bool vhost::init(_server_t *server, _cstr_t name, _cstr_t doc_root,
 		_cstr_t root_exclude, iHeap *_heap) {
 	pi_server = server;
 	strncpy(host, name, sizeof(host)-1);
+	snprintf(server_name, sizeof(server_name), "%s [%s]", GATN_SERVER_PREFIX, server->name());
 	pi_route_map = pi_class_map = NULL;
+	pi_proxy_list = NULL;
+	p_rcache = NULL;
+	p_limiter = NULL;
 	pi_mutex = NULL;
-	m_hlock = 0;
 	pi_heap = _heap;
 	m_running = false;
+	pi_tmaker = NULL;
+	m_health_task = NULL;
+	m_health_run = false;
+	pi_rc_pool = NULL;
+	m_revalidations = 0;
 	memset(event, 0, sizeof(event));
 	pi_log = dynamic_cast<iLog *>(_gpi_repo_->object_by_iname(I_LOG, RF_ORIGINAL));
 
@@ -33,6 +40,10 @@ bool vhost::init(_server_t *server, _cstr_t name, _cstr_t doc_root,
 void vhost::destroy(void) {
 	stop_extensions();
 	remove_extensions();
+	stop_health();
+	remove_proxies();
+	remove_rcache();
+	remove_limiter();
 	root.destroy();
 
 	if(pi_mutex) {
@@ -58,10 +69,17 @@ void vhost::destroy(void) {
 vhost::vhost() {
 	host[0] = 0;
 	pi_route_map = pi_class_map = NULL;
+	pi_proxy_list = NULL;
+	p_rcache = NULL;
+	p_limiter = NULL;
 	pi_mutex = 0;
 	pi_log = NULL;
-	m_hlock = 0;
 	m_running = false;
+	pi_tmaker = NULL;
+	m_health_task = NULL;
+	m_health_run = false;
+	pi_rc_pool = NULL;
+	m_revalidations = 0;
 	memset(event, 0, sizeof(event));
 }
 
@@ -73,7 +91,10 @@ iMutex *vhost::get_mutex(void) {
 
 iMap *vhost::get_route_map(void) {
 	if(!pi_route_map) {
-		if((pi_route_map = dynamic_cast<iMap *>(_gpi_repo_->object_by_iname(I_MAP, RF_CLONE|RF_NONOTIFY))))
+		// looked up by every request
+		if(!(pi_route_map = dynamic_cast<iMap *>(_gpi_repo_->object_by_cname(CLASS_NAME_FAST_MAP, RF_CLONE|RF_NONOTIFY))))
+			pi_route_map = dynamic_cast<iMap *>(_gpi_repo_->object_by_iname(I_MAP, RF_CLONE|RF_NONOTIFY));
+		if(pi_route_map)
 			pi_route_map->init(31, pi_heap);
 	}
 	return pi_route_map;
@@ -88,6 +109,413 @@ iMap *vhost::get_class_map(void) {
 	return pi_class_map;
 }
 
+iLlist *vhost::get_proxy_list(void) {
+	if(!pi_proxy_list) {
+		if((pi_proxy_list = dynamic_cast<iLlist *>(_gpi_repo_->object_by_iname(I_LLIST, RF_CLONE|RF_NONOTIFY))))
+			pi_proxy_list->init(LL_VECTOR, 1, pi_heap);
+	}
+
+	return pi_proxy_list;
+}
+
+void vhost::remove_proxies(void) {
+	if(pi_proxy_list) {
+		_u32 sz = 0;
+		HMUTEX hm = pi_proxy_list->lock();
+		_upstream_t *p = NULL;
+
+		while((p = (_upstream_t *)pi_proxy_list->first(&sz, hm))) {
+			p->destroy();
+			pi_proxy_list->del(hm);
+		}
+
+		pi_proxy_list->unlock(hm);
+		_gpi_repo_->object_release(pi_proxy_list);
+		pi_proxy_list = NULL;
+	}
+}
+
+_upstream_t *vhost::add_proxy(_cstr_t location, _u8 balance, _u32 timeout, _u32 keep_alive,
+			_cstr_t health_url, _u32 health_interval, _u32 max_fails) {
+	_upstream_t *r = NULL;
+	iLlist *pi_list = get_proxy_list();
+
+	_upstream_t *p = get_proxy(location);
+
+	if(pi_list && !(p && strcmp(p->location(), location) == 0)) {
+		HMUTEX hm = pi_list->lock();
+
+		if((r = (_upstream_t *)pi_list->add(sizeof(_upstream_t), hm))) {
+			if(r->init(pi_server, location, balance, timeout, keep_alive,
+					((server *)pi_server)->m_buffer_size,
+					health_url, health_interval, max_fails)) {
+				pi_log->fwrite(LMT_INFO, "Gatn: Proxy '%s%s' on server '%s'",
+						host, location, pi_server->name());
+				if(r->health_url())
+					start_health();
+			} else {
+				r->destroy();
+				pi_list->del(hm);
+				r = NULL;
+			}
+		}
+
+		pi_list->unlock(hm);
+	} else
+		pi_log->fwrite(LMT_ERROR, "Gatn: Unable to add proxy '%s%s'", host, location);
+
+	return r;
+}
+
+void vhost::enum_proxies(void (*enum_cb)(_upstream_t *, void *), void *udata) {
+	if(pi_proxy_list) {
+		_u32 sz = 0;
+		HMUTEX hm = pi_proxy_list->lock();
+		_upstream_t *p = (_upstream_t *)pi_proxy_list->first(&sz, hm);
+
+		while(p) {
+			enum_cb(p, udata);
+			p = (_upstream_t *)pi_proxy_list->next(&sz, hm);
+		}
+
+		pi_proxy_list->unlock(hm);
+	}
+}
+
+_rcache_t *vhost::get_rcache(void) {
+	if(!p_rcache) {
+		iHeap *pi_rc_heap = ((server *)pi_server)->mpi_heap;
+		_rcache_t *p = (_rcache_t *)pi_rc_heap->alloc(sizeof(_rcache_t));
+
+		if(p) {
+			memset(p, 0, sizeof(_rcache_t));
+			if(p->init(pi_rc_heap, RCACHE_MEMORY))
+				p_rcache = p;
+			else {
+				p->destroy();
+				pi_rc_heap->free(p, sizeof(_rcache_t));
+			}
+		}
+	}
+
+	return p_rcache;
+}
+
+void vhost::remove_rcache(void) {
+	// background revalidations use the cache
+	while(m_revalidations)
+		usleep(10000);
+
+	if(p_rcache) {
+		iHeap *pi_rc_heap = ((server *)pi_server)->mpi_heap;
+
+		p_rcache->destroy();
+		pi_rc_heap->free(p_rcache, sizeof(_rcache_t));
+		p_rcache = NULL;
+	}
+}
+
+bool vhost::cache_route(_u8 method, _cstr_t path, _u32 ttl, _u32 stale, _cstr_t vary) {
+	bool r = false;
+	_rcache_t *prc = get_rcache();
+
+	if(prc && (r = prc->add_policy(method, path, ttl, stale, vary)))
+		pi_log->fwrite(LMT_INFO, "Gatn: Cache '%s%s' (ttl: %us, stale: %us) on server '%s'",
+				host, path, ttl, stale, pi_server->name());
+	else
+		pi_log->fwrite(LMT_ERROR, "Gatn: Unable to cache '%s%s'", host, path);
+
+	return r;
+}
+
+void vhost::cache_limit(_ulong max_memory) {
+	_rcache_t *prc = get_rcache();
+
+	if(prc)
+		prc->limit(max_memory);
+}
+
+bool vhost::cached_request(iHttpServerConnection *p_httpc) {
+	bool r = false;
+	_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
+	_rc_policy_t pol;
+	_u8 method = p_httpc->req_method();
+
+	if(!p_rcache || !pc || !pc->url || !p_rcache->policy(method, pc->url, &pol))
+		return r;
+
+	// method + host + URI (+ vary)
+	_char_t key[MAX_RCACHE_KEY];
+	_cstr_t uri = p_httpc->req_uri();
+	_u32 sz_key = snprintf(key, sizeof(key), "%u\n%s\n%s", method, host, (uri) ? uri : pc->url);
+
+	for(_u32 i = 0; i < pol.nvary && sz_key < sizeof(key); i++) {
+		_cstr_t name = pol.vary[i];
+		_u32 sz_prefix = strlen(RCACHE_VARY_COOKIE);
+		_cstr_t value = (strncmp(name, RCACHE_VARY_COOKIE, sz_prefix) == 0) ?
+				pc->req.cookie(name + sz_prefix) : p_httpc->req_var(name);
+
+		sz_key += snprintf(key + sz_key, sizeof(key) - sz_key, "\n%s", (value) ? value : "");
+	}
+
+	if(sz_key >= sizeof(key))
+		return r;
+
+	_rc_entry_t *pe = NULL;
+	_rc_entry_t *pf = NULL;
+	_u8 lr = p_rcache->lookup(key, sz_key, &pe, &pf);
+
+	if(lr == RC_WAIT && !pc->rc_wait.retry && p_httpc->suspend()) {
+		// park the connection (not the worker) until the response is stored
+		pc->rc_wait.p_httpc = p_httpc;
+		if(p_rcache->wait(key, sz_key, &pc->rc_wait))
+			// continues by HTTP_ON_RESUME
+			return true;
+
+		// done meanwhile
+		p_httpc->resume();
+		lr = p_rcache->lookup(key, sz_key, &pe, &pf);
+	}
+
+	// resumed waiter doesn't wait again (runs the handler)
+	pc->rc_wait.retry = false;
+
+	switch(lr) {
+		case RC_HIT:
+		case RC_STALE:
+			pc->p_rcache = p_rcache;
+			pc->rce = pe;
+			cached_content(p_httpc, pe, (lr == RC_HIT) ? "HIT" : "STALE");
+			r = true;
+			break;
+		case RC_REVALIDATE:
+			pc->p_rcache = p_rcache;
+			pc->rce = pe;
+			cached_content(p_httpc, pe, "STALE");
+			if(!revalidate(p_httpc, pf))
+				// next request tries again
+				p_rcache->abort(pf);
+			r = true;
+			break;
+		case RC_FILL:
+			pc->p_rcache = p_rcache;
+			pc->rce_fill = pe;
+			pc->res.capture(true);
+			break;
+	}
+
+	return r;
+}
+
+void vhost::cached_content(iHttpServerConnection *p_httpc, _rc_entry_t *pe, _cstr_t xcache) {
+	_char_t age[32]="";
+	_cstr_t vars = (_cstr_t)pe->vars();
+	_u32 offset = 0;
+
+	p_httpc->res_code(pe->code);
+	while(offset < pe->sz_vars) {
+		_cstr_t name = vars + offset;
+		_cstr_t value = name + strlen(name) + 1;
+
+		p_httpc->res_var(name, value);
+		offset += (value - name) + strlen(value) + 1;
+	}
+
+	snprintf(age, sizeof(age), "%lu", (_ulong)(time(NULL) - pe->stime));
+	p_httpc->res_var("Age", age);
+	p_httpc->res_var("X-Cache", xcache);
+	if(pe->sz_content)
+		// send it directly from cache
+		p_httpc->res_content(pe->content(), pe->sz_content);
+}
+
+bool vhost::revalidate(iHttpServerConnection *p_httpc, _rc_entry_t *pf) {
+	bool r = false;
+	server *p_srv = (server *)pi_server;
+	cRcConnection *p_rc = NULL;
+
+	if(!pi_rc_pool) {
+		iTaskMaker *pi_tm = dynamic_cast<iTaskMaker *>(_gpi_repo_->object_by_iname(I_TASK_MAKER, RF_ORIGINAL));
+
+		if(pi_tm) {
+			// owned by task maker
+			pi_rc_pool = pi_tm->pool(RCACHE_POOL, RCACHE_THREADS);
+			_gpi_repo_->object_release(pi_tm);
+		}
+	}
+
+	if(pi_rc_pool && !p_httpc->req_content_len() &&
+			(p_rc = dynamic_cast<cRcConnection *>(_gpi_repo_->object_by_cname(CLASS_NAME_RC_CONNECTION, RF_CLONE|RF_NONOTIFY)))) {
+		if(p_rc->init(p_httpc, pi_heap, [](iHttpServerConnection *p_httpc, void *udata) {
+					((vhost *)udata)->revalidated(p_httpc);
+				}, this) && p_srv->create_connection(p_rc)) {
+			_connection_t *pc = (_connection_t *)p_rc->get_udata(IDX_CONNECTION);
+
+			pc->p_vhost = this;
+			pc->url = p_rc->req_url();
+			pc->res.mpi_root = &root;
+			pc->res.mpi_fcache = root.get_file_cache();
+			pc->p_rcache = p_rcache;
+			pc->rce_fill = pf;
+			pc->res.capture(true);
+			m_revalidations++;
+
+			HJOB hj = pi_rc_pool->submit([](void *arg)->void* {
+				cRcConnection *p_rc = (cRcConnection *)arg;
+				_connection_t *pc = (_connection_t *)p_rc->get_udata(IDX_CONNECTION);
+
+				pc->p_vhost->route(HTTP_ON_REQUEST, p_rc);
+				p_rc->done();
+				return NULL;
+			}, p_rc, JOB_PRIO_LOW);
+
+			if(hj) {
+				pi_rc_pool->release(hj);
+				r = true;
+			} else {
+				// aborted by caller
+				pc->rce_fill = NULL;
+				m_revalidations--;
+				p_srv->destroy_connection(p_rc);
+			}
+		}
+
+		if(!r)
+			_gpi_repo_->object_release(p_rc);
+	}
+
+	return r;
+}
+
+void vhost::revalidated(iHttpServerConnection *p_httpc) {
+	// response is stored (or not) by cache_response
+	route(HTTP_ON_CLOSE_DOCUMENT, p_httpc);
+	((server *)pi_server)->destroy_connection(p_httpc);
+	_gpi_repo_->object_release(p_httpc);
+	m_revalidations--;
+}
+
+void vhost::cache_response(iHttpServerConnection *p_httpc) {
+	_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
+
+	if(pc && pc->rce_fill && pc->p_rcache) {
+		_rc_entry_t *pf = pc->rce_fill;
+		_rc_policy_t pol;
+		_u16 code = p_httpc->error_code();
+
+		pc->rce_fill = NULL;
+		pc->res.capture(false);
+		// only complete and non personal responses
+		if(code == HTTPRC_OK && !pc->res.m_nostore &&
+				pc->res.m_content_len == p_httpc->res_content_len() &&
+				pc->p_rcache->policy(p_httpc->req_method(), pc->url, &pol)) {
+			pc->p_rcache->store(pf, pol.ttl, pol.stale, code, &pc->res);
+			p_httpc->res_var("X-Cache", "MISS");
+		} else
+			pc->p_rcache->abort(pf);
+	}
+}
+
+_limiter_t *vhost::get_limiter(void) {
+	if(!p_limiter) {
+		iHeap *pi_lim_heap = ((server *)pi_server)->mpi_heap;
+		_limiter_t *p = (_limiter_t *)pi_lim_heap->alloc(sizeof(_limiter_t));
+
+		if(p) {
+			if(p->init())
+				p_limiter = p;
+			else {
+				p->destroy();
+				pi_lim_heap->free(p, sizeof(_limiter_t));
+			}
+		}
+	}
+
+	return p_limiter;
+}
+
+void vhost::remove_limiter(void) {
+	if(p_limiter) {
+		iHeap *pi_lim_heap = ((server *)pi_server)->mpi_heap;
+
+		p_limiter->destroy();
+		pi_lim_heap->free(p_limiter, sizeof(_limiter_t));
+		p_limiter = NULL;
+	}
+}
+
+bool vhost::limit_client(_u32 rate, _u32 burst, _u32 max_conns) {
+	bool r = false;
+	_limiter_t *pl = get_limiter();
+
+	if(pl) {
+		pl->client(rate, burst, max_conns);
+		pi_log->fwrite(LMT_INFO, "Gatn: Limit '%s' to %u req/s (burst %u) and %u connections per client on server '%s'",
+				host, rate, burst, max_conns, pi_server->name());
+		r = true;
+	}
+
+	return r;
+}
+
+bool vhost::limit_route(_cstr_t path, _u32 rate, _u32 burst) {
+	bool r = false;
+	_limiter_t *pl = get_limiter();
+
+	if(pl && (r = pl->add_route(path, rate, burst)))
+		pi_log->fwrite(LMT_INFO, "Gatn: Limit '%s%s' to %u req/s (burst %u) per client on server '%s'",
+				host, path, rate, burst, pi_server->name());
+	else
+		pi_log->fwrite(LMT_ERROR, "Gatn: Unable to limit '%s%s'", host, path);
+
+	return r;
+}
+
+bool vhost::admit_connection(iHttpServerConnection *p_httpc) {
+	bool r = true;
+	_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
+
+	if(p_limiter && pc) {
+		_u32 ip = p_httpc->peer_ip();
+
+		if(p_limiter->connect(ip))
+			pc->peer_ip = ip;
+		else {
+			p_httpc->res_var("Retry-After", "1");
+			p_httpc->reject(HTTPRC_SERVICE_UNAVAILABLE);
+			r = false;
+		}
+	}
+
+	return r;
+}
+
+void vhost::release_connection(iHttpServerConnection *p_httpc) {
+	_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
+
+	if(p_limiter && pc && pc->peer_ip) {
+		p_limiter->disconnect(pc->peer_ip);
+		pc->peer_ip = 0;
+	}
+}
+
+bool vhost::admit_request(iHttpServerConnection *p_httpc) {
+	bool r = true;
+	_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
+
+	if(p_limiter && pc) {
+		_u16 rc = p_limiter->request(p_httpc->peer_ip(), pc->url);
+
+		if(rc) {
+			p_httpc->res_var("Retry-After", "1");
+			p_httpc->reject(rc);
+			r = false;
+		}
+	}
+
+	return r;
+}
+
 HMUTEX vhost::lock(HMUTEX hlock) {
 	HMUTEX r = 0;
 
@@ -99,10 +527,6 @@ HMUTEX vhost::lock(HMUTEX hlock) {
 	return r;
 }
 
-void vhost::_lock(void) {
-	m_hlock = lock(m_hlock);
-}
-
 void vhost::unlock(HMUTEX hlock) {
 	iMutex *pi_mutex = get_mutex();
 
@@ -110,10 +534,6 @@ void vhost::unlock(HMUTEX hlock) {
 		pi_mutex->unlock(hlock);
 }
 
-void vhost::_unlock(void) {
-	unlock(m_hlock);
-}
-
 void vhost::clear_events(void) {
 	memset(event, 0, sizeof(event));
 }
@@ -427,15 +847,14 @@ _s32 vhost::call_handler(_u8 evt, iHttpServerConnection *p_httpc) {
 	_s32 r = EHR_CONTINUE;
 	_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
 
-	if(pc && pc->p_vhost == this) {
-		_lock();
+	// no host lock without handler (cache hits don't wait for route handlers)
+	if(pc && pc->p_vhost == this && evt < HTTP_MAX_EVENTS && event[evt].pcb) {
+		HMUTEX hm = lock();
 
-		if(evt < HTTP_MAX_EVENTS) {
-			if(event[evt].pcb)
-				r = event[evt].pcb(&(pc->req), &(pc->res), event[evt].udata);
-		}
+		if(event[evt].pcb)
+			r = event[evt].pcb(&(pc->req), &(pc->res), event[evt].udata);
 
-		_unlock();
+		unlock(hm);
 	}
 
 	return r;
@@ -448,7 +867,40 @@ void vhost::send_content(iHttpServerConnection *p_httpc, _u8 *p_doc, _ulong sz_d
 	p_httpc->res_content(p_doc, sz_doc);
 }
 
+// 'doc_sz' is 0 for HEAD
+void vhost::document_header(iHttpServerConnection *p_httpc, HDOCUMENT hdoc, _ulong doc_sz) {
+	_char_t lines[MAX_FCACHE_HEADER];
+	_u32 sz = root.header(hdoc, lines, sizeof(lines));
+
+	if(sz)
+		// prepared by previous GET of same document (file content doesn't change while open)
+		p_httpc->res_header(lines, sz, HTTP_HDR_CONTENT_LEN);
+	else {
+		_char_t mtime[64]="";
+		time_t t = root.mtime(hdoc);
+		tm _tm;
+
+		gmtime_r(&t, &_tm);
+		strftime(mtime, sizeof(mtime), "%a, %d %b %Y %H:%M:%S GMT", &_tm);
+		sz = snprintf(lines, sizeof(lines), "Server: %s\r\nContent-Type: %s\r\nLast-Modified: %s\r\n",
+				server_name, root.mime(hdoc), mtime);
+		if(doc_sz && sz < sizeof(lines))
+			sz += snprintf(lines + sz, sizeof(lines) - sz, "Content-Length: %lu\r\n", doc_sz);
+
+		if(sz < sizeof(lines) && p_httpc->res_header(lines, sz, (doc_sz) ? HTTP_HDR_CONTENT_LEN : 0)) {
+			if(doc_sz)
+				// cache it (works for file cache only)
+				root.set_header(hdoc, lines, sz);
+		} else {
+			p_httpc->res_var("Server", server_name);
+			p_httpc->res_content_type(root.mime(hdoc));
+			p_httpc->res_mtime(t);
+		}
+	}
+}
+
 void vhost::send_error(iHttpServerConnection *p_httpc, _u16 err_rc, _cstr_t err_text) {
+	p_httpc->res_var("Server", server_name);
 	p_httpc->res_code(err_rc);
 	p_httpc->res_var("Connection", "close");
 	call_handler(ON_ERROR, p_httpc);
@@ -460,9 +912,30 @@ void vhost::send_error(iHttpServerConnection *p_httpc, _u16 err_rc, _cstr_t err_
 }
 
 void vhost::call_route_handler(_u8 evt, iHttpServerConnection *p_httpc) {
-	_lock();
+	_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
+
+	if(pc) {
+		// proxy locations are served without holding the host lock
+		if(evt == HTTP_ON_REQUEST)
+			pc->proxy.p_upstream = get_proxy(pc->url);
+
+		if(pc->proxy.p_upstream) {
+			proxy_request(evt, p_httpc);
+			return;
+		}
+
+		if(evt == HTTP_ON_REQUEST && cached_request(p_httpc))
+			// served from response cache
+			return;
+	}
+
+	route(evt, p_httpc);
+}
 
+void vhost::route(_u8 evt, iHttpServerConnection *p_httpc) {
 	_connection_t *pc = (_connection_t *)p_httpc->get_udata(IDX_CONNECTION);
+	HMUTEX hm = lock();
+
 	iMap *pi_map = get_route_map();
 
 	if(pc && pi_map) {
@@ -485,25 +958,18 @@ void vhost::call_route_handler(_u8 evt, iHttpServerConnection *p_httpc) {
 			else if(root.is_enabled() && evt == HTTP_ON_REQUEST) {
 				// route not found
 				// try to resolve file name
-				_char_t server_name[MAX_GATN_SERVER_NAME]="";
-
-				snprintf(server_name, sizeof(server_name), "%s [%s]", GATN_SERVER_PREFIX, pi_server->name());
-				p_httpc->res_var("Server", server_name);
-
 				p_httpc->res_protocol("HTTP/1.1");
 
 				if(method == HTTP_METHOD_GET || method == HTTP_METHOD_HEAD || method == HTTP_METHOD_POST) {
 					HDOCUMENT hdoc = root.open(url);
 
 					if(hdoc) {
-						p_httpc->res_content_type(root.mime(hdoc));
-						p_httpc->res_mtime(root.mtime(hdoc));
-
 						if(method == HTTP_METHOD_GET || method == HTTP_METHOD_POST) {
 							_ulong doc_sz = 0;
 
 							_u8 *ptr = (_u8 *)root.ptr(hdoc, &doc_sz);
 							if(ptr) {
+								document_header(p_httpc, hdoc, doc_sz);
 								send_content(p_httpc, ptr, doc_sz);
 								pc->hdoc = hdoc;
 							} else {
@@ -512,6 +978,7 @@ void vhost::call_route_handler(_u8 evt, iHttpServerConnection *p_httpc) {
 								root.close(hdoc);
 							}
 						} else if(method == HTTP_METHOD_HEAD) {
+							document_header(p_httpc, hdoc, 0);
 							p_httpc->res_code(HTTPRC_OK);
 							root.close(hdoc);
 						}
@@ -528,6 +995,15 @@ void vhost::call_route_handler(_u8 evt, iHttpServerConnection *p_httpc) {
 		}
 	}
 
-	_unlock();
+	unlock(hm);
+
+	if(evt == HTTP_ON_REQUEST && !(pc && pc->res.m_async))
+		cache_response(p_httpc);
+}
+
+void vhost::resume_response(iHttpServerConnection *p_httpc) {
+	// asynchronous response is complete
+	cache_response(p_httpc);
+	p_httpc->resume();
 }
 
@@ -57,7 +57,8 @@ private:
 				req->connection()->peer_ip(ip, sizeof(ip));
 				pobj->timestamp(tm, sizeof(tm));
 
-				pi_log->fwrite(LMT_INFO, "%s %s/%s: (%s) %s %s %s",
+				// arguments are copied, formatted by the log consumer
+				pi_log->bfwrite(LMT_INFO, "%s %s/%s: (%s) %s %s %s",
 							tm,
 							pobj->mpi_gatn_server->name(),
 							(strlen(pobj->m_host_name)) ? pobj->m_host_name: "defaulthost",
@@ -110,7 +111,7 @@ private:
 					req->connection()->peer_ip(ip, sizeof(ip));
 					pobj->timestamp(tm, sizeof(tm));
 
-					pi_log->fwrite(LMT_ERROR, "%s %s/%s: (%s) ERROR(%d) %s %s",
+					pi_log->bfwrite(LMT_ERROR, "%s %s/%s: (%s) ERROR(%d) %s %s",
 								tm,
 								pobj->mpi_gatn_server->name(),
 								(strlen(pobj->m_host_name)) ? pobj->m_host_name: "defaulthost",
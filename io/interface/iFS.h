@@ -51,6 +51,8 @@ public:
 
 #define HFCACHE	void*
 
+#define MAX_FCACHE_HEADER	512 // user data of file cache entry
+
 class iFileCache: public iBase {
 public:
 	INTERFACE(iFileCache, I_FILE_CACHE);
@@ -68,6 +70,13 @@ public:
 	virtual time_t mtime(HFCACHE hfc)=0;
 	// remove cache
 	virtual void remove(HFCACHE hfc)=0;
+	// attach user data (prepared response header) to cache entry
+	// (up to MAX_FCACHE_HEADER bytes)
+	// (dropped when the file changes)
+	virtual bool set_header(HFCACHE hfc, const void *data, _u32 size)=0;
+	// copy user data attached to cache entry and return its size
+	// (0 if missing or bigger than buffer)
+	virtual _u32 header(HFCACHE hfc, void *buffer, _u32 size)=0;
 };
 
 class iFS: public iBase {
@@ -65,6 +65,7 @@ public:
 #define HTTPRC_REQ_URI_TOO_LARGE	414 // Request-URI Too Large
 #define HTTPRC_UNSUPPORTED_MEDIA_TYPE	415 // Unsupported Media Type
 #define HTTPRC_EXPECTATION_FAILED	417 // Expectation Failed
+#define HTTPRC_TOO_MANY_REQUESTS	429 // Too Many Requests
 #define HTTPRC_INTERNAL_SERVER_ERROR	500 // Internal Server Error
 #define HTTPRC_NOT_IMPLEMENTED		501 // Not Implemented
 #define HTTPRC_BAD_GATEWAY		502 // Bad Gateway
@@ -82,6 +83,9 @@ public:
 #define HTTP_METHOD_OPTIONS	7
 #define HTTP_METHOD_TRACE	8
 
+// res_header flags
+#define HTTP_HDR_CONTENT_LEN	(1<<0)
+
 #define VAR_REQ_METHOD		"req-Method"
 #define VAR_REQ_HEADER		"req-Header"
 #define VAR_REQ_URI		"req-URI"
@@ -89,6 +93,20 @@ public:
 #define VAR_REQ_URN		"req-URN"
 #define VAR_REQ_PROTOCOL	"req-Protocol"
 
+// WebSocket opcodes
+#define WS_OP_CONTINUATION	0x0
+#define WS_OP_TEXT		0x1
+#define WS_OP_BINARY		0x2
+#define WS_OP_CLOSE		0x8
+#define WS_OP_PING		0x9
+#define WS_OP_PONG		0xa
+
+// WebSocket close codes
+#define WS_CLOSE_NORMAL		1000
+#define WS_CLOSE_GOING_AWAY	1001
+#define WS_CLOSE_PROTOCOL_ERROR	1002
+#define WS_CLOSE_TOO_BIG	1009
+
 class iHttpServerConnection: public iBase {
 public:
 	INTERFACE(iHttpServerConnection, I_HTTP_SERVER_CONNECTION);
@@ -124,6 +142,9 @@ public:
 	virtual bool req_parse_content(void)=0;
 	// set variable in response header
 	virtual bool res_var(_cstr_t name, _cstr_t value)=0;
+	// append prepared header lines ('name: value\r\n'...) to response header
+	// (flags: HTTP_HDR_CONTENT_LEN when lines include 'Content-Length')
+	virtual bool res_header(const void *data, _u32 size, _u8 flags=0)=0;
 	// get error code
 	virtual _u16 error_code(void)=0;
 	// set response code
@@ -134,6 +155,9 @@ public:
 	virtual void res_protocol(_cstr_t protocol)=0;
 	// set Content-Length variable
 	virtual bool res_content_len(_ulong content_len)=0;
+	// send content of unknown length (chunked transfer encoding), the content
+	// ends by HTTP_ON_RESPONSE_DATA without res_write
+	virtual void res_chunked(void)=0;
 	// Set content type
 	virtual void res_content_type(_cstr_t ctype)=0;
 	// Set document content
@@ -164,6 +188,32 @@ public:
 	// write response
 	virtual _u32 res_write(_u8 *data, _u32 size)=0;
 	virtual _u32 res_write(_cstr_t str)=0;
+
+	// send response code (without content) and close connection
+	// (by example from HTTP_ON_OPEN or HTTP_ON_REQUEST handler)
+	virtual void reject(_u16 httprc)=0;
+
+	// WebSocket (RFC 6455)
+	// accept upgrade request (call it from HTTP_ON_REQUEST handler)
+	virtual bool ws_upgrade(_cstr_t protocol=NULL)=0;
+	// returns true for upgraded connection
+	virtual bool is_websocket(void)=0;
+	// get current message (valid during HTTP_ON_WS_MESSAGE only)
+	// returns non NULL pointer for empty message too (size = 0)
+	virtual _u8 *ws_message(_u32 *size, _u8 *opcode=NULL)=0;
+	// send single (unfragmented) frame
+	virtual bool ws_send(_u8 opcode, const void *data, _u32 size)=0;
+	// send close frame and close connection
+	virtual bool ws_close(_u16 code=WS_CLOSE_NORMAL)=0;
+
+	// Asynchronous response: suspend (from event handler) releases the worker
+	// after the handler returns, and the connection is not processed until resume.
+	// The response must be completed (from any thread) before resume. After the
+	// connection timeout the client is disconnected, but resume is still required.
+	// With 'replay' the connection continues by HTTP_ON_RESUME event instead,
+	// to handle the request again (by example after waiting for shared result).
+	virtual bool suspend(void)=0;
+	virtual void resume(bool replay=false)=0;
 };
 
 // HTTP event prototype
@@ -179,12 +229,21 @@ typedef void _on_http_event_t(iHttpServerConnection *, void *);
 #define HTTP_ON_CLOSE		7
 #define HTTP_ON_RESERVED1	8
 #define HTTP_ON_RESERVED2	9
+#define HTTP_ON_WS_MESSAGE	HTTP_ON_RESERVED1
+#define HTTP_ON_RESUME		HTTP_ON_RESERVED2
+
+// broadcast filter (return true to send frame to connection)
+typedef bool _ws_filter_t(iHttpServerConnection *, void *);
 
 class iHttpServer: public iBase {
 public:
 	INTERFACE(iHttpServer, I_HTTP_SERVER);
 	virtual void on_event(_u8 evt, _on_http_event_t *handler, void *udata=NULL)=0;
 	virtual bool is_running(void)=0;
+	// encode frame once and send it to all (filtered) websocket connections
+	// returns number of connections
+	virtual _u32 ws_broadcast(_u8 opcode, const void *data, _u32 size,
+				_ws_filter_t *pcb_filter=NULL, void *udata=NULL)=0;
 };
 
 typedef void _on_http_response_t(void *data, _u32 size, void *udata);
@@ -210,10 +269,19 @@ public:
 	virtual _u32 _req_write(_cstr_t fmt, ...)=0;
 	// send request with timeout in milliseconds
 	virtual bool send(_u32 timeout_ms, _on_http_response_t *p_cb_resp=NULL, void *udata=NULL)=0;
+	// send request and receive response header only (timeout in seconds),
+	// the content should be received by res_read
+	virtual bool request(_u32 timeout_s)=0;
+	// receive next part of response content, returns 0 at the end of content (or error)
+	virtual _u32 res_read(void *buffer, _u32 size, _u32 timeout_s)=0;
+	// whole response content is received
+	virtual bool res_complete(void)=0;
 	// get response code
 	virtual _u16 res_code(void)=0;
 	// get value from response variable
 	virtual _cstr_t res_var(_cstr_t name)=0;
+	// get raw response header with status line (valid until res_read)
+	virtual _cstr_t res_header(_u32 *size)=0;
 	// get response content len
 	virtual _u32 res_content_len(void)=0;
 	// get response content
@@ -16,6 +16,8 @@ typedef struct { // file cache entry
 	_ulong		size; // file size
 	time_t		mtime; // last modification time of original file
 	bool		remove;
+	_u32		sz_hdr; // size of user header
+	_u8		hdr[MAX_FCACHE_HEADER]; // user header (prepared by owner)
 
 	void clear(void) {
 		pi_fio = NULL;
@@ -24,6 +26,7 @@ typedef struct { // file cache entry
 		size = 0;
 		mtime = 0;
 		remove = false;
+		sz_hdr = 0;
 	}
 }_fce_t;
 
@@ -77,6 +80,8 @@ private:
 				pfce->size = pfce->pi_fio->size();
 				pfce->mtime = _mtime;
 				pfce->remove = false;
+				// header belongs to previous content
+				pfce->sz_hdr = 0;
 				r = true;
 			}
 		}
@@ -319,6 +324,38 @@ public:
 		return pfce->mtime;
 	}
 
+	bool set_header(HFCACHE hfc, const void *data, _u32 size) {
+		bool r = false;
+		_fce_t *pfce = (_fce_t *)hfc;
+
+		if(size && size <= sizeof(pfce->hdr)) {
+			pfce->mutex.lock();
+			if(!pfce->sz_hdr) {
+				memcpy(pfce->hdr, data, size);
+				pfce->sz_hdr = size;
+			}
+			r = true;
+			pfce->mutex.unlock();
+		}
+
+		return r;
+	}
+
+	_u32 header(HFCACHE hfc, void *buffer, _u32 size) {
+		_u32 r = 0;
+		_fce_t *pfce = (_fce_t *)hfc;
+
+		// copy it, because the entry can be updated after unlock
+		pfce->mutex.lock();
+		if(pfce->sz_hdr && pfce->sz_hdr <= size) {
+			memcpy(buffer, pfce->hdr, pfce->sz_hdr);
+			r = pfce->sz_hdr;
+		}
+		pfce->mutex.unlock();
+
+		return r;
+	}
+
 	void remove(HFCACHE hfc) {
 		_fce_t *pfce = (_fce_t *)hfc;
 
@@ -1,5 +1,6 @@
 #include <string.h>
 #include <unistd.h>
+#include <vector>
 #include "iRepository.h"
 #include "iNet.h"
 #include "private.h"
@@ -7,19 +8,16 @@
 #define CFREE		0 // unused connections
 #define CPENDING	1 // column for pending connections
 #define CBUSY		2 // column for busy connections
+#define CSUSPENDED	3 // column for suspended connections (asynchronous response)
+#define CEXPIRED	4 // suspended connections after deadline (not counted)
 
-// bufferMap callback
-_u32 buffer_io(_u8 op, void *ptr, _u32 size, void *udata) {
-	_u32 r = 0;
-
-	switch(op) {
-		case BIO_INIT:
-			memset(ptr, 0, size);
-			break;
-	}
+#define ASYNC_SUSPEND	1
 
-	return r;
-}
+// websocket broadcast receiver
+typedef struct {
+	cHttpServerConnection *p_httpc;
+	_u32 session;
+}_ws_target_t;
 
 void *_http_server_thread(_u8 sig, void *arg) {
 	cHttpServer *srv = (cHttpServer *)arg;
@@ -43,7 +41,8 @@ bool cHttpServer::_init(_u32 port,
 		if((m_is_init = r = p_tcps->_init(port, ssl_context))) {
 			_char_t sname[17]="";
 
-			mpi_bmap->init(buffer_size, buffer_io);
+			// buffers are zeroed by map (only reused ones)
+			mpi_bmap->init(buffer_size, NULL, NULL, BMAP_SLAB|BMAP_ZERO);
 			m_max_workers = max_workers;
 			m_max_connections = max_connections;
 			m_connection_timeout = connection_timeout;
@@ -73,11 +72,17 @@ void cHttpServer::http_server_thread(void) {
 	_u32 to_idle = TO_IDLE;
 
 	while(m_is_running) {
-		if(m_is_init && m_num_connections < m_max_connections) {
-			if(add_connection())
+		if(m_is_init) {
+			if(m_num_connections < m_max_connections) {
+				if(add_connection())
+					to_idle = TO_IDLE;
+			} else if(reject_connection())
+				// don't leave clients in kernel queue
 				to_idle = TO_IDLE;
 		}
 
+		expire_connections();
+
 		if(to_idle) {
 			usleep(10000);
 			to_idle--;
@@ -108,6 +113,11 @@ void *_http_worker_thread(_u8 sig, void *udata) {
 						_u8 evt = rec->p_httpc->process();
 
 						p_https->call_event_handler(evt, rec->p_httpc);
+						// deliver pipelined websocket messages without waiting for next pass
+						while(evt == HTTP_ON_WS_MESSAGE && rec->p_httpc->ws_pending()) {
+							evt = rec->p_httpc->process();
+							p_https->call_event_handler(evt, rec->p_httpc);
+						}
 						p_https->pending_connection(rec);
 					} else {
 						p_https->call_event_handler(HTTP_ON_CLOSE, rec->p_httpc);
@@ -144,6 +154,7 @@ bool cHttpServer::object_ctl(_u32 cmd, void *arg, ...) {
 			m_is_init = m_is_running = m_use_ssl = false;
 			m_is_stopped = true;
 			m_num_connections = m_num_workers = m_active_workers = 0;
+			m_expire_time = 0;
 			memset(m_event, 0, sizeof(m_event));
 			mpi_log = (iLog *)pi_repo->object_by_iname(I_LOG, RF_ORIGINAL);
 			p_tcps = (cTCPServer *)pi_repo->object_by_cname(CLASS_NAME_TCP_SERVER, RF_CLONE|RF_NONOTIFY);
@@ -152,7 +163,7 @@ bool cHttpServer::object_ctl(_u32 cmd, void *arg, ...) {
 			mpi_list = (iLlist *)pi_repo->object_by_iname(I_LLIST, RF_CLONE|RF_NONOTIFY);
 			m_hconnection = pi_repo->handle_by_cname(CLASS_NAME_HTTP_SERVER_CONNECTION);
 			if(p_tcps && mpi_bmap && mpi_tmaker && mpi_list && m_hconnection) {
-				mpi_list->init(LL_VECTOR, 3);
+				mpi_list->init(LL_VECTOR|LL_SLAB, 5);
 				r = true;
 			}
 		} break;
@@ -165,6 +176,17 @@ bool cHttpServer::object_ctl(_u32 cmd, void *arg, ...) {
 				while(!m_is_stopped)
 					usleep(10000);
 			}
+			// Asynchronous responses: the clients are disconnected, but the
+			// connections are released after resume, because event handlers
+			// (jobs in thread pools) still use them.
+			expire_connections(true);
+			if(column_count(CEXPIRED)) {
+				if(mpi_log)
+					mpi_log->fwrite(LMT_WARNING, "HTTP(%u): wait for %u suspended connections",
+							m_port, column_count(CEXPIRED));
+				while(column_count(CEXPIRED))
+					usleep(10000);
+			}
 			// stop all workers
 			m_active_workers = 0;
 			_u32 t = 1000;
@@ -242,10 +264,12 @@ _http_connection_t *cHttpServer::alloc_connection(HMUTEX hlock) {
 	mpi_list->col(CFREE, hlock);
 	if((r = (_http_connection_t *)mpi_list->first(&sz, hlock))) {
 		r->state = CPENDING;
+		r->async = 0;
 		mpi_list->mov(r, CPENDING, hlock);
 	} else if((rec.p_httpc = (cHttpServerConnection *)_gpi_repo_->object_by_handle(m_hconnection, RF_CLONE|RF_NONOTIFY))) {
 		mpi_list->col(CPENDING, hlock);
 		rec.state = CPENDING;
+		rec.async = 0;
 		r = (_http_connection_t *)mpi_list->add(&rec, sizeof(_http_connection_t), hlock);
 	}
 
@@ -260,14 +284,16 @@ _http_connection_t *cHttpServer::add_connection(void) {
 		HMUTEX hm = mpi_list->lock();
 
 		if((r = alloc_connection(hm))) {
-			if(r->p_httpc->_init(p_sio, mpi_bmap, m_connection_timeout)) {
+			if(r->p_httpc->_init(p_sio, mpi_bmap, m_connection_timeout, this, r)) {
 				_u32 nphttpc = 0;
 				_u32 nbhttpc = 0;
 
 				mpi_list->col(CPENDING, hm);
-				m_num_connections = nphttpc = mpi_list->cnt(hm);
+				nphttpc = mpi_list->cnt(hm);
 				mpi_list->col(CBUSY, hm);
 				nbhttpc = mpi_list->cnt(hm);
+				mpi_list->col(CSUSPENDED, hm);
+				m_num_connections = nphttpc + nbhttpc + mpi_list->cnt(hm);
 
 				if(!m_num_workers ||
 						((m_num_workers - nbhttpc) < nphttpc &&
@@ -291,6 +317,28 @@ _http_connection_t *cHttpServer::add_connection(void) {
 	return r;
 }
 
+#define REJECT_RESPONSE	"HTTP/1.1 503 Service Unavailable\r\n" \
+			"Retry-After: 1\r\n" \
+			"Connection: close\r\n" \
+			"Content-Length: 0\r\n\r\n"
+
+bool cHttpServer::reject_connection(void) {
+	bool r = false;
+
+	// released connections are subtracted by release_connection
+	if(m_num_connections >= m_max_connections) {
+		iSocketIO *pi_sio = p_tcps->listen();
+
+		if(pi_sio) {
+			pi_sio->write(REJECT_RESPONSE, sizeof(REJECT_RESPONSE) - 1);
+			p_tcps->close(pi_sio);
+			r = true;
+		}
+	}
+
+	return r;
+}
+
 _http_connection_t *cHttpServer::get_connection(void) {
 	HMUTEX hm = mpi_list->lock();
 	_u32 sz = 0;
@@ -313,11 +361,102 @@ void cHttpServer::pending_connection(_http_connection_t *rec) {
 	HMUTEX hm = mpi_list->lock();
 
 	if(rec->state == CBUSY) {
+		// suspended by event handler or already resumed
+		_u8 col = (rec->async == ASYNC_SUSPEND) ? CSUSPENDED : CPENDING;
+
+		if(mpi_list->mov(rec, col, hm)) {
+			rec->state = col;
+			rec->t_suspend = time(NULL);
+		}
+	}
+
+	mpi_list->unlock(hm);
+}
+
+bool cHttpServer::suspend_connection(_http_connection_t *rec) {
+	bool r = false;
+	HMUTEX hm = mpi_list->lock();
+
+	// only from event handler (worker owns the connection)
+	if(rec->state == CBUSY) {
+		rec->async = ASYNC_SUSPEND;
+		r = true;
+	}
+
+	mpi_list->unlock(hm);
+
+	return r;
+}
+
+void cHttpServer::resume_connection(_http_connection_t *rec) {
+	HMUTEX hm = mpi_list->lock();
+
+	if(rec->state == CSUSPENDED) {
 		if(mpi_list->mov(rec, CPENDING, hm))
 			rec->state = CPENDING;
+	} else if(rec->state == CEXPIRED) {
+		// too late, the client is disconnected
+		mpi_list->unlock(hm);
+		call_event_handler(HTTP_ON_CLOSE, rec->p_httpc);
+		hm = mpi_list->lock();
+		mpi_list->col(CEXPIRED, hm);
+		if(mpi_list->sel(rec, hm)) {
+			rec->p_httpc->close();
+			if(mpi_list->mov(rec, CFREE, hm))
+				rec->state = CFREE;
+		}
+	}
+	// resumed before the end of event handler
+	rec->async = 0;
+
+	mpi_list->unlock(hm);
+
+	if(!m_num_workers && m_is_running)
+		start_worker();
+}
+
+void cHttpServer::expire_connections(bool all) {
+	time_t now = time(NULL);
+
+	if(all || now != m_expire_time) {
+		HMUTEX hm = mpi_list->lock();
+		_u32 sz = 0;
+
+		m_expire_time = now;
+		mpi_list->col(CSUSPENDED, hm);
+
+		_http_connection_t *rec = (_http_connection_t *)mpi_list->first(&sz, hm);
+
+		while(rec) {
+			if(all || (_u32)(now - rec->t_suspend) > m_connection_timeout) {
+				// the handler owns the connection until resume
+				rec->p_httpc->_shutdown();
+				if(mpi_list->mov(rec, CEXPIRED, hm)) {
+					rec->state = CEXPIRED;
+					if(m_num_connections)
+						m_num_connections--;
+					if(mpi_log && !all)
+						mpi_log->fwrite(LMT_WARNING, "HTTP(%u): suspended connection expired", m_port);
+				}
+				mpi_list->col(CSUSPENDED, hm);
+				rec = (_http_connection_t *)mpi_list->current(&sz, hm);
+			} else
+				rec = (_http_connection_t *)mpi_list->next(&sz, hm);
+		}
+
+		mpi_list->unlock(hm);
 	}
+}
+
+_u32 cHttpServer::column_count(_u8 col) {
+	_u32 r = 0;
+	HMUTEX hm = mpi_list->lock();
 
+	mpi_list->col(col, hm);
+	r = mpi_list->cnt(hm);
 	mpi_list->unlock(hm);
+
+	return r;
 }
 
 void cHttpServer::release_connection(_http_connection_t *rec) {
@@ -328,6 +467,8 @@ void cHttpServer::release_connection(_http_connection_t *rec) {
 		if(rec->p_httpc)
 			rec->p_httpc->close();
 		mpi_list->mov(rec, CFREE, hm);
+		if(m_num_connections)
+			m_num_connections--;
 	}
 
 	mpi_list->unlock(hm);
@@ -340,7 +481,7 @@ void cHttpServer::clear_column(_u8 col, HMUTEX hlock) {
 	mpi_list->col(col, hlock);
 	while((rec = (_http_connection_t *)mpi_list->first(&sz, hlock))) {
 		if(rec->p_httpc) {
-			if(col == CBUSY || col == CPENDING)
+			if(col != CFREE)
 				call_event_handler(HTTP_ON_CLOSE, rec->p_httpc);
 			_gpi_repo_->object_release(rec->p_httpc);
 		}
@@ -354,7 +495,50 @@ void cHttpServer::remove_all_connections(void) {
 	clear_column(CFREE, hm);
 	clear_column(CBUSY, hm);
 	clear_column(CPENDING, hm);
+	clear_column(CSUSPENDED, hm);
+	clear_column(CEXPIRED, hm);
+	mpi_list->unlock(hm);
+}
+
+_u32 cHttpServer::ws_broadcast(_u8 opcode, const void *data, _u32 size,
+				_ws_filter_t *pcb_filter, void *udata) {
+	_u32 r = 0;
+	_u8 hdr[WS_MAX_FRAME_HEADER];
+	// encode frame header once for all connections
+	_u32 sz_hdr = ws_frame_header(hdr, opcode, size);
+	std::vector<_ws_target_t> v_target;
+	HMUTEX hm = mpi_list->lock();
+	_u8 col[] = {CPENDING, CBUSY};
+
+	// collect receivers only, because a slow client must not block the list
+	for(_u32 i = 0; i < sizeof(col); i++) {
+		_u32 sz = 0;
+
+		mpi_list->col(col[i], hm);
+
+		_http_connection_t *rec = (_http_connection_t *)mpi_list->first(&sz, hm);
+
+		while(rec) {
+			cHttpServerConnection *p_httpc = rec->p_httpc;
+
+			if(p_httpc && p_httpc->is_websocket() &&
+					(!pcb_filter || pcb_filter(p_httpc, udata)))
+				v_target.push_back({p_httpc, p_httpc->ws_session()});
+
+			rec = (_http_connection_t *)mpi_list->next(&sz, hm);
+		}
+	}
+
 	mpi_list->unlock(hm);
+
+	// connection objects live until server stop, but the socket can be
+	// closed meanwhile (the session check skips it)
+	for(auto &t : v_target) {
+		if(t.p_httpc->ws_send_frame(t.session, hdr, sz_hdr, data, size))
+			r++;
+	}
+
+	return r;
 }
 
 static cHttpServer _g_http_server_;
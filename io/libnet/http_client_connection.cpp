@@ -1,5 +1,8 @@
 #include <string.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
 #include "private.h"
 
 #define INITIAL_BUFFER_ARRAY	16
@@ -12,6 +15,20 @@
 #define KEY_RES_CODE	"KEY-RES-CODE"
 #define KEY_CONTENT_LEN "Content-Length"
 #define KEY_RES_HEADER	"KEY-RES-HEADER"
+#define KEY_TRANSFER_ENCODING "Transfer-Encoding"
+
+// response content framing
+#define RES_LENGTH	1 // Content-Length
+#define RES_CHUNKED	2 // chunked transfer encoding
+#define RES_CLOSE	3 // terminated by connection close
+
+// chunked decoder state
+#define CHUNK_SIZE	0
+#define CHUNK_DATA	1
+#define CHUNK_END	2 // CRLF after chunk data
+#define CHUNK_TRAILER	3
+
+#define RECEIVE_POLL	100 // milliseconds
 
 typedef struct {
 	_char_t pair[MAX_VAR_LEN];
@@ -28,7 +45,8 @@ bool cHttpClientConnection::object_ctl(_u32 cmd, void *arg, ...) {
 	switch(cmd) {
 		case OCTL_INIT:
 			mpi_sio = NULL;
-			mpi_map = dynamic_cast <iMap *>(_gpi_repo_->object_by_iname(I_MAP, RF_CLONE | RF_NONOTIFY));
+			if(!(mpi_map = dynamic_cast <iMap *>(_gpi_repo_->object_by_cname(CLASS_NAME_FAST_MAP, RF_CLONE | RF_NONOTIFY))))
+				mpi_map = dynamic_cast <iMap *>(_gpi_repo_->object_by_iname(I_MAP, RF_CLONE | RF_NONOTIFY));
 			mpi_heap = dynamic_cast<iHeap *>(_gpi_repo_->object_by_iname(I_HEAP, RF_ORIGINAL));
 			mpi_str = dynamic_cast<iStr *>(_gpi_repo_->object_by_iname(I_STR, RF_ORIGINAL));
 			if(mpi_map && mpi_heap && mpi_str) {
@@ -74,6 +92,9 @@ bool cHttpClientConnection::_init(iSocketIO *pi_sio, _u32 buffer_size) {
 	m_content_len = 0;
 	m_header_len = 0;
 	m_res_code = 0;
+	m_res_mode = m_chunk_state = 0;
+	m_res_left = m_rd_offset = m_rd_len = 0;
+	m_res_done = false;
 	return r;
 }
 
@@ -116,6 +137,9 @@ void cHttpClientConnection::reset(void) {
 	m_header_len = 0;
 	m_req_method = 0;
 	m_res_code = 0;
+	m_res_mode = m_chunk_state = 0;
+	m_res_left = m_rd_offset = m_rd_len = 0;
+	m_res_done = false;
 	mpi_map->clr();
 	if(mp_bheader)
 		memset(mp_bheader, 0, m_buffer_size);
@@ -124,8 +148,15 @@ void cHttpClientConnection::reset(void) {
 bool cHttpClientConnection::alive(void) {
 	bool r = false;
 
-	if(mpi_sio)
-		r = mpi_sio->alive();
+	if(mpi_sio && (r = mpi_sio->alive()) && m_res_done) {
+		// idle keep-alive connection must not have any input,
+		// otherwise it's closed (or going to be closed) by peer
+		_u8 b = 0;
+		_s32 n = recv(mpi_sio->socket(), &b, 1, MSG_PEEK|MSG_DONTWAIT);
+
+		if(n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+			r = false;
+	}
 
 	return r;
 }
@@ -334,12 +365,10 @@ _u32 cHttpClientConnection::receive_buffer(void *buffer, time_t now, _u32 timeou
 	return r;
 }
 
-bool cHttpClientConnection::send(_u32 timeout_s, _on_http_response_t *p_cb_resp, void *udata) {
+bool cHttpClientConnection::send_request(void) {
 	bool r = false;
 
 	if(prepare_req_header()) {
-		time_t now = time(NULL);
-
 		mpi_sio->blocking(true);
 
 		// send header
@@ -360,17 +389,31 @@ bool cHttpClientConnection::send(_u32 timeout_s, _on_http_response_t *p_cb_resp,
 
 			if(buffer) {
 				_u32 sz = ((m_buffer_size - bo) < rem) ? (m_buffer_size - bo) : rem;
+				_u32 n = mpi_sio->write((_u8 *)buffer + bo,  sz);
 
-				bytes += mpi_sio->write((_u8 *)buffer + bo,  sz);
+				if(!n)
+					break;
+				bytes += n;
 			} else
 				break;
 		}
 
+		mpi_sio->blocking(false);
+		r = (bytes == m_content_len);
+	}
+
+	return r;
+}
+
+bool cHttpClientConnection::send(_u32 timeout_s, _on_http_response_t *p_cb_resp, void *udata) {
+	bool r = false;
+
+	if(send_request()) {
+		time_t now = time(NULL);
+		_u32 bytes = 0;
 		bool complete_header=false, complete_content=false;
 
 		reset();
-		bytes = 0;
-		mpi_sio->blocking(false);
 
 		// receive header ...
 		if((bytes = receive_buffer(mp_bheader, now, timeout_s))) {
@@ -421,6 +464,7 @@ bool cHttpClientConnection::send(_u32 timeout_s, _on_http_response_t *p_cb_resp,
 		}
 
 		if((r = complete_header && complete_content)) {
+			m_res_done = true;
 			if(p_cb_resp)
 				res_content(p_cb_resp, udata);
 		}
@@ -429,6 +473,190 @@ bool cHttpClientConnection::send(_u32 timeout_s, _on_http_response_t *p_cb_resp,
 	return r;
 }
 
+_u32 cHttpClientConnection::receive_wait(void *buffer, _u32 size, time_t deadline, bool wait) {
+	_u32 r = 0;
+
+	while(!(r = mpi_sio->read(buffer, size)) && wait && alive() && time(NULL) < deadline) {
+		struct pollfd pfd = {mpi_sio->socket(), POLLIN, 0};
+
+		poll(&pfd, 1, RECEIVE_POLL);
+	}
+
+	return r;
+}
+
+// read more data after unread part of header buffer
+bool cHttpClientConnection::receive_more(time_t deadline, bool wait) {
+	bool r = false;
+
+	if(m_rd_offset) {
+		memmove(mp_bheader, mp_bheader + m_rd_offset, m_rd_len - m_rd_offset);
+		m_rd_len -= m_rd_offset;
+		m_rd_offset = 0;
+	}
+
+	if(m_rd_len < m_buffer_size) {
+		_u32 n = receive_wait(mp_bheader + m_rd_len, m_buffer_size - m_rd_len, deadline, wait);
+
+		m_rd_len += n;
+		r = (n > 0);
+	}
+
+	return r;
+}
+
+_u32 cHttpClientConnection::receive_content(void *buffer, _u32 size, time_t deadline, bool wait) {
+	_u32 r = 0;
+	_u32 unread = m_rd_len - m_rd_offset;
+
+	if(unread) {
+		// content received together with header
+		r = (size < unread) ? size : unread;
+		memcpy(buffer, mp_bheader + m_rd_offset, r);
+		m_rd_offset += r;
+	} else
+		r = receive_wait(buffer, size, deadline, wait);
+
+	return r;
+}
+
+// wait for CRLF terminated line at begin of unread data
+bool cHttpClientConnection::receive_line(_u32 *sz, time_t deadline, bool wait) {
+	bool r = false;
+	_s32 eol = -1;
+
+	while((eol = mpi_str->nfind_string(mp_bheader + m_rd_offset, m_rd_len - m_rd_offset, "\r\n")) == -1) {
+		if(!receive_more(deadline, wait))
+			break;
+	}
+
+	if(eol != -1) {
+		*sz = eol;
+		r = true;
+	}
+
+	return r;
+}
+
+bool cHttpClientConnection::request(_u32 timeout_s) {
+	bool r = false;
+	_u8 method = m_req_method;
+
+	if(send_request()) {
+		time_t deadline = time(NULL) + timeout_s;
+		_s32 hdr_end = -1;
+
+		reset();
+
+		while(!r) {
+			// receive header
+			while((hdr_end = mpi_str->nfind_string(mp_bheader + m_rd_offset,
+						m_rd_len - m_rd_offset, "\r\n\r\n")) == -1) {
+				if(!receive_more(deadline, true))
+					break;
+			}
+
+			if(hdr_end == -1)
+				break;
+
+			if(m_rd_offset) {
+				// skip interim response
+				memmove(mp_bheader, mp_bheader + m_rd_offset, m_rd_len - m_rd_offset);
+				m_rd_len -= m_rd_offset;
+				m_rd_offset = 0;
+				mpi_map->clr();
+			}
+
+			m_header_len = m_rd_offset = hdr_end + 4;
+			m_content_len = 0;
+			parse_response_header();
+
+			if(m_res_code / 100 == 1)
+				continue;
+
+			_cstr_t te = res_var(KEY_TRANSFER_ENCODING);
+
+			if(method == HTTP_METHOD_HEAD || m_res_code == HTTPRC_NO_CONTENT ||
+					m_res_code == HTTPRC_NOT_MODIFIED) {
+				m_res_mode = RES_LENGTH;
+				m_res_done = true;
+			} else if(te && strcasestr(te, "chunked")) {
+				m_res_mode = RES_CHUNKED;
+				m_chunk_state = CHUNK_SIZE;
+				m_content_len = 0;
+			} else if(res_var(KEY_CONTENT_LEN)) {
+				m_res_mode = RES_LENGTH;
+				m_res_left = m_content_len;
+				m_res_done = (m_res_left == 0);
+			} else
+				m_res_mode = RES_CLOSE;
+
+			r = (m_res_code != 0);
+		}
+	}
+
+	return r;
+}
+
+_u32 cHttpClientConnection::res_read(void *buffer, _u32 size, _u32 timeout_s) {
+	_u32 r = 0;
+	time_t deadline = time(NULL) + timeout_s;
+
+	while(!m_res_done && r < size) {
+		// wait for data only when there is nothing to return
+		bool wait = (r == 0);
+		_u32 n = 0, sz = 0;
+
+		switch(m_res_mode) {
+			case RES_LENGTH:
+			case RES_CLOSE:
+				sz = size - r;
+				if(m_res_mode == RES_LENGTH && sz > m_res_left)
+					sz = m_res_left;
+				if((n = receive_content((_u8 *)buffer + r, sz, deadline, wait))) {
+					r += n;
+					if(m_res_mode == RES_LENGTH)
+						m_res_done = ((m_res_left -= n) == 0);
+				} else if(m_res_mode == RES_CLOSE && !alive())
+					m_res_done = true;
+				break;
+			case RES_CHUNKED:
+				if(m_chunk_state == CHUNK_DATA) {
+					sz = ((size - r) < m_res_left) ? (size - r) : m_res_left;
+					if((n = receive_content((_u8 *)buffer + r, sz, deadline, wait))) {
+						r += n;
+						if(!(m_res_left -= n))
+							m_chunk_state = CHUNK_END;
+					}
+				} else if(receive_line(&sz, deadline, wait)) {
+					_char_t *line = mp_bheader + m_rd_offset;
+
+					n = sz + 2; // consumed
+					if(m_chunk_state == CHUNK_SIZE) {
+						_char_t hex[16]="";
+
+						memcpy(hex, line, (sz < sizeof(hex) - 1) ? sz : sizeof(hex) - 1);
+						m_res_left = strtoul(hex, NULL, 16);
+						m_chunk_state = (m_res_left) ? CHUNK_DATA : CHUNK_TRAILER;
+					} else if(m_chunk_state == CHUNK_END)
+						m_chunk_state = CHUNK_SIZE;
+					else if(!sz) // empty line after trailer
+						m_res_done = true;
+					m_rd_offset += n;
+				}
+				break;
+		}
+
+		if(!n)
+			// no progress (timeout, error or no data without waiting)
+			break;
+	}
+
+	m_content_len += r;
+
+	return r;
+}
+
 _u32 cHttpClientConnection::parse_response_line(void) {
 	_u32 r = 0;
 	_char_t c = 0;
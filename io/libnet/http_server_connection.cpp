@@ -4,17 +4,6 @@
 #include "time.h"
 #include "url-codec.h"
 
-// http connection status
-enum httpc_state {
-	HTTPC_RECEIVE_HEADER =	1,
-	HTTPC_COMPLETE_HEADER,
-	HTTPC_PARSE_HEADER,
-	HTTPC_RECEIVE_CONTENT,
-	HTTPC_SEND_HEADER,
-	HTTPC_SEND_CONTENT,
-	HTTPC_CLOSE
-};
-
 typedef struct {
 	_u16 	rc;
 	_cstr_t	text;
@@ -54,6 +43,7 @@ static _http_resp_text_t _g_http_resp_text[] = {
 	{HTTPRC_REQ_URI_TOO_LARGE,	"Request-URI Too Large"},
 	{HTTPRC_UNSUPPORTED_MEDIA_TYPE,	"Unsupported Media Type"},
 	{HTTPRC_EXPECTATION_FAILED,	"Expectation Failed"},
+	{HTTPRC_TOO_MANY_REQUESTS,	"Too Many Requests"},
 	{HTTPRC_INTERNAL_SERVER_ERROR,	"Internal Server Error"},
 	{HTTPRC_NOT_IMPLEMENTED,	"Not Implemented"},
 	{HTTPRC_BAD_GATEWAY,		"Bad Gateway"},
@@ -82,9 +72,41 @@ static _http_method_map _g_method_map[] = {
 
 #define USE_CONNECTION_TIMEOUT
 
+#define HTTP_DATE_FORMAT	"%a, %d %b %Y %H:%M:%S GMT"
+#define HTTP_DATE_SIZE		32
+
+// 'Date' line is formatted once per second by every worker thread
+static thread_local time_t _g_date_time_ = 0;
+static thread_local _char_t _g_date_line_[HTTP_DATE_SIZE + 8];
+static thread_local _u32 _g_date_size_ = 0;
+
+static void http_time(time_t t, _char_t *str, _u32 size) {
+	tm _tm;
+
+	gmtime_r(&t, &_tm);
+	strftime(str, size, HTTP_DATE_FORMAT, &_tm);
+}
+
+static _cstr_t http_date(_u32 *size) {
+	time_t now = time(NULL);
+
+	if(now != _g_date_time_) {
+		_char_t date[HTTP_DATE_SIZE];
+
+		http_time(now, date, sizeof(date));
+		_g_date_size_ = snprintf(_g_date_line_, sizeof(_g_date_line_), "Date: %s\r\n", date);
+		_g_date_time_ = now;
+	}
+
+	*size = _g_date_size_;
+
+	return _g_date_line_;
+}
+
 static iStr *gpi_str = 0;
 static HOBJECT g_hmap = 0;
 static HOBJECT g_hlist = 0;
+static HOBJECT g_hmutex = 0;
 
 bool cHttpServerConnection::object_ctl(_u32 cmd, void *arg, ...) {
 	bool r = false;
@@ -94,7 +116,11 @@ bool cHttpServerConnection::object_ctl(_u32 cmd, void *arg, ...) {
 			iRepository *pi_repo = (iRepository *)arg;
 
 			mp_sio = NULL;
+			mp_server = NULL;
+			mp_rec = NULL;
 			mpi_bmap = NULL;
+			mpi_ws_mutex = NULL;
+			m_ws_session = 0;
 			memset(m_udata, 0, sizeof(m_udata));
 			m_ibuffer = m_oheader = m_obuffer = 0;
 			if(!gpi_str)
@@ -102,7 +128,10 @@ bool cHttpServerConnection::object_ctl(_u32 cmd, void *arg, ...) {
 			if(g_hmap)
 				mpi_req_map = (iMap *)pi_repo->object_by_handle(g_hmap, RF_CLONE | RF_NONOTIFY);
 			else {
-				if((g_hmap = pi_repo->handle_by_iname(I_MAP))) {
+				// small and short living maps (fast hash)
+				if(!(g_hmap = pi_repo->handle_by_cname(CLASS_NAME_FAST_MAP)))
+					g_hmap = pi_repo->handle_by_iname(I_MAP);
+				if(g_hmap) {
 					mpi_req_map = (iMap *)pi_repo->object_by_handle(g_hmap, RF_CLONE | RF_NONOTIFY);
 				}
 			}
@@ -110,8 +139,12 @@ bool cHttpServerConnection::object_ctl(_u32 cmd, void *arg, ...) {
 				g_hlist = pi_repo->handle_by_iname(I_LLIST);
 			if(g_hlist)
 				mpi_cookie_list = (iLlist *)pi_repo->object_by_handle(g_hlist, RF_CLONE | RF_NONOTIFY);
+			if(!g_hmutex)
+				g_hmutex = pi_repo->handle_by_iname(I_MUTEX);
+			if(g_hmutex)
+				mpi_ws_mutex = (iMutex *)pi_repo->object_by_handle(g_hmutex, RF_CLONE | RF_NONOTIFY);
 
-			if(gpi_str && mpi_req_map && mpi_cookie_list) {
+			if(gpi_str && mpi_req_map && mpi_cookie_list && mpi_ws_mutex) {
 				r = mpi_req_map->init(31);
 				r &= mpi_cookie_list->init(LL_VECTOR, 1);
 				clean_members();
@@ -124,6 +157,7 @@ bool cHttpServerConnection::object_ctl(_u32 cmd, void *arg, ...) {
 			pi_repo->object_release(gpi_str);
 			pi_repo->object_release(mpi_req_map);
 			pi_repo->object_release(mpi_cookie_list);
+			pi_repo->object_release(mpi_ws_mutex);
 			r = true;
 		} break;
 	}
@@ -148,18 +182,30 @@ void cHttpServerConnection::clean_members(void) {
 	mp_doc = 0;
 	m_req_data = false;
 	m_res_hdr_prepared = false;
+	m_res_len_prepared = false;
+	m_close = false;
+	m_res_chunked = m_chunk_wait = m_chunk_end = false;
+	m_ws_upgrade = false;
+	m_ws_opcode = m_ws_frag_opcode = 0;
+	m_ws_assembled = m_ws_consumed = 0;
+	m_ws_msg_offset = m_ws_msg_len = 0;
+	m_ws_msg_ready = false;
+	m_replay = false;
 	m_stime = time(NULL);
 	strncpy(m_res_protocol, "HTTP/1.1", sizeof(m_res_protocol)-1);
 	mpi_req_map->clr();
 	mpi_cookie_list->clr();
 }
 
-bool cHttpServerConnection::_init(cSocketIO *p_sio, iBufferMap *pi_bmap, _u32 timeout) {
+bool cHttpServerConnection::_init(cSocketIO *p_sio, iBufferMap *pi_bmap, _u32 timeout,
+				cHttpServer *p_srv, void *p_rec) {
 	bool r = false;
 
 	if(!mp_sio && p_sio && (r = p_sio->alive())) {
 		clean_members();
 		mp_sio = p_sio;
+		mp_server = p_srv;
+		mp_rec = p_rec;
 		mpi_bmap = pi_bmap;
 		m_timeout = timeout;
 		// use non blocking mode
@@ -171,13 +217,25 @@ bool cHttpServerConnection::_init(cSocketIO *p_sio, iBufferMap *pi_bmap, _u32 ti
 
 void cHttpServerConnection::close(void) {
 	if(mp_sio) {
+		// wait for pending frame output (see ws_broadcast)
+		HMUTEX hm = (mpi_ws_mutex) ? mpi_ws_mutex->lock() : 0;
+
 		_gpi_repo_->object_release(mp_sio);
 		mp_sio = NULL;
+		m_ws_session++;
+		if(mpi_ws_mutex)
+			mpi_ws_mutex->unlock(hm);
 	}
 
 	release_buffers();
 }
 
+void cHttpServerConnection::_shutdown(void) {
+	if(mp_sio)
+		// the owner gets I/O errors and the client sees the end of connection
+		shutdown(mp_sio->socket(), SHUT_RDWR);
+}
+
 void cHttpServerConnection::release_buffers(void) {
 	if(m_ibuffer) {
 		mpi_bmap->free(m_ibuffer);
@@ -569,13 +627,27 @@ void cHttpServerConnection::clear_ibuffer(void) {
 }
 
 void cHttpServerConnection::prepare_res_header(void) {
+	_u32 sz_date = 0;
+	_cstr_t date = http_date(&sz_date);
+
+	res_header(date, sz_date);
+
 	// Add content type to response header
 	if(m_content_type) {
 		res_var("Content-Type", m_content_type);
 	}
 
-	// Add content length to response header
-	if(m_res_content_len) {
+	if(m_res_chunked) {
+		_cstr_t protocol = req_protocol();
+
+		if(protocol && strcmp(protocol, "HTTP/1.0") == 0) {
+			// content ends by connection close
+			res_var("Connection", "close");
+			m_close = true;
+		} else
+			res_var("Transfer-Encoding", "chunked");
+	} else if(m_res_content_len && !m_res_len_prepared) {
+		// Add content length to response header
 		_char_t cl[32]="";
 
 		sprintf(cl, "%lu", m_res_content_len);
@@ -670,14 +742,50 @@ _u32 cHttpServerConnection::send_content(void) {
 				mp_sio->blocking(false);
 			}
 		}
+	} else if(m_res_chunked && !m_chunk_end) {
+		_u8 *ptr = (m_obuffer) ? (_u8 *)mpi_bmap->ptr(m_obuffer) : NULL;
+		bool framing = !m_close;
+
+		mp_sio->blocking(true);
+		if(ptr && m_obuffer_offset) {
+			if(framing && !m_obuffer_sent) {
+				_char_t cs[16]="";
+				_u32 n = snprintf(cs, sizeof(cs), "%x\r\n", m_obuffer_offset);
+
+				mp_sio->write(cs, n);
+			}
+
+			r = mp_sio->write(ptr + m_obuffer_sent, m_obuffer_offset - m_obuffer_sent);
+			m_obuffer_sent += r;
+			m_content_sent += r;
+			if(framing && m_obuffer_sent >= m_obuffer_offset)
+				mp_sio->write("\r\n", 2);
+			m_chunk_wait = false;
+		} else if(m_chunk_wait) {
+			// nothing written by HTTP_ON_RESPONSE_DATA (last chunk)
+			if(framing)
+				mp_sio->write("0\r\n\r\n", 5);
+			m_chunk_end = true;
+		}
+		mp_sio->blocking(false);
 	}
 
 	return r;
 }
 
+bool cHttpServerConnection::res_pending(void) {
+	return (m_res_chunked) ? !m_chunk_end : (m_content_sent < m_res_content_len);
+}
+
 _u8 cHttpServerConnection::process(void) {
 	_u8 r = 0;
 
+	if(m_replay) {
+		// request handling again (see resume)
+		m_replay = false;
+		return HTTP_ON_RESUME;
+	}
+
 	switch(m_state) {
 		case 0:
 			r = HTTP_ON_OPEN;
@@ -722,6 +830,11 @@ _u8 cHttpServerConnection::process(void) {
 			}
 			break;
 		case HTTPC_RECEIVE_CONTENT:
+			if(m_ws_upgrade) {
+				// keep early frames in input buffer
+				m_state = HTTPC_SEND_HEADER;
+				break;
+			}
 			clear_ibuffer();
 			if(receive_content()) {
 				r = HTTP_ON_REQUEST_DATA;
@@ -736,6 +849,25 @@ _u8 cHttpServerConnection::process(void) {
 			}
 			break;
 		case HTTPC_SEND_HEADER:
+			if(m_close) {
+				// rejected (don't wait for request content)
+				if(alive()) {
+					send_header();
+					if(m_oheader_sent == m_oheader_offset)
+						m_state = HTTPC_SEND_CONTENT;
+				} else
+					m_state = HTTPC_CLOSE;
+				break;
+			}
+			if(m_ws_upgrade) {
+				if(alive()) {
+					send_header();
+					if(m_oheader_sent == m_oheader_offset)
+						m_state = HTTPC_WS_RECEIVE;
+				} else
+					m_state = HTTPC_CLOSE;
+				break;
+			}
 			clear_ibuffer();
 			if(!receive_content()) {
 				if(alive() && m_response_code) {
@@ -752,23 +884,24 @@ _u8 cHttpServerConnection::process(void) {
 			break;
 		case HTTPC_SEND_CONTENT:
 			clear_ibuffer();
-			if(receive_content()) {
+			if(!m_close && receive_content()) {
 				r = HTTP_ON_REQUEST_DATA;
 				m_req_data = true;
 			} else {
 				if(alive()) {
 					send_content();
-					if(m_content_sent < m_res_content_len) {
+					if(res_pending()) {
 						if(!mp_doc) {
 							if(m_obuffer_sent >= m_obuffer_offset) {
 								r = HTTP_ON_RESPONSE_DATA;
 								m_obuffer_sent = m_obuffer_offset = 0;
+								m_chunk_wait = m_res_chunked;
 							}
 						}
 					} else {
 						_cstr_t ctype = req_var("Connection");
 
-						if(ctype && strcasecmp(ctype, "keep-alive") == 0) { // reuse connection
+						if(!m_close && ctype && strcasecmp(ctype, "keep-alive") == 0) { // reuse connection
 							clean_members();
 							m_state = HTTPC_RECEIVE_HEADER;
 							r = HTTP_ON_CLOSE_DOCUMENT;
@@ -780,6 +913,9 @@ _u8 cHttpServerConnection::process(void) {
 				m_req_data = false;
 			}
 			break;
+		case HTTPC_WS_RECEIVE:
+			r = ws_process();
+			break;
 		case HTTPC_CLOSE:
 			close();
 			break;
@@ -788,6 +924,34 @@ _u8 cHttpServerConnection::process(void) {
 	return r;
 }
 
+bool cHttpServerConnection::suspend(void) {
+	bool r = false;
+
+	if(mp_server && mp_rec && !m_ws_upgrade)
+		r = mp_server->suspend_connection((_http_connection_t *)mp_rec);
+
+	return r;
+}
+
+void cHttpServerConnection::resume(bool replay) {
+	if(replay)
+		m_replay = true;
+	if(mp_server && mp_rec)
+		mp_server->resume_connection((_http_connection_t *)mp_rec);
+}
+
+void cHttpServerConnection::reject(_u16 httprc) {
+	if(m_state && m_state < HTTPC_SEND_HEADER) {
+		res_code(httprc);
+		res_var("Connection", "close");
+		m_res_content_len = 0;
+		m_res_chunked = false;
+		mp_doc = NULL;
+		m_close = true;
+		m_state = HTTPC_SEND_HEADER;
+	}
+}
+
 _u32 cHttpServerConnection::res_write(_u8 *data, _u32 size) {
 	_u32 r = 0;
 
@@ -901,9 +1065,15 @@ bool cHttpServerConnection::res_var(_cstr_t name, _cstr_t value) {
 
 bool cHttpServerConnection::res_content_len(_ulong content_len) {
 	m_res_content_len = content_len;
+	m_res_chunked = false;
 	return true;
 }
 
+void cHttpServerConnection::res_chunked(void) {
+	m_res_content_len = 0;
+	m_res_chunked = true;
+}
+
 void cHttpServerConnection::res_cookie(_cstr_t name,
 		_cstr_t value,
 		_u8 flags,
@@ -936,11 +1106,31 @@ void cHttpServerConnection::res_cookie(_cstr_t name,
 }
 
 void cHttpServerConnection::res_mtime(time_t mtime) {
-	_char_t value[128]="";
-	tm *_tm = gmtime(&mtime);
-	strftime(value, sizeof(value), "%a, %d %b %Y %H:%M:%S GMT", _tm);
+	_char_t value[HTTP_DATE_SIZE]="";
 
+	http_time(mtime, value, sizeof(value));
 	res_var("Last-Modified", value);
 }
 
+bool cHttpServerConnection::res_header(const void *data, _u32 size, _u8 flags) {
+	bool r = false;
+
+	if(!m_oheader)
+		m_oheader = mpi_bmap->alloc();
+	if(m_oheader) {
+		_char_t *ptr = (_char_t *)mpi_bmap->ptr(m_oheader);
+		_u32 sz = mpi_bmap->size();
+
+		if(ptr && m_oheader_offset + size < sz) {
+			memcpy(ptr + m_oheader_offset, data, size);
+			m_oheader_offset += size;
+			if(flags & HTTP_HDR_CONTENT_LEN)
+				m_res_len_prepared = true;
+			r = true;
+		}
+	}
+
+	return r;
+}
+
 static cHttpServerConnection _g_httpc_;
@@ -77,9 +77,25 @@ public:
 
 #define HTTPC_MAX_UDATA_INDEX	8
 
+// http connection status
+enum httpc_state {
+	HTTPC_RECEIVE_HEADER =	1,
+	HTTPC_COMPLETE_HEADER,
+	HTTPC_PARSE_HEADER,
+	HTTPC_RECEIVE_CONTENT,
+	HTTPC_SEND_HEADER,
+	HTTPC_SEND_CONTENT,
+	HTTPC_WS_RECEIVE,
+	HTTPC_CLOSE
+};
+
+class cHttpServer;
+
 class cHttpServerConnection: public iHttpServerConnection {
 private:
 	cSocketIO	*mp_sio;
+	cHttpServer	*mp_server;
+	void		*mp_rec; // record in connection list of server
 	iBufferMap	*mpi_bmap;
 	iMap		*mpi_req_map;  // request variables container
 	iLlist		*mpi_cookie_list;
@@ -107,6 +123,23 @@ private:
 	_cstr_t		m_content_type;
 	void		*mp_doc;
 	bool		m_res_hdr_prepared;
+	bool		m_res_len_prepared; // 'Content-Length' is in prepared lines
+	bool		m_close; // close after response
+	bool		m_res_chunked; // chunked transfer encoding
+	bool		m_chunk_wait; // HTTP_ON_RESPONSE_DATA is expected to write next chunk
+	bool		m_chunk_end; // last chunk is sent
+	volatile bool	m_replay; // HTTP_ON_RESUME is expected
+	// WebSocket
+	iMutex		*mpi_ws_mutex; // serialize frame output
+	bool		m_ws_upgrade;
+	_u8		m_ws_opcode; // opcode of current message
+	_u8		m_ws_frag_opcode; // opcode of fragmented message
+	_u32		m_ws_assembled; // size of assembled fragments
+	_u32		m_ws_consumed; // bytes to discard before next frame
+	_u32		m_ws_msg_offset; // current message offset (in input buffer)
+	_u32		m_ws_msg_len; // current message length
+	bool		m_ws_msg_ready; // current message is valid (can be empty)
+	_u32		m_ws_session; // changes when socket is closed (see ws_broadcast)
 
 	_cstr_t get_rc_text(_u16 rc);
 	bool complete_req_header(void);
@@ -123,12 +156,19 @@ private:
 	void clean_members(void);
 	void release_buffers(void);
 	void prepare_res_header(void);
+	bool res_pending(void);
+	_u8 ws_process(void);
+	_u8 ws_frame(_u8 *ptr, _u32 sz_buffer, bool *next);
+	_u8 ws_protocol_error(_u16 code);
 
 public:
 	BASE(cHttpServerConnection, CLASS_NAME_HTTP_SERVER_CONNECTION, RF_CLONE, 1,0,0);
 	bool object_ctl(_u32 cmd, void *arg, ...);
-	bool _init(cSocketIO *p_sio, iBufferMap *pi_bmap, _u32 timeout);
+	bool _init(cSocketIO *p_sio, iBufferMap *pi_bmap, _u32 timeout,
+			cHttpServer *p_srv=NULL, void *p_rec=NULL);
 	void close(void);
+	// shut down the socket, but keep it for the owner of connection
+	void _shutdown(void);
 	bool alive(void);
 	_u8 process(void);
 	cSocketIO *get_socket_io(void) {
@@ -167,6 +207,7 @@ public:
 	bool req_parse_content(void);
 	// set variable in response header
 	bool res_var(_cstr_t name, _cstr_t value);
+	bool res_header(const void *data, _u32 size, _u8 flags=0);
 	// get error code
 	_u16 error_code(void) {
 		return m_error_code;
@@ -183,6 +224,7 @@ public:
 	}
 	// set Content-Length variable
 	bool res_content_len(_ulong content_len);
+	void res_chunked(void);
 	// return content len of response
 	_ulong res_content_len(void) {
 		return m_res_content_len;
@@ -221,11 +263,39 @@ public:
 	// write response
 	_u32 res_write(_u8 *data, _u32 size);
 	_u32 res_write(_cstr_t str);
+	void reject(_u16 httprc);
+	// WebSocket
+	bool ws_upgrade(_cstr_t protocol=NULL);
+	bool is_websocket(void);
+	_u8 *ws_message(_u32 *size, _u8 *opcode=NULL);
+	bool ws_send(_u8 opcode, const void *data, _u32 size);
+	bool ws_close(_u16 code=WS_CLOSE_NORMAL);
+	// asynchronous response
+	bool suspend(void);
+	void resume(bool replay=false);
+	// write prepared frame header and payload
+	bool ws_send_frame(_u8 *hdr, _u32 sz_hdr, const void *data, _u32 size);
+	// current socket session (changes at close)
+	_u32 ws_session(void) {
+		return m_ws_session;
+	}
+	// write frame only if the socket is still the one of 'session'
+	bool ws_send_frame(_u32 session, _u8 *hdr, _u32 sz_hdr, const void *data, _u32 size);
+	// true if input buffer contains data after current message
+	bool ws_pending(void);
 };
 
+// max. size of WebSocket frame header (server side, no mask)
+#define WS_MAX_FRAME_HEADER	10
+
+// encode WebSocket frame header and return header size
+_u32 ws_frame_header(_u8 *hdr, _u8 opcode, _u64 size);
+
 typedef struct {
 	cHttpServerConnection *p_httpc;
 	_u8 state;
+	_u8 async; // suspend request of event handler
+	time_t t_suspend; // start of suspended state
 }_http_connection_t;
 
 typedef struct {
@@ -253,20 +323,27 @@ private:
 	_u32			m_max_workers;
 	_u32			m_max_connections;
 	_u32			m_connection_timeout;
-	_u32			m_num_connections;
+	volatile _u32		m_num_connections; // pending, busy and suspended
+	time_t			m_expire_time; // last check of suspended connections
 	_u32			m_port;
 
 	friend void *_http_worker_thread(_u8 sig, void *);
 	friend void *_http_server_thread(_u8 sig, void *);
+	friend class cHttpServerConnection;
 
 	void http_server_thread(void);
 	bool start_worker(void);
 	bool stop_worker(void);
 	_http_connection_t *add_connection(void);
+	bool reject_connection(void);
 	_http_connection_t *get_connection(void);
 	_http_connection_t *alloc_connection(HMUTEX hlock);
 	void pending_connection(_http_connection_t *rec);
 	void release_connection(_http_connection_t *rec);
+	bool suspend_connection(_http_connection_t *rec);
+	void resume_connection(_http_connection_t *rec);
+	void expire_connections(bool all=false);
+	_u32 column_count(_u8 col);
 	void clear_column(_u8 col, HMUTEX hlock);
 	void remove_all_connections(void);
 	bool call_event_handler(_u8 evt, iHttpServerConnection *pi_httpc);
@@ -284,6 +361,8 @@ public:
 	bool is_running(void) {
 		return m_is_running;
 	}
+	_u32 ws_broadcast(_u8 opcode, const void *data, _u32 size,
+			_ws_filter_t *pcb_filter=NULL, void *udata=NULL);
 };
 
 class cHttpClientConnection: public iHttpClientConnection {
@@ -300,13 +379,25 @@ private:
 	_u32		m_content_len;
 	_u32		m_header_len;
 	_u16		m_res_code;
+	// incremental response (request/res_read)
+	_u8		m_res_mode; // content framing
+	_u8		m_chunk_state;
+	_u32		m_res_left; // content (or chunk) bytes to receive
+	_u32		m_rd_offset; // unread bytes in header buffer
+	_u32		m_rd_len;
+	bool		m_res_done;
 
 	void *alloc_buffer(void);
 	void *calc_buffer(_u32 *sz);
 	_u32 write_buffer(void *data, _u32 size);
 	bool prepare_req_header(void);
+	bool send_request(void);
 	bool parse_response_header(void);
 	_u32 receive_buffer(void *buffer, time_t now, _u32 timeout_s);
+	_u32 receive_wait(void *buffer, _u32 size, time_t deadline, bool wait);
+	bool receive_more(time_t deadline, bool wait);
+	_u32 receive_content(void *buffer, _u32 size, time_t deadline, bool wait);
+	bool receive_line(_u32 *sz, time_t deadline, bool wait);
 	bool add_var(_cstr_t vname, _u32 sz_vname, _cstr_t vvalue, _u32 sz_vvalue);
 	_u32 parse_response_line(void);
 	_u32 parse_variable_line(_cstr_t var, _u32 sz_max);
@@ -334,12 +425,24 @@ public:
 	_u32 _req_write(_cstr_t fmt, ...);
 	// send request with timeout in seconds
 	bool send(_u32 timeout_s, _on_http_response_t *p_cb_resp=NULL, void *udata=NULL);
+	// send request and receive response header only
+	bool request(_u32 timeout_s);
+	// receive next part of response content
+	_u32 res_read(void *buffer, _u32 size, _u32 timeout_s);
+	bool res_complete(void) {
+		return m_res_done;
+	}
 	// get response code
 	_u16 res_code(void) {
 		return m_res_code;
 	}
 	// get value from response variable
 	_cstr_t res_var(_cstr_t name);
+	// get raw response header
+	_cstr_t res_header(_u32 *size) {
+		*size = m_header_len;
+		return (m_header_len) ? mp_bheader : NULL;
+	}
 	// get response content len
 	_u32 res_content_len(void) {
 		return m_content_len;
@@ -237,8 +237,8 @@ bool cSocketIO::peer_ip(_str_t strip, _u32 len) {
 		struct sockaddr_in *s = (struct sockaddr_in *)&addr;
 		socklen_t _len = sizeof addr;
 
-		getpeername(m_socket, (struct sockaddr*)&addr, &_len);
-		inet_ntop(AF_INET, &s->sin_addr, strip, len);
+		if(getpeername(m_socket, (struct sockaddr*)&addr, &_len) == 0)
+			r = (inet_ntop(AF_INET, &s->sin_addr, strip, len) != NULL);
 	}
 
 	return r;
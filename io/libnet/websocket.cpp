@@ -0,0 +1,347 @@
+#include <string.h>
+#include <openssl/sha.h>
+#include <openssl/evp.h>
+#include "private.h"
+
+// WebSocket (RFC 6455) part of HTTP server connection
+
+#define WS_GUID		"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_FIN		0x80
+#define WS_RSV		0x70
+#define WS_MASK		0x80
+#define WS_OPCODE	0x0f
+#define WS_CONTROL	0x08
+#define WS_MAX_CONTROL	125
+
+_u32 ws_frame_header(_u8 *hdr, _u8 opcode, _u64 size) {
+	_u32 r = 2;
+
+	hdr[0] = WS_FIN | (opcode & WS_OPCODE);
+	if(size < 126)
+		hdr[1] = size;
+	else if(size < 0x10000) {
+		hdr[1] = 126;
+		hdr[2] = size >> 8;
+		hdr[3] = size;
+		r = 4;
+	} else {
+		hdr[1] = 127;
+		for(_u32 i = 0; i < 8; i++)
+			hdr[2 + i] = size >> ((7 - i) * 8);
+		r = 10;
+	}
+
+	return r;
+}
+
+// unmask payload in place
+static void ws_unmask(_u8 *data, _u64 size, const _u8 *mask) {
+	_u8 m[4] = {mask[0], mask[1], mask[2], mask[3]};
+	_u64 i = 0;
+
+	// bytes up to 8 byte boundary
+	for(; i < size && ((_ulong)(data + i) & 7); i++)
+		data[i] ^= m[i & 3];
+
+	if(i + 8 <= size) {
+		// word wide XOR (the mask rotated to current position)
+		_u8 rm[8];
+		_u64 m64, w;
+
+		for(_u32 j = 0; j < 8; j++)
+			rm[j] = m[(i + j) & 3];
+		memcpy(&m64, rm, sizeof(m64));
+
+		for(; i + 8 <= size; i += 8) {
+			memcpy(&w, data + i, sizeof(w));
+			w ^= m64;
+			memcpy(data + i, &w, sizeof(w));
+		}
+	}
+
+	// tail
+	for(; i < size; i++)
+		data[i] ^= m[i & 3];
+}
+
+bool cHttpServerConnection::ws_upgrade(_cstr_t protocol) {
+	bool r = false;
+	_cstr_t upgrade = req_var("Upgrade");
+	_cstr_t key = req_var("Sec-WebSocket-Key");
+	_cstr_t version = req_var("Sec-WebSocket-Version");
+
+	if(m_state == HTTPC_RECEIVE_CONTENT && !m_ws_upgrade &&
+			upgrade && strcasecmp(upgrade, "websocket") == 0 &&
+			key && (!version || atoi(version) == 13)) {
+		_char_t src[128]="";
+		_u8 digest[SHA_DIGEST_LENGTH];
+		_char_t accept[64]="";
+		_u32 n = snprintf(src, sizeof(src), "%s%s", key, WS_GUID);
+
+		if(n < sizeof(src)) {
+			SHA1((_u8 *)src, n, digest);
+			EVP_EncodeBlock((_u8 *)accept, digest, sizeof(digest));
+
+			res_protocol("HTTP/1.1");
+			res_code(HTTPRC_SWITCHING_PROTOCOL);
+			res_var("Upgrade", "websocket");
+			res_var("Connection", "Upgrade");
+			res_var("Sec-WebSocket-Accept", accept);
+			if(protocol)
+				res_var("Sec-WebSocket-Protocol", protocol);
+			m_res_content_len = 0;
+			mp_doc = NULL;
+			m_ws_upgrade = r = true;
+		}
+	}
+
+	return r;
+}
+
+bool cHttpServerConnection::is_websocket(void) {
+	return (m_state == HTTPC_WS_RECEIVE);
+}
+
+_u8 *cHttpServerConnection::ws_message(_u32 *size, _u8 *opcode) {
+	_u8 *r = NULL;
+
+	if(m_ws_msg_ready && m_ibuffer) {
+		_u8 *ptr = (_u8 *)mpi_bmap->ptr(m_ibuffer);
+
+		if(ptr) {
+			// valid pointer even for empty message
+			r = ptr + m_ws_msg_offset;
+			*size = m_ws_msg_len;
+			if(opcode)
+				*opcode = m_ws_opcode;
+		}
+	}
+
+	return r;
+}
+
+bool cHttpServerConnection::ws_pending(void) {
+	return (m_state == HTTPC_WS_RECEIVE && m_ws_msg_ready &&
+		m_ibuffer_offset > m_ws_consumed);
+}
+
+bool cHttpServerConnection::ws_send_frame(_u8 *hdr, _u32 sz_hdr, const void *data, _u32 size) {
+	return ws_send_frame(m_ws_session, hdr, sz_hdr, data, size);
+}
+
+bool cHttpServerConnection::ws_send_frame(_u32 session, _u8 *hdr, _u32 sz_hdr, const void *data, _u32 size) {
+	bool r = false;
+	HMUTEX hm = mpi_ws_mutex->lock();
+
+	// socket may be closed (and connection reused) since session was taken
+	if(session == m_ws_session && mp_sio && mp_sio->alive()) {
+		_u32 n = 0;
+
+		mp_sio->blocking(true);
+		while(n < sz_hdr && mp_sio->alive())
+			n += mp_sio->write(hdr + n, sz_hdr - n);
+		if(n == sz_hdr) {
+			n = 0;
+			while(n < size && mp_sio->alive())
+				n += mp_sio->write((_u8 *)data + n, size - n);
+			r = (n == size);
+		}
+		mp_sio->blocking(false);
+	}
+
+	mpi_ws_mutex->unlock(hm);
+
+	return r;
+}
+
+bool cHttpServerConnection::ws_send(_u8 opcode, const void *data, _u32 size) {
+	bool r = false;
+
+	if(is_websocket()) {
+		_u8 hdr[WS_MAX_FRAME_HEADER];
+		_u32 sz_hdr = ws_frame_header(hdr, opcode, size);
+
+		r = ws_send_frame(hdr, sz_hdr, data, size);
+	}
+
+	return r;
+}
+
+bool cHttpServerConnection::ws_close(_u16 code) {
+	bool r = false;
+
+	if(is_websocket()) {
+		_u8 payload[2] = {(_u8)(code >> 8), (_u8)code};
+
+		r = ws_send(WS_OP_CLOSE, payload, sizeof(payload));
+		m_state = HTTPC_CLOSE;
+	}
+
+	return r;
+}
+
+_u8 cHttpServerConnection::ws_protocol_error(_u16 code) {
+	ws_close(code);
+	m_ws_msg_len = 0;
+	m_ws_msg_ready = false;
+	return 0;
+}
+
+_u8 cHttpServerConnection::ws_process(void) {
+	_u8 r = 0;
+	_u8 *ptr = NULL;
+	_u32 sz_buffer = mpi_bmap->size();
+	bool next = true;
+
+	if(!m_ibuffer)
+		m_ibuffer = mpi_bmap->alloc();
+	if(!m_ibuffer || !(ptr = (_u8 *)mpi_bmap->ptr(m_ibuffer))) {
+		m_state = HTTPC_CLOSE;
+		return r;
+	}
+
+	if(m_ws_msg_ready) {
+		// discard the frame (message) delivered by previous call
+		memmove(ptr, ptr + m_ws_consumed, m_ibuffer_offset - m_ws_consumed);
+		m_ibuffer_offset -= m_ws_consumed;
+		m_ws_consumed = m_ws_msg_len = 0;
+		m_ws_msg_ready = false;
+	}
+
+	if(m_ibuffer_offset < sz_buffer) {
+		// don't switch IO mode while somebody writes a frame
+		HMUTEX hm = mpi_ws_mutex->lock();
+		receive();
+		mpi_ws_mutex->unlock(hm);
+	}
+
+	if(!alive()) {
+		m_state = HTTPC_CLOSE;
+		return r;
+	}
+
+	// parse frames until a message is complete or the buffer is drained
+	while(!r && next && m_state == HTTPC_WS_RECEIVE)
+		r = ws_frame(ptr, sz_buffer, &next);
+
+	return r;
+}
+
+// parse one frame at the end of input buffer
+// 'next' is set when the frame is consumed and the next one can be parsed
+_u8 cHttpServerConnection::ws_frame(_u8 *ptr, _u32 sz_buffer, bool *next) {
+	_u8 r = 0;
+
+	*next = false;
+
+	// parse frame after the assembled fragments
+	_u8 *frame = ptr + m_ws_assembled;
+	_u32 avail = m_ibuffer_offset - m_ws_assembled;
+
+	if(avail < 2)
+		return r;
+
+	_u8 fin = frame[0] & WS_FIN;
+	_u8 opcode = frame[0] & WS_OPCODE;
+	_u64 len = frame[1] & 0x7f;
+	_u32 sz_hdr = 2;
+
+	if((frame[0] & WS_RSV) || !(frame[1] & WS_MASK))
+		// no extensions negotiated and client frames must be masked
+		return ws_protocol_error(WS_CLOSE_PROTOCOL_ERROR);
+
+	if(len == 126) {
+		if(avail < 4)
+			return r;
+		len = ((_u64)frame[2] << 8) | frame[3];
+		sz_hdr = 4;
+	} else if(len == 127) {
+		if(avail < 10)
+			return r;
+		len = 0;
+		for(_u32 i = 0; i < 8; i++)
+			len = (len << 8) | frame[2 + i];
+		sz_hdr = 10;
+	}
+
+	sz_hdr += 4; // mask
+
+	if(m_ws_assembled + sz_hdr + len > sz_buffer)
+		// message does not fit in connection buffer
+		return ws_protocol_error(WS_CLOSE_TOO_BIG);
+
+	if(avail < sz_hdr + len)
+		// incomplete frame
+		return r;
+
+	_u8 *payload = frame + sz_hdr;
+	_u32 sz_frame = sz_hdr + len;
+
+	ws_unmask(payload, len, payload - 4);
+
+	if(opcode & WS_CONTROL) {
+		// control frames may come between fragments
+		if(!fin || len > WS_MAX_CONTROL)
+			return ws_protocol_error(WS_CLOSE_PROTOCOL_ERROR);
+
+		switch(opcode) {
+			case WS_OP_PING:
+				ws_send(WS_OP_PONG, payload, len);
+				break;
+			case WS_OP_PONG:
+				break;
+			case WS_OP_CLOSE:
+				// echo status code
+				ws_send(WS_OP_CLOSE, payload, (len >= 2) ? 2 : 0);
+				m_state = HTTPC_CLOSE;
+				break;
+			default:
+				return ws_protocol_error(WS_CLOSE_PROTOCOL_ERROR);
+		}
+
+		// remove control frame
+		memmove(frame, frame + sz_frame, avail - sz_frame);
+		m_ibuffer_offset -= sz_frame;
+		*next = true;
+	} else {
+		if(opcode == WS_OP_CONTINUATION) {
+			if(!m_ws_frag_opcode)
+				return ws_protocol_error(WS_CLOSE_PROTOCOL_ERROR);
+		} else if(opcode == WS_OP_TEXT || opcode == WS_OP_BINARY) {
+			if(m_ws_frag_opcode)
+				return ws_protocol_error(WS_CLOSE_PROTOCOL_ERROR);
+		} else
+			return ws_protocol_error(WS_CLOSE_PROTOCOL_ERROR);
+
+		if(fin && opcode != WS_OP_CONTINUATION) {
+			// single frame message (deliver it in place)
+			m_ws_opcode = opcode;
+			m_ws_msg_offset = sz_hdr;
+			m_ws_msg_len = len;
+			m_ws_consumed = sz_frame;
+			m_ws_msg_ready = true;
+			r = HTTP_ON_WS_MESSAGE;
+		} else {
+			// append fragment payload to assembled part
+			memmove(frame, payload, avail - sz_hdr);
+			m_ibuffer_offset -= sz_hdr;
+			m_ws_assembled += len;
+			if(opcode != WS_OP_CONTINUATION)
+				m_ws_frag_opcode = opcode;
+
+			if(fin) {
+				m_ws_opcode = m_ws_frag_opcode;
+				m_ws_msg_offset = 0;
+				m_ws_msg_len = m_ws_assembled;
+				m_ws_consumed = m_ws_assembled;
+				m_ws_assembled = 0;
+				m_ws_frag_opcode = 0;
+				m_ws_msg_ready = true;
+				r = HTTP_ON_WS_MESSAGE;
+			} else
+				*next = true;
+		}
+	}
+
+	return r;
+}
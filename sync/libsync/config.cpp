@@ -56,13 +56,14 @@ static tString to_string(HTCONTEXT jcxt, _cstr_t jpath, HTVALUE jobj) {
 	return r;
 }
 
-static void load_module(HTCONTEXT jcxt, HTVALUE jv_module) {
+static void load_module(HTCONTEXT jcxt, HTVALUE jv_module, tSTLVector<tString> &v_module, tSTLVector<tString> &v_alias) {
 	if(gpi_json->type(jv_module) == JVT_OBJECT) {
 		tString module = to_string(jcxt, "module", jv_module);
 		tString alias = to_string(jcxt, "alias", jv_module);
 
 		gpi_log->fwrite(LMT_INFO, "ExtSync: Load '%s' as '%s'", module.c_str(), alias.c_str());
-		_gpi_repo_->extension_load(module.c_str(), alias.c_str());
+		v_module.push_back(module);
+		v_alias.push_back(alias);
 	}
 }
 
@@ -72,11 +73,39 @@ static void load_modules(HTCONTEXT jcxt) {
 	if(jv_modules && gpi_json->type(jv_modules) == JVT_ARRAY) {
 		_u32 idx = 0;
 		HTVALUE jv_module = NULL;
+		tSTLVector<tString> v_module, v_alias;
+		tSTLVector<_ext_load_t> v_load;
 
 		while((jv_module = gpi_json->by_index(jv_modules, idx))) {
-			load_module(jcxt, jv_module);
+			load_module(jcxt, jv_module, v_module, v_alias);
 			idx++;
 		}
+
+		for(_u32 i = 0; i < v_module.size(); i++) {
+			_ext_load_t el = {v_module[i].c_str(), v_alias[i].c_str(), ERR_NONE, 0};
+
+			v_load.push_back(el);
+		}
+
+		// load all, then initialize in order of dependencies
+		if(v_load.size()) {
+			HTVALUE jv_parallel = gpi_json->select(jcxt, "parallel-init", NULL);
+			_u32 flags = (jv_parallel && gpi_json->type(jv_parallel) == JVT_TRUE) ? EXT_PARALLEL : 0;
+
+			_gpi_repo_->extension_load_list(v_load.data(), v_load.size(), flags,
+				[](_cstr_t alias, _cstr_t cname, _u32 init_time, _cstat_t state, void *udata) {
+					if(state & ST_INITIALIZED)
+						gpi_log->fwrite(LMT_INFO, "ExtSync: '%s' (%s) initialized in %u us", cname, alias, init_time);
+					else
+						gpi_log->fwrite(LMT_WARNING, "ExtSync: '%s' (%s) is not initialized", cname, alias);
+				});
+
+			for(_u32 i = 0; i < v_load.size(); i++) {
+				if(v_load[i].err != ERR_NONE)
+					gpi_log->fwrite(LMT_ERROR, "ExtSync: Unable to load '%s' (%d)",
+							v_load[i].file, v_load[i].err);
+			}
+		}
 	}
 }
 